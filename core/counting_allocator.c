@@ -1,10 +1,23 @@
 #include "core/counting_allocator.h"
 
+// Adds `size` to the allocated byte count and raises the peak if needed.
+static void counting_grow(counting_allocator_t* ca, size_t size) {
+  size_t now = atomic_fetch_add_explicit(&ca->allocated_bytes, size,
+                                         memory_order_relaxed) +
+               size;
+  size_t peak = atomic_load_explicit(&ca->peak_bytes, memory_order_relaxed);
+  while (now > peak && !atomic_compare_exchange_weak_explicit(
+                           &ca->peak_bytes, &peak, now, memory_order_relaxed,
+                           memory_order_relaxed)) {
+  }
+}
+
 static void* counting_alloc(allocator_t* self, size_t size, size_t alignment) {
   counting_allocator_t* ca = (counting_allocator_t*)self;
   void* ptr = ca->backing->alloc(ca->backing, size, alignment);
   if (ptr) {
-    atomic_fetch_add_explicit(&ca->allocated_bytes, size, memory_order_relaxed);
+    counting_grow(ca, size);
+    atomic_fetch_add_explicit(&ca->alloc_count, 1, memory_order_relaxed);
   }
   return ptr;
 }
@@ -16,9 +29,11 @@ static void* counting_realloc(allocator_t* self, void* ptr, size_t old_size,
       ca->backing->realloc(ca->backing, ptr, old_size, new_size, alignment);
   if (new_ptr || new_size == 0) {
     ptrdiff_t diff = (ptrdiff_t)new_size - (ptrdiff_t)old_size;
+    if (ptr == nullptr && new_ptr) {
+      atomic_fetch_add_explicit(&ca->alloc_count, 1, memory_order_relaxed);
+    }
     if (diff > 0) {
-      atomic_fetch_add_explicit(&ca->allocated_bytes, (size_t)diff,
-                                memory_order_relaxed);
+      counting_grow(ca, (size_t)diff);
     } else if (diff < 0) {
       atomic_fetch_sub_explicit(&ca->allocated_bytes, (size_t)(-diff),
                                 memory_order_relaxed);
@@ -43,8 +58,25 @@ void counting_allocator_init(counting_allocator_t* ca, allocator_t* backing) {
   ca->super.page_size = 0;
   ca->backing = backing;
   atomic_init(&ca->allocated_bytes, 0);
+  atomic_init(&ca->peak_bytes, 0);
+  atomic_init(&ca->alloc_count, 0);
 }
 
 size_t counting_allocator_get_allocated_bytes(counting_allocator_t* ca) {
   return atomic_load_explicit(&ca->allocated_bytes, memory_order_relaxed);
 }
+
+size_t counting_allocator_get_peak_bytes(counting_allocator_t* ca) {
+  return atomic_load_explicit(&ca->peak_bytes, memory_order_relaxed);
+}
+
+size_t counting_allocator_get_alloc_count(counting_allocator_t* ca) {
+  return atomic_load_explicit(&ca->alloc_count, memory_order_relaxed);
+}
+
+void counting_allocator_reset_peak(counting_allocator_t* ca) {
+  atomic_store_explicit(
+      &ca->peak_bytes,
+      atomic_load_explicit(&ca->allocated_bytes, memory_order_relaxed),
+      memory_order_relaxed);
+}
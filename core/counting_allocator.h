@@ -20,10 +20,20 @@ typedef struct counting_allocator {
   allocator_t super;
   allocator_t* backing;
   _Atomic(size_t) allocated_bytes;
+  // High-water mark of allocated_bytes since init or the last reset_peak
+  _Atomic(size_t) peak_bytes;
+  // Number of fresh blocks handed out (alloc, or realloc from nullptr)
+  _Atomic(size_t) alloc_count;
 } counting_allocator_t;
 
 void counting_allocator_init(counting_allocator_t* ca, allocator_t* backing);
 size_t counting_allocator_get_allocated_bytes(counting_allocator_t* ca);
+size_t counting_allocator_get_peak_bytes(counting_allocator_t* ca);
+size_t counting_allocator_get_alloc_count(counting_allocator_t* ca);
+
+// Restarts peak tracking from the current allocated byte count, so the next
+// get_peak_bytes reports the high-water mark of a single phase.
+void counting_allocator_reset_peak(counting_allocator_t* ca);
 
 static inline allocator_t* counting_allocator_get_allocator(
     counting_allocator_t* ca) {
@@ -0,0 +1,49 @@
+#include "core/counting_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include "core/allocator.h"
+
+TEST(counting_allocator_test, tracks_current_and_peak_bytes) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  allocator_t* a = counting_allocator_get_allocator(&ca);
+
+  void* p1 = allocator_alloc(a, 100);
+  void* p2 = allocator_alloc(a, 50);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 150u);
+  EXPECT_EQ(counting_allocator_get_peak_bytes(&ca), 150u);
+  EXPECT_EQ(counting_allocator_get_alloc_count(&ca), 2u);
+
+  allocator_free(a, p1, 100);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 50u);
+  EXPECT_EQ(counting_allocator_get_peak_bytes(&ca), 150u);
+
+  p2 = allocator_realloc(a, p2, 50, 80);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 80u);
+  EXPECT_EQ(counting_allocator_get_peak_bytes(&ca), 150u);
+  EXPECT_EQ(counting_allocator_get_alloc_count(&ca), 2u);
+
+  allocator_free(a, p2, 80);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
+}
+
+TEST(counting_allocator_test, reset_peak_starts_from_current) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  allocator_t* a = counting_allocator_get_allocator(&ca);
+
+  void* big = allocator_alloc(a, 1000);
+  allocator_free(a, big, 1000);
+  void* small = allocator_alloc(a, 10);
+  EXPECT_EQ(counting_allocator_get_peak_bytes(&ca), 1000u);
+
+  counting_allocator_reset_peak(&ca);
+  EXPECT_EQ(counting_allocator_get_peak_bytes(&ca), 10u);
+
+  void* mid = allocator_alloc(a, 200);
+  EXPECT_EQ(counting_allocator_get_peak_bytes(&ca), 210u);
+
+  allocator_free(a, mid, 200);
+  allocator_free(a, small, 10);
+}
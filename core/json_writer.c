@@ -110,6 +110,7 @@ void json_writer_init(json_writer_t* w, bool indent, darray_uint8_t* out_buf,
                       allocator_t* a) {
   w->buf = out_buf;
   w->allocator = a;
+  w->stream = nullptr;
   w->depth = 0;
   w->first_item[0] = true;
   w->after_key = false;
@@ -117,6 +118,35 @@ void json_writer_init(json_writer_t* w, bool indent, darray_uint8_t* out_buf,
   darray_clear(out_buf);
 }
 
+void json_writer_init_stream(json_writer_t* w, bool indent, FILE* stream,
+                             darray_uint8_t* block, allocator_t* a) {
+  json_writer_init(w, indent, block, a);
+  w->stream = stream;
+  darray_reserve(block, JSON_WRITER_BLOCK_SIZE, a);
+}
+
+static void json_writer_write_block(json_writer_t* w) {
+  if (w->buf->len > 0) {
+    fwrite(w->buf->ptr, 1, w->buf->len, w->stream);
+    darray_clear(w->buf);
+  }
+}
+
+void json_writer_flush(json_writer_t* w) {
+  if (w->stream) {
+    json_writer_write_block(w);
+    fflush(w->stream);
+  }
+}
+
+// Called after every public write. A single long string can push a block past
+// the limit; it is written out whole right after.
+static void json_writer_maybe_flush(json_writer_t* w) {
+  if (w->stream && w->buf->len >= JSON_WRITER_BLOCK_SIZE) {
+    json_writer_write_block(w);
+  }
+}
+
 static void json_writer_indent(json_writer_t* w) {
   if (w->indent) {
     for (size_t i = 0; i < w->depth; i++) {
@@ -159,6 +189,7 @@ void json_writer_begin_object(json_writer_t* w) {
     w->depth++;
     w->first_item[w->depth] = true;
   }
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_end_object(json_writer_t* w) {
@@ -171,6 +202,7 @@ void json_writer_end_object(json_writer_t* w) {
     w->first_item[w->depth] = false;
   }
   json_writer_append_char(w, '}');
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_begin_array(json_writer_t* w) {
@@ -184,6 +216,7 @@ void json_writer_begin_array(json_writer_t* w) {
     w->depth++;
     w->first_item[w->depth] = true;
   }
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_end_array(json_writer_t* w) {
@@ -196,6 +229,7 @@ void json_writer_end_array(json_writer_t* w) {
     w->first_item[w->depth] = false;
   }
   json_writer_append_char(w, ']');
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_name(json_writer_t* w, string_view_t name) {
@@ -222,6 +256,7 @@ void json_writer_name(json_writer_t* w, string_view_t name) {
     json_writer_append_str(w, "\":");
   }
   w->after_key = true;
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_string(json_writer_t* w, string_view_t val) {
@@ -229,6 +264,7 @@ void json_writer_string(json_writer_t* w, string_view_t val) {
   json_writer_append_char(w, '"');
   json_writer_write_escaped(w->buf, val, w->allocator);
   json_writer_append_char(w, '"');
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_number_double(json_writer_t* w, double val) {
@@ -238,6 +274,7 @@ void json_writer_number_double(json_writer_t* w, double val) {
   if (len > 0) {
     darray_push_n(w->buf, tmp, (size_t)len, w->allocator);
   }
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_number_int(json_writer_t* w, int64_t val) {
@@ -247,6 +284,7 @@ void json_writer_number_int(json_writer_t* w, int64_t val) {
   if (len > 0) {
     darray_push_n(w->buf, tmp, (size_t)len, w->allocator);
   }
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_bool(json_writer_t* w, bool val) {
@@ -256,9 +294,24 @@ void json_writer_bool(json_writer_t* w, bool val) {
   } else {
     json_writer_append_str(w, "false");
   }
+  json_writer_maybe_flush(w);
 }
 
 void json_writer_null(json_writer_t* w) {
   json_writer_prepare_value(w);
   json_writer_append_str(w, "null");
+  json_writer_maybe_flush(w);
+}
+
+void json_writer_raw(json_writer_t* w, string_view_t val) {
+  json_writer_prepare_value(w);
+  darray_push_n(w->buf, val.ptr, val.len, w->allocator);
+  json_writer_maybe_flush(w);
+}
+
+void json_writer_newline(json_writer_t* w) {
+  json_writer_append_char(w, '\n');
+  // A newline ends a record (JSON Lines), which readers of the stream should
+  // see right away rather than once a block fills up.
+  json_writer_flush(w);
 }
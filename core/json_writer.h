@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "core/allocator.h"
 #include "core/darray.h"
@@ -13,9 +14,14 @@
 extern "C" {
 #endif
 
+// Streaming writers hand their buffer to the stream once it holds this many
+// bytes.
+constexpr size_t JSON_WRITER_BLOCK_SIZE = 64 * 1024;
+
 typedef struct json_writer {
   darray_uint8_t* buf;  // Destination buffer (dynamic array of uint8_t)
   allocator_t* allocator;
+  FILE* stream;  // Non-null for streaming writers; `buf` is the pending block
   bool first_item[32];  // Nesting stack to track if we need to write commas
   size_t depth;
   bool after_key;  // State flag: true if we just wrote a love key
@@ -24,6 +30,17 @@ typedef struct json_writer {
 
 void json_writer_init(json_writer_t* w, bool indent, darray_uint8_t* out_buf,
                       allocator_t* a);
+
+// Initializes a writer that streams to `stream`. Output collects in `block`
+// and is written out whenever it reaches JSON_WRITER_BLOCK_SIZE or a record
+// ends with json_writer_newline(), so memory stays bounded however much is
+// written. Call json_writer_flush() when done.
+void json_writer_init_stream(json_writer_t* w, bool indent, FILE* stream,
+                             darray_uint8_t* block, allocator_t* a);
+
+// Writes any pending output of a streaming writer and flushes the stream.
+// Does nothing for buffer writers.
+void json_writer_flush(json_writer_t* w);
 void json_writer_begin_object(json_writer_t* w);
 void json_writer_end_object(json_writer_t* w);
 void json_writer_begin_array(json_writer_t* w);
@@ -39,6 +56,15 @@ void json_writer_number_int(json_writer_t* w, int64_t val);
 void json_writer_bool(json_writer_t* w, bool val);
 void json_writer_null(json_writer_t* w);
 
+// Writes `val`, which must be one complete JSON value, as is, e.g. a document
+// produced by another writer.
+void json_writer_raw(json_writer_t* w, string_view_t val);
+
+// Ends a top-level value with a newline, e.g. between JSON Lines records.
+// Streaming writers then flush, so each record reaches the stream as soon as
+// it is complete.
+void json_writer_newline(json_writer_t* w);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,7 +1,9 @@
 #include "core/json_writer.h"
 
 #include <gtest/gtest.h>
+#include <stdio.h>
 
+#include <string>
 #include <string_view>
 
 #include "core/allocator.h"
@@ -111,6 +113,25 @@ TEST(json_writer_test, double_and_bool) {
   darray_deinit(&buf, a);
 }
 
+TEST(json_writer_test, raw_values_take_commas) {
+  allocator_t* a = c_allocator();
+  darray_uint8_t buf = {};
+  json_writer_t w;
+  json_writer_init(&w, false, &buf, a);
+
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("a"));
+  json_writer_raw(&w, SV("[1,{\"b\":2}]"));
+  json_writer_name(&w, SV("c"));
+  json_writer_raw(&w, SV("\"x\""));
+  json_writer_end_object(&w);
+
+  std::string_view res(reinterpret_cast<const char*>(buf.ptr), buf.len);
+  EXPECT_EQ(res, "{\"a\":[1,{\"b\":2}],\"c\":\"x\"}");
+
+  darray_deinit(&buf, a);
+}
+
 TEST(json_writer_test, depth_clamping) {
   allocator_t* a = c_allocator();
   darray_uint8_t buf = {};
@@ -180,3 +201,72 @@ TEST(json_writer_test, indentation) {
 
   darray_deinit(&buf, a);
 }
+
+TEST(json_writer_test, stream_flushes_in_blocks) {
+  allocator_t* a = c_allocator();
+  FILE* f = tmpfile();
+  ASSERT_NE(f, nullptr);
+  darray_uint8_t block = {};
+  json_writer_t w;
+  json_writer_init_stream(&w, false, f, &block, a);
+
+  // Write ~3 blocks of array items; the pending block never grows past one
+  // block plus the item that filled it.
+  std::string expected = "[";
+  json_writer_begin_array(&w);
+  for (int i = 0; i < 20000; i++) {
+    json_writer_begin_object(&w);
+    json_writer_name(&w, string_view_from_cstr("i"));
+    json_writer_number_int(&w, i);
+    json_writer_end_object(&w);
+    expected += (i > 0 ? ",{\"i\":" : "{\"i\":") + std::to_string(i) + "}";
+    EXPECT_LT(block.len, JSON_WRITER_BLOCK_SIZE + 16);
+  }
+  json_writer_end_array(&w);
+  expected += "]";
+  EXPECT_GT(ftell(f), 0);
+  EXPECT_GT(block.len, 0u);
+  json_writer_flush(&w);
+  EXPECT_EQ(block.len, 0u);
+
+  std::string res(expected.size() + 1, '\0');
+  rewind(f);
+  size_t n = fread(res.data(), 1, res.size(), f);
+  res.resize(n);
+  EXPECT_EQ(res, expected);
+
+  fclose(f);
+  darray_deinit(&block, a);
+}
+
+TEST(json_writer_test, stream_flushes_records_at_newline) {
+  allocator_t* a = c_allocator();
+  FILE* f = tmpfile();
+  ASSERT_NE(f, nullptr);
+  darray_uint8_t block = {};
+  json_writer_t w;
+  json_writer_init_stream(&w, false, f, &block, a);
+
+  // Each JSON Lines record is in the stream once its newline is written.
+  std::string expected;
+  for (int i = 0; i < 3; i++) {
+    json_writer_begin_object(&w);
+    json_writer_name(&w, string_view_from_cstr("i"));
+    json_writer_number_int(&w, i);
+    json_writer_end_object(&w);
+    EXPECT_GT(block.len, 0u);
+    json_writer_newline(&w);
+    expected += "{\"i\":" + std::to_string(i) + "}\n";
+    EXPECT_EQ(block.len, 0u);
+    EXPECT_EQ(ftell(f), (long)expected.size());
+  }
+
+  std::string res(expected.size() + 1, '\0');
+  rewind(f);
+  size_t n = fread(res.data(), 1, res.size(), f);
+  res.resize(n);
+  EXPECT_EQ(res, expected);
+
+  fclose(f);
+  darray_deinit(&block, a);
+}
@@ -0,0 +1,131 @@
+#include "core/quantile_sketch.h"
+
+#include <math.h>
+#include <string.h>
+
+// Smallest value that gets a bin; smaller ones count as zero.
+static const double QUANTILE_SKETCH_MIN_VALUE = 1e-9;
+
+static double quantile_sketch_gamma(void) {
+  return (1.0 + QUANTILE_SKETCH_RELATIVE_ACCURACY) /
+         (1.0 - QUANTILE_SKETCH_RELATIVE_ACCURACY);
+}
+
+static int32_t quantile_sketch_index(double value) {
+  return (int32_t)ceil(log(value) / log(quantile_sketch_gamma()));
+}
+
+// Midpoint of bin `index` in relative terms, so every value in the bin is
+// within the relative accuracy of it.
+static double quantile_sketch_value(int32_t index) {
+  double gamma = quantile_sketch_gamma();
+  return 2.0 * pow(gamma, (double)index) / (gamma + 1.0);
+}
+
+// Grows the bins to cover indices [lo, hi].
+static void quantile_sketch_cover(quantile_sketch_t* s, int32_t lo, int32_t hi,
+                                  allocator_t* a) {
+  if (s->bins.len == 0) {
+    size_t len = (size_t)(hi - lo) + 1;
+    darray_resize(&s->bins, len, a);
+    memset(s->bins.ptr, 0, len * sizeof(uint64_t));
+    s->offset = lo;
+  } else {
+    int32_t end = s->offset + (int32_t)s->bins.len;
+    int32_t new_lo = lo < s->offset ? lo : s->offset;
+    int32_t new_end = hi + 1 > end ? hi + 1 : end;
+    if (new_lo < s->offset || new_end > end) {
+      size_t old_len = s->bins.len;
+      size_t shift = (size_t)(s->offset - new_lo);
+      size_t len = (size_t)(new_end - new_lo);
+      darray_resize(&s->bins, len, a);
+      memmove(s->bins.ptr + shift, s->bins.ptr, old_len * sizeof(uint64_t));
+      memset(s->bins.ptr, 0, shift * sizeof(uint64_t));
+      memset(s->bins.ptr + shift + old_len, 0,
+             (len - shift - old_len) * sizeof(uint64_t));
+      s->offset = new_lo;
+    }
+  }
+}
+
+static void quantile_sketch_update_extremes(quantile_sketch_t* s, double min,
+                                            double max) {
+  if (s->count == 0 || min < s->min) {
+    s->min = min;
+  }
+  if (s->count == 0 || max > s->max) {
+    s->max = max;
+  }
+}
+
+void quantile_sketch_deinit(quantile_sketch_t* s, allocator_t* a) {
+  darray_deinit(&s->bins, a);
+  *s = (quantile_sketch_t){};
+}
+
+void quantile_sketch_add(quantile_sketch_t* s, double value, allocator_t* a) {
+  if (value < QUANTILE_SKETCH_MIN_VALUE) {
+    s->zero_count++;
+  } else {
+    int32_t index = quantile_sketch_index(value);
+    quantile_sketch_cover(s, index, index, a);
+    s->bins.ptr[index - s->offset]++;
+  }
+  quantile_sketch_update_extremes(s, value, value);
+  s->count++;
+}
+
+void quantile_sketch_merge(quantile_sketch_t* dst, const quantile_sketch_t* src,
+                           allocator_t* a) {
+  if (src->count > 0) {
+    if (src->bins.len > 0) {
+      quantile_sketch_cover(dst, src->offset,
+                            src->offset + (int32_t)src->bins.len - 1, a);
+      uint64_t* bins = dst->bins.ptr + (src->offset - dst->offset);
+      for (size_t i = 0; i < src->bins.len; i++) {
+        bins[i] += src->bins.ptr[i];
+      }
+    }
+    dst->zero_count += src->zero_count;
+    quantile_sketch_update_extremes(dst, src->min, src->max);
+    dst->count += src->count;
+  }
+}
+
+double quantile_sketch_quantile(const quantile_sketch_t* s, double q) {
+  double result = 0.0;
+  if (s->count == 0) {
+    result = 0.0;
+  } else if (q <= 0.0) {
+    result = s->min;
+  } else if (q >= 1.0) {
+    result = s->max;
+  } else {
+    // Zero-based rank of the requested value.
+    double rank = q * (double)(s->count - 1);
+    uint64_t seen = s->zero_count;
+    if ((double)seen > rank) {
+      result = s->min;
+    } else {
+      bool found = false;
+      for (size_t i = 0; !found && i < s->bins.len; i++) {
+        seen += s->bins.ptr[i];
+        if ((double)seen > rank) {
+          result = quantile_sketch_value(s->offset + (int32_t)i);
+          found = true;
+        }
+      }
+      if (!found) {
+        result = s->max;
+      }
+    }
+    // The bin midpoint can fall outside the values actually seen.
+    if (result < s->min) {
+      result = s->min;
+    }
+    if (result > s->max) {
+      result = s->max;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,55 @@
+#ifndef CORE_QUANTILE_SKETCH_H
+#define CORE_QUANTILE_SKETCH_H
+
+#include <stdint.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Relative accuracy of quantile_sketch_quantile: the estimate is within 1% of
+// a value of the requested rank.
+constexpr double QUANTILE_SKETCH_RELATIVE_ACCURACY = 0.01;
+
+// Mergeable quantile sketch (DDSketch) of non-negative values.
+//
+// Positive values are counted in logarithmic bins: bin i holds the values in
+// (gamma^(i-1), gamma^i], with gamma = (1 + a) / (1 - a) for the relative
+// accuracy a. Memory depends on the ratio between the largest and smallest
+// value, not on the number of values: durations from 1 us to 1 hour fit in
+// about 1100 bins. Two sketches merge by adding bins, so partitions can be
+// sketched in parallel and combined, and values can be streamed in.
+//
+// Zero-initialized (`= {}`) is an empty sketch.
+typedef struct quantile_sketch {
+  // Counts of bins [offset, offset + bins.len)
+  darray_uint64_t bins;
+  int32_t offset;
+  // Values too small for a bin (<= 0, or below 1e-9)
+  uint64_t zero_count;
+  uint64_t count;
+  // Exact extremes
+  double min;
+  double max;
+} quantile_sketch_t;
+
+void quantile_sketch_deinit(quantile_sketch_t* s, allocator_t* a);
+
+void quantile_sketch_add(quantile_sketch_t* s, double value, allocator_t* a);
+
+// Adds every value of `src` to `dst`.
+void quantile_sketch_merge(quantile_sketch_t* dst, const quantile_sketch_t* src,
+                           allocator_t* a);
+
+// Estimates the value at quantile `q` in [0, 1]. q = 0 and q = 1 return the
+// exact min and max. Returns 0 for an empty sketch.
+double quantile_sketch_quantile(const quantile_sketch_t* s, double q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CORE_QUANTILE_SKETCH_H
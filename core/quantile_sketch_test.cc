@@ -0,0 +1,99 @@
+#include "core/quantile_sketch.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "core/allocator.h"
+
+// Exact value at quantile `q`, with the same rank convention as the sketch.
+static double exact_quantile(std::vector<double> values, double q) {
+  std::sort(values.begin(), values.end());
+  size_t rank = (size_t)(q * (double)(values.size() - 1));
+  return values[rank];
+}
+
+static void expect_relative_near(double actual, double expected) {
+  EXPECT_LE(std::fabs(actual - expected),
+            expected * QUANTILE_SKETCH_RELATIVE_ACCURACY)
+      << "actual " << actual << ", expected " << expected;
+}
+
+TEST(quantile_sketch_test, empty_sketch_returns_zero) {
+  quantile_sketch_t s = {};
+  EXPECT_EQ(quantile_sketch_quantile(&s, 0.5), 0.0);
+  EXPECT_EQ(s.count, 0u);
+}
+
+TEST(quantile_sketch_test, quantiles_within_relative_accuracy) {
+  allocator_t* a = c_allocator();
+  quantile_sketch_t s = {};
+  std::vector<double> values;
+  // Spread over six orders of magnitude.
+  for (int i = 0; i < 10000; i++) {
+    double v = std::pow(10.0, (double)(i * 7919 % 10000) / 10000.0 * 6.0);
+    values.push_back(v);
+    quantile_sketch_add(&s, v, a);
+  }
+  EXPECT_EQ(s.count, 10000u);
+  for (double q : {0.01, 0.25, 0.5, 0.9, 0.99}) {
+    expect_relative_near(quantile_sketch_quantile(&s, q),
+                         exact_quantile(values, q));
+  }
+  EXPECT_EQ(quantile_sketch_quantile(&s, 0.0),
+            *std::min_element(values.begin(), values.end()));
+  EXPECT_EQ(quantile_sketch_quantile(&s, 1.0),
+            *std::max_element(values.begin(), values.end()));
+  quantile_sketch_deinit(&s, a);
+}
+
+TEST(quantile_sketch_test, zeros_rank_below_positive_values) {
+  allocator_t* a = c_allocator();
+  quantile_sketch_t s = {};
+  for (int i = 0; i < 60; i++) {
+    quantile_sketch_add(&s, 0.0, a);
+  }
+  for (int i = 0; i < 40; i++) {
+    quantile_sketch_add(&s, 100.0, a);
+  }
+  EXPECT_EQ(quantile_sketch_quantile(&s, 0.5), 0.0);
+  EXPECT_EQ(quantile_sketch_quantile(&s, 0.9), 100.0);
+  quantile_sketch_deinit(&s, a);
+}
+
+TEST(quantile_sketch_test, merge_matches_single_sketch) {
+  allocator_t* a = c_allocator();
+  quantile_sketch_t all = {};
+  quantile_sketch_t low = {};
+  quantile_sketch_t high = {};
+  // The partitions cover disjoint bin ranges, so merging grows `low` at the
+  // top and `high` at the bottom.
+  for (int i = 1; i <= 1000; i++) {
+    double v = (double)i;
+    quantile_sketch_add(&all, v, a);
+    quantile_sketch_add(i <= 500 ? &low : &high, v, a);
+  }
+  quantile_sketch_t merged_up = {};
+  quantile_sketch_merge(&merged_up, &low, a);
+  quantile_sketch_merge(&merged_up, &high, a);
+  quantile_sketch_t merged_down = {};
+  quantile_sketch_merge(&merged_down, &high, a);
+  quantile_sketch_merge(&merged_down, &low, a);
+
+  for (double q : {0.0, 0.1, 0.5, 0.9, 0.99, 1.0}) {
+    double expected = quantile_sketch_quantile(&all, q);
+    EXPECT_EQ(quantile_sketch_quantile(&merged_up, q), expected);
+    EXPECT_EQ(quantile_sketch_quantile(&merged_down, q), expected);
+  }
+  EXPECT_EQ(merged_up.count, 1000u);
+  EXPECT_EQ(merged_up.min, 1.0);
+  EXPECT_EQ(merged_up.max, 1000.0);
+
+  quantile_sketch_deinit(&merged_down, a);
+  quantile_sketch_deinit(&merged_up, a);
+  quantile_sketch_deinit(&high, a);
+  quantile_sketch_deinit(&low, a);
+  quantile_sketch_deinit(&all, a);
+}
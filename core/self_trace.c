@@ -0,0 +1,329 @@
+#define _POSIX_C_SOURCE 200809L
+#include "core/self_trace.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "core/json_writer.h"
+#include "core/string.h"
+
+// Number of markers per thread ring (must be a power of two).
+constexpr size_t SELF_TRACE_RING_CAPACITY = 1 << 16;
+
+// Maximum scope nesting tracked while matching begin/end markers on export.
+constexpr size_t SELF_TRACE_MAX_DEPTH = 64;
+
+// A single begin (name != nullptr) or end (name == nullptr) marker, as copied
+// out of a ring by the exporter.
+typedef struct self_trace_marker {
+  const char* name;
+  uint64_t ts_ns;
+} self_trace_marker_t;
+
+// A marker slot in a ring. The exporter reads slots while their owner may be
+// overwriting them, so both fields are atomics accessed with relaxed order.
+typedef struct self_trace_slot {
+  _Atomic(const char*) name;
+  _Atomic(uint64_t) ts_ns;
+} self_trace_slot_t;
+
+// A per-thread ring. Only the owning thread writes slots and head; the
+// exporter reads them concurrently and discards slots overwritten mid-copy.
+typedef struct self_trace_ring {
+  self_trace_slot_t* slots;
+  // Total number of markers ever written (slot = head % capacity)
+  _Atomic(uint64_t) head;
+  // Markers before this index were dropped by self_trace_clear()
+  uint64_t cleared;
+  // Sequential thread ID used in the exported trace
+  uint32_t tid;
+  // Optional thread name (static storage)
+  const char* thread_name;
+  // Next ring in the global registry
+  struct self_trace_ring* next;
+  // Next ring in the free list, while no thread owns this one
+  struct self_trace_ring* next_free;
+} self_trace_ring_t;
+
+static _Atomic(bool) g_enabled = false;
+static _Atomic(uint64_t) g_epoch_ns = 0;
+
+// Registry of all rings. A ring is created on a thread's first recorded
+// marker and stays registered, so its markers are exported after the thread
+// exits. The exit hands the ring to the free list, and the next thread that
+// records takes it over under the same tid, so threads that come and go (e.g.
+// one per load) use as many rings as ever ran at once.
+static pthread_mutex_t g_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static self_trace_ring_t* g_rings = nullptr;
+static self_trace_ring_t* g_free_rings = nullptr;
+static uint32_t g_next_tid = 1;
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_ring_key;
+
+static _Thread_local self_trace_ring_t* t_ring = nullptr;
+static _Thread_local const char* t_thread_name = nullptr;
+
+static uint64_t self_trace_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Thread-exit destructor of g_ring_key: returns the thread's ring to the free
+// list.
+static void self_trace_release_ring(void* value) {
+  self_trace_ring_t* ring = (self_trace_ring_t*)value;
+  pthread_mutex_lock(&g_registry_mutex);
+  ring->next_free = g_free_rings;
+  g_free_rings = ring;
+  pthread_mutex_unlock(&g_registry_mutex);
+  t_ring = nullptr;
+}
+
+static void self_trace_create_ring_key(void) {
+  pthread_key_create(&g_ring_key, self_trace_release_ring);
+}
+
+static self_trace_ring_t* self_trace_register_thread(void) {
+  pthread_once(&g_ring_key_once, self_trace_create_ring_key);
+
+  pthread_mutex_lock(&g_registry_mutex);
+  self_trace_ring_t* ring = g_free_rings;
+  if (ring != nullptr) {
+    g_free_rings = ring->next_free;
+    ring->next_free = nullptr;
+    ring->thread_name = t_thread_name;
+  } else {
+    allocator_t* a = c_allocator();
+    ring = allocator_alloc(a, sizeof(self_trace_ring_t));
+    *ring = (self_trace_ring_t){
+        .slots = allocator_alloc_uninitialized(
+            a, SELF_TRACE_RING_CAPACITY * sizeof(self_trace_slot_t)),
+        .tid = g_next_tid++,
+        .thread_name = t_thread_name,
+        .next = g_rings,
+    };
+    atomic_init(&ring->head, 0);
+    g_rings = ring;
+  }
+  pthread_mutex_unlock(&g_registry_mutex);
+
+  pthread_setspecific(g_ring_key, ring);
+  t_ring = ring;
+  return ring;
+}
+
+static void self_trace_record(const char* name) {
+  self_trace_ring_t* ring = t_ring;
+  if (ring == nullptr) {
+    ring = self_trace_register_thread();
+  }
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  self_trace_slot_t* slot = &ring->slots[head & (SELF_TRACE_RING_CAPACITY - 1)];
+  atomic_store_explicit(&slot->name, name, memory_order_relaxed);
+  atomic_store_explicit(&slot->ts_ns, self_trace_now_ns(),
+                        memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void self_trace_set_enabled(bool enabled) {
+  if (enabled) {
+    uint64_t expected = 0;
+    atomic_compare_exchange_strong(&g_epoch_ns, &expected,
+                                   self_trace_now_ns());
+  }
+  atomic_store(&g_enabled, enabled);
+}
+
+bool self_trace_is_enabled(void) {
+  return atomic_load_explicit(&g_enabled, memory_order_relaxed);
+}
+
+void self_trace_begin(const char* name) {
+  if (atomic_load_explicit(&g_enabled, memory_order_relaxed)) {
+    self_trace_record(name);
+  }
+}
+
+void self_trace_end(void) {
+  if (atomic_load_explicit(&g_enabled, memory_order_relaxed)) {
+    self_trace_record(nullptr);
+  }
+}
+
+void self_trace_set_thread_name(const char* name) {
+  t_thread_name = name;
+  if (t_ring != nullptr) {
+    pthread_mutex_lock(&g_registry_mutex);
+    t_ring->thread_name = name;
+    pthread_mutex_unlock(&g_registry_mutex);
+  }
+}
+
+void self_trace_clear(void) {
+  pthread_mutex_lock(&g_registry_mutex);
+  for (self_trace_ring_t* ring = g_rings; ring != nullptr; ring = ring->next) {
+    ring->cleared = atomic_load_explicit(&ring->head, memory_order_acquire);
+  }
+  pthread_mutex_unlock(&g_registry_mutex);
+}
+
+// ─── Export ──────────────────────────────────────────────────────────────────
+
+static void write_thread_name(json_writer_t* w, uint32_t tid,
+                              const char* thread_name) {
+  json_writer_begin_object(w);
+  json_writer_name(w, SV("name"));
+  json_writer_string(w, SV("thread_name"));
+  json_writer_name(w, SV("ph"));
+  json_writer_string(w, SV("M"));
+  json_writer_name(w, SV("pid"));
+  json_writer_number_int(w, 1);
+  json_writer_name(w, SV("tid"));
+  json_writer_number_int(w, tid);
+  json_writer_name(w, SV("args"));
+  json_writer_begin_object(w);
+  json_writer_name(w, SV("name"));
+  json_writer_string(w, string_view_from_cstr(thread_name));
+  json_writer_end_object(w);
+  json_writer_end_object(w);
+}
+
+static void write_complete_event(json_writer_t* w, const char* name,
+                                 uint32_t tid, uint64_t epoch_ns,
+                                 uint64_t begin_ns, uint64_t end_ns) {
+  json_writer_begin_object(w);
+  json_writer_name(w, SV("name"));
+  json_writer_string(w, string_view_from_cstr(name));
+  json_writer_name(w, SV("cat"));
+  json_writer_string(w, SV("ztracing"));
+  json_writer_name(w, SV("ph"));
+  json_writer_string(w, SV("X"));
+  json_writer_name(w, SV("ts"));
+  json_writer_number_int(w, (int64_t)((begin_ns - epoch_ns) / 1000));
+  json_writer_name(w, SV("dur"));
+  json_writer_number_int(w, (int64_t)((end_ns - begin_ns) / 1000));
+  json_writer_name(w, SV("pid"));
+  json_writer_number_int(w, 1);
+  json_writer_name(w, SV("tid"));
+  json_writer_number_int(w, tid);
+  json_writer_end_object(w);
+}
+
+// Snapshots one ring and writes its matched scopes as complete events.
+static void write_ring_events(json_writer_t* w, self_trace_ring_t* ring,
+                              self_trace_marker_t* snapshot, uint64_t epoch_ns,
+                              uint64_t now_ns) {
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint64_t start = head > SELF_TRACE_RING_CAPACITY
+                       ? head - SELF_TRACE_RING_CAPACITY
+                       : 0;
+  if (start < ring->cleared) {
+    start = ring->cleared;
+  }
+  for (uint64_t i = start; i < head; i++) {
+    self_trace_slot_t* slot = &ring->slots[i & (SELF_TRACE_RING_CAPACITY - 1)];
+    snapshot[i - start] = (self_trace_marker_t){
+        .name = atomic_load_explicit(&slot->name, memory_order_relaxed),
+        .ts_ns = atomic_load_explicit(&slot->ts_ns, memory_order_relaxed),
+    };
+  }
+
+  // The owner may have lapped the ring while we copied; skip any slot that
+  // could have been overwritten during the copy. The fence orders the copy
+  // before the second head load, as in a seqlock reader.
+  atomic_thread_fence(memory_order_acquire);
+  uint64_t head_after = atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint64_t valid = head_after > SELF_TRACE_RING_CAPACITY
+                       ? head_after - SELF_TRACE_RING_CAPACITY
+                       : 0;
+  if (valid < start) {
+    valid = start;
+  }
+
+  uint64_t stack[SELF_TRACE_MAX_DEPTH];
+  size_t depth = 0;
+  size_t overflow = 0;
+  for (uint64_t i = valid; i < head; i++) {
+    const self_trace_marker_t* m = &snapshot[i - start];
+    if (m->name != nullptr) {
+      if (depth < SELF_TRACE_MAX_DEPTH) {
+        stack[depth++] = i;
+      } else {
+        overflow++;
+      }
+    } else if (overflow > 0) {
+      overflow--;
+    } else if (depth > 0) {
+      const self_trace_marker_t* b = &snapshot[stack[--depth] - start];
+      write_complete_event(w, b->name, ring->tid, epoch_ns, b->ts_ns, m->ts_ns);
+    }
+    // An end with an empty stack lost its begin to wrap-around; drop it.
+  }
+
+  // Close scopes that are still open at export time.
+  while (depth > 0) {
+    const self_trace_marker_t* b = &snapshot[stack[--depth] - start];
+    write_complete_event(w, b->name, ring->tid, epoch_ns, b->ts_ns, now_ns);
+  }
+}
+
+void self_trace_write_json(darray_uint8_t* out_buf, allocator_t* a) {
+  json_writer_t w;
+  json_writer_init(&w, false, out_buf, a);
+
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("traceEvents"));
+  json_writer_begin_array(&w);
+
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("name"));
+  json_writer_string(&w, SV("process_name"));
+  json_writer_name(&w, SV("ph"));
+  json_writer_string(&w, SV("M"));
+  json_writer_name(&w, SV("pid"));
+  json_writer_number_int(&w, 1);
+  json_writer_name(&w, SV("args"));
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("name"));
+  json_writer_string(&w, SV("ztracing"));
+  json_writer_end_object(&w);
+  json_writer_end_object(&w);
+
+  uint64_t epoch_ns = atomic_load(&g_epoch_ns);
+  uint64_t now_ns = self_trace_now_ns();
+  self_trace_marker_t* snapshot = allocator_alloc_uninitialized(
+      a, SELF_TRACE_RING_CAPACITY * sizeof(self_trace_marker_t));
+
+  pthread_mutex_lock(&g_registry_mutex);
+  for (self_trace_ring_t* ring = g_rings; ring != nullptr; ring = ring->next) {
+    if (ring->thread_name != nullptr) {
+      write_thread_name(&w, ring->tid, ring->thread_name);
+    }
+    write_ring_events(&w, ring, snapshot, epoch_ns, now_ns);
+  }
+  pthread_mutex_unlock(&g_registry_mutex);
+
+  allocator_free(a, snapshot,
+                 SELF_TRACE_RING_CAPACITY * sizeof(self_trace_marker_t));
+
+  json_writer_end_array(&w);
+  json_writer_end_object(&w);
+}
+
+bool self_trace_write_file(const char* path, allocator_t* a) {
+  bool success = false;
+  darray_uint8_t buf = {};
+  self_trace_write_json(&buf, a);
+
+  FILE* f = fopen(path, "wb");
+  if (f) {
+    success = fwrite(buf.ptr, 1, buf.len, f) == buf.len;
+    success = (fclose(f) == 0) && success;
+  }
+
+  darray_deinit(&buf, a);
+  return success;
+}
@@ -0,0 +1,82 @@
+#ifndef CORE_SELF_TRACE_H
+#define CORE_SELF_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ─── Self-Tracing ────────────────────────────────────────────────────────────
+//
+// Lightweight scoped instrumentation used to profile ztracing with ztracing.
+//
+// Each thread records begin/end markers into its own fixed-size ring buffer.
+// A ring has a single producer (its owning thread), so recording takes no
+// locks: the writer fills a slot and publishes it with a release store. When a
+// ring wraps, the oldest markers are overwritten. When a thread exits, its ring
+// (and its markers) passes to the next thread that records, under the same
+// thread ID in the exported trace.
+//
+// Recording is off until self_trace_set_enabled(true) is called, and a scope
+// on a disabled tracer costs one relaxed atomic load. Building with
+// -DSELF_TRACE_ENABLED=0 compiles every scope out entirely.
+//
+// Usage (scope names must be string literals):
+//   SELF_TRACE_BEGIN("track_organize");
+//   ...
+//   SELF_TRACE_END();
+
+#ifndef SELF_TRACE_ENABLED
+#define SELF_TRACE_ENABLED 1
+#endif
+
+#if SELF_TRACE_ENABLED
+#define SELF_TRACE_BEGIN(name) self_trace_begin(name "")
+#define SELF_TRACE_END() self_trace_end()
+#else
+#define SELF_TRACE_BEGIN(name) ((void)0)
+#define SELF_TRACE_END() ((void)0)
+#endif
+
+// Turns recording on or off for all threads. The first enable also fixes the
+// time origin of the exported trace.
+void self_trace_set_enabled(bool enabled);
+
+// Returns true if recording is currently on.
+bool self_trace_is_enabled(void);
+
+// Records the start of a scope on the calling thread. `name` must outlive the
+// process (use SELF_TRACE_BEGIN, which only accepts string literals).
+void self_trace_begin(const char* name);
+
+// Records the end of the innermost open scope on the calling thread.
+void self_trace_end(void);
+
+// Names the calling thread in the exported trace. `name` must be a string
+// with static storage duration.
+void self_trace_set_thread_name(const char* name);
+
+// Drops everything recorded so far on all threads.
+void self_trace_clear(void);
+
+// Serializes all rings into out_buf as a Chrome trace ("traceEvents" with one
+// complete 'X' event per matched scope, plus thread_name metadata). Scopes
+// still open are closed at the time of the call; ends whose begin was
+// overwritten are dropped. Safe to call while other threads are recording.
+void self_trace_write_json(darray_uint8_t* out_buf, allocator_t* a);
+
+// Convenience wrapper that writes the Chrome trace to `path`.
+// Returns false if the file could not be written.
+bool self_trace_write_file(const char* path, allocator_t* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CORE_SELF_TRACE_H
@@ -0,0 +1,155 @@
+#include "core/self_trace.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+
+// ─── Test Helpers ────────────────────────────────────────────────────────────
+
+static std::string dump_trace() {
+  allocator_t* a = c_allocator();
+  darray_uint8_t buf = {};
+  self_trace_write_json(&buf, a);
+  std::string res(reinterpret_cast<const char*>(buf.ptr), buf.len);
+  darray_deinit(&buf, a);
+  return res;
+}
+
+static size_t count_occurrences(const std::string& haystack,
+                                const std::string& needle) {
+  size_t count = 0;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + needle.size())) {
+    count++;
+  }
+  return count;
+}
+
+class self_trace_test : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    self_trace_set_enabled(true);
+    self_trace_clear();
+  }
+  void TearDown() override { self_trace_set_enabled(false); }
+};
+
+// ─── Recording ───────────────────────────────────────────────────────────────
+
+TEST_F(self_trace_test, nested_scopes_become_complete_events) {
+  SELF_TRACE_BEGIN("outer");
+  SELF_TRACE_BEGIN("inner");
+  SELF_TRACE_END();
+  SELF_TRACE_END();
+
+  std::string json = dump_trace();
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0u);
+  EXPECT_NE(json.find("\"name\":\"outer\",\"cat\":\"ztracing\",\"ph\":\"X\""),
+            std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"inner\",\"cat\":\"ztracing\",\"ph\":\"X\""),
+            std::string::npos);
+  EXPECT_EQ(count_occurrences(json, "\"ph\":\"X\""), 2u);
+}
+
+TEST_F(self_trace_test, disabled_records_nothing) {
+  self_trace_set_enabled(false);
+  EXPECT_FALSE(self_trace_is_enabled());
+  SELF_TRACE_BEGIN("ignored");
+  SELF_TRACE_END();
+
+  std::string json = dump_trace();
+  EXPECT_EQ(json.find("ignored"), std::string::npos);
+}
+
+TEST_F(self_trace_test, clear_drops_recorded_scopes) {
+  SELF_TRACE_BEGIN("before_clear");
+  SELF_TRACE_END();
+  self_trace_clear();
+  SELF_TRACE_BEGIN("after_clear");
+  SELF_TRACE_END();
+
+  std::string json = dump_trace();
+  EXPECT_EQ(json.find("before_clear"), std::string::npos);
+  EXPECT_NE(json.find("after_clear"), std::string::npos);
+}
+
+TEST_F(self_trace_test, open_scope_is_closed_at_export) {
+  SELF_TRACE_BEGIN("still_open");
+  std::string json = dump_trace();
+  SELF_TRACE_END();
+
+  EXPECT_NE(json.find("\"name\":\"still_open\""), std::string::npos);
+}
+
+TEST_F(self_trace_test, threads_get_separate_rings_and_names) {
+  std::thread t([] {
+    self_trace_set_thread_name("test_worker");
+    SELF_TRACE_BEGIN("on_worker");
+    SELF_TRACE_END();
+  });
+  t.join();
+  SELF_TRACE_BEGIN("on_main");
+  SELF_TRACE_END();
+
+  std::string json = dump_trace();
+  EXPECT_NE(json.find("\"name\":\"on_worker\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"on_main\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"name\":\"test_worker\"}"),
+            std::string::npos);
+}
+
+// Returns the tid of the first complete event named `name`, or -1.
+static int event_tid(const std::string& json, const std::string& name) {
+  int tid = -1;
+  size_t pos = json.find("\"name\":\"" + name + "\"");
+  if (pos != std::string::npos) {
+    pos = json.find("\"tid\":", pos);
+    tid = atoi(json.c_str() + pos + 6);
+  }
+  return tid;
+}
+
+TEST_F(self_trace_test, exited_threads_hand_rings_over) {
+  // One thread at a time, so each takes over the ring of the last one.
+  for (int i = 0; i < 4; i++) {
+    std::thread t([i] {
+      SELF_TRACE_BEGIN("sequential");
+      SELF_TRACE_END();
+      if (i == 3) {
+        SELF_TRACE_BEGIN("last_thread");
+        SELF_TRACE_END();
+      }
+    });
+    t.join();
+  }
+
+  std::string json = dump_trace();
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"sequential\""), 4u);
+  int last_tid = event_tid(json, "last_thread");
+  EXPECT_GT(last_tid, 0);
+  size_t pos = 0;
+  while ((pos = json.find("\"name\":\"sequential\"", pos)) !=
+         std::string::npos) {
+    EXPECT_EQ(event_tid(json.substr(pos), "sequential"), last_tid);
+    pos++;
+  }
+}
+
+TEST_F(self_trace_test, wrapped_ring_keeps_newest_scopes) {
+  // Far more scopes than a ring holds; the oldest are overwritten.
+  for (int i = 0; i < 100000; i++) {
+    SELF_TRACE_BEGIN("spin");
+    SELF_TRACE_END();
+  }
+  SELF_TRACE_BEGIN("last");
+  SELF_TRACE_END();
+
+  std::string json = dump_trace();
+  EXPECT_NE(json.find("\"name\":\"last\""), std::string::npos);
+  EXPECT_LT(count_occurrences(json, "\"name\":\"spin\""), 100000u);
+}
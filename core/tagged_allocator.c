@@ -0,0 +1,181 @@
+#include "core/tagged_allocator.h"
+
+#include <stdint.h>
+
+// Smallest header placed in front of every block. The header is widened to
+// the requested alignment so the user pointer keeps that alignment.
+constexpr size_t TAGGED_HEADER_MIN_SIZE = 16;
+
+static size_t tagged_header_size(size_t alignment) {
+  return alignment > TAGGED_HEADER_MIN_SIZE ? alignment
+                                            : TAGGED_HEADER_MIN_SIZE;
+}
+
+// The tag is stored in the last 4 bytes of the header.
+static memory_tag_t tagged_read_tag(void* user_ptr) {
+  return (memory_tag_t)((uint32_t*)user_ptr)[-1];
+}
+
+static void tagged_write_tag(void* user_ptr, memory_tag_t tag) {
+  ((uint32_t*)user_ptr)[-1] = (uint32_t)tag;
+}
+
+static void counters_grow(memory_tag_counters_t* c, size_t size) {
+  size_t now =
+      atomic_fetch_add_explicit(&c->current_bytes, size, memory_order_relaxed) +
+      size;
+  size_t peak = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed);
+  while (now > peak && !atomic_compare_exchange_weak_explicit(
+                           &c->peak_bytes, &peak, now, memory_order_relaxed,
+                           memory_order_relaxed)) {
+  }
+}
+
+static void counters_shrink(memory_tag_counters_t* c, size_t size) {
+  atomic_fetch_sub_explicit(&c->current_bytes, size, memory_order_relaxed);
+}
+
+static void account_grow(tagged_allocator_t* ta, memory_tag_t tag,
+                         size_t size) {
+  counters_grow(&ta->tags[tag], size);
+  counters_grow(&ta->total, size);
+}
+
+static void account_shrink(tagged_allocator_t* ta, memory_tag_t tag,
+                           size_t size) {
+  counters_shrink(&ta->tags[tag], size);
+  counters_shrink(&ta->total, size);
+}
+
+static void account_new_block(tagged_allocator_t* ta, memory_tag_t tag) {
+  atomic_fetch_add_explicit(&ta->tags[tag].alloc_count, 1,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&ta->total.alloc_count, 1, memory_order_relaxed);
+}
+
+static void* tagged_alloc(allocator_t* self, size_t size, size_t alignment) {
+  tagged_allocator_view_t* view = (tagged_allocator_view_t*)self;
+  tagged_allocator_t* ta = view->owner;
+  size_t header = tagged_header_size(alignment);
+  void* user_ptr = nullptr;
+
+  char* raw = ta->backing->alloc(ta->backing, size + header, alignment);
+  if (raw) {
+    user_ptr = raw + header;
+    tagged_write_tag(user_ptr, view->tag);
+    account_grow(ta, view->tag, size);
+    account_new_block(ta, view->tag);
+  }
+  return user_ptr;
+}
+
+static void tagged_dealloc(allocator_t* self, void* ptr, size_t size,
+                           size_t alignment) {
+  tagged_allocator_view_t* view = (tagged_allocator_view_t*)self;
+  tagged_allocator_t* ta = view->owner;
+  if (ptr) {
+    size_t header = tagged_header_size(alignment);
+    account_shrink(ta, tagged_read_tag(ptr), size);
+    ta->backing->dealloc(ta->backing, (char*)ptr - header, size + header,
+                         alignment);
+  }
+}
+
+static void* tagged_realloc(allocator_t* self, void* ptr, size_t old_size,
+                            size_t new_size, size_t alignment) {
+  tagged_allocator_view_t* view = (tagged_allocator_view_t*)self;
+  tagged_allocator_t* ta = view->owner;
+  void* user_ptr = nullptr;
+
+  if (ptr == nullptr) {
+    if (new_size > 0) {
+      user_ptr = tagged_alloc(self, new_size, alignment);
+    }
+  } else if (new_size == 0) {
+    tagged_dealloc(self, ptr, old_size, alignment);
+  } else {
+    // The block keeps the tag it was allocated with.
+    size_t header = tagged_header_size(alignment);
+    memory_tag_t tag = tagged_read_tag(ptr);
+    char* raw = ta->backing->realloc(ta->backing, (char*)ptr - header,
+                                     old_size + header, new_size + header,
+                                     alignment);
+    if (raw) {
+      user_ptr = raw + header;
+      if (new_size > old_size) {
+        account_grow(ta, tag, new_size - old_size);
+      } else {
+        account_shrink(ta, tag, old_size - new_size);
+      }
+    }
+  }
+  return user_ptr;
+}
+
+void tagged_allocator_init(tagged_allocator_t* ta, allocator_t* backing) {
+  *ta = (tagged_allocator_t){.backing = backing};
+  for (size_t i = 0; i < MEMORY_TAG_COUNT; i++) {
+    ta->views[i] = (tagged_allocator_view_t){
+        .super =
+            {
+                .alloc = tagged_alloc,
+                .realloc = tagged_realloc,
+                .dealloc = tagged_dealloc,
+            },
+        .owner = ta,
+        .tag = (memory_tag_t)i,
+    };
+  }
+}
+
+tagged_allocator_t* tagged_allocator_from(allocator_t* a) {
+  tagged_allocator_t* result = nullptr;
+  if (a != nullptr && a->alloc == tagged_alloc) {
+    result = ((tagged_allocator_view_t*)a)->owner;
+  }
+  return result;
+}
+
+allocator_t* allocator_for_tag(allocator_t* a, memory_tag_t tag) {
+  allocator_t* result = a;
+  tagged_allocator_t* ta = tagged_allocator_from(a);
+  if (ta != nullptr) {
+    result = &ta->views[tag].super;
+  }
+  return result;
+}
+
+static void load_counters(memory_tag_counters_t* c,
+                          memory_tag_stats_t* out_stats) {
+  *out_stats = (memory_tag_stats_t){
+      .current_bytes =
+          atomic_load_explicit(&c->current_bytes, memory_order_relaxed),
+      .peak_bytes = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed),
+      .alloc_count =
+          atomic_load_explicit(&c->alloc_count, memory_order_relaxed),
+  };
+}
+
+void tagged_allocator_get_stats(tagged_allocator_t* ta, memory_tag_t tag,
+                                memory_tag_stats_t* out_stats) {
+  load_counters(&ta->tags[tag], out_stats);
+}
+
+void tagged_allocator_get_total_stats(tagged_allocator_t* ta,
+                                      memory_tag_stats_t* out_stats) {
+  load_counters(&ta->total, out_stats);
+}
+
+const char* memory_tag_name(memory_tag_t tag) {
+  static const char* const names[MEMORY_TAG_COUNT] = {
+      [MEMORY_TAG_OTHER] = "other",   [MEMORY_TAG_STRINGS] = "strings",
+      [MEMORY_TAG_EVENTS] = "events", [MEMORY_TAG_ARGS] = "args",
+      [MEMORY_TAG_TRACKS] = "tracks", [MEMORY_TAG_RENDER] = "render",
+      [MEMORY_TAG_SEARCH] = "search",
+  };
+  const char* name = "unknown";
+  if ((size_t)tag < MEMORY_TAG_COUNT) {
+    name = names[tag];
+  }
+  return name;
+}
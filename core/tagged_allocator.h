@@ -0,0 +1,105 @@
+#ifndef CORE_TAGGED_ALLOCATOR_H
+#define CORE_TAGGED_ALLOCATOR_H
+
+#include <stddef.h>
+
+#include "core/allocator.h"
+
+#ifdef __cplusplus
+#include <atomic>
+#ifndef _Atomic
+#define _Atomic(T) std::atomic<T>
+#endif
+#else
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ─── Tagged Memory Accounting ────────────────────────────────────────────────
+//
+// A tagged_allocator forwards to a backing allocator and keeps current, peak,
+// and allocation-count statistics per subsystem tag.
+//
+// Subsystems opt in with allocator_for_tag(a, TAG): when `a` belongs to a
+// tagged allocator it returns a view that accounts to TAG, otherwise it
+// returns `a` unchanged. Call sites therefore need no knowledge of whether
+// accounting is enabled.
+//
+// Every block carries its tag in a small header in front of the user pointer,
+// so frees and reallocs are always credited to the tag that allocated the
+// block, no matter which view (or the untagged root) releases it.
+
+typedef enum memory_tag {
+  MEMORY_TAG_OTHER,    // Untagged allocations
+  MEMORY_TAG_STRINGS,  // trace_data string pool, table and lookup
+  MEMORY_TAG_EVENTS,   // trace_data persisted events
+  MEMORY_TAG_ARGS,     // trace_data persisted arguments
+  MEMORY_TAG_TRACKS,   // Per-track indices, depths and caches
+  MEMORY_TAG_RENDER,   // Viewer layout, render blocks and ImGui state
+  MEMORY_TAG_SEARCH,   // Search results and filtered selections
+  MEMORY_TAG_COUNT,
+} memory_tag_t;
+
+typedef struct memory_tag_stats {
+  size_t current_bytes;
+  size_t peak_bytes;
+  size_t alloc_count;
+} memory_tag_stats_t;
+
+typedef struct memory_tag_counters {
+  _Atomic(size_t) current_bytes;
+  _Atomic(size_t) peak_bytes;
+  _Atomic(size_t) alloc_count;
+} memory_tag_counters_t;
+
+struct tagged_allocator;
+
+// An allocator_t that accounts new blocks to one tag of its owner.
+typedef struct tagged_allocator_view {
+  allocator_t super;
+  struct tagged_allocator* owner;
+  memory_tag_t tag;
+} tagged_allocator_view_t;
+
+typedef struct tagged_allocator {
+  tagged_allocator_view_t views[MEMORY_TAG_COUNT];
+  allocator_t* backing;
+  memory_tag_counters_t tags[MEMORY_TAG_COUNT];
+  memory_tag_counters_t total;
+} tagged_allocator_t;
+
+void tagged_allocator_init(tagged_allocator_t* ta, allocator_t* backing);
+
+// Returns the root allocator; allocations made through it count as
+// MEMORY_TAG_OTHER.
+static inline allocator_t* tagged_allocator_get_allocator(
+    tagged_allocator_t* ta) {
+  return &ta->views[MEMORY_TAG_OTHER].super;
+}
+
+// Returns the view of `a` for `tag` if `a` is a tagged allocator (root or any
+// view), or `a` itself otherwise.
+allocator_t* allocator_for_tag(allocator_t* a, memory_tag_t tag);
+
+// Returns the tagged allocator that `a` belongs to, or nullptr.
+tagged_allocator_t* tagged_allocator_from(allocator_t* a);
+
+void tagged_allocator_get_stats(tagged_allocator_t* ta, memory_tag_t tag,
+                                memory_tag_stats_t* out_stats);
+
+// Stats across all tags. The total peak is tracked on its own, so it can be
+// lower than the sum of per-tag peaks.
+void tagged_allocator_get_total_stats(tagged_allocator_t* ta,
+                                      memory_tag_stats_t* out_stats);
+
+// Returns a short lowercase name for `tag` (e.g. "strings").
+const char* memory_tag_name(memory_tag_t tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CORE_TAGGED_ALLOCATOR_H
@@ -0,0 +1,98 @@
+#include "core/tagged_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include "core/allocator.h"
+#include "core/counting_allocator.h"
+
+static memory_tag_stats_t stats_for(tagged_allocator_t* ta, memory_tag_t tag) {
+  memory_tag_stats_t stats;
+  tagged_allocator_get_stats(ta, tag, &stats);
+  return stats;
+}
+
+TEST(tagged_allocator_test, tracks_current_peak_and_count_per_tag) {
+  tagged_allocator_t ta;
+  tagged_allocator_init(&ta, c_allocator());
+  allocator_t* a = tagged_allocator_get_allocator(&ta);
+  allocator_t* strings = allocator_for_tag(a, MEMORY_TAG_STRINGS);
+  allocator_t* events = allocator_for_tag(a, MEMORY_TAG_EVENTS);
+
+  void* s = allocator_alloc(strings, 100);
+  void* e1 = allocator_alloc(events, 40);
+  void* e2 = allocator_alloc(events, 60);
+  void* o = allocator_alloc(a, 7);
+
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_STRINGS).current_bytes, 100u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_STRINGS).alloc_count, 1u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_EVENTS).current_bytes, 100u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_EVENTS).alloc_count, 2u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_OTHER).current_bytes, 7u);
+
+  allocator_free(events, e1, 40);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_EVENTS).current_bytes, 60u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_EVENTS).peak_bytes, 100u);
+
+  memory_tag_stats_t total;
+  tagged_allocator_get_total_stats(&ta, &total);
+  EXPECT_EQ(total.current_bytes, 167u);
+  EXPECT_EQ(total.peak_bytes, 207u);
+  EXPECT_EQ(total.alloc_count, 4u);
+
+  allocator_free(strings, s, 100);
+  allocator_free(events, e2, 60);
+  allocator_free(a, o, 7);
+  tagged_allocator_get_total_stats(&ta, &total);
+  EXPECT_EQ(total.current_bytes, 0u);
+}
+
+TEST(tagged_allocator_test, blocks_keep_their_tag_across_views) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  tagged_allocator_t ta;
+  tagged_allocator_init(&ta, counting_allocator_get_allocator(&ca));
+  allocator_t* a = tagged_allocator_get_allocator(&ta);
+
+  // Grown and freed through the untagged root; still credited to ARGS.
+  void* p = allocator_alloc(allocator_for_tag(a, MEMORY_TAG_ARGS), 32);
+  p = allocator_realloc(a, p, 32, 256);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_ARGS).current_bytes, 256u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_ARGS).alloc_count, 1u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_OTHER).current_bytes, 0u);
+
+  p = allocator_realloc(a, p, 256, 16);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_ARGS).current_bytes, 16u);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_ARGS).peak_bytes, 256u);
+
+  allocator_free(a, p, 16);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_ARGS).current_bytes, 0u);
+  // Headers are returned to the backing allocator as well.
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
+}
+
+TEST(tagged_allocator_test, preserves_requested_alignment) {
+  tagged_allocator_t ta;
+  tagged_allocator_init(&ta, c_allocator());
+  allocator_t* a = allocator_for_tag(tagged_allocator_get_allocator(&ta),
+                                     MEMORY_TAG_RENDER);
+
+  // malloc only guarantees 16-byte alignment, which the header must keep.
+  void* p = a->alloc(a, 24, 16);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0u);
+  a->dealloc(a, p, 24, 16);
+  EXPECT_EQ(stats_for(&ta, MEMORY_TAG_RENDER).current_bytes, 0u);
+}
+
+TEST(tagged_allocator_test, for_tag_passes_through_untagged_allocators) {
+  allocator_t* a = c_allocator();
+  EXPECT_EQ(allocator_for_tag(a, MEMORY_TAG_EVENTS), a);
+  EXPECT_EQ(tagged_allocator_from(a), nullptr);
+
+  tagged_allocator_t ta;
+  tagged_allocator_init(&ta, a);
+  allocator_t* events =
+      allocator_for_tag(tagged_allocator_get_allocator(&ta), MEMORY_TAG_EVENTS);
+  EXPECT_EQ(allocator_for_tag(events, MEMORY_TAG_EVENTS), events);
+  EXPECT_EQ(tagged_allocator_from(events), &ta);
+  EXPECT_STREQ(memory_tag_name(MEMORY_TAG_STRINGS), "strings");
+}
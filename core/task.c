@@ -11,6 +11,14 @@
 #include "core/arena.h"
 #include "core/assert.h"
 #include "core/logging.h"
+#include "core/self_trace.h"
+
+// Default high-water cap on idle arenas retained by the per-queue pool.
+constexpr size_t TASK_ARENA_POOL_DEFAULT_LIMIT = 32;
+
+// Arenas that grew beyond this many bytes (e.g. the final organize pass of a
+// load) are destroyed on release instead of pinning their memory in the pool.
+constexpr size_t TASK_ARENA_POOL_MAX_ARENA_BYTES = 64 * 1024 * 1024;
 
 // ─── Internal Structures ─────────────────────────────────────────────────────
 
@@ -101,6 +109,17 @@ struct task_queue {
   task_node_t* pending_tail;
   // The thread assumed to be reaping completions (for deadlock detection)
   pthread_t owner_thread;
+
+  // LIFO stack of reset arenas recycled across submissions (cap entries)
+  arena_t** arena_pool;
+  // Number of idle arenas currently held in the pool
+  size_t arena_pool_len;
+  // High-water cap on idle arenas retained by the pool
+  size_t arena_pool_limit;
+  // Hit/miss/trim counters for sizing the pool
+  size_t arena_pool_hits;
+  size_t arena_pool_misses;
+  size_t arena_pool_trimmed;
 };
 
 // ─── Private Helper Declarations ─────────────────────────────────────────────
@@ -116,6 +135,9 @@ static void cancel_stream_locked(task_queue_t* queue, task_stream_t stream);
 static bool pending_list_push_locked(task_queue_t* queue,
                                      const task_submission_t* sub,
                                      arena_t** arena, bool cancelled);
+static arena_t* arena_pool_take_locked(task_queue_t* queue);
+static void arena_pool_release_locked(task_queue_t* queue, arena_t* arena);
+static void arena_pool_trim_locked(task_queue_t* queue, size_t limit);
 
 // ─── Public API: Lifecycle ───────────────────────────────────────────────────
 
@@ -133,6 +155,9 @@ task_queue_t* task_queue_create(size_t cap, task_executor_t executor,
       .allocator = allocator,
       .executor = executor,
       .owner_thread = pthread_self(),
+      .arena_pool_limit = cap < TASK_ARENA_POOL_DEFAULT_LIMIT
+                              ? cap
+                              : TASK_ARENA_POOL_DEFAULT_LIMIT,
   };
 
   // Allocate the circular ring buffers and node pool (never return NULL, abort
@@ -148,6 +173,7 @@ task_queue_t* task_queue_create(size_t cap, task_executor_t executor,
       allocator_alloc(queue->allocator, sizeof(task_execution_t) * cap);
   queue->node_pool =
       allocator_alloc(queue->allocator, sizeof(task_node_t) * cap);
+  queue->arena_pool = allocator_alloc(queue->allocator, sizeof(arena_t*) * cap);
 
   // Initialize the node pool as a free list of vacant nodes
   queue->free_nodes = &queue->node_pool[0];
@@ -208,8 +234,12 @@ void task_queue_destroy(task_queue_t* queue) {
       arena_destroy(queue->executions[i].arena);
     }
   }
+  // 4. Destroy all idle arenas in the pool
+  arena_pool_trim_locked(queue, 0);
 
   // Free the node pool, ring buffers, and the queue structure itself
+  allocator_free(queue->allocator, queue->arena_pool,
+                 sizeof(arena_t*) * queue->cap);
   allocator_free(queue->allocator, queue->node_pool,
                  sizeof(task_node_t) * queue->cap);
   allocator_free(queue->allocator, queue->executions,
@@ -294,6 +324,32 @@ void task_queue_cancel_submission(task_queue_t* queue, void* user_data) {
   expect(pthread_mutex_unlock(&queue->mutex) == 0);
 }
 
+// ─── Public API: Arena Pool ──────────────────────────────────────────────────
+
+void task_queue_set_arena_pool_limit(task_queue_t* queue, size_t limit) {
+  expect(pthread_mutex_lock(&queue->mutex) == 0);
+  queue->arena_pool_limit = limit < queue->cap ? limit : queue->cap;
+  arena_pool_trim_locked(queue, queue->arena_pool_limit);
+  expect(pthread_mutex_unlock(&queue->mutex) == 0);
+}
+
+void task_queue_get_arena_pool_stats(task_queue_t* queue,
+                                     task_arena_pool_stats_t* out_stats) {
+  expect(pthread_mutex_lock(&queue->mutex) == 0);
+  size_t idle_bytes = 0;
+  for (size_t i = 0; i < queue->arena_pool_len; ++i) {
+    idle_bytes += queue->arena_pool[i]->peak;
+  }
+  *out_stats = (task_arena_pool_stats_t){
+      .hits = queue->arena_pool_hits,
+      .misses = queue->arena_pool_misses,
+      .trimmed = queue->arena_pool_trimmed,
+      .idle = queue->arena_pool_len,
+      .idle_bytes = idle_bytes,
+  };
+  expect(pthread_mutex_unlock(&queue->mutex) == 0);
+}
+
 // ─── Submission Queue (SQ) ───────────────────────────────────────────────────
 
 task_submission_t* task_queue_get_submission(task_queue_t* queue) {
@@ -314,9 +370,14 @@ task_submission_t* task_queue_get_submission(task_queue_t* queue) {
   task_submission_t* sub = &queue->sq_entries[idx];
   queue->sq_tail++;
 
-  // Clean the slot before leasing and associate a fresh task-local arena
+  // Clean the slot before leasing and associate a reset task-local arena.
+  // A slot that was leased but never given a task still holds its arena, so
+  // hand that back to the pool first.
   *sub = (task_submission_t){};
-  queue->sq_arenas[idx] = arena_create_with_allocator(queue->allocator);
+  if (queue->sq_arenas[idx] != nullptr) {
+    arena_pool_release_locked(queue, queue->sq_arenas[idx]);
+  }
+  queue->sq_arenas[idx] = arena_pool_take_locked(queue);
   sub->arena = queue->sq_arenas[idx];
 
   expect(pthread_mutex_unlock(&queue->mutex) == 0);
@@ -423,7 +484,7 @@ void task_queue_remove_completion(task_queue_t* queue) {
   if (queue->cq_head < queue->cq_tail) {
     size_t idx = queue->cq_head % queue->cap;
     if (queue->cq_arenas[idx] != nullptr) {
-      arena_destroy(queue->cq_arenas[idx]);
+      arena_pool_release_locked(queue, queue->cq_arenas[idx]);
       queue->cq_arenas[idx] = nullptr;
     }
     queue->cq_head++;
@@ -463,7 +524,9 @@ static void task_worker(void* arg) {
 
     // 2. Execute the task (outside the global mutex lock!)
     if (!atomic_load(&exec->cancelled)) {
+      SELF_TRACE_BEGIN("task_run");
       exec->task(&internal_ctx.public_ctx);
+      SELF_TRACE_END();
     }
 
     // 3. Lock the mutex to commit the result and check for next streams
@@ -753,7 +816,9 @@ static void dispatch_pending_locked(task_queue_t* queue) {
     expect(pthread_mutex_unlock(&queue->mutex) == 0);
 
     // Dispatch execution using the abstract injected executor!
+    SELF_TRACE_BEGIN("task_dispatch");
     queue->executor(task_worker, payload);
+    SELF_TRACE_END();
 
     // Re-acquire lock to continue the dispatch loop safely!
     expect(pthread_mutex_lock(&queue->mutex) == 0);
@@ -823,6 +888,42 @@ static bool pending_list_push_locked(task_queue_t* queue,
   return true;
 }
 
+static arena_t* arena_pool_take_locked(task_queue_t* queue) {
+  // Assumes queue->mutex is LOCKED on entry!
+  arena_t* arena = nullptr;
+  if (queue->arena_pool_len > 0) {
+    // Pooled arenas were reset on release, so they are ready for reuse
+    arena = queue->arena_pool[--queue->arena_pool_len];
+    queue->arena_pool_hits++;
+  } else {
+    arena = arena_create_with_allocator(queue->allocator);
+    queue->arena_pool_misses++;
+  }
+  return arena;
+}
+
+static void arena_pool_release_locked(task_queue_t* queue, arena_t* arena) {
+  // Assumes queue->mutex is LOCKED on entry!
+  if (queue->arena_pool_len < queue->arena_pool_limit &&
+      arena->peak <= TASK_ARENA_POOL_MAX_ARENA_BYTES) {
+    // Resetting consolidates any overflow chunks into one, so the next lease
+    // serves the same working set without touching the backing allocator.
+    arena_reset(arena);
+    queue->arena_pool[queue->arena_pool_len++] = arena;
+  } else {
+    arena_destroy(arena);
+    queue->arena_pool_trimmed++;
+  }
+}
+
+static void arena_pool_trim_locked(task_queue_t* queue, size_t limit) {
+  // Assumes queue->mutex is LOCKED on entry (or the queue is being destroyed)
+  while (queue->arena_pool_len > limit) {
+    arena_destroy(queue->arena_pool[--queue->arena_pool_len]);
+    queue->arena_pool_trimmed++;
+  }
+}
+
 bool task_should_abort(const task_context_t* ctx) {
   const task_context_internal_t* internal_ctx =
       (const task_context_internal_t*)ctx;
@@ -83,9 +83,12 @@ typedef struct {
   // - STABILITY: All allocations remain 100% valid and stable during
   // scheduling,
   //   background execution, and after completion (available to the UI thread).
-  // - AUTOMATIC RECLAIM: The entire arena is deinitialized and all allocations
-  //   are reclaimed at once when task_queue_remove_completion() is called for
+  // - AUTOMATIC RECLAIM: The entire arena is reset and all allocations are
+  //   reclaimed at once when task_queue_remove_completion() is called for
   //   this task, OR when the queue is destroyed via task_queue_destroy().
+  //   Reset arenas are kept in a per-queue pool and handed to later
+  //   submissions, so steady-state submissions do not touch the backing
+  //   allocator.
   //
   // ⚠️ CRITICAL CONSTRAINTS:
   // 1. DO NOT access any memory allocated from this arena after calling
@@ -121,6 +124,23 @@ typedef struct {
   task_status_t status;
 } task_completion_t;
 
+// ─── Arena Pool Statistics ───────────────────────────────────────────────────
+
+// Counters describing the per-queue pool of recycled task arenas. Use these to
+// size the pool via task_queue_set_arena_pool_limit().
+typedef struct {
+  // Submissions that were handed a recycled arena from the pool
+  size_t hits;
+  // Submissions that had to create a fresh arena (pool was empty)
+  size_t misses;
+  // Arenas destroyed on release instead of pooled (pool full or oversized)
+  size_t trimmed;
+  // Idle arenas currently held by the pool
+  size_t idle;
+  // Bytes retained by the idle arenas
+  size_t idle_bytes;
+} task_arena_pool_stats_t;
+
 // ─── Public API: Lifecycle ───────────────────────────────────────────────────
 
 // Creates a new task queue with the specified capacity (number of pre-allocated
@@ -149,6 +169,17 @@ void task_queue_cancel_stream(task_queue_t* queue, task_stream_t stream);
 // managed by the system and cannot be cancelled.
 void task_queue_cancel_submission(task_queue_t* queue, void* user_data);
 
+// ─── Public API: Arena Pool ──────────────────────────────────────────────────
+
+// Sets the high-water cap on idle arenas retained by the pool (clamped to the
+// queue capacity). Idle arenas above the new cap are destroyed immediately.
+// Passing 0 disables pooling and trims the pool empty.
+void task_queue_set_arena_pool_limit(task_queue_t* queue, size_t limit);
+
+// Copies the current arena pool counters into out_stats.
+void task_queue_get_arena_pool_stats(task_queue_t* queue,
+                                     task_arena_pool_stats_t* out_stats);
+
 // ─── Thread Safety Warning ───────────────────────────────────────────────────
 
 // Accessing the Submission Queue (SQ) and Completion Queue (CQ) APIs is NOT
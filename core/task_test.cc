@@ -2283,3 +2283,120 @@ TEST(task_queue_test, task_local_arena_lifetime) {
   // be cleanly freed!
   EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
 }
+
+// ─── Arena Pool ──────────────────────────────────────────────────────────────
+
+// A c_allocator wrapper that counts every call reaching the backing allocator.
+struct call_counting_allocator {
+  allocator_t super;
+  int calls;
+};
+
+static void* call_counting_alloc(allocator_t* self, size_t size,
+                                 size_t alignment) {
+  call_counting_allocator* a = (call_counting_allocator*)self;
+  a->calls++;
+  return c_allocator()->alloc(c_allocator(), size, alignment);
+}
+
+static void* call_counting_realloc(allocator_t* self, void* ptr,
+                                   size_t old_size, size_t new_size,
+                                   size_t alignment) {
+  call_counting_allocator* a = (call_counting_allocator*)self;
+  a->calls++;
+  return c_allocator()->realloc(c_allocator(), ptr, old_size, new_size,
+                                alignment);
+}
+
+static void call_counting_dealloc(allocator_t* self, void* ptr, size_t size,
+                                  size_t alignment) {
+  call_counting_allocator* a = (call_counting_allocator*)self;
+  a->calls++;
+  c_allocator()->dealloc(c_allocator(), ptr, size, alignment);
+}
+
+// Runs one submit/reap cycle that allocates `bytes` from the task arena.
+static void run_arena_cycle(task_queue_t* queue, size_t bytes) {
+  task_submission_t* sub = task_queue_get_submission(queue);
+  ASSERT_NE(sub, nullptr);
+  void* data = allocator_alloc(arena_get_allocator(sub->arena), bytes);
+  sub->task = [](task_context_t* ctx) { (void)ctx; };
+  sub->user_data = data;
+  task_queue_submit(queue);
+
+  task_completion_t cqe;
+  ASSERT_TRUE(wait_for_completion(queue, &cqe));
+  EXPECT_EQ(cqe.status, TASK_STATUS_OK);
+  task_queue_remove_completion(queue);
+}
+
+TEST(task_queue_arena_pool_test, steady_state_has_no_backing_calls) {
+  call_counting_allocator backing = {
+      .super =
+          {
+              .alloc = call_counting_alloc,
+              .realloc = call_counting_realloc,
+              .dealloc = call_counting_dealloc,
+          },
+  };
+  task_queue_t* queue = task_queue_create(16, inline_executor, &backing.super);
+
+  // Warm up: the first cycle creates the arena and grows it past the first
+  // chunk, the second settles it into its consolidated shape.
+  run_arena_cycle(queue, 1024 * 1024);
+  run_arena_cycle(queue, 1024 * 1024);
+
+  int calls_after_warmup = backing.calls;
+  for (int i = 0; i < 100; ++i) {
+    run_arena_cycle(queue, 1024 * 1024);
+  }
+  EXPECT_EQ(backing.calls, calls_after_warmup);
+
+  task_arena_pool_stats_t stats;
+  task_queue_get_arena_pool_stats(queue, &stats);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.hits, 101u);
+  EXPECT_EQ(stats.trimmed, 0u);
+  EXPECT_EQ(stats.idle, 1u);
+  EXPECT_GE(stats.idle_bytes, 1024u * 1024u);
+
+  task_queue_destroy(queue);
+}
+
+TEST(task_queue_arena_pool_test, limit_caps_idle_arenas) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  task_queue_t* queue = task_queue_create(
+      16, inline_executor, counting_allocator_get_allocator(&ca));
+  task_queue_set_arena_pool_limit(queue, 2);
+
+  // Lease four arenas at once so four are released together.
+  for (int i = 0; i < 4; ++i) {
+    task_submission_t* sub = task_queue_get_submission(queue);
+    ASSERT_NE(sub, nullptr);
+    sub->task = [](task_context_t* ctx) { (void)ctx; };
+    sub->user_data = sub;
+  }
+  task_queue_submit(queue);
+  for (int i = 0; i < 4; ++i) {
+    task_completion_t cqe;
+    ASSERT_TRUE(wait_for_completion(queue, &cqe));
+    task_queue_remove_completion(queue);
+  }
+
+  task_arena_pool_stats_t stats;
+  task_queue_get_arena_pool_stats(queue, &stats);
+  EXPECT_EQ(stats.misses, 4u);
+  EXPECT_EQ(stats.idle, 2u);
+  EXPECT_EQ(stats.trimmed, 2u);
+
+  // Lowering the limit trims the pool immediately.
+  task_queue_set_arena_pool_limit(queue, 0);
+  task_queue_get_arena_pool_stats(queue, &stats);
+  EXPECT_EQ(stats.idle, 0u);
+  EXPECT_EQ(stats.idle_bytes, 0u);
+  EXPECT_EQ(stats.trimmed, 4u);
+
+  task_queue_destroy(queue);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
+}
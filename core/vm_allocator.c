@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+
+#include "core/vm_allocator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if VM_ALLOCATOR_SUPPORTED
+#include <sys/mman.h>
+
+// A new reservation covers this many times the requested size, so a block
+// that keeps growing is moved only a handful of times.
+constexpr size_t VM_RESERVE_FACTOR = 8;
+
+// Smallest reservation, in bytes.
+constexpr size_t VM_MIN_RESERVE = 64 * 1024 * 1024;
+
+// Stored in the first page of every reservation; the block starts one page
+// later so it stays page aligned.
+typedef struct vm_block_header {
+  // Size of the whole mapping, including the header page
+  size_t reserved;
+  // Readable/writable prefix of the mapping, including the header page
+  size_t committed;
+} vm_block_header_t;
+
+static size_t vm_round_up(size_t n, size_t page_size) {
+  return (n + page_size - 1) & ~(page_size - 1);
+}
+
+static size_t vm_reserve_size(vm_allocator_t* va, size_t size) {
+  size_t reserve = size;
+  if (size <= SIZE_MAX / VM_RESERVE_FACTOR) {
+    reserve = size * VM_RESERVE_FACTOR;
+  }
+  if (reserve < VM_MIN_RESERVE) {
+    reserve = VM_MIN_RESERVE;
+  }
+  return vm_round_up(reserve, va->os_page_size) + va->os_page_size;
+}
+
+static bool vm_is_large(vm_allocator_t* va, size_t size, size_t alignment) {
+  return size >= VM_ALLOCATOR_MIN_BLOCK_SIZE && alignment <= va->os_page_size;
+}
+
+static char* vm_map_reserve(size_t reserved) {
+  char* base = mmap(nullptr, reserved, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "OOM: vm allocator failed to reserve %zu bytes\n",
+            reserved);
+    abort();
+  }
+  return base;
+}
+
+// Makes [base + from, base + to) readable and writable.
+static void vm_commit(char* base, size_t from, size_t to) {
+  if (mprotect(base + from, to - from, PROT_READ | PROT_WRITE) != 0) {
+    fprintf(stderr, "OOM: vm allocator failed to commit %zu bytes\n",
+            to - from);
+    abort();
+  }
+}
+
+// Returns the pages in [base + from, base + to) to the OS.
+static void vm_decommit(char* base, size_t from, size_t to) {
+  madvise(base + from, to - from, MADV_DONTNEED);
+  mprotect(base + from, to - from, PROT_NONE);
+}
+
+static void* vm_block_create(vm_allocator_t* va, size_t size) {
+  size_t ps = va->os_page_size;
+  size_t reserved = vm_reserve_size(va, size);
+  size_t committed = ps + vm_round_up(size, ps);
+  char* base = vm_map_reserve(reserved);
+  vm_commit(base, 0, committed);
+  *(vm_block_header_t*)base = (vm_block_header_t){
+      .reserved = reserved,
+      .committed = committed,
+  };
+  atomic_fetch_add_explicit(&va->reserved_bytes, reserved,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&va->committed_bytes, committed,
+                            memory_order_relaxed);
+  return base + ps;
+}
+
+static void vm_block_destroy(vm_allocator_t* va, void* ptr) {
+  char* base = (char*)ptr - va->os_page_size;
+  vm_block_header_t hdr = *(vm_block_header_t*)base;
+  munmap(base, hdr.reserved);
+  atomic_fetch_sub_explicit(&va->reserved_bytes, hdr.reserved,
+                            memory_order_relaxed);
+  atomic_fetch_sub_explicit(&va->committed_bytes, hdr.committed,
+                            memory_order_relaxed);
+}
+
+// Moves the committed prefix of a block into a larger reservation. mremap
+// transfers the pages themselves, so no data is copied.
+static char* vm_block_relocate(vm_allocator_t* va, char* base,
+                               size_t new_size) {
+  vm_block_header_t* hdr = (vm_block_header_t*)base;
+  size_t old_reserved = hdr->reserved;
+  size_t committed = hdr->committed;
+  size_t new_reserved = vm_reserve_size(va, new_size);
+
+  char* new_base = vm_map_reserve(new_reserved);
+  if (mremap(base, committed, committed, MREMAP_MAYMOVE | MREMAP_FIXED,
+             new_base) == MAP_FAILED) {
+    fprintf(stderr, "OOM: vm allocator failed to move %zu bytes\n",
+            committed);
+    abort();
+  }
+  // mremap unmapped the committed prefix; drop the rest of the old range.
+  munmap(base + committed, old_reserved - committed);
+
+  hdr = (vm_block_header_t*)new_base;
+  hdr->reserved = new_reserved;
+  atomic_fetch_add_explicit(&va->reserved_bytes, new_reserved - old_reserved,
+                            memory_order_relaxed);
+  return new_base;
+}
+
+static void* vm_block_resize(vm_allocator_t* va, void* ptr, size_t new_size) {
+  size_t ps = va->os_page_size;
+  char* base = (char*)ptr - ps;
+  size_t needed = ps + vm_round_up(new_size, ps);
+
+  if (needed > ((vm_block_header_t*)base)->reserved) {
+    base = vm_block_relocate(va, base, new_size);
+  }
+
+  vm_block_header_t* hdr = (vm_block_header_t*)base;
+  if (needed > hdr->committed) {
+    vm_commit(base, hdr->committed, needed);
+    atomic_fetch_add_explicit(&va->committed_bytes, needed - hdr->committed,
+                              memory_order_relaxed);
+  } else if (needed < hdr->committed) {
+    vm_decommit(base, needed, hdr->committed);
+    atomic_fetch_sub_explicit(&va->committed_bytes, hdr->committed - needed,
+                              memory_order_relaxed);
+  }
+  hdr->committed = needed;
+  return base + ps;
+}
+
+static void* vm_alloc(allocator_t* self, size_t size, size_t alignment) {
+  vm_allocator_t* va = (vm_allocator_t*)self;
+  void* result = nullptr;
+  if (vm_is_large(va, size, alignment)) {
+    result = vm_block_create(va, size);
+  } else {
+    result = va->backing->alloc(va->backing, size, alignment);
+  }
+  return result;
+}
+
+static void vm_dealloc(allocator_t* self, void* ptr, size_t size,
+                       size_t alignment) {
+  vm_allocator_t* va = (vm_allocator_t*)self;
+  if (ptr) {
+    if (vm_is_large(va, size, alignment)) {
+      vm_block_destroy(va, ptr);
+    } else {
+      va->backing->dealloc(va->backing, ptr, size, alignment);
+    }
+  }
+}
+
+static void* vm_realloc(allocator_t* self, void* ptr, size_t old_size,
+                        size_t new_size, size_t alignment) {
+  vm_allocator_t* va = (vm_allocator_t*)self;
+  void* result = nullptr;
+
+  if (ptr == nullptr) {
+    if (new_size > 0) {
+      result = vm_alloc(self, new_size, alignment);
+    }
+  } else if (new_size == 0) {
+    vm_dealloc(self, ptr, old_size, alignment);
+  } else {
+    bool old_large = vm_is_large(va, old_size, alignment);
+    bool new_large = vm_is_large(va, new_size, alignment);
+    if (old_large && new_large) {
+      result = vm_block_resize(va, ptr, new_size);
+    } else if (!old_large && !new_large) {
+      result = va->backing->realloc(va->backing, ptr, old_size, new_size,
+                                    alignment);
+    } else {
+      // Crossing the threshold copies at most VM_ALLOCATOR_MIN_BLOCK_SIZE.
+      result = vm_alloc(self, new_size, alignment);
+      memcpy(result, ptr, old_size < new_size ? old_size : new_size);
+      vm_dealloc(self, ptr, old_size, alignment);
+    }
+  }
+  return result;
+}
+
+#else
+
+static void* vm_alloc(allocator_t* self, size_t size, size_t alignment) {
+  vm_allocator_t* va = (vm_allocator_t*)self;
+  return va->backing->alloc(va->backing, size, alignment);
+}
+
+static void vm_dealloc(allocator_t* self, void* ptr, size_t size,
+                       size_t alignment) {
+  vm_allocator_t* va = (vm_allocator_t*)self;
+  va->backing->dealloc(va->backing, ptr, size, alignment);
+}
+
+static void* vm_realloc(allocator_t* self, void* ptr, size_t old_size,
+                        size_t new_size, size_t alignment) {
+  vm_allocator_t* va = (vm_allocator_t*)self;
+  return va->backing->realloc(va->backing, ptr, old_size, new_size,
+                              alignment);
+}
+
+#endif  // VM_ALLOCATOR_SUPPORTED
+
+void vm_allocator_init(vm_allocator_t* va, allocator_t* backing) {
+  *va = (vm_allocator_t){
+      .super =
+          {
+              .alloc = vm_alloc,
+              .realloc = vm_realloc,
+              .dealloc = vm_dealloc,
+          },
+      .backing = backing,
+  };
+#if VM_ALLOCATOR_SUPPORTED
+  va->os_page_size = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+size_t vm_allocator_get_reserved_bytes(vm_allocator_t* va) {
+  return atomic_load_explicit(&va->reserved_bytes, memory_order_relaxed);
+}
+
+size_t vm_allocator_get_committed_bytes(vm_allocator_t* va) {
+  return atomic_load_explicit(&va->committed_bytes, memory_order_relaxed);
+}
@@ -0,0 +1,74 @@
+#ifndef CORE_VM_ALLOCATOR_H
+#define CORE_VM_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/allocator.h"
+
+#ifdef __cplusplus
+#include <atomic>
+#ifndef _Atomic
+#define _Atomic(T) std::atomic<T>
+#endif
+#else
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ─── Virtual Memory Allocator ────────────────────────────────────────────────
+//
+// A heap allocator for large growable arrays (trace_data events/args/strings,
+// per-track indices).
+//
+// Blocks smaller than VM_ALLOCATOR_MIN_BLOCK_SIZE are forwarded to the backing
+// allocator. Larger blocks get their own address range, reserved up front with
+// PROT_NONE and committed page by page as the block grows:
+//
+//   - Growing within the reservation commits more pages in place; the pointer
+//     does not change and nothing is copied.
+//   - Growing past the reservation moves the committed pages into a larger
+//     reservation with mremap, which remaps page tables instead of copying.
+//   - Shrinking (darray_compact) returns the tail pages to the OS.
+//
+// Appending N bytes therefore needs ~N bytes of resident memory instead of the
+// ~2N a copying realloc needs at each growth step.
+//
+// Only available on 64-bit Linux, where address space is plentiful. Elsewhere
+// every call is forwarded to the backing allocator.
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__) && UINTPTR_MAX > 0xFFFFFFFFu
+#define VM_ALLOCATOR_SUPPORTED 1
+#else
+#define VM_ALLOCATOR_SUPPORTED 0
+#endif
+
+// Blocks at or above this size are backed by their own reservation.
+constexpr size_t VM_ALLOCATOR_MIN_BLOCK_SIZE = 1024 * 1024;
+
+typedef struct vm_allocator {
+  allocator_t super;
+  allocator_t* backing;
+  size_t os_page_size;
+  // Bytes of address space currently reserved / committed by large blocks
+  _Atomic(size_t) reserved_bytes;
+  _Atomic(size_t) committed_bytes;
+} vm_allocator_t;
+
+void vm_allocator_init(vm_allocator_t* va, allocator_t* backing);
+
+static inline allocator_t* vm_allocator_get_allocator(vm_allocator_t* va) {
+  return (allocator_t*)va;
+}
+
+size_t vm_allocator_get_reserved_bytes(vm_allocator_t* va);
+size_t vm_allocator_get_committed_bytes(vm_allocator_t* va);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CORE_VM_ALLOCATOR_H
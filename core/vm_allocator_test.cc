@@ -0,0 +1,100 @@
+#include "core/vm_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include "core/allocator.h"
+#include "core/counting_allocator.h"
+#include "core/darray.h"
+
+class vm_allocator_test : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    counting_allocator_init(&backing_, c_allocator());
+    vm_allocator_init(&va_, counting_allocator_get_allocator(&backing_));
+    a_ = vm_allocator_get_allocator(&va_);
+  }
+  void TearDown() override {
+    EXPECT_EQ(vm_allocator_get_reserved_bytes(&va_), 0u);
+    EXPECT_EQ(vm_allocator_get_committed_bytes(&va_), 0u);
+    EXPECT_EQ(counting_allocator_get_allocated_bytes(&backing_), 0u);
+  }
+
+  counting_allocator_t backing_;
+  vm_allocator_t va_;
+  allocator_t* a_ = nullptr;
+};
+
+TEST_F(vm_allocator_test, small_blocks_use_backing_allocator) {
+  void* p = allocator_alloc(a_, 128);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&backing_), 128u);
+  EXPECT_EQ(vm_allocator_get_reserved_bytes(&va_), 0u);
+  p = allocator_realloc(a_, p, 128, 4096);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&backing_), 4096u);
+  allocator_free(a_, p, 4096);
+}
+
+TEST_F(vm_allocator_test, darray_grows_in_place_and_keeps_contents) {
+  if (!VM_ALLOCATOR_SUPPORTED) {
+    GTEST_SKIP() << "virtual memory growth is only available on 64-bit Linux";
+  }
+  darray_uint64_t values = {};
+  const uint64_t* large_ptr = nullptr;
+  bool moved_while_large = false;
+  for (uint64_t i = 0; i < 2 * 1024 * 1024; i++) {
+    darray_push(&values, i, a_);
+    bool large = values.cap * sizeof(uint64_t) >= VM_ALLOCATOR_MIN_BLOCK_SIZE;
+    if (large) {
+      // 16 MiB stays inside the first reservation, so the block never moves.
+      moved_while_large |= large_ptr != nullptr && large_ptr != values.ptr;
+      large_ptr = values.ptr;
+    }
+  }
+  EXPECT_FALSE(moved_while_large);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&backing_), 0u);
+  for (uint64_t i = 0; i < values.len; i++) {
+    ASSERT_EQ(values.ptr[i], i);
+  }
+  darray_deinit(&values, a_);
+}
+
+TEST_F(vm_allocator_test, growth_past_reservation_preserves_contents) {
+  if (!VM_ALLOCATOR_SUPPORTED) {
+    GTEST_SKIP() << "virtual memory growth is only available on 64-bit Linux";
+  }
+  size_t size = VM_ALLOCATOR_MIN_BLOCK_SIZE;
+  char* p = (char*)allocator_alloc_uninitialized(a_, size);
+  memset(p, 0xAB, size);
+  size_t first_reserved = vm_allocator_get_reserved_bytes(&va_);
+
+  size_t big = first_reserved * 2;
+  p = (char*)allocator_realloc_uninitialized(a_, p, size, big);
+  EXPECT_GT(vm_allocator_get_reserved_bytes(&va_), first_reserved);
+  EXPECT_EQ((unsigned char)p[0], 0xAB);
+  EXPECT_EQ((unsigned char)p[size - 1], 0xAB);
+  p[big - 1] = 1;
+
+  allocator_free(a_, p, big);
+}
+
+TEST_F(vm_allocator_test, compact_releases_tail_pages) {
+  if (!VM_ALLOCATOR_SUPPORTED) {
+    GTEST_SKIP() << "virtual memory growth is only available on 64-bit Linux";
+  }
+  darray_uint8_t bytes = {};
+  darray_resize(&bytes, 8 * 1024 * 1024, a_);
+  size_t committed_before = vm_allocator_get_committed_bytes(&va_);
+
+  bytes.len = 2 * 1024 * 1024;
+  uint8_t* before = bytes.ptr;
+  darray_compact(&bytes, a_);
+  EXPECT_EQ(bytes.ptr, before);
+  EXPECT_LT(vm_allocator_get_committed_bytes(&va_), committed_before);
+
+  // Shrinking below the threshold moves the block back to the heap.
+  bytes.len = 1024;
+  darray_compact(&bytes, a_);
+  EXPECT_EQ(vm_allocator_get_committed_bytes(&va_), 0u);
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&backing_), 1024u);
+
+  darray_deinit(&bytes, a_);
+}
@@ -4,11 +4,13 @@
 #include <string.h>
 
 #include "core/counting_allocator.h"
+#include "core/tagged_allocator.h"
 #include "core/logging.h"
 #include "src/colors.h"
 #include "src/imgui_c.h"
 #include "src/loading_screen.h"
 #include "src/platform.h"
+#include "src/trace_call_tree_task.h"
 #include "src/trace_load_task.h"
 #include "src/trace_search_task.h"
 #include "src/welcome_screen.h"
@@ -69,10 +71,163 @@ static void draw_selection_shortcuts(const theme_t* theme) {
   cheatsheet_add_row(theme, "Clear Focused", "Click Background");
 }
 
+// Per-subsystem breakdown shown when hovering the menu-bar memory readout.
+static void draw_memory_tooltip(app_t* app) {
+  ig_begin_tooltip();
+  if (ig_begin_table("##memory_by_tag", 4,
+                     IG_TABLE_FLAGS_ROW_BG | IG_TABLE_FLAGS_SIZING_FIXED_FIT,
+                     (ig_vec2_t){0.0f, 0.0f}, 0.0f)) {
+    ig_table_setup_column("Tag", IG_TABLE_COLUMN_FLAGS_WIDTH_FIXED, 0.0f, 0);
+    ig_table_setup_column("Current", IG_TABLE_COLUMN_FLAGS_WIDTH_FIXED, 0.0f,
+                          0);
+    ig_table_setup_column("Peak", IG_TABLE_COLUMN_FLAGS_WIDTH_FIXED, 0.0f, 0);
+    ig_table_setup_column("Allocs", IG_TABLE_COLUMN_FLAGS_WIDTH_FIXED, 0.0f,
+                          0);
+    ig_table_headers_row();
+
+    memory_tag_stats_t stats;
+    for (size_t i = 0; i <= MEMORY_TAG_COUNT; i++) {
+      const char* name = "total";
+      if (i < MEMORY_TAG_COUNT) {
+        name = memory_tag_name((memory_tag_t)i);
+        tagged_allocator_get_stats(&app->tagged_allocator, (memory_tag_t)i,
+                                   &stats);
+      } else {
+        tagged_allocator_get_total_stats(&app->tagged_allocator, &stats);
+      }
+      ig_table_next_row();
+      ig_table_next_column();
+      ig_text("%s", name);
+      ig_table_next_column();
+      ig_text("%.1f MB", (double)stats.current_bytes / (1024.0 * 1024.0));
+      ig_table_next_column();
+      ig_text("%.1f MB", (double)stats.peak_bytes / (1024.0 * 1024.0));
+      ig_table_next_column();
+      ig_text("%zu", stats.alloc_count);
+    }
+    ig_end_table();
+  }
+  ig_end_tooltip();
+}
+
+// Frames the overlay averages its phase times over
+constexpr size_t FRAME_PROFILER_AVERAGE_FRAMES = 60;
+
+// Floating overlay with a rolling graph of the recent frames' phases.
+static void draw_frame_profiler(app_t* app) {
+  const frame_profiler_t* fp = &app->frame_profiler;
+  const theme_t* theme = app->theme;
+
+  ig_vec2_t viewport_size = ig_viewport_get_size(ig_get_main_viewport());
+  ig_set_next_window_pos((ig_vec2_t){viewport_size.x - 10.0f, 30.0f},
+                         IG_COND_APPEARING, (ig_vec2_t){1.0f, 0.0f});
+  if (ig_begin("Frame Profiler", &app->show_frame_profiler,
+               IG_WINDOW_FLAGS_ALWAYS_AUTO_RESIZE |
+                   IG_WINDOW_FLAGS_NO_DOCKING |
+                   IG_WINDOW_FLAGS_NO_FOCUS_ON_APPEARING)) {
+    // One stacked bar per frame, newest on the right. The scale fits the
+    // slowest recorded frame, and never goes below 30 FPS.
+    const float bar_width = 2.0f;
+    const float graph_height = 80.0f;
+    float graph_width = bar_width * (float)FRAME_PROFILER_CAPACITY;
+    double scale_ms = 1000.0 / 30.0;
+    for (size_t i = 0; i < fp->len; i++) {
+      double total_ms = frame_profile_total_ms(frame_profiler_get(fp, i));
+      if (total_ms > scale_ms) scale_ms = total_ms;
+    }
+
+    ig_draw_list_t* draw_list = ig_get_window_draw_list();
+    ig_vec2_t origin = ig_get_cursor_screen_pos();
+    float bottom = origin.y + graph_height;
+    ig_draw_list_add_rect_filled(draw_list, origin,
+                                 (ig_vec2_t){origin.x + graph_width, bottom},
+                                 theme->viewport_bg);
+    for (size_t i = 0; i < fp->len; i++) {
+      const frame_profile_t* frame = frame_profiler_get(fp, i);
+      float x = origin.x + graph_width - bar_width * (float)(fp->len - i);
+      float y = bottom;
+      for (int p = 0; p < FRAME_PHASE_COUNT; p++) {
+        float h = (float)(frame->phase_ms[p] / scale_ms) * graph_height;
+        if (h > 0.0f) {
+          ig_draw_list_add_rect_filled(draw_list, (ig_vec2_t){x, y - h},
+                                       (ig_vec2_t){x + bar_width, y},
+                                       theme->event_palette[p]);
+          y -= h;
+        }
+      }
+    }
+    float budget_y =
+        bottom - (float)(1000.0 / 60.0 / scale_ms) * graph_height;
+    ig_draw_list_add_line(draw_list, (ig_vec2_t){origin.x, budget_y},
+                          (ig_vec2_t){origin.x + graph_width, budget_y},
+                          theme->track_text, 1.0f);
+    ig_dummy((ig_vec2_t){graph_width, graph_height});
+
+    size_t n = fp->len < FRAME_PROFILER_AVERAGE_FRAMES
+                   ? fp->len
+                   : FRAME_PROFILER_AVERAGE_FRAMES;
+    double avg_ms[FRAME_PHASE_COUNT] = {};
+    double avg_total_ms = 0.0;
+    for (size_t i = fp->len - n; i < fp->len; i++) {
+      const frame_profile_t* frame = frame_profiler_get(fp, i);
+      for (int p = 0; p < FRAME_PHASE_COUNT; p++) {
+        avg_ms[p] += frame->phase_ms[p] / (double)n;
+        avg_total_ms += frame->phase_ms[p] / (double)n;
+      }
+    }
+    ig_text("%.2f ms per frame (average of %zu)", avg_total_ms, n);
+    float swatch_size = ig_get_text_line_height();
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++) {
+      ig_vec2_t pos = ig_get_cursor_screen_pos();
+      ig_draw_list_add_rect_filled(
+          draw_list, pos,
+          (ig_vec2_t){pos.x + swatch_size, pos.y + swatch_size},
+          theme->event_palette[p]);
+      ig_dummy((ig_vec2_t){swatch_size, swatch_size});
+      ig_same_line(0.0f, -1.0f);
+      ig_text("%-13s %7.2f ms", frame_phase_name((frame_phase_t)p), avg_ms[p]);
+    }
+
+    if (fp->len > 0) {
+      ig_separator();
+      const frame_profile_t* last = frame_profiler_get(fp, fp->len - 1);
+      for (int c = 0; c < FRAME_COUNTER_COUNT; c++) {
+        ig_text("%-13s %llu", frame_counter_name((frame_counter_t)c),
+                (unsigned long long)last->counters[c]);
+      }
+    }
+
+    if (ig_button("Export Chrome Trace", (ig_vec2_t){0.0f, 0.0f})) {
+      allocator_t* allocator =
+          tagged_allocator_get_allocator(&app->tagged_allocator);
+      darray_uint8_t json = {};
+      frame_profiler_write_json(fp, &json, allocator);
+      platform_save_file("ztracing_frames.json", json.ptr, json.len);
+      darray_deinit(&json, allocator);
+    }
+  }
+  ig_end();
+}
+
 static void app_apply_theme(app_t* app, const theme_t* theme) {
   if (app->theme == theme) return;
   app->theme = theme;
   ig_style_apply_theme(theme);
+  app_request_redraw(app);
+}
+
+// Frees the snapshots not applied yet and the track preview, once the load
+// they belong to is over.
+static void app_end_preview(app_t* app) {
+  allocator_t* allocator =
+      tagged_allocator_get_allocator(&app->tagged_allocator);
+  trace_loading_state_t* loading = &app->loading;
+  for (size_t i = 0; i < loading->pending_snapshots.len; i++) {
+    trace_load_snapshot_destroy(loading->pending_snapshots.ptr[i], allocator);
+  }
+  darray_deinit(&loading->pending_snapshots, allocator);
+  track_preview_destroy(loading->track_preview);
+  loading->track_preview = nullptr;
 }
 
 void app_stop_jobs(app_t* app) {
@@ -82,12 +237,33 @@ void app_stop_jobs(app_t* app) {
     app->trace_load_task = nullptr;
     app->loading.active = false;
   }
+  app_end_preview(app);
 
   // Cancel active search task (if any)
   if (app->active_search_task != nullptr) {
     task_queue_cancel_submission(app->task_queue, app->active_search_task);
     app->active_search_task = nullptr;
   }
+
+  // Cancel the call tree task (if any); its completion is still reaped.
+  if (app->active_call_tree_task != nullptr) {
+    app->active_call_tree_task->superseded = true;
+    task_queue_cancel_submission(app->task_queue, app->active_call_tree_task);
+    app->active_call_tree_task = nullptr;
+  }
+}
+
+// Returns where the viewer must move its tracks instead of freeing them, or
+// nullptr. The call tree task in flight reads them without owning them, so
+// it takes them over the first time they are replaced.
+static darray_track_t* app_call_tree_task_old_tracks(app_t* app) {
+  trace_call_tree_task_t* task = app->active_call_tree_task;
+  darray_track_t* old_tracks = nullptr;
+  if (task != nullptr && !task->tracks_retired) {
+    task->tracks_retired = true;
+    old_tracks = &task->retired_tracks;
+  }
+  return old_tracks;
 }
 
 void app_init(app_t* app, allocator_t* parent) {
@@ -95,10 +271,15 @@ void app_init(app_t* app, allocator_t* parent) {
       .power_save_mode = true,
       .first_frame = true,
   };
-  counting_allocator_init(&app->counting_allocator, parent);
+  vm_allocator_init(&app->vm_allocator, parent);
+  counting_allocator_init(&app->counting_allocator,
+                          vm_allocator_get_allocator(&app->vm_allocator));
+  tagged_allocator_init(
+      &app->tagged_allocator,
+      counting_allocator_get_allocator(&app->counting_allocator));
 
   allocator_t* allocator =
-      counting_allocator_get_allocator(&app->counting_allocator);
+      tagged_allocator_get_allocator(&app->tagged_allocator);
 
   // Initialize the global background task queue
   app->task_queue = task_queue_create(1024, platform_submit_job, allocator);
@@ -124,7 +305,7 @@ void app_deinit(app_t* app) {
   app_stop_jobs(app);
 
   allocator_t* allocator =
-      counting_allocator_get_allocator(&app->counting_allocator);
+      tagged_allocator_get_allocator(&app->tagged_allocator);
 
   task_queue_destroy(app->task_queue);
 
@@ -134,9 +315,58 @@ void app_deinit(app_t* app) {
   trace_viewer_deinit(&app->trace_viewer, allocator);
 }
 
+// Searches again so the results cover the events the trace gained.
+// Re-runs the search query, if any, over the trace that gained events.
+static void app_search_new_events(app_t* app) {
+  if (app->trace_viewer.search_query.len > 0 &&
+      app->trace_viewer.search_query.ptr[0] != '\0') {
+    app->trace_viewer.search_query_dirty = true;
+  }
+}
+
+// Replaces the displayed trace with `td` and its organized `tracks`, taking
+// ownership of both.
+static void app_adopt_trace(app_t* app, trace_data_t* td,
+                            darray_track_t tracks, int64_t min_ts,
+                            int64_t max_ts) {
+  allocator_t* allocator =
+      tagged_allocator_get_allocator(&app->tagged_allocator);
+  trace_data_release(app->trace_data, allocator);
+  app->trace_data = td;
+  trace_viewer_adopt_tracks(&app->trace_viewer, td, tracks, min_ts, max_ts,
+                            app_call_tree_task_old_tracks(app), allocator);
+  app_search_new_events(app);
+}
+
+// Applies the snapshots of the trace being loaded that have arrived. They
+// change the trace and its tracks in place, so they wait while a search or
+// call tree task is reading them.
+static void app_apply_snapshots(app_t* app) {
+  allocator_t* allocator =
+      tagged_allocator_get_allocator(&app->tagged_allocator);
+  trace_loading_state_t* loading = &app->loading;
+  if (loading->pending_snapshots.len > 0 &&
+      (app->trace_data == nullptr || !trace_data_is_shared(app->trace_data))) {
+    if (app->trace_data == nullptr) {
+      app->trace_data = trace_data_create(allocator);
+      loading->track_preview = track_preview_create(allocator);
+    }
+    for (size_t i = 0; i < loading->pending_snapshots.len; i++) {
+      trace_load_snapshot_t* snapshot = loading->pending_snapshots.ptr[i];
+      trace_data_delta_apply(app->trace_data, &snapshot->data, allocator);
+      trace_viewer_apply_track_deltas(&app->trace_viewer, app->trace_data,
+                                      loading->track_preview,
+                                      &snapshot->tracks, allocator);
+      trace_load_snapshot_destroy(snapshot, allocator);
+    }
+    darray_clear(&loading->pending_snapshots);
+    app_search_new_events(app);
+  }
+}
+
 void app_poll_completions(app_t* app) {
   allocator_t* allocator =
-      counting_allocator_get_allocator(&app->counting_allocator);
+      tagged_allocator_get_allocator(&app->tagged_allocator);
   task_completion_t cqe;
   bool reaped_any = false;
 
@@ -158,7 +388,6 @@ void app_poll_completions(app_t* app) {
         // Update UI progress metrics smooth as butter!
         app->loading.event_count = payload->parsed_event_count;
         app->loading.total_bytes = payload->processed_bytes;
-        app->loading.request_update = true;
 
         // On EOF, adopt the final parsed results
         if (payload->is_eof) {
@@ -166,21 +395,18 @@ void app_poll_completions(app_t* app) {
               "app_poll_completions: loader task completed! Adopting "
               "results.");
 
-          trace_data_release(app->trace_data, allocator);
-          app->trace_data = payload->completed_td;
-          app->trace_viewer.tracks = payload->completed_tracks;
-          app->trace_viewer.viewport.min_ts = payload->completed_min_ts;
-          app->trace_viewer.viewport.max_ts = payload->completed_max_ts;
+          if (app->trace_load_task == task) {
+            app_end_preview(app);
+          }
+          app_adopt_trace(app, payload->completed_td,
+                          payload->completed_tracks, payload->completed_min_ts,
+                          payload->completed_max_ts);
 
           app->trace_load_task = nullptr;
           app->loading.active = false;
 
           trace_load_task_release(task);  // Release UI thread reference
 
-          trace_viewer_reset_view(&app->trace_viewer);
-          trace_viewer_precompute_minimap_heatmap(&app->trace_viewer,
-                                                  app->trace_data, allocator);
-
           // Print performance stats on the UI thread once adopted
           if (payload->stats.ready) {
             LOG_INFO(
@@ -195,13 +421,24 @@ void app_poll_completions(app_t* app) {
                      app->trace_viewer.tracks.len,
                      payload->stats.organize_duration_ms);
           }
+        } else if (payload->snapshot != nullptr &&
+                   app->trace_load_task == task) {
+          // Applied below, once no task reads the trace
+          darray_push(&app->loading.pending_snapshots, payload->snapshot,
+                      allocator);
+          payload->snapshot = nullptr;
         }
+        trace_load_task_chunk_release_snapshot(payload, allocator);
       }
       // B. CANCELLATION / FAILURE PATH (Zero-Leak Guard)
       else {
         LOG_DEBUG("app_poll_completions: loader task cancelled or failed!");
+        trace_load_task_chunk_release_snapshot(payload, allocator);
 
         if (payload->is_eof) {
+          if (app->trace_load_task == task) {
+            app_end_preview(app);
+          }
           app->trace_load_task = nullptr;
           app->loading.active = false;
           trace_load_task_release(task);  // Release UI thread reference
@@ -233,19 +470,60 @@ void app_poll_completions(app_t* app) {
       // Always destroy the task context and release trace_data reference
       trace_data_release((trace_data_t*)task->td, allocator);
       trace_search_task_destroy(task);
+    } else if (cqe.task == trace_call_tree_task_run) {
+      trace_call_tree_task_t* task = (trace_call_tree_task_t*)cqe.user_data;
+      trace_viewer_t* tv = &app->trace_viewer;
+      if (cqe.status == TASK_STATUS_OK && !task->superseded) {
+        trace_viewer_adopt_call_tree(tv, task->tree, task->order,
+                                     task->offsets, task->start_time,
+                                     task->end_time, allocator);
+        task->tree = (trace_call_tree_t){};
+        task->order = (darray_uint32_t){};
+        task->offsets = (darray_double_t){};
+      }
+      if (app->active_call_tree_task == task) {
+        app->active_call_tree_task = nullptr;
+        tv->call_tree_computing = false;
+      }
+
+      trace_data_release((trace_data_t*)task->td, allocator);
+      trace_call_tree_task_destroy(task);
     }
     // Always remove the completion from the queue to free the slot!
     task_queue_remove_completion(app->task_queue);
   }
 
   if (reaped_any) {
-    app->loading.request_update = true;
+    app_apply_snapshots(app);
+    app_request_redraw(app);
   }
 }
 
+void app_request_redraw(app_t* app) { app->redraw_frames = APP_REDRAW_FRAMES; }
+
+// State that is only advanced by drawing more frames. Loading progress and
+// search results arrive as completions instead.
+static bool app_is_animating(const app_t* app) {
+  const trace_viewer_t* tv = &app->trace_viewer;
+  return app->first_frame || tv->search_query_dirty ||
+         tv->has_target_scroll_y || tv->has_target_focused_event ||
+         tv->request_scroll_to_focused_event ||
+         (tv->call_tree_requested && app->active_call_tree_task == nullptr);
+}
+
+bool app_needs_redraw(const app_t* app) {
+  return !app->power_save_mode || app->redraw_frames > 0 ||
+         app_is_animating(app);
+}
+
 void app_update(app_t* app) {
   allocator_t* allocator =
-      counting_allocator_get_allocator(&app->counting_allocator);
+      tagged_allocator_get_allocator(&app->tagged_allocator);
+  // Stays zero on frames where the timeline is not drawn.
+  app->trace_viewer.frame_stats = (trace_viewer_frame_stats_t){};
+  if (app->redraw_frames > 0) {
+    app->redraw_frames--;
+  }
 
   // === 0. Search Coordination (Task Queue Spawning) ===
   if (app->trace_viewer.search_query_dirty) {
@@ -283,6 +561,32 @@ void app_update(app_t* app) {
     }
   }
 
+  // === 0b. Call Tree Coordination (Task Queue Spawning) ===
+  trace_viewer_t* tv = &app->trace_viewer;
+  if (tv->call_tree_requested && app->trace_data != nullptr) {
+    trace_call_tree_task_t* task = app->active_call_tree_task;
+    if (task != nullptr) {
+      // Wait for the running task to stop before starting the next one.
+      if (!task->superseded) {
+        task->superseded = true;
+        task_queue_cancel_submission(app->task_queue, task);
+      }
+    } else {
+      task_submission_t* sub = task_queue_get_submission(app->task_queue);
+      if (sub != nullptr) {
+        trace_data_retain(app->trace_data);
+        app->active_call_tree_task = trace_call_tree_task_create(
+            app->trace_data, &tv->tracks, tv->call_tree_request_start_time,
+            tv->call_tree_request_end_time, sub, allocator);
+        task_queue_submit(app->task_queue);
+        tv->call_tree_requested = false;
+        tv->call_tree_computing = true;
+      } else {
+        LOG_DEBUG("app_update: Task Queue is full! Retrying the call tree.");
+      }
+    }
+  }
+
   // === 1. Main Menu Bar ===
   if (ig_begin_main_menu_bar()) {
     if (ig_begin_menu("View", true)) {
@@ -294,6 +598,10 @@ void app_update(app_t* app) {
       ig_menu_item_ptr("Power-save Mode", nullptr, &app->power_save_mode, true);
       ig_menu_item_ptr("Details Panel", nullptr,
                        &app->trace_viewer.show_details_panel, true);
+      ig_menu_item_ptr("Flame Graph", nullptr,
+                       &app->trace_viewer.show_flame_graph_panel, true);
+      ig_menu_item_ptr("Frame Profiler", nullptr, &app->show_frame_profiler,
+                       true);
 
       ig_separator();
       if (ig_begin_menu("Theme", true)) {
@@ -347,6 +655,9 @@ void app_update(app_t* app) {
     float text_width = ig_calc_text_size(mem_buf).x;
     ig_same_line(ig_get_window_size().x - text_width - 8.0f * 2.0f, 0.0f);
     ig_text_disabled("%s", mem_buf);
+    if (ig_is_item_hovered()) {
+      draw_memory_tooltip(app);
+    }
 
     ig_end_main_menu_bar();
   }
@@ -369,6 +680,10 @@ void app_update(app_t* app) {
     ig_dock_builder_split_node(dock_id_main, IG_DIR_RIGHT, 0.30f,
                                &dock_id_right, &dock_id_main);
     ig_dock_builder_dock_window("Details", dock_id_right);
+    uint32_t dock_id_bottom;
+    ig_dock_builder_split_node(dock_id_main, IG_DIR_DOWN, 0.30f,
+                               &dock_id_bottom, &dock_id_main);
+    ig_dock_builder_dock_window("Flame Graph", dock_id_bottom);
 
     ig_dock_node_t* main_node = ig_dock_builder_get_node(dock_id_main);
     if (main_node) {
@@ -384,6 +699,7 @@ void app_update(app_t* app) {
   if (app->show_metrics_window)
     ig_show_metrics_window(&app->show_metrics_window);
   if (app->show_about_window) ig_show_about_window(&app->show_about_window);
+  if (app->show_frame_profiler) draw_frame_profiler(app);
 
   if (ig_is_key_pressed(IG_KEY_SLASH, false) && ig_get_io_key_shift() &&
       !ig_get_io_want_text_input()) {
@@ -466,7 +782,9 @@ void app_update(app_t* app) {
   ig_push_style_var(IG_STYLE_VAR_WINDOW_PADDING, (ig_vec2_t){0.0f, 0.0f});
 
   if (ig_begin("Main Viewport", nullptr, viewport_flags)) {
-    if (app->loading.active) {
+    bool has_events =
+        app->trace_data != nullptr && app->trace_data->events.len > 0;
+    if (app->loading.active && !has_events) {
       const char* filename = app->loading.filename.len > 0
                                  ? (const char*)app->loading.filename.ptr
                                  : "";
@@ -474,8 +792,8 @@ void app_update(app_t* app) {
                           app->loading.total_bytes,
                           app->loading.input_consumed_bytes,
                           app->loading.input_total_bytes, app->theme);
-    } else if (app->trace_data != nullptr && app->trace_data->events.len > 0 &&
-               !app->loading.active) {
+    } else if (has_events) {
+      // While loading, this is the latest snapshot.
       trace_viewer_draw(&app->trace_viewer, app->trace_data, allocator,
                         app->theme);
     } else {
@@ -484,6 +802,48 @@ void app_update(app_t* app) {
   }
   ig_end();
   ig_pop_style_var(3);
+
+  if (app->loading.active && app->trace_data != nullptr) {
+    loading_screen_draw_overlay(app->loading.event_count,
+                                app->loading.input_consumed_bytes,
+                                app->loading.input_total_bytes, app->theme);
+  }
+}
+
+void app_record_frame(app_t* app, double start_ms, double poll_ms,
+                      double update_ms, double gl_ms, uint64_t upload_bytes) {
+  const trace_viewer_frame_stats_t* stats = &app->trace_viewer.frame_stats;
+  double layout_ms =
+      stats->step_ms - stats->step_render_blocks_ms - stats->hover_ms;
+  double draw_list_ms =
+      update_ms - stats->step_ms - stats->draw_render_blocks_ms;
+  const ig_draw_data_t* draw_data = ig_get_draw_data();
+  frame_profile_t frame = {
+      .start_ms = start_ms,
+      .phase_ms =
+          {
+              [FRAME_PHASE_POLL] = poll_ms,
+              [FRAME_PHASE_LAYOUT] = layout_ms > 0.0 ? layout_ms : 0.0,
+              [FRAME_PHASE_RENDER_BLOCKS] =
+                  stats->step_render_blocks_ms + stats->draw_render_blocks_ms,
+              [FRAME_PHASE_HOVER] = stats->hover_ms,
+              [FRAME_PHASE_DRAW_LIST] =
+                  draw_list_ms > 0.0 ? draw_list_ms : 0.0,
+              [FRAME_PHASE_GL] = gl_ms,
+          },
+      .counters =
+          {
+              [FRAME_COUNTER_RENDER_BLOCKS] = stats->render_blocks,
+              [FRAME_COUNTER_VERTICES] =
+                  draw_data ? (uint64_t)ig_draw_data_get_total_vtx_count(
+                                  draw_data)
+                            : 0,
+              [FRAME_COUNTER_TEXT_DRAWS] = stats->text_draws,
+              [FRAME_COUNTER_UPLOAD_BYTES] = upload_bytes,
+          },
+  };
+  frame_profiler_push(&app->frame_profiler, &frame);
+  app->drawn_frames++;
 }
 
 void app_on_theme_changed(app_t* app, bool is_dark) {
@@ -498,11 +858,18 @@ void app_on_theme_changed(app_t* app, bool is_dark) {
 
 void app_begin_session(app_t* app, int session_id, const char* filename,
                        size_t input_total_bytes) {
+  // A call tree task still reading the old tracks keeps them.
+  darray_track_t* old_tracks = app_call_tree_task_old_tracks(app);
+  if (old_tracks != nullptr) {
+    *old_tracks = app->trace_viewer.tracks;
+    app->trace_viewer.tracks = (darray_track_t){};
+  }
+
   // Stop any active running session (non-blocking abort)
   app_stop_jobs(app);
 
   allocator_t* allocator =
-      counting_allocator_get_allocator(&app->counting_allocator);
+      tagged_allocator_get_allocator(&app->tagged_allocator);
 
   // Reset the trace viewer state
   trace_viewer_deinit(&app->trace_viewer, allocator);
@@ -520,7 +887,7 @@ void app_begin_session(app_t* app, int session_id, const char* filename,
   app->loading.start_time = platform_get_now();
   app->loading.active = true;
   app->loading.session_id = session_id;
-  app->loading.request_update = false;
+  app_request_redraw(app);
 
   // Cache the trace filename
   darray_clear(&app->loading.filename);
@@ -538,13 +905,15 @@ void app_begin_session(app_t* app, int session_id, const char* filename,
   app->loading.stream_id = stream_id;
   app->trace_load_task =
       trace_load_task_create(app->task_queue, stream_id, allocator);
+  trace_load_task_set_snapshot_interval(app->trace_load_task,
+                                        APP_LOAD_SNAPSHOT_INTERVAL_CHUNKS);
 }
 
 size_t app_handle_file_chunk(app_t* app, int session_id, char* data,
                              size_t size, size_t input_consumed_bytes,
                              bool is_eof) {
   allocator_t* allocator =
-      counting_allocator_get_allocator(&app->counting_allocator);
+      tagged_allocator_get_allocator(&app->tagged_allocator);
 
   size_t result = 0;
 
@@ -7,13 +7,17 @@
 
 #include "core/allocator.h"
 #include "core/counting_allocator.h"
+#include "core/tagged_allocator.h"
+#include "core/vm_allocator.h"
 #include "core/task.h"
 #include "core/darray.h"
 #include "src/colors.h"
+#include "src/frame_profiler.h"
 #include "src/trace_data.h"
 #include "src/trace_viewer.h"
 
 struct trace_load_task;
+struct trace_load_snapshot;
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,20 +43,51 @@ typedef struct trace_loading_state {
   int session_id;            // Current active session ID
   task_stream_t stream_id;   // Scheduler stream ID of the active session
   darray_uint8_t filename;   // Name of the trace file being loaded
-  bool request_update;       // Set to true when new frames should be drawn
+  // Keeps the tracks of the trace being loaded finished as snapshots are
+  // applied to them. Null until the first snapshot arrives.
+  track_preview_t* track_preview;
+  // Snapshots that arrived while a task was reading the trace, applied in
+  // order once none is
+  darray_t(struct trace_load_snapshot*) pending_snapshots;
 } trace_loading_state_t;
 
+// Number of frames drawn after something changes, so that hover state,
+// tooltips and the dock layout can settle.
+constexpr int APP_REDRAW_FRAMES = 5;
+
+// Chunks between snapshots of a trace that is still loading (see
+// trace_load_task_set_snapshot_interval), which the viewer shows until the
+// load completes.
+constexpr size_t APP_LOAD_SNAPSHOT_INTERVAL_CHUNKS = 16;
+
 typedef struct app {
+  // Backs large arrays (events, args, track indices) with reserved address
+  // space that grows in place.
+  vm_allocator_t vm_allocator;
   counting_allocator_t counting_allocator;
+  // Wraps counting_allocator; all app allocations go through it so memory can
+  // be broken down per subsystem.
+  tagged_allocator_t tagged_allocator;
 
   // UI & Config
   theme_mode_t theme_mode;
   const theme_t* theme;
   bool power_save_mode;
+  // Damage tracking: with power_save_mode on, frames are only built and
+  // drawn while redraw_frames > 0 or the app is animating (see
+  // app_needs_redraw). Otherwise the host keeps presenting the last frame.
+  int redraw_frames;
+  // Frames built and drawn so far
+  uint64_t drawn_frames;
   bool first_frame;
   bool show_metrics_window;
   bool show_about_window;
   bool show_shortcuts_window;
+  bool show_frame_profiler;
+
+  // Phase timings and counts of recent frames, shown by the frame profiler
+  // overlay
+  frame_profiler_t frame_profiler;
 
   // Background Task Schedulers
   task_queue_t* task_queue;  // Global background task queue scheduler
@@ -60,6 +95,9 @@ typedef struct app {
       trace_load_task;  // Active loading task handle (opaque)
   struct trace_search_task*
       active_search_task;  // Active search task handle (opaque)
+  // Call tree task in flight (opaque). At most one runs at a time, since it
+  // reads the viewer's tracks without owning them.
+  struct trace_call_tree_task* active_call_tree_task;
 
   // Background Loading State
   trace_loading_state_t loading;
@@ -78,9 +116,24 @@ void app_deinit(app_t* app);
 // Polls and processes all pending background task completions.
 void app_poll_completions(app_t* app);
 
+// Marks the next APP_REDRAW_FRAMES frames dirty. Hosts call it on input and
+// window size changes; the app calls it on completions and theme changes.
+void app_request_redraw(app_t* app);
+
+// Returns whether the host must build and draw the next frame, or whether it
+// can skip app_update and rendering and keep presenting the previous frame.
+bool app_needs_redraw(const app_t* app);
+
 // Updates the application state and UI for a single frame.
 void app_update(app_t* app);
 
+// Records a drawn frame that started at `start_ms`, spent `poll_ms` in
+// app_poll_completions, `update_ms` from ig_new_frame through ig_render, and
+// `gl_ms` rendering the draw data, which uploaded `upload_bytes` to the GPU.
+// The trace viewer's frame stats break `update_ms` down further.
+void app_record_frame(app_t* app, double start_ms, double poll_ms,
+                      double update_ms, double gl_ms, uint64_t upload_bytes);
+
 // Notifies the application that the system theme has changed.
 void app_on_theme_changed(app_t* app, bool is_dark);
 
@@ -0,0 +1,308 @@
+#include "src/cli_output.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+
+bool cli_format_parse(string_view_t s, cli_format_t* out_format) {
+  bool ok = true;
+  if (string_view_eq(s, SV("table"))) {
+    *out_format = CLI_FORMAT_TABLE;
+  } else if (string_view_eq(s, SV("json"))) {
+    *out_format = CLI_FORMAT_JSON;
+  } else if (string_view_eq(s, SV("jsonl"))) {
+    *out_format = CLI_FORMAT_JSONL;
+  } else if (string_view_eq(s, SV("csv"))) {
+    *out_format = CLI_FORMAT_CSV;
+  } else {
+    ok = false;
+  }
+  return ok;
+}
+
+// ─── CSV ─────────────────────────────────────────────────────────────────────
+
+static void csv_write_separator(cli_output_t* o) {
+  if (o->csv_line_started) {
+    fputc(',', o->out);
+  }
+  o->csv_line_started = true;
+}
+
+// Quotes fields that contain a separator, quote or line break (RFC 4180).
+static void csv_write_field(cli_output_t* o, string_view_t value) {
+  csv_write_separator(o);
+  bool needs_quotes = false;
+  for (size_t i = 0; !needs_quotes && i < value.len; i++) {
+    char c = value.ptr[i];
+    needs_quotes = c == ',' || c == '"' || c == '\n' || c == '\r';
+  }
+  if (needs_quotes) {
+    fputc('"', o->out);
+    for (size_t i = 0; i < value.len; i++) {
+      if (value.ptr[i] == '"') {
+        fputc('"', o->out);
+      }
+      fputc(value.ptr[i], o->out);
+    }
+    fputc('"', o->out);
+  } else {
+    fwrite(value.ptr, 1, value.len, o->out);
+  }
+}
+
+static void csv_end_line(cli_output_t* o) {
+  fputc('\n', o->out);
+  o->csv_line_started = false;
+}
+
+static void csv_write_header(cli_output_t* o) {
+  if (!o->csv_header_written) {
+    for (size_t i = 0; i < o->columns.len; i++) {
+      if (o->columns.ptr[i].key.len > 0) {
+        csv_write_field(o, o->columns.ptr[i].key);
+      }
+    }
+    csv_end_line(o);
+    o->csv_header_written = true;
+  }
+}
+
+// Writes blank fields for keyed columns before `col` that the row skipped.
+static void csv_skip_to(cli_output_t* o, size_t col) {
+  for (size_t i = o->next_column; i < col && i < o->columns.len; i++) {
+    if (o->columns.ptr[i].key.len > 0) {
+      csv_write_separator(o);
+    }
+  }
+}
+
+// ─── Rows ────────────────────────────────────────────────────────────────────
+
+static void cli_output_end_row(cli_output_t* o) {
+  if (o->in_row) {
+    switch (o->format) {
+      case CLI_FORMAT_JSON:
+        json_writer_end_object(&o->json);
+        break;
+      case CLI_FORMAT_JSONL:
+        json_writer_end_object(&o->json);
+        json_writer_newline(&o->json);
+        break;
+      case CLI_FORMAT_CSV:
+        csv_skip_to(o, o->columns.len);
+        csv_end_line(o);
+        break;
+      case CLI_FORMAT_TABLE:
+        break;
+    }
+    o->in_row = false;
+  }
+}
+
+void cli_output_init(cli_output_t* o, cli_format_t format, FILE* out,
+                     allocator_t* a) {
+  *o = (cli_output_t){
+      .format = format,
+      .out = out,
+      .allocator = a,
+  };
+  if (format == CLI_FORMAT_JSON || format == CLI_FORMAT_JSONL) {
+    json_writer_init_stream(&o->json, false, out, &o->json_block, a);
+  }
+}
+
+void cli_output_deinit(cli_output_t* o) {
+  // Nothing is written if no table was started, e.g. on invalid options.
+  if (o->format == CLI_FORMAT_JSON && o->table_count > 0) {
+    json_writer_end_array(&o->json);
+    json_writer_newline(&o->json);
+  }
+  if (o->format == CLI_FORMAT_JSON || o->format == CLI_FORMAT_JSONL) {
+    json_writer_flush(&o->json);
+    darray_deinit(&o->json_block, o->allocator);
+  } else {
+    fflush(o->out);
+  }
+  darray_deinit(&o->columns, o->allocator);
+}
+
+void cli_output_begin_table(cli_output_t* o, string_view_t name) {
+  o->table_name = name;
+  darray_clear(&o->columns);
+  o->in_row = false;
+  o->csv_header_written = false;
+  switch (o->format) {
+    case CLI_FORMAT_TABLE:
+      cli_table_init(&o->table);
+      break;
+    case CLI_FORMAT_JSON:
+      if (o->table_count == 0) {
+        json_writer_begin_array(&o->json);
+      }
+      json_writer_begin_object(&o->json);
+      json_writer_name(&o->json, SV("table"));
+      json_writer_string(&o->json, name);
+      json_writer_name(&o->json, SV("rows"));
+      json_writer_begin_array(&o->json);
+      break;
+    case CLI_FORMAT_CSV:
+      if (o->table_count > 0) {
+        csv_end_line(o);
+      }
+      break;
+    case CLI_FORMAT_JSONL:
+      break;
+  }
+  o->table_count++;
+}
+
+void cli_output_add_column(cli_output_t* o, string_view_t key,
+                           string_view_t header, cli_table_align_t align,
+                           int width, bool dynamic) {
+  cli_output_column_t column = {.key = key, .table_index = SIZE_MAX};
+  if (o->format == CLI_FORMAT_TABLE && header.len > 0) {
+    column.table_index = o->table.columns.len;
+    cli_table_add_column(&o->table, header, align, width, dynamic);
+  }
+  darray_push(&o->columns, column, o->allocator);
+}
+
+void cli_output_set_show_sign(cli_output_t* o, size_t col) {
+  if (col < o->columns.len) {
+    o->columns.ptr[col].show_sign = true;
+  }
+}
+
+void cli_output_add_row(cli_output_t* o) {
+  cli_output_end_row(o);
+  switch (o->format) {
+    case CLI_FORMAT_TABLE:
+      cli_table_add_row(&o->table);
+      break;
+    case CLI_FORMAT_JSON:
+      json_writer_begin_object(&o->json);
+      break;
+    case CLI_FORMAT_JSONL:
+      json_writer_begin_object(&o->json);
+      json_writer_name(&o->json, SV("table"));
+      json_writer_string(&o->json, o->table_name);
+      break;
+    case CLI_FORMAT_CSV:
+      csv_write_header(o);
+      break;
+  }
+  o->in_row = true;
+  o->next_column = 0;
+}
+
+// Prepares a machine-format cell. Returns false if the column has no key, or
+// for table output.
+static bool cli_output_begin_cell(cli_output_t* o, size_t col) {
+  bool write = false;
+  if (o->format != CLI_FORMAT_TABLE && col < o->columns.len &&
+      o->columns.ptr[col].key.len > 0) {
+    write = true;
+    if (o->format == CLI_FORMAT_CSV) {
+      csv_skip_to(o, col);
+    } else {
+      json_writer_name(&o->json, o->columns.ptr[col].key);
+    }
+  }
+  o->next_column = col + 1;
+  return write;
+}
+
+static size_t cli_output_table_index(const cli_output_t* o, size_t col) {
+  return col < o->columns.len ? o->columns.ptr[col].table_index : SIZE_MAX;
+}
+
+static bool cli_output_show_sign(const cli_output_t* o, size_t col) {
+  return col < o->columns.len && o->columns.ptr[col].show_sign;
+}
+
+void cli_output_set_string(cli_output_t* o, size_t col, string_view_t value) {
+  if (o->format == CLI_FORMAT_TABLE) {
+    size_t index = cli_output_table_index(o, col);
+    if (index != SIZE_MAX) {
+      cli_table_set_cell(&o->table, index, value);
+    }
+  } else if (cli_output_begin_cell(o, col)) {
+    if (o->format == CLI_FORMAT_CSV) {
+      csv_write_field(o, value);
+    } else {
+      json_writer_string(&o->json, value);
+    }
+  }
+}
+
+void cli_output_set_fmt(cli_output_t* o, size_t col, const char* fmt, ...) {
+  string_t s = {};
+  va_list args;
+  va_start(args, fmt);
+  string_vprintf(&s, o->allocator, fmt, args);
+  va_end(args);
+  cli_output_set_string(o, col, string_get_view(&s));
+  string_free(s, o->allocator);
+}
+
+void cli_output_set_int(cli_output_t* o, size_t col, int64_t value) {
+  if (o->format == CLI_FORMAT_TABLE) {
+    size_t index = cli_output_table_index(o, col);
+    if (index != SIZE_MAX) {
+      if (cli_output_show_sign(o, col)) {
+        cli_table_set_cell_fmt(&o->table, index, "%+" PRId64, value);
+      } else {
+        cli_table_set_cell_fmt(&o->table, index, "%" PRId64, value);
+      }
+    }
+  } else if (cli_output_begin_cell(o, col)) {
+    if (o->format == CLI_FORMAT_CSV) {
+      csv_write_separator(o);
+      fprintf(o->out, "%" PRId64, value);
+    } else {
+      json_writer_number_int(&o->json, value);
+    }
+  }
+}
+
+void cli_output_set_double(cli_output_t* o, size_t col, double value,
+                           int precision) {
+  if (o->format == CLI_FORMAT_TABLE) {
+    size_t index = cli_output_table_index(o, col);
+    if (index != SIZE_MAX) {
+      if (cli_output_show_sign(o, col)) {
+        cli_table_set_cell_fmt(&o->table, index, "%+.*f", precision, value);
+      } else {
+        cli_table_set_cell_fmt(&o->table, index, "%.*f", precision, value);
+      }
+    }
+  } else if (cli_output_begin_cell(o, col)) {
+    if (o->format == CLI_FORMAT_CSV) {
+      // Same precision as json_writer_number_double.
+      csv_write_separator(o);
+      fprintf(o->out, "%.6g", value);
+    } else {
+      json_writer_number_double(&o->json, value);
+    }
+  }
+}
+
+void cli_output_end_table(cli_output_t* o) {
+  cli_output_end_row(o);
+  switch (o->format) {
+    case CLI_FORMAT_TABLE:
+      cli_table_fprint(&o->table, o->out);
+      cli_table_deinit(&o->table);
+      break;
+    case CLI_FORMAT_JSON:
+      json_writer_end_array(&o->json);
+      json_writer_end_object(&o->json);
+      break;
+    case CLI_FORMAT_CSV:
+      csv_write_header(o);
+      break;
+    case CLI_FORMAT_JSONL:
+      break;
+  }
+}
@@ -0,0 +1,125 @@
+#ifndef SRC_CLI_OUTPUT_H
+#define SRC_CLI_OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+#include "core/json_writer.h"
+#include "core/string.h"
+#include "src/cli_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ─── CLI Output ──────────────────────────────────────────────────────────────
+//
+// Writes the result tables of a subcommand in the format picked by --format:
+//
+//   table  Aligned text through cli_table. Rows are buffered, since column
+//          widths depend on every row.
+//   json   [{"table": "<name>", "rows": [{...}, ...]}, ...]
+//   jsonl  One {"table": "<name>", ...} object per row.
+//   csv    A header line and the rows of each table; tables are separated by
+//          a blank line.
+//
+// The machine formats write each row as soon as it is complete, through a
+// streaming json_writer (json/jsonl) or stdio (csv), so memory does not grow
+// with the number of rows.
+//
+// Columns have a machine key and a table header. A column with an empty key
+// only appears in table output (e.g. ASCII bars); one with an empty header
+// only appears in machine output (e.g. a raw number behind a formatted range).
+// Cells of a row must be set in column order.
+
+typedef enum cli_format {
+  CLI_FORMAT_TABLE,
+  CLI_FORMAT_JSON,
+  CLI_FORMAT_JSONL,
+  CLI_FORMAT_CSV,
+} cli_format_t;
+
+// Parses "table", "json", "jsonl" or "csv". Returns false otherwise.
+bool cli_format_parse(string_view_t s, cli_format_t* out_format);
+
+typedef struct cli_output_column {
+  string_view_t key;
+  // Index of the column in `table`, or SIZE_MAX for machine-only columns.
+  size_t table_index;
+  // Table output prints a '+' before positive numbers (e.g. deltas).
+  bool show_sign;
+} cli_output_column_t;
+
+typedef struct cli_output {
+  cli_format_t format;
+  FILE* out;
+  allocator_t* allocator;
+
+  // CLI_FORMAT_TABLE: the table being built.
+  cli_table_t table;
+  // CLI_FORMAT_JSON / CLI_FORMAT_JSONL: writer and its pending block.
+  json_writer_t json;
+  darray_uint8_t json_block;
+
+  string_view_t table_name;
+  darray_t(cli_output_column_t) columns;
+  size_t table_count;
+  bool in_row;
+  // Next column of the current row; CSV fills skipped columns with blanks.
+  size_t next_column;
+  // CSV: whether the current line has a field yet.
+  bool csv_line_started;
+  bool csv_header_written;
+} cli_output_t;
+
+void cli_output_init(cli_output_t* o, cli_format_t format, FILE* out,
+                     allocator_t* a);
+
+// Ends the document and flushes the stream. Writes nothing if no table was
+// started.
+void cli_output_deinit(cli_output_t* o);
+
+static inline bool cli_output_is_table(const cli_output_t* o) {
+  return o->format == CLI_FORMAT_TABLE;
+}
+
+// Starts a table. `name` is the machine name and must outlive the table.
+void cli_output_begin_table(cli_output_t* o, string_view_t name);
+
+// Adds a column to the current table. `key` must outlive the table.
+void cli_output_add_column(cli_output_t* o, string_view_t key,
+                           string_view_t header, cli_table_align_t align,
+                           int width, bool dynamic);
+
+// Prints numbers of column `col` with an explicit sign in table output.
+void cli_output_set_show_sign(cli_output_t* o, size_t col);
+
+// Starts a new row, completing the previous one.
+void cli_output_add_row(cli_output_t* o);
+
+void cli_output_set_string(cli_output_t* o, size_t col, string_view_t value);
+
+// Sets a text cell in every format.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((format(printf, 3, 4)))
+#endif
+void cli_output_set_fmt(cli_output_t* o, size_t col, const char* fmt, ...);
+
+void cli_output_set_int(cli_output_t* o, size_t col, int64_t value);
+
+// Sets a number cell; table output prints `precision` decimals.
+void cli_output_set_double(cli_output_t* o, size_t col, double value,
+                           int precision);
+
+// Completes the current table; table output prints it now.
+void cli_output_end_table(cli_output_t* o);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SRC_CLI_OUTPUT_H
@@ -0,0 +1,100 @@
+#include "src/cli_output.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <string>
+#include "core/allocator.h"
+
+// Writes a two-column table with a table-only and a machine-only column.
+static std::string write_sample(cli_format_t format) {
+  allocator_t* a = c_allocator();
+  FILE* f = tmpfile();
+  cli_output_t o;
+  cli_output_init(&o, format, f, a);
+
+  cli_output_begin_table(&o, SV("events"));
+  cli_output_add_column(&o, SV("name"), SV("Name"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(&o, SV(""), SV("Bar"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(&o, SV("count"), SV(""), CLI_ALIGN_RIGHT, 0, true);
+  cli_output_add_column(&o, SV("avg"), SV("Avg"), CLI_ALIGN_RIGHT, 0, true);
+
+  cli_output_add_row(&o);
+  cli_output_set_string(&o, 0, SV("a,\"b\""));
+  cli_output_set_string(&o, 1, SV("##"));
+  cli_output_set_int(&o, 2, 3);
+  cli_output_set_double(&o, 3, 1.5, 2);
+
+  cli_output_add_row(&o);
+  cli_output_set_fmt(&o, 0, "e%d", 2);
+  cli_output_set_double(&o, 3, 0.25, 2);
+  cli_output_end_table(&o);
+  cli_output_deinit(&o);
+
+  std::string result;
+  long size = ftell(f);
+  result.resize((size_t)size);
+  rewind(f);
+  EXPECT_EQ(fread(result.data(), 1, result.size(), f), result.size());
+  fclose(f);
+  return result;
+}
+
+TEST(cli_output_test, parse_format) {
+  cli_format_t format = CLI_FORMAT_TABLE;
+  EXPECT_TRUE(cli_format_parse(SV("jsonl"), &format));
+  EXPECT_EQ(format, CLI_FORMAT_JSONL);
+  EXPECT_TRUE(cli_format_parse(SV("csv"), &format));
+  EXPECT_EQ(format, CLI_FORMAT_CSV);
+  EXPECT_FALSE(cli_format_parse(SV("xml"), &format));
+  EXPECT_EQ(format, CLI_FORMAT_CSV);
+}
+
+TEST(cli_output_test, table_skips_machine_only_columns) {
+  std::string out = write_sample(CLI_FORMAT_TABLE);
+  EXPECT_NE(out.find("Name"), std::string::npos);
+  EXPECT_NE(out.find("##"), std::string::npos);
+  EXPECT_NE(out.find("1.50"), std::string::npos);
+  EXPECT_EQ(out.find("count"), std::string::npos);
+}
+
+TEST(cli_output_test, json) {
+  EXPECT_EQ(write_sample(CLI_FORMAT_JSON),
+            "[{\"table\":\"events\",\"rows\":["
+            "{\"name\":\"a,\\\"b\\\"\",\"count\":3,\"avg\":1.5},"
+            "{\"name\":\"e2\",\"avg\":0.25}]}]\n");
+}
+
+TEST(cli_output_test, jsonl) {
+  EXPECT_EQ(write_sample(CLI_FORMAT_JSONL),
+            "{\"table\":\"events\",\"name\":\"a,\\\"b\\\"\",\"count\":3,"
+            "\"avg\":1.5}\n"
+            "{\"table\":\"events\",\"name\":\"e2\",\"avg\":0.25}\n");
+}
+
+TEST(cli_output_test, csv_quotes_and_fills_skipped_columns) {
+  EXPECT_EQ(write_sample(CLI_FORMAT_CSV),
+            "name,count,avg\n"
+            "\"a,\"\"b\"\"\",3,1.5\n"
+            "e2,,0.25\n");
+}
+
+TEST(cli_output_test, csv_separates_tables) {
+  allocator_t* a = c_allocator();
+  FILE* f = tmpfile();
+  cli_output_t o;
+  cli_output_init(&o, CLI_FORMAT_CSV, f, a);
+  for (int i = 0; i < 2; i++) {
+    cli_output_begin_table(&o, SV("t"));
+    cli_output_add_column(&o, SV("v"), SV("V"), CLI_ALIGN_LEFT, 0, true);
+    cli_output_add_row(&o);
+    cli_output_set_int(&o, 0, i);
+    cli_output_end_table(&o);
+  }
+  cli_output_deinit(&o);
+
+  char buf[64] = {};
+  rewind(f);
+  size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  EXPECT_EQ(std::string(buf, n), "v\n0\n\nv\n1\n");
+}
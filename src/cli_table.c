@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "src/cli_table.h"
 
 #include <stdio.h>
@@ -29,7 +31,7 @@ static size_t utf8_strlen(string_view_t sv) {
   return len;
 }
 
-static int get_terminal_width(void) {
+static int get_terminal_width(FILE* out) {
   char* cols = getenv("COLUMNS");
   if (cols) {
     int val = atoi(cols);
@@ -38,14 +40,15 @@ static int get_terminal_width(void) {
     }
   }
 
-  if (!isatty(STDOUT_FILENO)) {
+  int fd = fileno(out);
+  if (fd < 0 || !isatty(fd)) {
     return 0; // Unlimited when redirected
   }
 
   int width = 80;
 #ifdef TIOCGWINSZ
   struct winsize w;
-  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == 0 && w.ws_col > 0) {
+  if (ioctl(fd, TIOCGWINSZ, &w) == 0 && w.ws_col > 0) {
     width = w.ws_col;
   }
 #endif
@@ -55,11 +58,12 @@ static int get_terminal_width(void) {
 // Prints at most max_width visual characters of sv.
 // If truncated, and max_width > 3, prints max_width - 1 chars and then "…".
 // Returns the actual visual width printed.
-static size_t print_truncated_utf8(string_view_t sv, size_t max_width) {
+static size_t print_truncated_utf8(FILE* out, string_view_t sv,
+                                   size_t max_width) {
   size_t total_visual_len = utf8_strlen(sv);
   
   if (total_visual_len <= max_width) {
-    printf("%.*s", (int)sv.len, sv.ptr);
+    fprintf(out, "%.*s", (int)sv.len, sv.ptr);
     return total_visual_len;
   }
   
@@ -88,9 +92,9 @@ static size_t print_truncated_utf8(string_view_t sv, size_t max_width) {
     visual_len++;
   }
   
-  printf("%.*s", (int)printed_bytes, sv.ptr);
+  fprintf(out, "%.*s", (int)printed_bytes, sv.ptr);
   if (use_ellipsis) {
-    printf("…");
+    fprintf(out, "…");
     visual_len++;
   }
   return visual_len;
@@ -161,7 +165,9 @@ void cli_table_set_cell_fmt(cli_table_t* t, size_t col_idx, const char* fmt, ...
   row->cells.ptr[col_idx] = s;
 }
 
-void cli_table_print(cli_table_t* t) {
+void cli_table_print(cli_table_t* t) { cli_table_fprint(t, stdout); }
+
+void cli_table_fprint(cli_table_t* t, FILE* out) {
   if (!t) return;
 
   // 1. Calculate dynamic widths based on content
@@ -186,7 +192,7 @@ void cli_table_print(cli_table_t* t) {
   }
 
   // 2. Adjust widths to fit terminal
-  int W = get_terminal_width();
+  int W = get_terminal_width(out);
   size_t total_width = 0;
   for (size_t c = 0; c < t->columns.len; c++) {
     total_width += (size_t)cols[c].width;
@@ -234,27 +240,27 @@ void cli_table_print(cli_table_t* t) {
     string_view_t header_view = string_get_view(&col->header);
     
     if (col->align == CLI_ALIGN_LEFT) {
-      size_t printed = print_truncated_utf8(header_view, (size_t)col->width);
+      size_t printed = print_truncated_utf8(out, header_view, (size_t)col->width);
       for (int i = 0; i < col->width - (int)printed; i++) {
-        putchar(' ');
+        fputc(' ', out);
       }
     } else {
       size_t header_len = utf8_strlen(header_view);
       if (header_len > (size_t)col->width) {
-        print_truncated_utf8(header_view, (size_t)col->width);
+        print_truncated_utf8(out, header_view, (size_t)col->width);
       } else {
         for (int i = 0; i < col->width - (int)header_len; i++) {
-          putchar(' ');
+          fputc(' ', out);
         }
-        printf("%.*s", (int)header_view.len, header_view.ptr);
+        fprintf(out, "%.*s", (int)header_view.len, header_view.ptr);
       }
     }
 
     if (c < t->columns.len - 1) {
-      printf(" | ");
+      fprintf(out, " | ");
     }
   }
-  printf("\n");
+  fprintf(out, "\n");
 
   // 4. Print separator
   total_width = 0;
@@ -265,9 +271,9 @@ void cli_table_print(cli_table_t* t) {
     total_width += (t->columns.len - 1) * 3;
   }
   for (size_t i = 0; i < total_width; i++) {
-    putchar('-');
+    fputc('-', out);
   }
-  printf("\n");
+  fprintf(out, "\n");
 
   // 5. Print rows
   cli_table_row_t* rows = t->rows.ptr;
@@ -281,26 +287,26 @@ void cli_table_print(cli_table_t* t) {
       }
 
       if (col->align == CLI_ALIGN_LEFT) {
-        size_t printed = print_truncated_utf8(cell_view, (size_t)col->width);
+        size_t printed = print_truncated_utf8(out, cell_view, (size_t)col->width);
         for (int i = 0; i < col->width - (int)printed; i++) {
-          putchar(' ');
+          fputc(' ', out);
         }
       } else {
         size_t cell_len = utf8_strlen(cell_view);
         if (cell_len > (size_t)col->width) {
-          print_truncated_utf8(cell_view, (size_t)col->width);
+          print_truncated_utf8(out, cell_view, (size_t)col->width);
         } else {
           for (int i = 0; i < col->width - (int)cell_len; i++) {
-            putchar(' ');
+            fputc(' ', out);
           }
-          printf("%.*s", (int)cell_view.len, cell_view.ptr);
+          fprintf(out, "%.*s", (int)cell_view.len, cell_view.ptr);
         }
       }
 
       if (c < t->columns.len - 1) {
-        printf(" | ");
+        fprintf(out, " | ");
       }
     }
-    printf("\n");
+    fprintf(out, "\n");
   }
 }
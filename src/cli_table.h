@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "core/darray.h"
 #include "core/string.h"
@@ -60,6 +61,9 @@ void cli_table_set_cell_fmt(cli_table_t* t, size_t col_idx, const char* fmt, ...
 // Prints the table to stdout, adjusting column widths to fit the terminal.
 void cli_table_print(cli_table_t* t);
 
+// Prints the table to `out`. Columns are only shrunk when `out` is a terminal.
+void cli_table_fprint(cli_table_t* t, FILE* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,9 @@
 #include "src/cli_table.h"
 #include <gtest/gtest.h>
+#include <stdio.h>
 #include <stdlib.h>
+
+#include <string>
 #include "core/allocator.h"
 
 TEST(cli_table_test, basic) {
@@ -81,3 +84,27 @@ TEST(cli_table_test, terminal_width_truncation) {
   cli_table_deinit(&t);
   unsetenv("COLUMNS");
 }
+
+TEST(cli_table_test, fprint_writes_to_stream) {
+  FILE* f = tmpfile();
+  ASSERT_NE(f, nullptr);
+
+  cli_table_t t;
+  cli_table_init(&t);
+  cli_table_add_column(&t, SV("Name"), CLI_ALIGN_LEFT, 0, true);
+  cli_table_add_column(&t, SV("Count"), CLI_ALIGN_RIGHT, 5, false);
+  cli_table_add_row(&t);
+  cli_table_set_cell(&t, 0, SV("frame"));
+  cli_table_set_cell_fmt(&t, 1, "%d", 3);
+  cli_table_fprint(&t, f);
+  cli_table_deinit(&t);
+
+  char buf[256] = {};
+  rewind(f);
+  size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  EXPECT_EQ(std::string(buf, n),
+            "Name  | Count\n"
+            "-------------\n"
+            "frame |     3\n");
+}
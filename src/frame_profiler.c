@@ -0,0 +1,143 @@
+#include "src/frame_profiler.h"
+
+#include "core/json_writer.h"
+#include "core/string.h"
+
+const char* frame_phase_name(frame_phase_t phase) {
+  static const char* const NAMES[FRAME_PHASE_COUNT] = {
+      [FRAME_PHASE_POLL] = "poll",
+      [FRAME_PHASE_LAYOUT] = "layout",
+      [FRAME_PHASE_RENDER_BLOCKS] = "render_blocks",
+      [FRAME_PHASE_HOVER] = "hover",
+      [FRAME_PHASE_DRAW_LIST] = "draw_list",
+      [FRAME_PHASE_GL] = "gl",
+  };
+  return phase < FRAME_PHASE_COUNT ? NAMES[phase] : "";
+}
+
+const char* frame_counter_name(frame_counter_t counter) {
+  static const char* const NAMES[FRAME_COUNTER_COUNT] = {
+      [FRAME_COUNTER_RENDER_BLOCKS] = "render_blocks",
+      [FRAME_COUNTER_VERTICES] = "vertices",
+      [FRAME_COUNTER_TEXT_DRAWS] = "text_draws",
+      [FRAME_COUNTER_UPLOAD_BYTES] = "upload_bytes",
+  };
+  return counter < FRAME_COUNTER_COUNT ? NAMES[counter] : "";
+}
+
+double frame_profile_total_ms(const frame_profile_t* frame) {
+  double total = 0.0;
+  for (int i = 0; i < FRAME_PHASE_COUNT; i++) {
+    total += frame->phase_ms[i];
+  }
+  return total;
+}
+
+void frame_profiler_push(frame_profiler_t* fp, const frame_profile_t* frame) {
+  fp->frames[fp->next] = *frame;
+  fp->next = (fp->next + 1) % FRAME_PROFILER_CAPACITY;
+  if (fp->len < FRAME_PROFILER_CAPACITY) {
+    fp->len++;
+  }
+}
+
+const frame_profile_t* frame_profiler_get(const frame_profiler_t* fp,
+                                          size_t i) {
+  size_t oldest = (fp->next + FRAME_PROFILER_CAPACITY - fp->len) %
+                  FRAME_PROFILER_CAPACITY;
+  return &fp->frames[(oldest + i) % FRAME_PROFILER_CAPACITY];
+}
+
+static int64_t ms_to_us(double ms) { return (int64_t)(ms * 1000.0); }
+
+static void write_event_header(json_writer_t* w, const char* name,
+                               const char* ph, int64_t ts_us) {
+  json_writer_name(w, SV("name"));
+  json_writer_string(w, string_view_from_cstr(name));
+  json_writer_name(w, SV("cat"));
+  json_writer_string(w, SV("frame"));
+  json_writer_name(w, SV("ph"));
+  json_writer_string(w, string_view_from_cstr(ph));
+  json_writer_name(w, SV("ts"));
+  json_writer_number_int(w, ts_us);
+  json_writer_name(w, SV("pid"));
+  json_writer_number_int(w, 1);
+  json_writer_name(w, SV("tid"));
+  json_writer_number_int(w, 1);
+}
+
+static void write_counters(json_writer_t* w, const frame_profile_t* frame) {
+  json_writer_name(w, SV("args"));
+  json_writer_begin_object(w);
+  for (int i = 0; i < FRAME_COUNTER_COUNT; i++) {
+    const char* name = frame_counter_name((frame_counter_t)i);
+    json_writer_name(w, string_view_from_cstr(name));
+    json_writer_number_int(w, (int64_t)frame->counters[i]);
+  }
+  json_writer_end_object(w);
+}
+
+void frame_profiler_write_json(const frame_profiler_t* fp,
+                               darray_uint8_t* out_buf, allocator_t* a) {
+  json_writer_t w;
+  json_writer_init(&w, false, out_buf, a);
+
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("traceEvents"));
+  json_writer_begin_array(&w);
+
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("name"));
+  json_writer_string(&w, SV("thread_name"));
+  json_writer_name(&w, SV("ph"));
+  json_writer_string(&w, SV("M"));
+  json_writer_name(&w, SV("pid"));
+  json_writer_number_int(&w, 1);
+  json_writer_name(&w, SV("tid"));
+  json_writer_number_int(&w, 1);
+  json_writer_name(&w, SV("args"));
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("name"));
+  json_writer_string(&w, SV("Frames"));
+  json_writer_end_object(&w);
+  json_writer_end_object(&w);
+
+  for (size_t f = 0; f < fp->len; f++) {
+    const frame_profile_t* frame = frame_profiler_get(fp, f);
+    // Whole microseconds, so the phases always fit inside the frame.
+    int64_t start_us = ms_to_us(frame->start_ms);
+    int64_t phase_us[FRAME_PHASE_COUNT];
+    int64_t total_us = 0;
+    for (int i = 0; i < FRAME_PHASE_COUNT; i++) {
+      phase_us[i] = ms_to_us(frame->phase_ms[i]);
+      total_us += phase_us[i];
+    }
+
+    json_writer_begin_object(&w);
+    write_event_header(&w, "frame", "X", start_us);
+    json_writer_name(&w, SV("dur"));
+    json_writer_number_int(&w, total_us);
+    write_counters(&w, frame);
+    json_writer_end_object(&w);
+
+    int64_t ts_us = start_us;
+    for (int i = 0; i < FRAME_PHASE_COUNT; i++) {
+      if (phase_us[i] > 0) {
+        json_writer_begin_object(&w);
+        write_event_header(&w, frame_phase_name((frame_phase_t)i), "X", ts_us);
+        json_writer_name(&w, SV("dur"));
+        json_writer_number_int(&w, phase_us[i]);
+        json_writer_end_object(&w);
+        ts_us += phase_us[i];
+      }
+    }
+
+    json_writer_begin_object(&w);
+    write_event_header(&w, "counts", "C", start_us);
+    write_counters(&w, frame);
+    json_writer_end_object(&w);
+  }
+
+  json_writer_end_array(&w);
+  json_writer_end_object(&w);
+}
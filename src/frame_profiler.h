@@ -0,0 +1,74 @@
+#ifndef SRC_FRAME_PROFILER_H
+#define SRC_FRAME_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+
+// Where a frame's time goes, in pipeline order. The phases are disjoint and
+// add up to the frame time.
+typedef enum frame_phase {
+  FRAME_PHASE_POLL,           // app_poll_completions
+  FRAME_PHASE_LAYOUT,         // trace_viewer_step, minus the two below
+  FRAME_PHASE_RENDER_BLOCKS,  // track_compute_*render_blocks, both passes
+  FRAME_PHASE_HOVER,          // Snapping and hit-testing
+  FRAME_PHASE_DRAW_LIST,      // The rest of building the ImGui draw lists
+  FRAME_PHASE_GL,             // Uploading and drawing the draw data
+  FRAME_PHASE_COUNT,
+} frame_phase_t;
+
+typedef enum frame_counter {
+  FRAME_COUNTER_RENDER_BLOCKS,  // Event and counter blocks drawn
+  FRAME_COUNTER_VERTICES,       // Vertices in the draw data
+  FRAME_COUNTER_TEXT_DRAWS,     // Event labels and track names drawn
+  FRAME_COUNTER_UPLOAD_BYTES,   // Buffer bytes uploaded to the GPU
+  FRAME_COUNTER_COUNT,
+} frame_counter_t;
+
+typedef struct frame_profile {
+  // platform_get_now() at the start of the frame
+  double start_ms;
+  double phase_ms[FRAME_PHASE_COUNT];
+  uint64_t counters[FRAME_COUNTER_COUNT];
+} frame_profile_t;
+
+constexpr size_t FRAME_PROFILER_CAPACITY = 240;
+
+// The most recent FRAME_PROFILER_CAPACITY frames. Recording a frame is a
+// struct copy, so the profiler stays on all the time.
+typedef struct frame_profiler {
+  frame_profile_t frames[FRAME_PROFILER_CAPACITY];
+  // Slot the next frame goes into
+  size_t next;
+  size_t len;
+} frame_profiler_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char* frame_phase_name(frame_phase_t phase);
+const char* frame_counter_name(frame_counter_t counter);
+
+// Returns the sum of the phases of `frame`.
+double frame_profile_total_ms(const frame_profile_t* frame);
+
+void frame_profiler_push(frame_profiler_t* fp, const frame_profile_t* frame);
+
+// Returns the i-th recorded frame, oldest first (i < fp->len).
+const frame_profile_t* frame_profiler_get(const frame_profiler_t* fp,
+                                          size_t i);
+
+// Serializes the recorded frames into out_buf as a Chrome trace: one 'X'
+// event per frame holding its counters, with the phases as children laid out
+// back to back in pipeline order, plus a 'C' counter event per frame.
+void frame_profiler_write_json(const frame_profiler_t* fp,
+                               darray_uint8_t* out_buf, allocator_t* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SRC_FRAME_PROFILER_H
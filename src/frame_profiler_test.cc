@@ -0,0 +1,59 @@
+#include "src/frame_profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+
+static frame_profile_t make_frame(double start_ms) {
+  frame_profile_t frame = {.start_ms = start_ms};
+  frame.phase_ms[FRAME_PHASE_LAYOUT] = 1.0;
+  frame.phase_ms[FRAME_PHASE_GL] = 2.5;
+  frame.counters[FRAME_COUNTER_TEXT_DRAWS] = 7;
+  frame.counters[FRAME_COUNTER_UPLOAD_BYTES] = 4096;
+  return frame;
+}
+
+TEST(frame_profiler_test, keeps_the_most_recent_frames) {
+  frame_profiler_t fp = {};
+  for (size_t i = 0; i < FRAME_PROFILER_CAPACITY + 10; i++) {
+    frame_profile_t frame = make_frame((double)i);
+    frame_profiler_push(&fp, &frame);
+  }
+
+  ASSERT_EQ(fp.len, (size_t)FRAME_PROFILER_CAPACITY);
+  EXPECT_DOUBLE_EQ(frame_profiler_get(&fp, 0)->start_ms, 10.0);
+  EXPECT_DOUBLE_EQ(frame_profiler_get(&fp, fp.len - 1)->start_ms,
+                   (double)(FRAME_PROFILER_CAPACITY + 9));
+  EXPECT_DOUBLE_EQ(frame_profile_total_ms(frame_profiler_get(&fp, 0)), 3.5);
+}
+
+TEST(frame_profiler_test, writes_chrome_trace) {
+  allocator_t* a = c_allocator();
+  frame_profiler_t fp = {};
+  frame_profile_t frame = make_frame(2.0);
+  frame_profiler_push(&fp, &frame);
+
+  darray_uint8_t buf = {};
+  frame_profiler_write_json(&fp, &buf, a);
+  std::string json((const char*)buf.ptr, buf.len);
+  darray_deinit(&buf, a);
+
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0u);
+  EXPECT_NE(json.find("\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\","
+                      "\"ts\":2000,\"pid\":1,\"tid\":1,\"dur\":3500"),
+            std::string::npos);
+  // Phases follow each other inside the frame; empty ones are left out.
+  EXPECT_NE(json.find("\"name\":\"layout\",\"cat\":\"frame\",\"ph\":\"X\","
+                      "\"ts\":2000,\"pid\":1,\"tid\":1,\"dur\":1000"),
+            std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"gl\",\"cat\":\"frame\",\"ph\":\"X\","
+                      "\"ts\":3000,\"pid\":1,\"tid\":1,\"dur\":2500"),
+            std::string::npos);
+  EXPECT_EQ(json.find("\"name\":\"poll\""), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"C\""), std::string::npos);
+  EXPECT_NE(json.find("\"text_draws\":7"), std::string::npos);
+  EXPECT_NE(json.find("\"upload_bytes\":4096"), std::string::npos);
+}
@@ -54,9 +54,14 @@ static_assert(IG_WINDOW_FLAGS_NO_COLLAPSE == ImGuiWindowFlags_NoCollapse,
 static_assert(IG_WINDOW_FLAGS_NO_SCROLL_WITH_MOUSE ==
                   ImGuiWindowFlags_NoScrollWithMouse,
               "ImGuiWindowFlags mismatch");
+static_assert(IG_WINDOW_FLAGS_ALWAYS_AUTO_RESIZE ==
+                  ImGuiWindowFlags_AlwaysAutoResize,
+              "ImGuiWindowFlags mismatch");
 static_assert(IG_WINDOW_FLAGS_NO_FOCUS_ON_APPEARING ==
                   ImGuiWindowFlags_NoFocusOnAppearing,
               "ImGuiWindowFlags mismatch");
+static_assert(IG_WINDOW_FLAGS_NO_DOCKING == ImGuiWindowFlags_NoDocking,
+              "ImGuiWindowFlags mismatch");
 
 static_assert(IG_INPUT_TEXT_FLAGS_NONE == ImGuiInputTextFlags_None,
               "ImGuiInputTextFlags mismatch");
@@ -95,6 +100,7 @@ static_assert(IG_DOCK_NODE_FLAGS_NO_DOCKING_OVER_ME ==
               "ImGuiDockNodeFlags mismatch");
 
 static_assert(IG_DIR_RIGHT == ImGuiDir_Right, "ImGuiDir mismatch");
+static_assert(IG_DIR_DOWN == ImGuiDir_Down, "ImGuiDir mismatch");
 
 static_assert(IG_COL_POPUP_BG == ImGuiCol_PopupBg, "ImGuiCol mismatch");
 
@@ -125,6 +131,10 @@ void ig_io_set_display_size(ig_vec2_t size) {
 
 void ig_io_set_delta_time(float dt) { ImGui::GetIO().DeltaTime = dt; }
 
+bool ig_io_has_pending_input_events(void) {
+  return ImGui::GetCurrentContext()->InputEventsQueue.Size > 0;
+}
+
 void ig_set_allocator_functions(void* (*alloc_func)(size_t sz, void* user_data),
                                 void (*free_func)(void* ptr, void* user_data),
                                 void* user_data) {
@@ -162,6 +172,10 @@ ig_draw_data_t* ig_get_draw_data(void) {
   return reinterpret_cast<ig_draw_data_t*>(ImGui::GetDrawData());
 }
 
+int ig_draw_data_get_total_vtx_count(const ig_draw_data_t* draw_data) {
+  return reinterpret_cast<const ImDrawData*>(draw_data)->TotalVtxCount;
+}
+
 ig_draw_list_t* ig_get_window_draw_list(void) {
   return reinterpret_cast<ig_draw_list_t*>(ImGui::GetWindowDrawList());
 }
@@ -566,6 +580,16 @@ void ig_draw_list_add_rect(ig_draw_list_t* draw_list, ig_vec2_t p_min,
       thickness);
 }
 
+void ig_draw_list_add_rect_instances(ig_draw_list_t* draw_list,
+                                     const ig_rect_instance_t* rects,
+                                     size_t count) {
+  if (count > 0) {
+    reinterpret_cast<ImDrawList*>(draw_list)->AddCallback(
+        IG_DRAW_CALLBACK_RECT_INSTANCES, (void*)rects,
+        count * sizeof(ig_rect_instance_t));
+  }
+}
+
 void ig_draw_list_add_line(ig_draw_list_t* draw_list, ig_vec2_t p1,
                            ig_vec2_t p2, uint32_t col, float thickness) {
   reinterpret_cast<ImDrawList*>(draw_list)->AddLine(
@@ -55,7 +55,9 @@ constexpr ig_window_flags_t IG_WINDOW_FLAGS_NO_MOVE = 4;
 constexpr ig_window_flags_t IG_WINDOW_FLAGS_NO_SCROLLBAR = 8;
 constexpr ig_window_flags_t IG_WINDOW_FLAGS_NO_COLLAPSE = 32;
 constexpr ig_window_flags_t IG_WINDOW_FLAGS_NO_SCROLL_WITH_MOUSE = 16;
+constexpr ig_window_flags_t IG_WINDOW_FLAGS_ALWAYS_AUTO_RESIZE = 64;
 constexpr ig_window_flags_t IG_WINDOW_FLAGS_NO_FOCUS_ON_APPEARING = 4096;
+constexpr ig_window_flags_t IG_WINDOW_FLAGS_NO_DOCKING = 1 << 19;
 
 constexpr ig_input_text_flags_t IG_INPUT_TEXT_FLAGS_NONE = 0;
 constexpr ig_input_text_flags_t IG_INPUT_TEXT_FLAGS_CALLBACK_RESIZE = 4194304;
@@ -99,6 +101,7 @@ constexpr ig_dock_node_flags_t IG_DOCK_NODE_FLAGS_NO_TAB_BAR = 1 << 12;
 constexpr ig_dock_node_flags_t IG_DOCK_NODE_FLAGS_NO_DOCKING_OVER_ME = 1 << 20;
 
 constexpr ig_dir_t IG_DIR_RIGHT = 1;
+constexpr ig_dir_t IG_DIR_DOWN = 3;
 
 constexpr ig_col_t IG_COL_POPUP_BG = 4;
 
@@ -116,6 +119,8 @@ void ig_create_context(void);
 void ig_destroy_context(void);
 void ig_io_set_display_size(ig_vec2_t size);
 void ig_io_set_delta_time(float dt);
+// Returns whether input events were queued since the last ig_new_frame.
+bool ig_io_has_pending_input_events(void);
 void ig_set_allocator_functions(void* (*alloc_func)(size_t sz, void* user_data),
                                 void (*free_func)(void* ptr, void* user_data),
                                 void* user_data);
@@ -126,6 +131,7 @@ void ig_set_font_data(const void* font_data, int font_size, float dpi_scale);
 void ig_new_frame(void);
 void ig_render(void);
 ig_draw_data_t* ig_get_draw_data(void);
+int ig_draw_data_get_total_vtx_count(const ig_draw_data_t* draw_data);
 
 ig_draw_list_t* ig_get_window_draw_list(void);
 ig_vec2_t ig_get_cursor_screen_pos(void);
@@ -328,6 +334,11 @@ void ig_draw_list_add_rect_filled(ig_draw_list_t* draw_list, ig_vec2_t p_min,
 void ig_draw_list_add_rect(ig_draw_list_t* draw_list, ig_vec2_t p_min,
                            ig_vec2_t p_max, uint32_t col, float rounding,
                            int flags, float thickness);
+// Queues `count` rectangles to be drawn as one instanced batch at this point
+// of the draw list. The rectangles are copied.
+void ig_draw_list_add_rect_instances(ig_draw_list_t* draw_list,
+                                     const ig_rect_instance_t* rects,
+                                     size_t count);
 void ig_draw_list_add_line(ig_draw_list_t* draw_list, ig_vec2_t p1,
                            ig_vec2_t p2, uint32_t col, float thickness);
 void ig_draw_list_add_text_simple(ig_draw_list_t* draw_list, ig_vec2_t pos,
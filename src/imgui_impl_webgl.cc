@@ -8,18 +8,48 @@
 #include "core/allocator.h"
 #include "core/logging.h"
 #include "core/darray.h"
+#include "src/imgui_types.h"
 #include "third_party/imgui/imgui.h"
 
+// Attribute locations of the rect instance program. They overlap the ImGui
+// program's, so the divisors are reset after each batch.
+enum {
+  RECT_ATTRIB_RECT = 0,
+  RECT_ATTRIB_COLOR = 1,
+  RECT_ATTRIB_BORDER_COLOR = 2,
+  RECT_ATTRIB_FLAGS = 3,
+  RECT_ATTRIB_CORNER = 4,
+};
+
+// A GPU buffer and a CPU copy of its contents. The GPU storage only grows,
+// and each frame uploads just the byte range that differs from the last one.
+struct StreamBuffer {
+  GLenum target;
+  GLuint buffer;
+  // Bytes of GPU storage
+  size_t capacity;
+  // Contents of the GPU buffer; the first `valid` bytes match it.
+  darray_uint8_t staging;
+  size_t valid;
+  size_t dirty_begin, dirty_end;
+};
+
 struct BackendData {
   allocator_t* allocator;
   GLuint shader_program;
-  GLuint vbo, ebo;
+  StreamBuffer vbo, ebo;
   GLuint vao;
   GLuint font_texture;
   GLint attrib_location_pos, attrib_location_uv, attrib_location_color;
   GLint attrib_location_proj_mtx;
-  darray_t(ImDrawVert) vtx_staging;
-  darray_t(ImDrawIdx) idx_staging;
+  float proj_mtx[4][4];
+  // Instanced rectangles, see IG_DRAW_CALLBACK_RECT_INSTANCES
+  GLuint rect_program;
+  GLint rect_location_proj_mtx;
+  GLuint rect_corner_vbo;
+  // The rect instances of every batch of a frame, one range per batch
+  StreamBuffer rect_instance_vbo;
+  imgui_impl_webgl_stats_t stats;
 };
 
 static BackendData* get_backend_data() {
@@ -28,6 +58,63 @@ static BackendData* get_backend_data() {
              : nullptr;
 }
 
+static void stream_buffer_init(StreamBuffer* sb, GLenum target) {
+  *sb = {};
+  sb->target = target;
+  glGenBuffers(1, &sb->buffer);
+}
+
+static void stream_buffer_deinit(StreamBuffer* sb, allocator_t* allocator) {
+  glDeleteBuffers(1, &sb->buffer);
+  darray_deinit(&sb->staging, allocator);
+}
+
+// Starts writing `size` bytes of new contents.
+static void stream_buffer_begin(StreamBuffer* sb, size_t size,
+                                allocator_t* allocator) {
+  darray_resize(&sb->staging, size, allocator);
+  sb->dirty_begin = size;
+  sb->dirty_end = 0;
+}
+
+// Copies `size` bytes to `offset`, marking them dirty unless the GPU already
+// holds them.
+static void stream_buffer_write(StreamBuffer* sb, size_t offset,
+                                const void* data, size_t size) {
+  uint8_t* dst = sb->staging.ptr + offset;
+  if (offset + size > sb->valid || memcmp(dst, data, size) != 0) {
+    memcpy(dst, data, size);
+    if (offset < sb->dirty_begin) sb->dirty_begin = offset;
+    if (offset + size > sb->dirty_end) sb->dirty_end = offset + size;
+  }
+}
+
+// Uploads the dirty range, growing the GPU storage first if needed, and leaves
+// the buffer bound.
+static void stream_buffer_upload(StreamBuffer* sb,
+                                 imgui_impl_webgl_stats_t* stats) {
+  size_t size = sb->staging.len;
+  glBindBuffer(sb->target, sb->buffer);
+  bool grow = size > sb->capacity;
+  if (grow) {
+    // New storage starts out undefined, so all of it is uploaded.
+    sb->capacity = size > sb->capacity * 2 ? size : sb->capacity * 2;
+    stats->buffer_grows++;
+    glBufferData(sb->target, (GLsizeiptr)sb->capacity, nullptr,
+                 GL_DYNAMIC_DRAW);
+    sb->dirty_begin = 0;
+    sb->dirty_end = size;
+  }
+  if (sb->dirty_end > sb->dirty_begin) {
+    size_t dirty = sb->dirty_end - sb->dirty_begin;
+    glBufferSubData(sb->target, (GLintptr)sb->dirty_begin, (GLsizeiptr)dirty,
+                    sb->staging.ptr + sb->dirty_begin);
+    stats->uploaded_bytes += dirty;
+  }
+  stats->written_bytes += size;
+  sb->valid = size;
+}
+
 static void setup_vertex_attributes(size_t vtx_offset) {
   BackendData* bd = get_backend_data();
 
@@ -68,18 +155,66 @@ static void setup_render_state(ImDrawData* draw_data, int fb_width,
       {0.0f, 0.0f, -1.0f, 0.0f},
       {(R + L) / (L - R), (T + B) / (B - T), 0.0f, 1.0f},
   };
+  memcpy(bd->proj_mtx, ortho_projection, sizeof(ortho_projection));
   glUseProgram(bd->shader_program);
   glUniformMatrix4fv(bd->attrib_location_proj_mtx, 1, GL_FALSE,
                      &ortho_projection[0][0]);
 
-  glBindBuffer(GL_ARRAY_BUFFER, bd->vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ebo);
+  glBindBuffer(GL_ARRAY_BUFFER, bd->vbo.buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ebo.buffer);
 
   glEnableVertexAttribArray((GLuint)bd->attrib_location_pos);
   glEnableVertexAttribArray((GLuint)bd->attrib_location_uv);
   glEnableVertexAttribArray((GLuint)bd->attrib_location_color);
 }
 
+static bool is_rect_instances(const ImDrawCmd* pcmd) {
+  return pcmd->UserCallback == IG_DRAW_CALLBACK_RECT_INSTANCES;
+}
+
+// Draws the ig_rect_instance_t batch of `pcmd`, uploaded at `offset` in the
+// rect instance buffer, with one instanced draw call.
+static void render_rect_instances(const ImDrawCmd* pcmd, size_t offset) {
+  BackendData* bd = get_backend_data();
+  size_t size = (size_t)pcmd->UserCallbackDataSize;
+  GLsizei count = (GLsizei)(size / sizeof(ig_rect_instance_t));
+
+  glBindBuffer(GL_ARRAY_BUFFER, bd->rect_instance_vbo.buffer);
+  glUseProgram(bd->rect_program);
+  glUniformMatrix4fv(bd->rect_location_proj_mtx, 1, GL_FALSE,
+                     &bd->proj_mtx[0][0]);
+
+  GLsizei stride = sizeof(ig_rect_instance_t);
+  glVertexAttribPointer(RECT_ATTRIB_RECT, 4, GL_FLOAT, GL_FALSE, stride,
+                        (GLvoid*)(offset + offsetof(ig_rect_instance_t, x1)));
+  glVertexAttribPointer(
+      RECT_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+      (GLvoid*)(offset + offsetof(ig_rect_instance_t, color)));
+  glVertexAttribPointer(
+      RECT_ATTRIB_BORDER_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+      (GLvoid*)(offset + offsetof(ig_rect_instance_t, border_color)));
+  glVertexAttribIPointer(
+      RECT_ATTRIB_FLAGS, 1, GL_UNSIGNED_INT, stride,
+      (GLvoid*)(offset + offsetof(ig_rect_instance_t, flags)));
+  for (GLuint i = RECT_ATTRIB_RECT; i <= RECT_ATTRIB_FLAGS; i++) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribDivisor(i, 1);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, bd->rect_corner_vbo);
+  glVertexAttribPointer(RECT_ATTRIB_CORNER, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glEnableVertexAttribArray(RECT_ATTRIB_CORNER);
+
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+  bd->stats.draw_calls++;
+
+  for (GLuint i = RECT_ATTRIB_RECT; i <= RECT_ATTRIB_FLAGS; i++) {
+    glVertexAttribDivisor(i, 0);
+  }
+  glDisableVertexAttribArray(RECT_ATTRIB_FLAGS);
+  glDisableVertexAttribArray(RECT_ATTRIB_CORNER);
+}
+
 void imgui_impl_webgl_render_draw_data(struct ig_draw_data* draw_data_opaque) {
   ImDrawData* draw_data = reinterpret_cast<ImDrawData*>(draw_data_opaque);
   int fb_width =
@@ -90,46 +225,63 @@ void imgui_impl_webgl_render_draw_data(struct ig_draw_data* draw_data_opaque) {
 
   BackendData* bd = get_backend_data();
   allocator_t* allocator = bd->allocator;
+  bd->stats = {};
 
-  // 1. Calculate total counts and prepare staging buffers
+  // 1. Calculate total sizes
   size_t total_vtx_count = 0;
   size_t total_idx_count = 0;
+  size_t total_rect_size = 0;
   for (int n = 0; n < draw_data->CmdListsCount; n++) {
     const ImDrawList* cmd_list = draw_data->CmdLists[n];
     total_vtx_count += (size_t)cmd_list->VtxBuffer.Size;
     total_idx_count += (size_t)cmd_list->IdxBuffer.Size;
+    for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
+      const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+      if (is_rect_instances(pcmd)) {
+        total_rect_size += (size_t)pcmd->UserCallbackDataSize;
+      }
+    }
   }
 
-  darray_resize(&bd->vtx_staging, total_vtx_count, allocator);
-  darray_resize(&bd->idx_staging, total_idx_count, allocator);
-
-  // 2. Concatenate data
+  // 2. Concatenate data, skipping draw lists and rect batches that did not
+  // change since the last frame. Each rect batch gets its own range, so none
+  // is overwritten while an earlier draw may still read it.
+  stream_buffer_begin(&bd->vbo, total_vtx_count * sizeof(ImDrawVert),
+                      allocator);
+  stream_buffer_begin(&bd->ebo, total_idx_count * sizeof(ImDrawIdx),
+                      allocator);
+  stream_buffer_begin(&bd->rect_instance_vbo, total_rect_size, allocator);
   size_t vtx_dst_offset = 0;
   size_t idx_dst_offset = 0;
+  size_t rect_dst_offset = 0;
   for (int n = 0; n < draw_data->CmdListsCount; n++) {
     const ImDrawList* cmd_list = draw_data->CmdLists[n];
-    size_t vtx_count = (size_t)cmd_list->VtxBuffer.Size;
-    size_t idx_count = (size_t)cmd_list->IdxBuffer.Size;
+    size_t vtx_size = (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+    size_t idx_size = (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
 
-    memcpy(bd->vtx_staging.ptr + vtx_dst_offset,
-           cmd_list->VtxBuffer.Data, vtx_count * sizeof(ImDrawVert));
-    memcpy(bd->idx_staging.ptr + idx_dst_offset,
-           cmd_list->IdxBuffer.Data, idx_count * sizeof(ImDrawIdx));
+    stream_buffer_write(&bd->vbo, vtx_dst_offset, cmd_list->VtxBuffer.Data,
+                        vtx_size);
+    stream_buffer_write(&bd->ebo, idx_dst_offset, cmd_list->IdxBuffer.Data,
+                        idx_size);
 
-    vtx_dst_offset += vtx_count;
-    idx_dst_offset += idx_count;
-  }
+    vtx_dst_offset += vtx_size;
+    idx_dst_offset += idx_size;
 
-  // 3. One single upload to GPU
-  glBindBuffer(GL_ARRAY_BUFFER, bd->vbo);
-  glBufferData(GL_ARRAY_BUFFER,
-               (GLsizeiptr)(total_vtx_count * sizeof(ImDrawVert)),
-               bd->vtx_staging.ptr, GL_STREAM_DRAW);
+    for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
+      const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+      if (is_rect_instances(pcmd)) {
+        size_t rect_size = (size_t)pcmd->UserCallbackDataSize;
+        stream_buffer_write(&bd->rect_instance_vbo, rect_dst_offset,
+                            pcmd->UserCallbackData, rect_size);
+        rect_dst_offset += rect_size;
+      }
+    }
+  }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               (GLsizeiptr)(total_idx_count * sizeof(ImDrawIdx)),
-               bd->idx_staging.ptr, GL_STREAM_DRAW);
+  // 3. At most one upload per buffer
+  stream_buffer_upload(&bd->vbo, &bd->stats);
+  stream_buffer_upload(&bd->ebo, &bd->stats);
+  stream_buffer_upload(&bd->rect_instance_vbo, &bd->stats);
 
   // 4. Setup state and render
   setup_render_state(draw_data, fb_width, fb_height);
@@ -138,11 +290,21 @@ void imgui_impl_webgl_render_draw_data(struct ig_draw_data* draw_data_opaque) {
   ImVec2 clip_scale = draw_data->FramebufferScale;
   size_t global_vtx_offset = 0;
   size_t global_idx_offset = 0;
+  size_t rect_offset = 0;
 
   for (int n = 0; n < draw_data->CmdListsCount; n++) {
     const ImDrawList* cmd_list = draw_data->CmdLists[n];
     for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
       const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+      if (pcmd->UserCallback == ImDrawCallback_ResetRenderState) {
+        setup_render_state(draw_data, fb_width, fb_height);
+        continue;
+      }
+      if (pcmd->UserCallback != nullptr && !is_rect_instances(pcmd)) {
+        pcmd->UserCallback(cmd_list, pcmd);
+        continue;
+      }
+
       ImVec2 clip_min((pcmd->ClipRect.x - clip_off.x) * clip_scale.x,
                       (pcmd->ClipRect.y - clip_off.y) * clip_scale.y);
       ImVec2 clip_max((pcmd->ClipRect.z - clip_off.x) * clip_scale.x,
@@ -153,13 +315,22 @@ void imgui_impl_webgl_render_draw_data(struct ig_draw_data* draw_data_opaque) {
         glScissor((int)clip_min.x, (int)((float)fb_height - clip_max.y),
                   (int)(clip_max.x - clip_min.x),
                   (int)(clip_max.y - clip_min.y));
-        glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->GetTexID());
-        setup_vertex_attributes(global_vtx_offset + pcmd->VtxOffset);
-        glDrawElements(
-            GL_TRIANGLES, (GLsizei)pcmd->ElemCount,
-            sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
-            (void*)(intptr_t)((global_idx_offset + pcmd->IdxOffset) *
-                              sizeof(ImDrawIdx)));
+        if (is_rect_instances(pcmd)) {
+          render_rect_instances(pcmd, rect_offset);
+          setup_render_state(draw_data, fb_width, fb_height);
+        } else {
+          glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->GetTexID());
+          setup_vertex_attributes(global_vtx_offset + pcmd->VtxOffset);
+          glDrawElements(
+              GL_TRIANGLES, (GLsizei)pcmd->ElemCount,
+              sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+              (void*)(intptr_t)((global_idx_offset + pcmd->IdxOffset) *
+                                sizeof(ImDrawIdx)));
+          bd->stats.draw_calls++;
+        }
+      }
+      if (is_rect_instances(pcmd)) {
+        rect_offset += (size_t)pcmd->UserCallbackDataSize;
       }
     }
     global_vtx_offset += (size_t)cmd_list->VtxBuffer.Size;
@@ -167,6 +338,49 @@ void imgui_impl_webgl_render_draw_data(struct ig_draw_data* draw_data_opaque) {
   }
 }
 
+static GLuint compile_shader(GLenum type, const GLchar* source) {
+  GLuint handle = glCreateShader(type);
+  glShaderSource(handle, 1, &source, nullptr);
+  glCompileShader(handle);
+  GLint status;
+  glGetShaderiv(handle, GL_COMPILE_STATUS, &status);
+  if (status == GL_FALSE) {
+    char buffer[512];
+    glGetShaderInfoLog(handle, 512, nullptr, buffer);
+    LOG_ERROR("%s shader compilation failed: %s",
+              type == GL_VERTEX_SHADER ? "vertex" : "fragment", buffer);
+    glDeleteShader(handle);
+    handle = 0;
+  }
+  return handle;
+}
+
+// Returns 0 if a shader fails to compile or the program fails to link.
+static GLuint create_program(const GLchar* vertex_shader,
+                             const GLchar* fragment_shader) {
+  GLuint program = 0;
+  GLuint vert_handle = compile_shader(GL_VERTEX_SHADER, vertex_shader);
+  GLuint frag_handle = compile_shader(GL_FRAGMENT_SHADER, fragment_shader);
+  if (vert_handle && frag_handle) {
+    program = glCreateProgram();
+    glAttachShader(program, vert_handle);
+    glAttachShader(program, frag_handle);
+    glLinkProgram(program);
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+      char buffer[512];
+      glGetProgramInfoLog(program, 512, nullptr, buffer);
+      LOG_ERROR("shader program linking failed: %s", buffer);
+      glDeleteProgram(program);
+      program = 0;
+    }
+  }
+  if (vert_handle) glDeleteShader(vert_handle);
+  if (frag_handle) glDeleteShader(frag_handle);
+  return program;
+}
+
 bool imgui_impl_webgl_init(allocator_t* allocator) {
   ImGuiIO& io = ImGui::GetIO();
   BackendData* bd =
@@ -204,40 +418,8 @@ bool imgui_impl_webgl_init(allocator_t* allocator) {
       "    Out_Color = Frag_Color * texture(Texture, Frag_UV.st);\n"
       "}\n";
 
-  GLuint vert_handle = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vert_handle, 1, &vertex_shader, nullptr);
-  glCompileShader(vert_handle);
-  GLint status;
-  glGetShaderiv(vert_handle, GL_COMPILE_STATUS, &status);
-  if (status == GL_FALSE) {
-    char buffer[512];
-    glGetShaderInfoLog(vert_handle, 512, nullptr, buffer);
-    LOG_ERROR("vertex shader compilation failed: %s", buffer);
-    return false;
-  }
-
-  GLuint frag_handle = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(frag_handle, 1, &fragment_shader, nullptr);
-  glCompileShader(frag_handle);
-  glGetShaderiv(frag_handle, GL_COMPILE_STATUS, &status);
-  if (status == GL_FALSE) {
-    char buffer[512];
-    glGetShaderInfoLog(frag_handle, 512, nullptr, buffer);
-    LOG_ERROR("fragment shader compilation failed: %s", buffer);
-    return false;
-  }
-
-  bd->shader_program = glCreateProgram();
-  glAttachShader(bd->shader_program, vert_handle);
-  glAttachShader(bd->shader_program, frag_handle);
-  glLinkProgram(bd->shader_program);
-  glGetProgramiv(bd->shader_program, GL_LINK_STATUS, &status);
-  if (status == GL_FALSE) {
-    char buffer[512];
-    glGetProgramInfoLog(bd->shader_program, 512, nullptr, buffer);
-    LOG_ERROR("shader program linking failed: %s", buffer);
-    return false;
-  }
+  bd->shader_program = create_program(vertex_shader, fragment_shader);
+  if (!bd->shader_program) return false;
 
   bd->attrib_location_proj_mtx =
       glGetUniformLocation(bd->shader_program, "ProjMtx");
@@ -245,11 +427,81 @@ bool imgui_impl_webgl_init(allocator_t* allocator) {
   bd->attrib_location_uv = glGetAttribLocation(bd->shader_program, "UV");
   bd->attrib_location_color = glGetAttribLocation(bd->shader_program, "Color");
 
-  bd->vtx_staging = {};
-  bd->idx_staging = {};
+  // Each rect instance covers a quad grown by the part of its border that
+  // lies outside the rectangle. The fill and the border are composited in the
+  // fragment shader, matching AddRectFilled followed by AddRect.
+  const GLchar* rect_vertex_shader =
+      "#version 300 es\n"
+      "precision highp float;\n"
+      "layout (location = 0) in vec4 Rect;\n"
+      "layout (location = 1) in vec4 Color;\n"
+      "layout (location = 2) in vec4 BorderColor;\n"
+      "layout (location = 3) in uint Flags;\n"
+      "layout (location = 4) in vec2 Corner;\n"
+      "uniform mat4 ProjMtx;\n"
+      "out vec2 Frag_Pos;\n"
+      "flat out vec4 Frag_Rect;\n"
+      "flat out vec4 Frag_Color;\n"
+      "flat out vec4 Frag_BorderColor;\n"
+      "flat out float Frag_BorderWidth;\n"
+      "flat out float Frag_Outset;\n"
+      "void main()\n"
+      "{\n"
+      "    float width = (Flags & 2u) != 0u ? 3.0\n"
+      "                : ((Flags & 1u) != 0u ? 1.0 : 0.0);\n"
+      "    float outset = max(width - 1.0, 0.0) * 0.5;\n"
+      "    vec4 outer = Rect + vec4(-outset, -outset, outset, outset);\n"
+      "    Frag_Pos = mix(outer.xy, outer.zw, Corner);\n"
+      "    Frag_Rect = Rect;\n"
+      "    Frag_Color = Color;\n"
+      "    Frag_BorderColor = BorderColor;\n"
+      "    Frag_BorderWidth = width;\n"
+      "    Frag_Outset = outset;\n"
+      "    gl_Position = ProjMtx * vec4(Frag_Pos, 0, 1);\n"
+      "}\n";
+
+  const GLchar* rect_fragment_shader =
+      "#version 300 es\n"
+      "precision highp float;\n"
+      "in vec2 Frag_Pos;\n"
+      "flat in vec4 Frag_Rect;\n"
+      "flat in vec4 Frag_Color;\n"
+      "flat in vec4 Frag_BorderColor;\n"
+      "flat in float Frag_BorderWidth;\n"
+      "flat in float Frag_Outset;\n"
+      "layout (location = 0) out vec4 Out_Color;\n"
+      "void main()\n"
+      "{\n"
+      "    bool inside = all(greaterThanEqual(Frag_Pos, Frag_Rect.xy)) &&\n"
+      "                  all(lessThanEqual(Frag_Pos, Frag_Rect.zw));\n"
+      "    vec4 color = inside ? Frag_Color : vec4(0.0);\n"
+      "    vec2 edge = min(Frag_Pos - Frag_Rect.xy, Frag_Rect.zw - Frag_Pos);\n"
+      "    if (min(edge.x, edge.y) + Frag_Outset < Frag_BorderWidth) {\n"
+      "        vec4 b = Frag_BorderColor;\n"
+      "        float a = b.a + color.a * (1.0 - b.a);\n"
+      "        vec3 rgb = b.rgb * b.a + color.rgb * color.a * (1.0 - b.a);\n"
+      "        color = vec4(a > 0.0 ? rgb / a : vec3(0.0), a);\n"
+      "    }\n"
+      "    if (color.a <= 0.0) discard;\n"
+      "    Out_Color = color;\n"
+      "}\n";
+
+  bd->rect_program = create_program(rect_vertex_shader, rect_fragment_shader);
+  if (!bd->rect_program) return false;
+  bd->rect_location_proj_mtx =
+      glGetUniformLocation(bd->rect_program, "ProjMtx");
+
+  stream_buffer_init(&bd->vbo, GL_ARRAY_BUFFER);
+  stream_buffer_init(&bd->ebo, GL_ELEMENT_ARRAY_BUFFER);
+  bd->stats = {};
 
-  glGenBuffers(1, &bd->vbo);
-  glGenBuffers(1, &bd->ebo);
+  // Corners of the unit quad, drawn as a triangle strip per instance
+  const float rect_corners[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+  glGenBuffers(1, &bd->rect_corner_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, bd->rect_corner_vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(rect_corners), rect_corners,
+               GL_STATIC_DRAW);
+  stream_buffer_init(&bd->rect_instance_vbo, GL_ARRAY_BUFFER);
 
   glActiveTexture(GL_TEXTURE0);
 
@@ -288,15 +540,21 @@ void imgui_impl_webgl_destroy_fonts_texture() {
 
 void imgui_impl_webgl_shutdown() {
   BackendData* bd = get_backend_data();
-  glDeleteBuffers(1, &bd->vbo);
-  glDeleteBuffers(1, &bd->ebo);
+  allocator_t* allocator = bd->allocator;
+  stream_buffer_deinit(&bd->vbo, allocator);
+  stream_buffer_deinit(&bd->ebo, allocator);
+  stream_buffer_deinit(&bd->rect_instance_vbo, allocator);
+  glDeleteBuffers(1, &bd->rect_corner_vbo);
   glDeleteProgram(bd->shader_program);
+  glDeleteProgram(bd->rect_program);
   imgui_impl_webgl_destroy_fonts_texture();
-  allocator_t* allocator = bd->allocator;
-  darray_deinit(&bd->vtx_staging, allocator);
-  darray_deinit(&bd->idx_staging, allocator);
   allocator_free(allocator, bd, sizeof(BackendData));
   ImGui::GetIO().BackendRendererUserData = nullptr;
 }
 
 void imgui_impl_webgl_new_frame() {}
+
+imgui_impl_webgl_stats_t imgui_impl_webgl_get_stats() {
+  BackendData* bd = get_backend_data();
+  return bd ? bd->stats : imgui_impl_webgl_stats_t{};
+}
@@ -1,10 +1,25 @@
 #ifndef SRC_IMGUI_IMPL_WEBGL_H
 #define SRC_IMGUI_IMPL_WEBGL_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "core/allocator.h"
 
 struct ig_draw_data;
 
+// Buffer traffic of the last imgui_impl_webgl_render_draw_data call.
+typedef struct imgui_impl_webgl_stats {
+  // Vertex, index and rect instance bytes the frame consisted of
+  size_t written_bytes;
+  // The part of written_bytes that differed from the previous frame and was
+  // uploaded with glBufferSubData
+  size_t uploaded_bytes;
+  // Buffers whose GPU storage had to grow
+  uint32_t buffer_grows;
+  uint32_t draw_calls;
+} imgui_impl_webgl_stats_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,6 +30,7 @@ void imgui_impl_webgl_new_frame(void);
 void imgui_impl_webgl_render_draw_data(struct ig_draw_data* draw_data);
 bool imgui_impl_webgl_create_fonts_texture(void);
 void imgui_impl_webgl_destroy_fonts_texture(void);
+imgui_impl_webgl_stats_t imgui_impl_webgl_get_stats(void);
 
 #ifdef __cplusplus
 }
@@ -11,8 +11,26 @@ typedef struct ig_vec4 {
   float x, y, z, w;
 } ig_vec4_t;
 
+// One axis-aligned rectangle of an instanced batch, in screen coordinates.
+// The renderer backend draws a whole batch with a single draw call.
+typedef struct ig_rect_instance {
+  float x1, y1, x2, y2;
+  uint32_t color;
+  uint32_t border_color;
+  uint32_t flags;
+} ig_rect_instance_t;
+
+// A 1px border inside the rectangle, like ImDrawList::AddRect.
+constexpr uint32_t IG_RECT_INSTANCE_BORDER = 1 << 0;
+// A 3px border centered 1px inside the rectangle.
+constexpr uint32_t IG_RECT_INSTANCE_THICK_BORDER = 1 << 1;
+
 #ifdef __cplusplus
 #include "third_party/imgui/imgui.h"
+
+// Draw callback marking a batch of ig_rect_instance_t held in the command's
+// callback data. Only imgui_impl_webgl knows how to draw it.
+#define IG_DRAW_CALLBACK_RECT_INSTANCES ((ImDrawCallback)(intptr_t)(-16))
 #else
 typedef uint32_t ImU32;
 #endif
@@ -47,3 +47,28 @@ void loading_screen_draw(const char* filename, size_t event_count,
   
   ig_text_colored(theme->status_loading, "%s", progress);
 }
+
+void loading_screen_draw_overlay(size_t event_count,
+                                 size_t input_consumed_bytes,
+                                 size_t input_total_bytes,
+                                 const theme_t* theme) {
+  ig_vec2_t viewport_size = ig_viewport_get_size(ig_get_main_viewport());
+  ig_set_next_window_pos(
+      (ig_vec2_t){viewport_size.x * 0.5f, viewport_size.y - 10.0f},
+      IG_COND_NONE, (ig_vec2_t){0.5f, 1.0f});
+  if (ig_begin("Loading", nullptr,
+               IG_WINDOW_FLAGS_NO_TITLE_BAR | IG_WINDOW_FLAGS_NO_RESIZE |
+                   IG_WINDOW_FLAGS_NO_MOVE | IG_WINDOW_FLAGS_NO_SCROLLBAR |
+                   IG_WINDOW_FLAGS_ALWAYS_AUTO_RESIZE |
+                   IG_WINDOW_FLAGS_NO_DOCKING |
+                   IG_WINDOW_FLAGS_NO_FOCUS_ON_APPEARING)) {
+    ig_text_colored(theme->status_loading, "Loading... %zu events so far",
+                    event_count);
+    if (input_total_bytes > 0) {
+      float fraction = (float)input_consumed_bytes / (float)input_total_bytes;
+      if (fraction > 1.0f) fraction = 1.0f;
+      ig_progress_bar(fraction, (ig_vec2_t){300.0f, 0.0f}, nullptr);
+    }
+  }
+  ig_end();
+}
@@ -16,6 +16,13 @@ void loading_screen_draw(const char* filename, size_t event_count,
                          size_t total_bytes, size_t input_consumed_bytes,
                          size_t input_total_bytes, const theme_t* theme);
 
+// Draws a small progress window at the bottom of the screen, over a trace
+// that is shown while the rest of it loads.
+void loading_screen_draw_overlay(size_t event_count,
+                                 size_t input_consumed_bytes,
+                                 size_t input_total_bytes,
+                                 const theme_t* theme);
+
 #ifdef __cplusplus
 }
 #endif
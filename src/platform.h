@@ -1,6 +1,8 @@
 #ifndef SRC_PLATFORM_H
 #define SRC_PLATFORM_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -20,6 +22,10 @@ void platform_teardown_workers();
 void platform_open_file_dialog();
 bool platform_is_main_thread(void);
 
+// Saves `size` bytes of `data` as `filename`: a download in the browser, a
+// file in the working directory natively.
+void platform_save_file(const char* filename, const void* data, size_t size);
+
 // Settings persistence
 void platform_set_setting(const char* key, const char* value);
 bool platform_get_setting(const char* key, char* out_val, int max_len);
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "core/self_trace.h"
 #include "src/platform.h"
 
 #define JOB_QUEUE_CAPACITY 64
@@ -31,6 +32,7 @@ static bool g_teardown_in_progress = false;
 
 static void* platform_worker_main(void* arg) {
   (void)arg;
+  self_trace_set_thread_name("worker");
   bool running = true;
   while (running) {
     job_t job = {nullptr, nullptr};
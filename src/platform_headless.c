@@ -1,5 +1,6 @@
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <time.h>
 
 #include "src/platform.h"
@@ -31,6 +32,14 @@ void platform_open_file_dialog() {
   // Headless stub: do nothing
 }
 
+void platform_save_file(const char* filename, const void* data, size_t size) {
+  FILE* f = fopen(filename, "wb");
+  if (f) {
+    fwrite(data, 1, size, f);
+    fclose(f);
+  }
+}
+
 void platform_set_setting(const char* key, const char* value) {
   (void)key;
   (void)value;
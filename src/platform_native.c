@@ -1,5 +1,6 @@
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <time.h>
 
 #include "src/platform.h"
@@ -34,6 +35,14 @@ bool platform_is_mac() {
   return is_mac;
 }
 
+void platform_save_file(const char* filename, const void* data, size_t size) {
+  FILE* f = fopen(filename, "wb");
+  if (f) {
+    fwrite(data, 1, size, f);
+    fclose(f);
+  }
+}
+
 void platform_set_setting(const char* key, const char* value) {
   (void)key;
   (void)value;
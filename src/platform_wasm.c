@@ -47,6 +47,17 @@ EM_JS(void, platform_open_file_dialog, (), {
   input.click();
 })
 
+EM_JS(void, platform_save_file, (const char* filename, const void* data, size_t size), {
+  // Copy out of the (possibly shared) wasm memory; Blob rejects shared views.
+  const bytes = HEAPU8.slice(data, data + size);
+  const url = URL.createObjectURL(new Blob([bytes]));
+  const link = document.createElement('a');
+  link.href = url;
+  link.download = UTF8ToString(filename);
+  link.click();
+  setTimeout(() => URL.revokeObjectURL(url), 0);
+})
+
 EM_JS(void, platform_set_setting, (const char* key, const char* value), {
   var keyStr = UTF8ToString(key);
   var valStr = UTF8ToString(value);
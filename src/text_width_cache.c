@@ -0,0 +1,57 @@
+#include "src/text_width_cache.h"
+
+static uint32_t hash_string_ref(const string_ref_t* key, void* ctx) {
+  (void)ctx;
+  uint32_t a = *key;
+  a = (a ^ 61) ^ (a >> 16);
+  a = a + (a << 3);
+  a = a ^ (a >> 4);
+  a = a * 0x27d4eb2d;
+  a = a ^ (a >> 15);
+  return a;
+}
+
+static bool eq_string_ref(const string_ref_t* a, const string_ref_t* b,
+                          void* ctx) {
+  (void)ctx;
+  return *a == *b;
+}
+
+void text_width_cache_deinit(text_width_cache_t* c, allocator_t* a) {
+  hash_table_deinit(&c->widths, a);
+  *c = (text_width_cache_t){};
+}
+
+void text_width_cache_clear(text_width_cache_t* c) {
+  hash_table_clear(&c->widths);
+}
+
+void text_width_cache_set_font(text_width_cache_t* c, const void* font,
+                               float font_size) {
+  if (c->font != font || c->font_size != font_size) {
+    hash_table_clear(&c->widths);
+    c->font = font;
+    c->font_size = font_size;
+  }
+}
+
+float text_width_cache_get(text_width_cache_t* c, string_ref_t ref,
+                           string_view_t text, text_width_measure_fn_t measure,
+                           allocator_t* a) {
+  float result = 0.0f;
+  if (c->widths.hash_fn == nullptr) {
+    hash_table_init(&c->widths, hash_string_ref, eq_string_ref, nullptr);
+  }
+  const float* cached = c->bypass ? nullptr : hash_table_get(&c->widths, &ref);
+  if (cached) {
+    result = *cached;
+    c->hits++;
+  } else {
+    result = measure(c->font, c->font_size, text);
+    if (!c->bypass) {
+      hash_table_put(&c->widths, &ref, result, a);
+    }
+    c->misses++;
+  }
+  return result;
+}
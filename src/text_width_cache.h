@@ -0,0 +1,55 @@
+#ifndef SRC_TEXT_WIDTH_CACHE_H
+#define SRC_TEXT_WIDTH_CACHE_H
+
+#include <stddef.h>
+
+#include "core/allocator.h"
+#include "core/hash_table.h"
+#include "core/string.h"
+#include "src/trace_data.h"
+
+// Measures the width of `text` in pixels when drawn with `font` at
+// `font_size`.
+typedef float (*text_width_measure_fn_t)(const void* font, float font_size,
+                                         string_view_t text);
+
+// Widths of interned strings, keyed by string ref, for one font and size.
+// Event labels repeat a few thousand distinct names across millions of
+// events, so each name is measured once instead of every frame. Supports ZII.
+typedef struct text_width_cache {
+  const void* font;
+  float font_size;
+  hash_table_t(string_ref_t, float) widths;
+  // Measures every lookup and keeps nothing, for comparing against the cache
+  // (see tools/frame_benchmark).
+  bool bypass;
+  size_t hits;
+  size_t misses;
+} text_width_cache_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void text_width_cache_deinit(text_width_cache_t* c, allocator_t* a);
+
+// Drops every cached width. Widths of one trace are meaningless for another,
+// since string refs are per trace.
+void text_width_cache_clear(text_width_cache_t* c);
+
+// Selects the font the following widths are measured with, clearing the
+// cache when the font or size (e.g. after a DPI change) differs.
+void text_width_cache_set_font(text_width_cache_t* c, const void* font,
+                               float font_size);
+
+// Returns the width of `text`, the string interned as `ref`, measuring it
+// with `measure` on a miss (every lookup is one while bypassed).
+float text_width_cache_get(text_width_cache_t* c, string_ref_t ref,
+                           string_view_t text, text_width_measure_fn_t measure,
+                           allocator_t* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SRC_TEXT_WIDTH_CACHE_H
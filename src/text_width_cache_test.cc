@@ -0,0 +1,118 @@
+#include "src/text_width_cache.h"
+
+#include <gtest/gtest.h>
+
+#include "core/allocator.h"
+
+static int g_measure_calls = 0;
+
+// 10px per character at size 10, scaling with the font size.
+static float fake_measure(const void* font, float font_size,
+                          string_view_t text) {
+  (void)font;
+  g_measure_calls++;
+  return (float)text.len * font_size;
+}
+
+TEST(text_width_cache_test, measures_each_ref_once) {
+  allocator_t* a = c_allocator();
+  g_measure_calls = 0;
+  text_width_cache_t c = {};
+  int font = 0;
+  text_width_cache_set_font(&c, &font, 10.0f);
+
+  EXPECT_FLOAT_EQ(
+      text_width_cache_get(&c, 1, SV("parse"), fake_measure, a),
+      50.0f);
+  EXPECT_FLOAT_EQ(
+      text_width_cache_get(&c, 2, SV("gen"), fake_measure, a),
+      30.0f);
+  EXPECT_FLOAT_EQ(
+      text_width_cache_get(&c, 1, SV("parse"), fake_measure, a),
+      50.0f);
+  EXPECT_EQ(g_measure_calls, 2);
+  EXPECT_EQ(c.hits, 1u);
+  EXPECT_EQ(c.misses, 2u);
+
+  // The same font keeps the widths.
+  text_width_cache_set_font(&c, &font, 10.0f);
+  text_width_cache_get(&c, 1, SV("parse"), fake_measure, a);
+  EXPECT_EQ(g_measure_calls, 2);
+
+  text_width_cache_deinit(&c, a);
+}
+
+TEST(text_width_cache_test, font_change_invalidates) {
+  allocator_t* a = c_allocator();
+  g_measure_calls = 0;
+  text_width_cache_t c = {};
+  int font = 0;
+  int other_font = 0;
+  text_width_cache_set_font(&c, &font, 10.0f);
+  text_width_cache_get(&c, 1, SV("parse"), fake_measure, a);
+
+  // A new size, as after a DPI change.
+  text_width_cache_set_font(&c, &font, 20.0f);
+  EXPECT_FLOAT_EQ(
+      text_width_cache_get(&c, 1, SV("parse"), fake_measure, a),
+      100.0f);
+  EXPECT_EQ(g_measure_calls, 2);
+
+  text_width_cache_set_font(&c, &other_font, 20.0f);
+  text_width_cache_get(&c, 1, SV("parse"), fake_measure, a);
+  EXPECT_EQ(g_measure_calls, 3);
+
+  // Clearing (e.g. for a new trace) drops widths of stale refs.
+  text_width_cache_clear(&c);
+  EXPECT_FLOAT_EQ(
+      text_width_cache_get(&c, 1, SV("emit"), fake_measure, a),
+      80.0f);
+  EXPECT_EQ(g_measure_calls, 4);
+
+  text_width_cache_deinit(&c, a);
+}
+
+TEST(text_width_cache_test, usable_after_reset) {
+  allocator_t* a = c_allocator();
+  g_measure_calls = 0;
+  text_width_cache_t c = {};
+  int font = 0;
+  text_width_cache_set_font(&c, &font, 10.0f);
+  text_width_cache_get(&c, 1, SV("parse"), fake_measure, a);
+
+  // As when the viewer is reset for the next trace.
+  text_width_cache_deinit(&c, a);
+  c = (text_width_cache_t){};
+  text_width_cache_set_font(&c, &font, 10.0f);
+  EXPECT_FLOAT_EQ(text_width_cache_get(&c, 1, SV("gen"), fake_measure, a),
+                  30.0f);
+  EXPECT_EQ(g_measure_calls, 2);
+
+  text_width_cache_deinit(&c, a);
+}
+
+TEST(text_width_cache_test, bypass_measures_every_lookup) {
+  allocator_t* a = c_allocator();
+  g_measure_calls = 0;
+  text_width_cache_t c = {};
+  int font = 0;
+  text_width_cache_set_font(&c, &font, 10.0f);
+  text_width_cache_get(&c, 1, SV("parse"), fake_measure, a);
+
+  c.bypass = true;
+  EXPECT_FLOAT_EQ(text_width_cache_get(&c, 1, SV("parse"), fake_measure, a),
+                  50.0f);
+  EXPECT_FLOAT_EQ(text_width_cache_get(&c, 2, SV("gen"), fake_measure, a),
+                  30.0f);
+  EXPECT_EQ(g_measure_calls, 3);
+  EXPECT_EQ(c.hits, 0u);
+
+  // What was cached before is still there; nothing was added meanwhile.
+  c.bypass = false;
+  text_width_cache_get(&c, 1, SV("parse"), fake_measure, a);
+  text_width_cache_get(&c, 2, SV("gen"), fake_measure, a);
+  EXPECT_EQ(g_measure_calls, 4);
+  EXPECT_EQ(c.hits, 1u);
+
+  text_width_cache_deinit(&c, a);
+}
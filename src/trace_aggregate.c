@@ -3,15 +3,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "core/arena.h"
 #include "core/hash_table.h"
 
-typedef struct {
-  double total_duration;
-  size_t count;
-} agg_value_t;
-
-typedef hash_table_t(uint32_t, agg_value_t) agg_map_t;
-
 static uint32_t hash_uint32(const uint32_t* key, void* ctx) {
   (void)ctx;
   uint32_t a = *key;
@@ -36,6 +30,15 @@ static int compare_aggregate_duration(const void* a_ptr, const void* b_ptr) {
   return 0;
 }
 
+static int compare_aggregate_self_duration(const void* a_ptr,
+                                          const void* b_ptr) {
+  const trace_aggregate_entry_t* am = (const trace_aggregate_entry_t*)a_ptr;
+  const trace_aggregate_entry_t* bm = (const trace_aggregate_entry_t*)b_ptr;
+  if (am->self_duration > bm->self_duration) return -1;
+  if (am->self_duration < bm->self_duration) return 1;
+  return 0;
+}
+
 static int compare_aggregate_count(const void* a_ptr, const void* b_ptr) {
   const trace_aggregate_entry_t* am = (const trace_aggregate_entry_t*)a_ptr;
   const trace_aggregate_entry_t* bm = (const trace_aggregate_entry_t*)b_ptr;
@@ -44,58 +47,166 @@ static int compare_aggregate_count(const void* a_ptr, const void* b_ptr) {
   return 0;
 }
 
-void trace_aggregate_compute(const trace_data_t* td, string_view_t group_by,
-                             string_view_t sort_by,
-                             darray_trace_aggregate_entry_t* out_entries,
-                             allocator_t* a) {
-  if (!td || !out_entries) {
-    return;
+bool trace_aggregate_metric_parse(string_view_t s,
+                                  trace_aggregate_metric_t* out_metric) {
+  bool ok = true;
+  if (string_view_eq(s, SV("total"))) {
+    *out_metric = TRACE_AGGREGATE_METRIC_TOTAL;
+  } else if (string_view_eq(s, SV("self"))) {
+    *out_metric = TRACE_AGGREGATE_METRIC_SELF;
+  } else {
+    ok = false;
   }
+  return ok;
+}
 
-  bool by_cat = string_view_eq(group_by, SV("category"));
+void trace_aggregate_partial_init(trace_aggregate_partial_t* p,
+                                  string_view_t group_by) {
+  *p = (trace_aggregate_partial_t){
+      .by_cat = string_view_eq(group_by, SV("category")),
+  };
+  hash_table_init(&p->map, hash_uint32, eq_uint32, nullptr);
+}
 
-  agg_map_t map = {};
-  hash_table_init(&map, hash_uint32, eq_uint32, nullptr);
+void trace_aggregate_partial_deinit(trace_aggregate_partial_t* p,
+                                    allocator_t* a) {
+  for (size_t i = 0; i < p->map.capacity; i++) {
+    if (p->map.entries[i].occupied) {
+      quantile_sketch_deinit(&p->map.entries[i].value.durations, a);
+      quantile_sketch_deinit(&p->map.entries[i].value.self_durations, a);
+    }
+  }
+  hash_table_deinit(&p->map, a);
+}
 
+// Returns the value of `key`, inserting an empty one if needed.
+static trace_aggregate_value_t* trace_aggregate_partial_get(
+    trace_aggregate_partial_t* p, uint32_t key, allocator_t* a) {
+  trace_aggregate_value_t* val = hash_table_get(&p->map, &key);
+  if (!val) {
+    trace_aggregate_value_t new_val = {.entry = {.key_ref = key}};
+    hash_table_put(&p->map, &key, new_val, a);
+    val = hash_table_get(&p->map, &key);
+  }
+  return val;
+}
+
+void trace_aggregate_partial_add_tracks(trace_aggregate_partial_t* p,
+                                        const trace_data_t* td,
+                                        const darray_track_t* tracks,
+                                        size_t begin, size_t end,
+                                        allocator_t* a) {
   const trace_event_persisted_t* events = td->events.ptr;
-  for (size_t i = 0; i < td->events.len; i++) {
-    const trace_event_persisted_t* e = &events[i];
-    uint32_t key = by_cat ? e->cat_ref : e->name_ref;
-
-    agg_value_t* val = hash_table_get(&map, &key);
-    if (val) {
-      val->total_duration += (double)e->dur;
-      val->count++;
-    } else {
-      agg_value_t new_val = {.total_duration = (double)e->dur, .count = 1};
-      hash_table_put(&map, &key, new_val, a);
+  const track_t* tracks_data = tracks->ptr;
+  for (size_t t_idx = begin; t_idx < end && t_idx < tracks->len; t_idx++) {
+    const track_t* t = &tracks_data[t_idx];
+    const size_t* event_indices = t->event_indices.ptr;
+    // Counter tracks have no nesting, so their events are all self time.
+    const int64_t* self_durs =
+        t->self_durs.len == t->event_indices.len ? t->self_durs.ptr : nullptr;
+    for (size_t i = 0; i < t->event_indices.len; i++) {
+      const trace_event_persisted_t* e = &events[event_indices[i]];
+      uint32_t key = p->by_cat ? e->cat_ref : e->name_ref;
+      int64_t self_dur = self_durs ? self_durs[i] : e->dur;
+      trace_aggregate_value_t* val = trace_aggregate_partial_get(p, key, a);
+      val->entry.total_duration += (double)e->dur;
+      val->entry.self_duration += (double)self_dur;
+      val->entry.count++;
+      quantile_sketch_add(&val->durations, (double)e->dur, a);
+      quantile_sketch_add(&val->self_durations, (double)self_dur, a);
+    }
+  }
+}
+
+void trace_aggregate_partial_merge(trace_aggregate_partial_t* dst,
+                                   const trace_aggregate_partial_t* src,
+                                   allocator_t* a) {
+  for (size_t i = 0; i < src->map.capacity; i++) {
+    if (src->map.entries[i].occupied) {
+      const trace_aggregate_value_t* src_val = &src->map.entries[i].value;
+      const trace_aggregate_entry_t* e = &src_val->entry;
+      trace_aggregate_value_t* val =
+          trace_aggregate_partial_get(dst, e->key_ref, a);
+      val->entry.total_duration += e->total_duration;
+      val->entry.self_duration += e->self_duration;
+      val->entry.count += e->count;
+      quantile_sketch_merge(&val->durations, &src_val->durations, a);
+      quantile_sketch_merge(&val->self_durations, &src_val->self_durations,
+                            a);
     }
   }
+}
 
-  // Collect into darray
-  if (map.capacity > 0) {
-    for (size_t i = 0; i < map.capacity; i++) {
-      if (map.entries[i].occupied) {
-        trace_aggregate_entry_t entry = {
-            .key_ref = map.entries[i].key,
-            .total_duration = map.entries[i].value.total_duration,
-            .count = map.entries[i].value.count,
-        };
-        darray_push(out_entries, entry, a);
-      }
+void trace_aggregate_partial_collect(
+    const trace_aggregate_partial_t* p, string_view_t sort_by,
+    trace_aggregate_metric_t metric,
+    darray_trace_aggregate_entry_t* out_entries, allocator_t* a) {
+  size_t first = out_entries->len;
+  for (size_t i = 0; i < p->map.capacity; i++) {
+    if (p->map.entries[i].occupied) {
+      const trace_aggregate_value_t* val = &p->map.entries[i].value;
+      const quantile_sketch_t* durations =
+          metric == TRACE_AGGREGATE_METRIC_SELF ? &val->self_durations
+                                                : &val->durations;
+      trace_aggregate_entry_t entry = val->entry;
+      entry.p50_duration = quantile_sketch_quantile(durations, 0.5);
+      entry.p90_duration = quantile_sketch_quantile(durations, 0.9);
+      entry.p99_duration = quantile_sketch_quantile(durations, 0.99);
+      entry.max_duration = durations->max;
+      darray_push(out_entries, entry, a);
     }
   }
 
-  // Sort
-  if (out_entries->len > 0) {
+  size_t count = out_entries->len - first;
+  if (count > 0) {
+    int (*compare)(const void*, const void*) = compare_aggregate_duration;
     if (string_view_eq(sort_by, SV("count"))) {
-      qsort(out_entries->ptr, out_entries->len, sizeof(trace_aggregate_entry_t),
-            compare_aggregate_count);
-    } else {
-      qsort(out_entries->ptr, out_entries->len, sizeof(trace_aggregate_entry_t),
-            compare_aggregate_duration);
+      compare = compare_aggregate_count;
+    } else if (metric == TRACE_AGGREGATE_METRIC_SELF) {
+      compare = compare_aggregate_self_duration;
     }
+    qsort(out_entries->ptr + first, count, sizeof(trace_aggregate_entry_t),
+          compare);
   }
+}
 
-  hash_table_deinit(&map, a);
+void trace_aggregate_compute_tracks(const trace_data_t* td,
+                                    const darray_track_t* tracks,
+                                    string_view_t group_by,
+                                    string_view_t sort_by,
+                                    trace_aggregate_metric_t metric,
+                                    darray_trace_aggregate_entry_t* out_entries,
+                                    allocator_t* a) {
+  if (!td || !tracks || !out_entries) {
+    return;
+  }
+  trace_aggregate_partial_t p;
+  trace_aggregate_partial_init(&p, group_by);
+  trace_aggregate_partial_add_tracks(&p, td, tracks, 0, tracks->len, a);
+  trace_aggregate_partial_collect(&p, sort_by, metric, out_entries, a);
+  trace_aggregate_partial_deinit(&p, a);
+}
+
+void trace_aggregate_compute(const trace_data_t* td, string_view_t group_by,
+                             string_view_t sort_by,
+                             darray_trace_aggregate_entry_t* out_entries,
+                             allocator_t* a) {
+  if (!td || !out_entries) {
+    return;
+  }
+  darray_track_t tracks = {};
+  int64_t min_ts = 0;
+  int64_t max_ts = 0;
+  arena_t* scratch_arena = arena_create_with_allocator(a);
+  track_organize(td, &tracks, &min_ts, &max_ts, a,
+                 arena_get_allocator(scratch_arena));
+  arena_destroy(scratch_arena);
+
+  trace_aggregate_compute_tracks(td, &tracks, group_by, sort_by,
+                                 TRACE_AGGREGATE_METRIC_TOTAL, out_entries, a);
+
+  for (size_t i = 0; i < tracks.len; i++) {
+    track_deinit(&tracks.ptr[i], a);
+  }
+  darray_deinit(&tracks, a);
 }
@@ -5,22 +5,57 @@
 #include <stdint.h>
 
 #include "core/darray.h"
+#include "core/hash_table.h"
+#include "core/quantile_sketch.h"
 #include "core/string.h"
 #include "src/trace_data.h"
+#include "src/track.h"
 
 typedef struct trace_aggregate_entry {
   uint32_t key_ref;
+  // Inclusive duration: each event's full `dur`
   double total_duration;
+  // Exclusive duration: `dur` minus the time spent in direct children
+  double self_duration;
   size_t count;
+  // Distribution of the events' inclusive or exclusive durations, per the
+  // metric the entries were collected with, estimated within
+  // QUANTILE_SKETCH_RELATIVE_ACCURACY (max is exact).
+  double p50_duration;
+  double p90_duration;
+  double p99_duration;
+  double max_duration;
 } trace_aggregate_entry_t;
 
 typedef darray_t(trace_aggregate_entry_t) darray_trace_aggregate_entry_t;
 
+// The duration that "duration" sorting (and diff deltas) use.
+typedef enum trace_aggregate_metric {
+  TRACE_AGGREGATE_METRIC_TOTAL,
+  TRACE_AGGREGATE_METRIC_SELF,
+} trace_aggregate_metric_t;
+
+typedef struct trace_aggregate_value {
+  trace_aggregate_entry_t entry;
+  quantile_sketch_t durations;
+  quantile_sketch_t self_durations;
+} trace_aggregate_value_t;
+
+// Per-key sums and duration sketches over some of the tracks of a trace.
+// Partials of disjoint track ranges can be computed in parallel and merged.
+typedef struct trace_aggregate_partial {
+  hash_table_t(uint32_t, trace_aggregate_value_t) map;
+  bool by_cat;
+} trace_aggregate_partial_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Computes global aggregation of events grouped by name or category.
+// Computes global aggregation of events grouped by name or category, with
+// inclusive durations and their percentiles. Organizes the trace's tracks
+// first; callers that already have them should use
+// trace_aggregate_compute_tracks.
 //
 // Arguments:
 // - td: The trace_data_t storage.
@@ -33,6 +68,48 @@ void trace_aggregate_compute(const trace_data_t* td, string_view_t group_by,
                              darray_trace_aggregate_entry_t* out_entries,
                              allocator_t* a);
 
+// Parses "total" or "self". Returns false for anything else.
+bool trace_aggregate_metric_parse(string_view_t s,
+                                  trace_aggregate_metric_t* out_metric);
+
+// Prepares a partial grouped by "name" or "category".
+void trace_aggregate_partial_init(trace_aggregate_partial_t* p,
+                                  string_view_t group_by);
+void trace_aggregate_partial_deinit(trace_aggregate_partial_t* p,
+                                    allocator_t* a);
+
+// Adds the events of tracks [begin, end). Self durations come from the
+// tracks' `self_durs`, so each event is visited once.
+void trace_aggregate_partial_add_tracks(trace_aggregate_partial_t* p,
+                                        const trace_data_t* td,
+                                        const darray_track_t* tracks,
+                                        size_t begin, size_t end,
+                                        allocator_t* a);
+
+// Adds the sums and sketches of `src` into `dst`. Both must group the same
+// way.
+void trace_aggregate_partial_merge(trace_aggregate_partial_t* dst,
+                                   const trace_aggregate_partial_t* src,
+                                   allocator_t* a);
+
+// Appends the entries of `p` to `out_entries`, sorted by `sort_by`
+// ("duration" uses `metric`, or "count"). The percentiles are of the
+// `metric` durations.
+void trace_aggregate_partial_collect(
+    const trace_aggregate_partial_t* p, string_view_t sort_by,
+    trace_aggregate_metric_t metric,
+    darray_trace_aggregate_entry_t* out_entries, allocator_t* a);
+
+// Same as trace_aggregate_compute, over organized tracks on this thread.
+// Sorting by "duration" and the percentiles use `metric`.
+void trace_aggregate_compute_tracks(const trace_data_t* td,
+                                    const darray_track_t* tracks,
+                                    string_view_t group_by,
+                                    string_view_t sort_by,
+                                    trace_aggregate_metric_t metric,
+                                    darray_trace_aggregate_entry_t* out_entries,
+                                    allocator_t* a);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,17 +1,20 @@
 #include "src/trace_aggregate.h"
 #include <gtest/gtest.h>
 #include "core/allocator.h"
+#include "core/arena.h"
 #include "src/trace_data.h"
+#include "src/track.h"
 
 static void add_event(trace_data_t* td, allocator_t* a, const char* name,
-                      const char* cat, int64_t dur) {
+                      const char* cat, int64_t dur, int64_t ts = 1000,
+                      int32_t tid = 1) {
   trace_event_t e = {};
   e.ph = "X";
   e.pid = 1;
-  e.tid = 1;
+  e.tid = tid;
   e.name = name;
   e.cat = cat;
-  e.ts = 1000;
+  e.ts = ts;
   e.dur = dur;
   trace_event_matcher_t matcher = {};
   trace_data_add_event(td, &e, &matcher, a);
@@ -35,6 +38,10 @@ TEST(trace_aggregate_test, basic) {
   EXPECT_EQ(trace_data_get_string(td, entries.ptr[0].key_ref), "task1");
   EXPECT_DOUBLE_EQ(entries.ptr[0].total_duration, 250.0);
   EXPECT_EQ(entries.ptr[0].count, 2u);
+  // All three start together, so task1 (100) nests in task1 (150), which
+  // nests in task2. Self time and percentiles are filled too.
+  EXPECT_DOUBLE_EQ(entries.ptr[0].self_duration, 150.0);
+  EXPECT_DOUBLE_EQ(entries.ptr[0].max_duration, 150.0);
 
   EXPECT_EQ(trace_data_get_string(td, entries.ptr[1].key_ref), "task2");
   EXPECT_DOUBLE_EQ(entries.ptr[1].total_duration, 200.0);
@@ -57,3 +64,100 @@ TEST(trace_aggregate_test, basic) {
   darray_deinit(&entries_cat, a);
   trace_data_release(td, a);
 }
+
+// Thread 1: outer [0, 1000) holds inner [100, 400) and inner [500, 700).
+// Thread 2: a lone inner [0, 50).
+class trace_aggregate_tracks_test : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    a_ = c_allocator();
+    td_ = trace_data_create(a_);
+    add_event(td_, a_, "outer", "cpu", 1000, 0, 1);
+    add_event(td_, a_, "inner", "cpu", 300, 100, 1);
+    add_event(td_, a_, "inner", "cpu", 200, 500, 1);
+    add_event(td_, a_, "inner", "cpu", 50, 0, 2);
+
+    int64_t min_ts, max_ts;
+    arena_t* scratch_arena = arena_create();
+    track_organize(td_, &tracks_, &min_ts, &max_ts, a_,
+                   arena_get_allocator(scratch_arena));
+    arena_destroy(scratch_arena);
+  }
+
+  void TearDown() override {
+    for (size_t i = 0; i < tracks_.len; i++) {
+      track_deinit(&tracks_.ptr[i], a_);
+    }
+    darray_deinit(&tracks_, a_);
+    trace_data_release(td_, a_);
+  }
+
+  allocator_t* a_ = nullptr;
+  trace_data_t* td_ = nullptr;
+  darray_track_t tracks_ = {};
+};
+
+TEST_F(trace_aggregate_tracks_test, self_excludes_children) {
+  darray_trace_aggregate_entry_t entries = {};
+  trace_aggregate_compute_tracks(td_, &tracks_, SV("name"), SV("duration"),
+                                 TRACE_AGGREGATE_METRIC_SELF, &entries, a_);
+
+  ASSERT_EQ(entries.len, 2u);
+  EXPECT_EQ(trace_data_get_string(td_, entries.ptr[0].key_ref), "inner");
+  EXPECT_DOUBLE_EQ(entries.ptr[0].total_duration, 550.0);
+  EXPECT_DOUBLE_EQ(entries.ptr[0].self_duration, 550.0);
+  EXPECT_EQ(entries.ptr[0].count, 3u);
+  EXPECT_EQ(trace_data_get_string(td_, entries.ptr[1].key_ref), "outer");
+  EXPECT_DOUBLE_EQ(entries.ptr[1].total_duration, 1000.0);
+  EXPECT_DOUBLE_EQ(entries.ptr[1].self_duration, 500.0);
+  // Percentiles are of the self durations too.
+  EXPECT_DOUBLE_EQ(entries.ptr[1].max_duration, 500.0);
+  EXPECT_NEAR(entries.ptr[1].p50_duration, 500.0, 5.0);
+
+  // By total, outer comes first.
+  darray_clear(&entries);
+  trace_aggregate_compute_tracks(td_, &tracks_, SV("name"), SV("duration"),
+                                 TRACE_AGGREGATE_METRIC_TOTAL, &entries, a_);
+  ASSERT_EQ(entries.len, 2u);
+  EXPECT_EQ(trace_data_get_string(td_, entries.ptr[0].key_ref), "outer");
+  EXPECT_DOUBLE_EQ(entries.ptr[0].max_duration, 1000.0);
+
+  darray_deinit(&entries, a_);
+}
+
+TEST_F(trace_aggregate_tracks_test, merged_partials_match_single_pass) {
+  ASSERT_EQ(tracks_.len, 2u);
+  trace_aggregate_partial_t first, second;
+  trace_aggregate_partial_init(&first, SV("category"));
+  trace_aggregate_partial_init(&second, SV("category"));
+  trace_aggregate_partial_add_tracks(&first, td_, &tracks_, 0, 1, a_);
+  trace_aggregate_partial_add_tracks(&second, td_, &tracks_, 1, 2, a_);
+  trace_aggregate_partial_merge(&first, &second, a_);
+
+  darray_trace_aggregate_entry_t entries = {};
+  trace_aggregate_partial_collect(&first, SV("count"),
+                                  TRACE_AGGREGATE_METRIC_TOTAL, &entries, a_);
+  ASSERT_EQ(entries.len, 1u);
+  EXPECT_EQ(trace_data_get_string(td_, entries.ptr[0].key_ref), "cpu");
+  EXPECT_DOUBLE_EQ(entries.ptr[0].total_duration, 1550.0);
+  EXPECT_DOUBLE_EQ(entries.ptr[0].self_duration, 1050.0);
+  EXPECT_EQ(entries.ptr[0].count, 4u);
+  // Durations 50, 200, 300 and 1000, sketched in both partials.
+  EXPECT_NEAR(entries.ptr[0].p50_duration, 200.0, 2.0);
+  EXPECT_NEAR(entries.ptr[0].p90_duration, 300.0, 3.0);
+  EXPECT_NEAR(entries.ptr[0].p99_duration, 300.0, 3.0);
+  EXPECT_DOUBLE_EQ(entries.ptr[0].max_duration, 1000.0);
+
+  darray_deinit(&entries, a_);
+  trace_aggregate_partial_deinit(&first, a_);
+  trace_aggregate_partial_deinit(&second, a_);
+}
+
+TEST(trace_aggregate_test, parse_metric) {
+  trace_aggregate_metric_t metric = TRACE_AGGREGATE_METRIC_TOTAL;
+  EXPECT_TRUE(trace_aggregate_metric_parse(SV("self"), &metric));
+  EXPECT_EQ(metric, TRACE_AGGREGATE_METRIC_SELF);
+  EXPECT_TRUE(trace_aggregate_metric_parse(SV("total"), &metric));
+  EXPECT_EQ(metric, TRACE_AGGREGATE_METRIC_TOTAL);
+  EXPECT_FALSE(trace_aggregate_metric_parse(SV("both"), &metric));
+}
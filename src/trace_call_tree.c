@@ -0,0 +1,238 @@
+#include "src/trace_call_tree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t hash_uint64(const uint64_t* key, void* ctx) {
+  (void)ctx;
+  uint64_t v = *key * 0x9e3779b97f4a7c15ull;
+  return (uint32_t)(v ^ (v >> 32));
+}
+
+static bool eq_uint64(const uint64_t* a, const uint64_t* b, void* ctx) {
+  (void)ctx;
+  return *a == *b;
+}
+
+trace_call_tree_filter_t trace_call_tree_filter_all(void) {
+  return (trace_call_tree_filter_t){
+      .start_ts = INT64_MIN,
+      .end_ts = INT64_MAX,
+  };
+}
+
+void trace_call_tree_init(trace_call_tree_t* tree, allocator_t* a) {
+  *tree = (trace_call_tree_t){};
+  hash_table_init(&tree->children, hash_uint64, eq_uint64, nullptr);
+  trace_call_tree_node_t root = {.parent = TRACE_CALL_TREE_NONE};
+  darray_push(&tree->nodes, root, a);
+}
+
+void trace_call_tree_deinit(trace_call_tree_t* tree, allocator_t* a) {
+  hash_table_deinit(&tree->children, a);
+  darray_deinit(&tree->nodes, a);
+  *tree = (trace_call_tree_t){};
+}
+
+// Returns the child of `parent` named `name_ref`, creating it if needed.
+static uint32_t trace_call_tree_child(trace_call_tree_t* tree, uint32_t parent,
+                                      string_ref_t name_ref,
+                                      uint8_t palette_index, allocator_t* a) {
+  uint64_t key = (uint64_t)parent << 32 | name_ref;
+  uint32_t* found = hash_table_get(&tree->children, &key);
+  uint32_t result = 0;
+  if (found) {
+    result = *found;
+  } else {
+    result = (uint32_t)tree->nodes.len;
+    trace_call_tree_node_t node = {
+        .name_ref = name_ref,
+        .parent = parent,
+        .depth = tree->nodes.ptr[parent].depth + 1,
+        .palette_index = palette_index,
+    };
+    darray_push(&tree->nodes, node, a);
+    hash_table_put(&tree->children, &key, result, a);
+  }
+  return result;
+}
+
+// Adds one event of duration `dur` to `node`, and takes it out of the
+// parent's self time.
+static void trace_call_tree_add(trace_call_tree_t* tree, uint32_t node,
+                                double dur) {
+  trace_call_tree_node_t* nodes = tree->nodes.ptr;
+  nodes[node].count++;
+  nodes[node].total_duration += dur;
+  nodes[node].self_duration += dur;
+  uint32_t parent = nodes[node].parent;
+  if (parent == 0) {
+    nodes[0].count++;
+    nodes[0].total_duration += dur;
+  } else {
+    nodes[parent].self_duration -= dur;
+  }
+}
+
+void trace_call_tree_add_tracks(trace_call_tree_t* tree, const trace_data_t* td,
+                                const darray_track_t* tracks, size_t begin,
+                                size_t end,
+                                const trace_call_tree_filter_t* filter,
+                                allocator_t* a) {
+  const trace_event_persisted_t* events = td->events.ptr;
+  const track_t* tracks_data = tracks->ptr;
+  // stack.ptr[d]: node of the latest event at depth d, or
+  // TRACE_CALL_TREE_NONE when it was filtered out.
+  darray_uint32_t stack = {};
+  for (size_t t_idx = begin; t_idx < end && t_idx < tracks->len; t_idx++) {
+    const track_t* t = &tracks_data[t_idx];
+    if (t->type != TRACK_TYPE_THREAD ||
+        t->depths.len != t->event_indices.len) {
+      continue;
+    }
+    darray_resize(&stack, (size_t)t->max_depth + 1, a);
+    for (size_t d = 0; d < stack.len; d++) {
+      stack.ptr[d] = TRACE_CALL_TREE_NONE;
+    }
+
+    const size_t* event_indices = t->event_indices.ptr;
+    const uint32_t* depths = t->depths.ptr;
+    size_t first = filter->start_ts == INT64_MIN
+                       ? 0
+                       : track_find_visible_start_index(t, td, filter->start_ts);
+    for (size_t i = first; i < t->event_indices.len; i++) {
+      const trace_event_persisted_t* e = &events[event_indices[i]];
+      if (e->ts > filter->end_ts) {
+        break;
+      }
+      int64_t e_end = e->ts + e->dur;
+      if (e_end < filter->start_ts) {
+        // Ends before the window, and so do its descendants.
+        continue;
+      }
+      uint32_t depth = depths[i];
+
+      uint32_t parent = TRACE_CALL_TREE_NONE;
+      if (depth > 0) {
+        parent = stack.ptr[depth - 1];
+      } else if (filter->root_ref == 0) {
+        parent = 0;
+      }
+      if (parent == TRACE_CALL_TREE_NONE && filter->root_ref != 0 &&
+          e->name_ref == filter->root_ref) {
+        parent = 0;
+      }
+
+      uint32_t node = TRACE_CALL_TREE_NONE;
+      if (parent != TRACE_CALL_TREE_NONE) {
+        int64_t clip_start = e->ts > filter->start_ts ? e->ts : filter->start_ts;
+        int64_t clip_end = e_end < filter->end_ts ? e_end : filter->end_ts;
+        double dur = (double)(clip_end - clip_start);
+        node = trace_call_tree_child(tree, parent, e->name_ref,
+                                     e->palette_index, a);
+        trace_call_tree_add(tree, node, dur);
+      }
+      stack.ptr[depth] = node;
+    }
+  }
+  darray_deinit(&stack, a);
+}
+
+void trace_call_tree_merge(trace_call_tree_t* dst, const trace_call_tree_t* src,
+                           allocator_t* a) {
+  // Parents come first, so one pass maps every src node to its dst node.
+  darray_uint32_t map = {};
+  darray_resize(&map, src->nodes.len, a);
+  map.ptr[0] = 0;
+  const trace_call_tree_node_t* nodes = src->nodes.ptr;
+  for (size_t i = 1; i < src->nodes.len; i++) {
+    const trace_call_tree_node_t* n = &nodes[i];
+    uint32_t node = trace_call_tree_child(dst, map.ptr[n->parent], n->name_ref,
+                                          n->palette_index, a);
+    map.ptr[i] = node;
+    dst->nodes.ptr[node].count += n->count;
+    dst->nodes.ptr[node].total_duration += n->total_duration;
+    dst->nodes.ptr[node].self_duration += n->self_duration;
+  }
+  dst->nodes.ptr[0].count += nodes[0].count;
+  dst->nodes.ptr[0].total_duration += nodes[0].total_duration;
+  darray_deinit(&map, a);
+}
+
+typedef struct trace_call_tree_sort_entry {
+  uint32_t parent;
+  uint32_t node;
+  double total_duration;
+} trace_call_tree_sort_entry_t;
+
+static int compare_sort_entry(const void* a_ptr, const void* b_ptr) {
+  const trace_call_tree_sort_entry_t* a =
+      (const trace_call_tree_sort_entry_t*)a_ptr;
+  const trace_call_tree_sort_entry_t* b =
+      (const trace_call_tree_sort_entry_t*)b_ptr;
+  if (a->parent != b->parent) return a->parent < b->parent ? -1 : 1;
+  if (a->total_duration > b->total_duration) return -1;
+  if (a->total_duration < b->total_duration) return 1;
+  return (a->node > b->node) - (a->node < b->node);
+}
+
+void trace_call_tree_preorder(const trace_call_tree_t* tree,
+                              darray_uint32_t* out_order, allocator_t* a) {
+  size_t count = tree->nodes.len;
+  const trace_call_tree_node_t* nodes = tree->nodes.ptr;
+
+  // Children grouped by parent, largest first.
+  darray_t(trace_call_tree_sort_entry_t) sorted = {};
+  for (size_t i = 1; i < count; i++) {
+    trace_call_tree_sort_entry_t entry = {
+        .parent = nodes[i].parent,
+        .node = (uint32_t)i,
+        .total_duration = nodes[i].total_duration,
+    };
+    darray_push(&sorted, entry, a);
+  }
+  if (sorted.len > 0) {
+    qsort(sorted.ptr, sorted.len, sizeof(trace_call_tree_sort_entry_t),
+          compare_sort_entry);
+  }
+  // Children of node n are sorted[first[n] .. first[n + 1]).
+  darray_uint32_t first = {};
+  darray_resize(&first, count + 1, a);
+  memset(first.ptr, 0, (count + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < sorted.len; i++) {
+    first.ptr[sorted.ptr[i].parent + 1]++;
+  }
+  for (size_t i = 0; i < count; i++) {
+    first.ptr[i + 1] += first.ptr[i];
+  }
+
+  darray_uint32_t stack = {};
+  if (count > 0) {
+    darray_push(&stack, 0u, a);
+  }
+  while (stack.len > 0) {
+    uint32_t node = stack.ptr[stack.len - 1];
+    darray_pop(&stack);
+    darray_push(out_order, node, a);
+    for (uint32_t i = first.ptr[node + 1]; i > first.ptr[node]; i--) {
+      darray_push(&stack, sorted.ptr[i - 1].node, a);
+    }
+  }
+
+  darray_deinit(&stack, a);
+  darray_deinit(&first, a);
+  darray_deinit(&sorted, a);
+}
+
+void trace_call_tree_append_stack(const trace_call_tree_t* tree,
+                                  const trace_data_t* td, uint32_t node,
+                                  string_t* out, allocator_t* a) {
+  const trace_call_tree_node_t* nodes = tree->nodes.ptr;
+  if (node != 0) {
+    trace_call_tree_append_stack(tree, td, nodes[node].parent, out, a);
+    if (nodes[node].parent != 0) {
+      string_append_char(out, ';', a);
+    }
+    string_append(out, trace_data_get_string(td, nodes[node].name_ref), a);
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef SRC_TRACE_CALL_TREE_H
+#define SRC_TRACE_CALL_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+#include "core/hash_table.h"
+#include "core/string.h"
+#include "src/trace_data.h"
+#include "src/track.h"
+
+constexpr uint32_t TRACE_CALL_TREE_NONE = UINT32_MAX;
+
+// One frame path: every event reached through the same names from the root.
+typedef struct trace_call_tree_node {
+  string_ref_t name_ref;
+  // Index of the parent node (TRACE_CALL_TREE_NONE for the root)
+  uint32_t parent;
+  // 0 for the root, 1 for top-level frames
+  uint32_t depth;
+  // Palette index of the first event merged into the node
+  uint8_t palette_index;
+  size_t count;
+  // Sum of the events' durations, clipped to the filter window
+  double total_duration;
+  // Total minus the time spent in children. Can dip below zero when events
+  // only partially overlap their parents.
+  double self_duration;
+} trace_call_tree_node_t;
+
+typedef darray_t(trace_call_tree_node_t) darray_trace_call_tree_node_t;
+
+// Merged call tree (a trie of name paths). Trees of disjoint track ranges can
+// be built in parallel and merged.
+typedef struct trace_call_tree {
+  // nodes.ptr[0] is the root, whose total is the sum of the top-level
+  // frames. A node always comes after its parent.
+  darray_trace_call_tree_node_t nodes;
+  // (parent << 32 | name_ref) -> child node index
+  hash_table_t(uint64_t, uint32_t) children;
+} trace_call_tree_t;
+
+typedef struct trace_call_tree_filter {
+  // Only events overlapping [start_ts, end_ts] count, clipped to it.
+  int64_t start_ts;
+  int64_t end_ts;
+  // When non-zero, only stacks through a frame with this name count, rooted
+  // at the outermost such frame.
+  string_ref_t root_ref;
+} trace_call_tree_filter_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns a filter that keeps every event.
+trace_call_tree_filter_t trace_call_tree_filter_all(void);
+
+void trace_call_tree_init(trace_call_tree_t* tree, allocator_t* a);
+void trace_call_tree_deinit(trace_call_tree_t* tree, allocator_t* a);
+
+// Adds the events of thread tracks [begin, end), using each track's `depths`
+// to reconstruct their stacks.
+void trace_call_tree_add_tracks(trace_call_tree_t* tree, const trace_data_t* td,
+                                const darray_track_t* tracks, size_t begin,
+                                size_t end,
+                                const trace_call_tree_filter_t* filter,
+                                allocator_t* a);
+
+// Adds the nodes of `src` into `dst`. Both must refer to the same trace.
+void trace_call_tree_merge(trace_call_tree_t* dst, const trace_call_tree_t* src,
+                           allocator_t* a);
+
+// Appends the node indices in depth-first order to `out_order`, starting with
+// the root, with siblings ordered by total duration (largest first).
+void trace_call_tree_preorder(const trace_call_tree_t* tree,
+                              darray_uint32_t* out_order, allocator_t* a);
+
+// Appends the names from the top-level frame down to `node`, separated by
+// ';' (the folded-stack format).
+void trace_call_tree_append_stack(const trace_call_tree_t* tree,
+                                  const trace_data_t* td, uint32_t node,
+                                  string_t* out, allocator_t* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SRC_TRACE_CALL_TREE_H
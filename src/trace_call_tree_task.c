@@ -0,0 +1,107 @@
+#include "src/trace_call_tree_task.h"
+
+#include <math.h>
+
+#include "core/assert.h"
+#include "core/logging.h"
+#include "core/self_trace.h"
+#include "core/task.h"
+
+// Background worker thread function (conforms to task_t signature)
+void trace_call_tree_task_run(task_context_t* ctx) {
+  trace_call_tree_task_t* task = (trace_call_tree_task_t*)ctx->user_data;
+  expect(task != nullptr);
+
+  allocator_t* allocator = task->allocator;
+  const darray_track_t* tracks = &task->tracks;
+  trace_call_tree_filter_t filter = {
+      .start_ts = (int64_t)floor(task->start_time),
+      .end_ts = (int64_t)ceil(task->end_time),
+  };
+
+  SELF_TRACE_BEGIN("trace_call_tree");
+  trace_call_tree_t tree;
+  trace_call_tree_init(&tree, allocator);
+  bool aborted = false;
+  for (size_t i = 0; i < tracks->len && !aborted; i++) {
+    if (task_should_abort(ctx)) {
+      aborted = true;
+    } else {
+      trace_call_tree_add_tracks(&tree, task->td, tracks, i, i + 1, &filter,
+                                 allocator);
+    }
+  }
+
+  darray_uint32_t order = {};
+  darray_double_t offsets = {};
+  if (!aborted) {
+    trace_call_tree_preorder(&tree, &order, allocator);
+
+    // Lay children out left to right within their parent, in preorder so a
+    // parent is placed before its children.
+    size_t count = tree.nodes.len;
+    const trace_call_tree_node_t* nodes = tree.nodes.ptr;
+    allocator_t* scratch = arena_get_allocator(ctx->arena);
+    darray_resize(&offsets, count, allocator);
+    darray_double_t next_offsets = {};
+    darray_resize(&next_offsets, count, scratch);
+    offsets.ptr[0] = 0.0;
+    next_offsets.ptr[0] = 0.0;
+    for (size_t i = 1; i < order.len; i++) {
+      uint32_t node = order.ptr[i];
+      uint32_t parent = nodes[node].parent;
+      offsets.ptr[node] = next_offsets.ptr[parent];
+      next_offsets.ptr[parent] += nodes[node].total_duration;
+      next_offsets.ptr[node] = offsets.ptr[node];
+    }
+  }
+  SELF_TRACE_END();
+
+  if (aborted) {
+    LOG_DEBUG("trace_call_tree_task_run background task aborted");
+    trace_call_tree_deinit(&tree, allocator);
+  } else {
+    // Save outputs to the task context to be adopted by the UI thread
+    task->tree = tree;
+    task->order = order;
+    task->offsets = offsets;
+  }
+}
+
+trace_call_tree_task_t* trace_call_tree_task_create(
+    const trace_data_t* td, const darray_track_t* tracks, double start_time,
+    double end_time, task_submission_t* sub, allocator_t* allocator) {
+  expect(td != nullptr);
+  expect(sub != nullptr);
+
+  // The context lives in the task-local submission arena.
+  trace_call_tree_task_t* task = (trace_call_tree_task_t*)allocator_alloc(
+      arena_get_allocator(sub->arena), sizeof(trace_call_tree_task_t));
+  *task = (trace_call_tree_task_t){
+      .td = td,
+      .tracks = *tracks,
+      .start_time = start_time,
+      .end_time = end_time,
+      .allocator = allocator,
+  };
+
+  sub->task = trace_call_tree_task_run;
+  sub->user_data = task;
+  sub->stream = 0;
+
+  return task;
+}
+
+void trace_call_tree_task_destroy(trace_call_tree_task_t* task) {
+  if (!task) return;
+  allocator_t* a = task->allocator;
+  trace_call_tree_deinit(&task->tree, a);
+  darray_deinit(&task->order, a);
+  darray_deinit(&task->offsets, a);
+  for (size_t i = 0; i < task->retired_tracks.len; i++) {
+    track_deinit(&task->retired_tracks.ptr[i], a);
+  }
+  darray_deinit(&task->retired_tracks, a);
+  // Note: task itself is allocated from the task-local arena and will be
+  // automatically reclaimed when task_queue_remove_completion is called.
+}
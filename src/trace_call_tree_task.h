@@ -0,0 +1,63 @@
+#ifndef SRC_TRACE_CALL_TREE_TASK_H
+#define SRC_TRACE_CALL_TREE_TASK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+#include "core/task.h"
+#include "src/trace_call_tree.h"
+#include "src/trace_data.h"
+#include "src/track.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Transparent call tree task context: builds the merged call tree of a time
+// range for the flame graph panel off the UI thread.
+struct trace_call_tree_task {
+  const trace_data_t* td;
+  // The viewer's tracks, read without owning them. When the viewer replaces
+  // them before the task completes, they are moved to `retired_tracks`
+  // instead of being freed.
+  darray_track_t tracks;
+  double start_time;
+  double end_time;
+  allocator_t* allocator;
+
+  // --- UI thread only ---
+  bool tracks_retired;
+  darray_track_t retired_tracks;
+  // A newer range was asked for, or the trace was closed; the outputs are
+  // dropped.
+  bool superseded;
+
+  // --- Outputs (written by worker on success, read by UI thread) ---
+  trace_call_tree_t tree;
+  // Node indices in preorder, siblings by total duration
+  darray_uint32_t order;
+  // Start of each node, in microseconds from the start of the root
+  darray_double_t offsets;
+};
+
+typedef struct trace_call_tree_task trace_call_tree_task_t;
+
+// Prepares a call tree task for [start_time, end_time] in the submission
+// slot `sub`. Outputs are allocated from `allocator`.
+trace_call_tree_task_t* trace_call_tree_task_create(
+    const trace_data_t* td, const darray_track_t* tracks, double start_time,
+    double end_time, task_submission_t* sub, allocator_t* allocator);
+
+// Frees the outputs that were not adopted and the retired tracks.
+void trace_call_tree_task_destroy(trace_call_tree_task_t* task);
+
+// Opaque background worker function signature (passed to the task queue)
+void trace_call_tree_task_run(task_context_t* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SRC_TRACE_CALL_TREE_TASK_H
@@ -0,0 +1,91 @@
+#include "src/trace_call_tree_task.h"
+
+#include <gtest/gtest.h>
+
+#include "core/allocator.h"
+#include "core/arena.h"
+#include "core/counting_allocator.h"
+#include "core/task.h"
+#include "src/platform.h"
+#include "src/trace_data.h"
+#include "src/track.h"
+
+static void add_event(trace_data_t* td, allocator_t* a, const char* name,
+                      int64_t ts, int64_t dur) {
+  trace_event_t e = {};
+  e.ph = "X";
+  e.pid = 1;
+  e.tid = 1;
+  e.name = name;
+  e.ts = ts;
+  e.dur = dur;
+  trace_event_matcher_t matcher = {};
+  trace_data_add_event(td, &e, &matcher, a);
+  trace_event_matcher_deinit(&matcher);
+}
+
+// E2E test for the background call tree task: builds the tree of a window on
+// the Task Queue and hands the tracks the viewer replaced back to the task.
+TEST(trace_call_tree_task_test, e2e_call_tree_task) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  allocator_t* a = counting_allocator_get_allocator(&ca);
+
+  {
+    // outer [0, 100) holds inner [10, 30); a later outer starts at 200.
+    trace_data_t* td = trace_data_create(a);
+    add_event(td, a, "outer", 0, 100);
+    add_event(td, a, "inner", 10, 20);
+    add_event(td, a, "outer", 200, 50);
+
+    darray_track_t tracks = {};
+    int64_t min_ts, max_ts;
+    arena_t* scratch_arena = arena_create_with_allocator(a);
+    track_organize(td, &tracks, &min_ts, &max_ts, a,
+                   arena_get_allocator(scratch_arena));
+    arena_destroy(scratch_arena);
+
+    task_queue_t* queue = task_queue_create(64, platform_submit_job, a);
+    task_submission_t* sub = task_queue_get_submission(queue);
+    ASSERT_NE(sub, nullptr);
+
+    trace_call_tree_task_t* task =
+        trace_call_tree_task_create(td, &tracks, 0.0, 150.0, sub, a);
+    EXPECT_NE(task, nullptr);
+    task_queue_submit(queue);
+
+    // The viewer moves on to other tracks; the task keeps the ones it reads.
+    task->tracks_retired = true;
+    task->retired_tracks = tracks;
+
+    task_completion_t cqe = {};
+    task_queue_wait_completion(queue, &cqe);
+    EXPECT_EQ(cqe.task, trace_call_tree_task_run);
+    EXPECT_EQ(cqe.user_data, task);
+    EXPECT_EQ(cqe.status, TASK_STATUS_OK);
+
+    // Root, outer and outer;inner. The second outer is outside the window.
+    ASSERT_EQ(task->tree.nodes.len, 3u);
+    ASSERT_EQ(task->order.len, 3u);
+    ASSERT_EQ(task->offsets.len, 3u);
+    const trace_call_tree_node_t* nodes = task->tree.nodes.ptr;
+    EXPECT_DOUBLE_EQ(nodes[0].total_duration, 100.0);
+    uint32_t outer = task->order.ptr[1];
+    uint32_t inner = task->order.ptr[2];
+    EXPECT_EQ(trace_data_get_string(td, nodes[outer].name_ref), "outer");
+    EXPECT_EQ(nodes[inner].parent, outer);
+    EXPECT_DOUBLE_EQ(task->offsets.ptr[outer], 0.0);
+    EXPECT_DOUBLE_EQ(task->offsets.ptr[inner], 0.0);
+
+    trace_call_tree_task_destroy(task);
+    task_queue_remove_completion(queue);
+    task_queue_destroy(queue);
+    trace_data_release(td, a);
+
+    // Tear down workers to ensure all threads exit and free their resources
+    platform_teardown_workers();
+  }
+
+  // The outputs and the retired tracks were freed with the task.
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
+}
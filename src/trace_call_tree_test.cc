@@ -0,0 +1,180 @@
+#include "src/trace_call_tree.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "core/allocator.h"
+#include "core/arena.h"
+#include "src/trace_data.h"
+#include "src/track.h"
+
+static void add_event(trace_data_t* td, allocator_t* a, const char* name,
+                      int64_t ts, int64_t dur, int32_t tid) {
+  trace_event_t e = {};
+  e.ph = "X";
+  e.pid = 1;
+  e.tid = tid;
+  e.name = name;
+  e.ts = ts;
+  e.dur = dur;
+  trace_event_matcher_t matcher = {};
+  trace_data_add_event(td, &e, &matcher, a);
+  trace_event_matcher_deinit(&matcher);
+}
+
+// Thread 1: Javac [0, 1000) holds parse [100, 400) and gen [500, 900), which
+// holds emit [600, 700).
+// Thread 2: Javac [0, 500) holds parse [0, 200).
+class trace_call_tree_test : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    a_ = c_allocator();
+    td_ = trace_data_create(a_);
+    add_event(td_, a_, "Javac", 0, 1000, 1);
+    add_event(td_, a_, "parse", 100, 300, 1);
+    add_event(td_, a_, "gen", 500, 400, 1);
+    add_event(td_, a_, "emit", 600, 100, 1);
+    add_event(td_, a_, "Javac", 0, 500, 2);
+    add_event(td_, a_, "parse", 0, 200, 2);
+
+    int64_t min_ts, max_ts;
+    arena_t* scratch_arena = arena_create();
+    track_organize(td_, &tracks_, &min_ts, &max_ts, a_,
+                   arena_get_allocator(scratch_arena));
+    arena_destroy(scratch_arena);
+  }
+
+  void TearDown() override {
+    for (size_t i = 0; i < tracks_.len; i++) {
+      track_deinit(&tracks_.ptr[i], a_);
+    }
+    darray_deinit(&tracks_, a_);
+    trace_data_release(td_, a_);
+  }
+
+  // Returns the folded stacks of `tree` in preorder.
+  std::vector<std::string> stacks(const trace_call_tree_t* tree) {
+    darray_uint32_t order = {};
+    trace_call_tree_preorder(tree, &order, a_);
+    std::vector<std::string> result;
+    for (size_t i = 0; i < order.len; i++) {
+      string_t s = {};
+      trace_call_tree_append_stack(tree, td_, order.ptr[i], &s, a_);
+      result.push_back(std::string(s.ptr ? s.ptr : "", s.len));
+      string_free(s, a_);
+    }
+    darray_deinit(&order, a_);
+    return result;
+  }
+
+  // Returns the node with the given folded stack.
+  const trace_call_tree_node_t* find(const trace_call_tree_t* tree,
+                                     const std::string& stack) {
+    const trace_call_tree_node_t* result = nullptr;
+    for (size_t i = 0; i < tree->nodes.len && !result; i++) {
+      string_t s = {};
+      trace_call_tree_append_stack(tree, td_, (uint32_t)i, &s, a_);
+      if (std::string(s.ptr ? s.ptr : "", s.len) == stack) {
+        result = &tree->nodes.ptr[i];
+      }
+      string_free(s, a_);
+    }
+    return result;
+  }
+
+  allocator_t* a_ = nullptr;
+  trace_data_t* td_ = nullptr;
+  darray_track_t tracks_ = {};
+};
+
+TEST_F(trace_call_tree_test, merges_identical_paths_across_tracks) {
+  trace_call_tree_t tree;
+  trace_call_tree_init(&tree, a_);
+  trace_call_tree_filter_t filter = trace_call_tree_filter_all();
+  trace_call_tree_add_tracks(&tree, td_, &tracks_, 0, tracks_.len, &filter,
+                             a_);
+
+  EXPECT_EQ(stacks(&tree),
+            (std::vector<std::string>{"", "Javac", "Javac;parse", "Javac;gen",
+                                      "Javac;gen;emit"}));
+  EXPECT_DOUBLE_EQ(tree.nodes.ptr[0].total_duration, 1500.0);
+
+  const trace_call_tree_node_t* javac = find(&tree, "Javac");
+  ASSERT_NE(javac, nullptr);
+  EXPECT_EQ(javac->count, 2u);
+  EXPECT_DOUBLE_EQ(javac->total_duration, 1500.0);
+  EXPECT_DOUBLE_EQ(javac->self_duration, 600.0);
+
+  const trace_call_tree_node_t* parse = find(&tree, "Javac;parse");
+  ASSERT_NE(parse, nullptr);
+  EXPECT_EQ(parse->count, 2u);
+  EXPECT_DOUBLE_EQ(parse->total_duration, 500.0);
+
+  const trace_call_tree_node_t* gen = find(&tree, "Javac;gen");
+  ASSERT_NE(gen, nullptr);
+  EXPECT_DOUBLE_EQ(gen->self_duration, 300.0);
+  EXPECT_EQ(gen->depth, 2u);
+
+  trace_call_tree_deinit(&tree, a_);
+}
+
+TEST_F(trace_call_tree_test, merged_trees_match_single_pass) {
+  ASSERT_EQ(tracks_.len, 2u);
+  trace_call_tree_filter_t filter = trace_call_tree_filter_all();
+  trace_call_tree_t first, second;
+  trace_call_tree_init(&first, a_);
+  trace_call_tree_init(&second, a_);
+  trace_call_tree_add_tracks(&first, td_, &tracks_, 1, 2, &filter, a_);
+  trace_call_tree_add_tracks(&second, td_, &tracks_, 0, 1, &filter, a_);
+  trace_call_tree_merge(&first, &second, a_);
+
+  EXPECT_EQ(stacks(&first),
+            (std::vector<std::string>{"", "Javac", "Javac;parse", "Javac;gen",
+                                      "Javac;gen;emit"}));
+  const trace_call_tree_node_t* javac = find(&first, "Javac");
+  ASSERT_NE(javac, nullptr);
+  EXPECT_EQ(javac->count, 2u);
+  EXPECT_DOUBLE_EQ(javac->self_duration, 600.0);
+  EXPECT_DOUBLE_EQ(first.nodes.ptr[0].total_duration, 1500.0);
+
+  trace_call_tree_deinit(&first, a_);
+  trace_call_tree_deinit(&second, a_);
+}
+
+TEST_F(trace_call_tree_test, window_clips_durations) {
+  trace_call_tree_t tree;
+  trace_call_tree_init(&tree, a_);
+  trace_call_tree_filter_t filter = {.start_ts = 550, .end_ts = 650};
+  trace_call_tree_add_tracks(&tree, td_, &tracks_, 0, tracks_.len, &filter,
+                             a_);
+
+  EXPECT_EQ(stacks(&tree), (std::vector<std::string>{"", "Javac", "Javac;gen",
+                                                      "Javac;gen;emit"}));
+  const trace_call_tree_node_t* javac = find(&tree, "Javac");
+  ASSERT_NE(javac, nullptr);
+  EXPECT_EQ(javac->count, 1u);
+  EXPECT_DOUBLE_EQ(javac->total_duration, 100.0);
+  EXPECT_DOUBLE_EQ(javac->self_duration, 0.0);
+  const trace_call_tree_node_t* emit = find(&tree, "Javac;gen;emit");
+  ASSERT_NE(emit, nullptr);
+  EXPECT_DOUBLE_EQ(emit->total_duration, 50.0);
+
+  trace_call_tree_deinit(&tree, a_);
+}
+
+TEST_F(trace_call_tree_test, root_filter_reroots_stacks) {
+  trace_call_tree_t tree;
+  trace_call_tree_init(&tree, a_);
+  trace_call_tree_filter_t filter = trace_call_tree_filter_all();
+  filter.root_ref = trace_data_lookup_string(td_, SV("gen"));
+  trace_call_tree_add_tracks(&tree, td_, &tracks_, 0, tracks_.len, &filter,
+                             a_);
+
+  EXPECT_EQ(stacks(&tree),
+            (std::vector<std::string>{"", "gen", "gen;emit"}));
+  EXPECT_DOUBLE_EQ(tree.nodes.ptr[0].total_duration, 400.0);
+
+  trace_call_tree_deinit(&tree, a_);
+}
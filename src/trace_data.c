@@ -5,6 +5,7 @@
 
 #include "core/assert.h"
 #include "core/darray.h"
+#include "core/tagged_allocator.h"
 #include "src/colors.h"
 
 static uint32_t compute_hash(string_view_t s) {
@@ -105,6 +106,117 @@ void trace_data_compact(trace_data_t* td, allocator_t* a) {
   darray_compact(&td->args, a);
 }
 
+bool trace_data_is_shared(const trace_data_t* td) {
+  return atomic_load_explicit(&td->ref_count, memory_order_acquire) > 1;
+}
+
+trace_data_extent_t trace_data_get_extent(const trace_data_t* td) {
+  return (trace_data_extent_t){
+      .string_bytes = td->string_buffer.len,
+      .strings = td->string_table.len,
+      .events = td->events.len,
+      .args = td->args.len,
+  };
+}
+
+void trace_data_delta_capture(trace_data_delta_t* delta,
+                              const trace_data_t* td, trace_data_extent_t base,
+                              const size_t* ended_events, size_t ended_count,
+                              allocator_t* a) {
+  allocator_t* strings_a = allocator_for_tag(a, MEMORY_TAG_STRINGS);
+  allocator_t* events_a = allocator_for_tag(a, MEMORY_TAG_EVENTS);
+  allocator_t* args_a = allocator_for_tag(a, MEMORY_TAG_ARGS);
+  expect(delta->events.len == 0 && delta->updates.len == 0);
+  expect(base.events <= td->events.len && base.args <= td->args.len);
+
+  delta->base = base;
+  darray_push_n(&delta->string_buffer,
+                td->string_buffer.ptr + base.string_bytes,
+                td->string_buffer.len - base.string_bytes, strings_a);
+  darray_push_n(&delta->string_table, td->string_table.ptr + base.strings,
+                td->string_table.len - base.strings, strings_a);
+  darray_push_n(&delta->events, td->events.ptr + base.events,
+                td->events.len - base.events, events_a);
+  darray_push_n(&delta->args, td->args.ptr + base.args,
+                td->args.len - base.args, args_a);
+
+  // The end event's args were either written over the begin event's own or
+  // appended, in which case they are in delta->args already.
+  const trace_event_persisted_t* events = td->events.ptr;
+  const trace_arg_persisted_t* args = td->args.ptr;
+  for (size_t i = 0; i < ended_count; i++) {
+    size_t event_idx = ended_events[i];
+    expect(event_idx < base.events);
+    const trace_event_persisted_t* e = &events[event_idx];
+    trace_event_update_t update = {.event_idx = event_idx, .event = *e};
+    darray_push(&delta->updates, update, a);
+    if (e->args_offset < base.args) {
+      darray_push_n(&delta->updated_args, args + e->args_offset,
+                    e->args_count, args_a);
+    }
+  }
+}
+
+void trace_data_delta_apply(trace_data_t* td, const trace_data_delta_t* delta,
+                            allocator_t* a) {
+  allocator_t* strings_a = allocator_for_tag(a, MEMORY_TAG_STRINGS);
+  allocator_t* events_a = allocator_for_tag(a, MEMORY_TAG_EVENTS);
+  allocator_t* args_a = allocator_for_tag(a, MEMORY_TAG_ARGS);
+  trace_data_extent_t extent = trace_data_get_extent(td);
+  expect(extent.string_bytes == delta->base.string_bytes &&
+         extent.strings == delta->base.strings &&
+         extent.events == delta->base.events &&
+         extent.args == delta->base.args);
+
+  darray_push_n(&td->string_buffer, delta->string_buffer.ptr,
+                delta->string_buffer.len, strings_a);
+  darray_push_n(&td->string_table, delta->string_table.ptr,
+                delta->string_table.len, strings_a);
+  darray_push_n(&td->events, delta->events.ptr, delta->events.len, events_a);
+  darray_push_n(&td->args, delta->args.ptr, delta->args.len, args_a);
+
+  // Index the new strings by their stored hashes, as trace_data_push_string
+  // would have.
+  string_lookup_table_t* lt = &td->string_lookup;
+  for (size_t i = 0; i < delta->string_table.len; i++) {
+    if ((lt->size + 1) * 2 > lt->capacity) {
+      string_lookup_table_resize(lt, lt->capacity * 2, strings_a);
+    }
+    uint32_t h = delta->string_table.ptr[i].hash;
+    size_t idx = h & lt->capacity_mask;
+    while (lt->entries[idx].index != 0) {
+      idx = (idx + 1) & lt->capacity_mask;
+    }
+    lt->entries[idx].index = (uint32_t)(extent.strings + i + 1);
+    lt->entries[idx].hash = h;
+    lt->size++;
+  }
+
+  trace_event_persisted_t* events = td->events.ptr;
+  trace_arg_persisted_t* args = td->args.ptr;
+  const trace_arg_persisted_t* updated_args = delta->updated_args.ptr;
+  for (size_t i = 0; i < delta->updates.len; i++) {
+    const trace_event_update_t* u = &delta->updates.ptr[i];
+    expect(u->event_idx < extent.events);
+    events[u->event_idx] = u->event;
+    if (u->event.args_offset < extent.args) {
+      memcpy(args + u->event.args_offset, updated_args,
+             u->event.args_count * sizeof(trace_arg_persisted_t));
+      updated_args += u->event.args_count;
+    }
+  }
+}
+
+void trace_data_delta_deinit(trace_data_delta_t* delta, allocator_t* a) {
+  darray_deinit(&delta->string_buffer, a);
+  darray_deinit(&delta->string_table, a);
+  darray_deinit(&delta->events, a);
+  darray_deinit(&delta->args, a);
+  darray_deinit(&delta->updates, a);
+  darray_deinit(&delta->updated_args, a);
+  *delta = (trace_data_delta_t){};
+}
+
 string_ref_t trace_data_push_string(trace_data_t* td, string_view_t s,
                                     allocator_t* a) {
   string_ref_t result = 0;
@@ -114,7 +226,8 @@ string_ref_t trace_data_push_string(trace_data_t* td, string_view_t s,
 
   string_lookup_table_t* lt = &td->string_lookup;
   if (lt->capacity == 0) {
-    string_lookup_table_resize(lt, 16, a);
+    string_lookup_table_resize(lt, 16,
+                               allocator_for_tag(a, MEMORY_TAG_STRINGS));
   }
 
   uint32_t h = compute_hash(s);
@@ -140,10 +253,11 @@ string_ref_t trace_data_push_string(trace_data_t* td, string_view_t s,
       .hash = h,
   };
 
-  darray_push_n(&td->string_buffer, s.ptr, s.len, a);
-  darray_push(&td->string_buffer, '\0', a);
+  allocator_t* strings_a = allocator_for_tag(a, MEMORY_TAG_STRINGS);
+  darray_push_n(&td->string_buffer, s.ptr, s.len, strings_a);
+  darray_push(&td->string_buffer, '\0', strings_a);
 
-  darray_push(&td->string_table, entry, a);
+  darray_push(&td->string_table, entry, strings_a);
   uint32_t new_index = (uint32_t)td->string_table.len;
 
   lt->entries[idx].index = new_index;
@@ -151,12 +265,69 @@ string_ref_t trace_data_push_string(trace_data_t* td, string_view_t s,
   lt->size++;
 
   if (lt->size * 2 > lt->capacity) {
-    string_lookup_table_resize(lt, lt->capacity * 2, a);
+    string_lookup_table_resize(lt, lt->capacity * 2, strings_a);
   }
 
   return new_index;
 }
 
+// Probes `td`'s lookup table for `s`, whose hash is `h`. Returns 0 if absent.
+static string_ref_t trace_data_find_string(const trace_data_t* td,
+                                           string_view_t s, uint32_t h) {
+  string_ref_t result = 0;
+  const string_lookup_table_t* lt = &td->string_lookup;
+  if (lt->capacity > 0) {
+    const string_entry_t* st_table = td->string_table.ptr;
+    const char* st_buffer = (const char*)td->string_buffer.ptr;
+    size_t idx = h & lt->capacity_mask;
+    while (result == 0 && lt->entries[idx].index != 0) {
+      const string_lookup_entry_t* entry = &lt->entries[idx];
+      if (entry->hash == h) {
+        const string_entry_t* e = &st_table[entry->index - 1];
+        if (s.len == e->len &&
+            memcmp(s.ptr, st_buffer + e->offset, s.len) == 0) {
+          result = entry->index;
+        }
+      }
+      idx = (idx + 1) & lt->capacity_mask;
+    }
+  }
+  return result;
+}
+
+string_ref_t trace_data_lookup_string(const trace_data_t* td, string_view_t s) {
+  string_ref_t result = 0;
+  if (s.len > 0) {
+    result = trace_data_find_string(td, s, compute_hash(s));
+  }
+  return result;
+}
+
+string_ref_t trace_data_translate_string(const trace_data_t* from,
+                                         string_ref_t ref,
+                                         const trace_data_t* to) {
+  string_ref_t result = 0;
+  if (ref > 0 && ref <= from->string_table.len) {
+    const string_entry_t* e = &from->string_table.ptr[ref - 1];
+    result = trace_data_find_string(to, trace_data_get_string(from, ref),
+                                    e->hash);
+  }
+  return result;
+}
+
+void trace_data_build_string_translation(const trace_data_t* from,
+                                         const trace_data_t* to,
+                                         darray_uint32_t* out_refs,
+                                         allocator_t* a) {
+  size_t count = from->string_table.len;
+  darray_resize(out_refs, count + 1, a);
+  out_refs->ptr[0] = 0;
+  for (size_t i = 0; i < count; i++) {
+    out_refs->ptr[i + 1] =
+        trace_data_translate_string(from, (string_ref_t)(i + 1), to);
+  }
+}
+
 static string_ref_t trace_data_push_string_cached(trace_data_t* td,
                                                   string_view_t s,
                                                   string_ref_t* cache_ref,
@@ -308,7 +479,8 @@ static void trace_data_merge_args(trace_data_t* td,
       uint32_t new_offset = (uint32_t)td->args.len;
       uint32_t new_count = old_count + (uint32_t)new_args_count;
 
-      darray_reserve(&td->args, td->args.len + new_count, a);
+      allocator_t* args_a = allocator_for_tag(a, MEMORY_TAG_ARGS);
+      darray_reserve(&td->args, td->args.len + new_count, args_a);
 
       memcpy(td->args.ptr + new_offset, td->args.ptr + old_offset,
              old_count * sizeof(trace_arg_persisted_t));
@@ -322,7 +494,7 @@ static void trace_data_merge_args(trace_data_t* td,
               .val_ref = e_val_refs[i],
               .val_double = e_ev->args[i].val_double,
           };
-          darray_push(&td->args, arg, a);
+          darray_push(&td->args, arg, args_a);
         }
       }
 
@@ -356,6 +528,8 @@ void trace_data_add_event(trace_data_t* td, const trace_event_t* event,
   string_view_t ph = event->ph;
   bool is_begin = (ph.len == 1 && (ph.ptr[0] == 'B' || ph.ptr[0] == 'b'));
   bool is_end = (ph.len == 1 && (ph.ptr[0] == 'E' || ph.ptr[0] == 'e'));
+  allocator_t* events_a = allocator_for_tag(a, MEMORY_TAG_EVENTS);
+  allocator_t* args_a = allocator_for_tag(a, MEMORY_TAG_ARGS);
 
   if (is_begin) {
     trace_event_persisted_t p = {};
@@ -382,11 +556,11 @@ void trace_data_add_event(trace_data_t* td, const trace_event_t* event,
           td, event->args[i].key, &td->last_arg_key_refs[cache_idx], a);
       arg.val_ref = trace_data_push_string(td, event->args[i].val, a);
       arg.val_double = event->args[i].val_double;
-      darray_push(&td->args, arg, a);
+      darray_push(&td->args, arg, args_a);
     }
 
     size_t new_idx = td->events.len;
-    darray_push(&td->events, p, a);
+    darray_push(&td->events, p, events_a);
 
     uint64_t thread_id =
         ((uint64_t)(uint32_t)event->pid << 32) | (uint32_t)event->tid;
@@ -447,9 +621,9 @@ void trace_data_add_event(trace_data_t* td, const trace_event_t* event,
           td, event->args[i].key, &td->last_arg_key_refs[cache_idx], a);
       arg.val_ref = trace_data_push_string(td, event->args[i].val, a);
       arg.val_double = event->args[i].val_double;
-      darray_push(&td->args, arg, a);
+      darray_push(&td->args, arg, args_a);
     }
 
-    darray_push(&td->events, p, a);
+    darray_push(&td->events, p, events_a);
   }
 }
@@ -103,6 +103,58 @@ void trace_data_retain(trace_data_t* td);
 void trace_data_release(trace_data_t* td, allocator_t* a);
 void trace_data_compact(trace_data_t* td, allocator_t* a);
 
+// Returns true if references to `td` other than the caller's exist, e.g. held
+// by a task that reads it on another thread.
+bool trace_data_is_shared(const trace_data_t* td);
+
+// Lengths of the arrays of a trace_data_t, which mark a point while it grows.
+typedef struct trace_data_extent {
+  size_t string_bytes;
+  size_t strings;
+  size_t events;
+  size_t args;
+} trace_data_extent_t;
+
+trace_data_extent_t trace_data_get_extent(const trace_data_t* td);
+
+// A begin event that ended after it was copied into a delta: it has its
+// duration now, and the args of its end event were merged into its own.
+typedef struct trace_event_update {
+  size_t event_idx;
+  trace_event_persisted_t event;
+} trace_event_update_t;
+
+// What a growing trace_data_t gained since it was at `base`: the strings,
+// events and args appended since, and the begin events from before `base`
+// that ended meanwhile. Applying the deltas of a trace in order to an empty
+// trace_data_t rebuilds a copy of it without copying anything twice.
+typedef struct trace_data_delta {
+  trace_data_extent_t base;
+  darray_uint8_t string_buffer;
+  darray_t(string_entry_t) string_table;
+  darray_t(trace_event_persisted_t) events;
+  darray_t(trace_arg_persisted_t) args;
+  darray_t(trace_event_update_t) updates;
+  // Args from before `base` that the updates overwrote in place, in the order
+  // of the updates
+  darray_t(trace_arg_persisted_t) updated_args;
+} trace_data_delta_t;
+
+// Copies what `td` holds beyond `base` into `delta`, which must be empty.
+// `ended_events` are the begin events that were still waiting for their end
+// at `base` and have ended since; they become updates.
+void trace_data_delta_capture(trace_data_delta_t* delta,
+                              const trace_data_t* td, trace_data_extent_t base,
+                              const size_t* ended_events, size_t ended_count,
+                              allocator_t* a);
+
+// Appends `delta` to `td`, which must be at `delta->base`, and applies its
+// updates.
+void trace_data_delta_apply(trace_data_t* td, const trace_data_delta_t* delta,
+                            allocator_t* a);
+
+void trace_data_delta_deinit(trace_data_delta_t* delta, allocator_t* a);
+
 typedef struct active_event_b {
   size_t event_idx;
 } active_event_b_t;
@@ -141,6 +193,35 @@ static inline string_view_t trace_data_get_string(const trace_data_t* td,
   return result;
 }
 
+// Returns the ref of `s` in the string pool of `td`, or 0 if it is not there.
+string_ref_t trace_data_lookup_string(const trace_data_t* td, string_view_t s);
+
+// Returns the ref of the string `ref` names in `from` within `to`'s string
+// pool, or 0 if `to` does not contain it.
+//
+// Uses the hash stored with the string in `from`, so the string is compared
+// but never rehashed.
+string_ref_t trace_data_translate_string(const trace_data_t* from,
+                                         string_ref_t ref,
+                                         const trace_data_t* to);
+
+// Builds a table mapping every string ref of `from` to the ref of the same
+// string in `to`: `out_refs->ptr[ref]` is the translated ref, or 0 if `to`
+// does not contain the string. Entry 0 (the empty string) maps to 0.
+//
+// With it, multi-trace analyses (e.g. diff) compare names, categories, track
+// names and arg values of two traces by integer ref instead of by string.
+//
+// Arguments:
+// - from: The trace whose refs are translated.
+// - to: The trace whose string pool is searched.
+// - out_refs: Output darray, resized to from->string_table.len + 1.
+// - a: Allocator.
+void trace_data_build_string_translation(const trace_data_t* from,
+                                         const trace_data_t* to,
+                                         darray_uint32_t* out_refs,
+                                         allocator_t* a);
+
 /**
  * Performs a binary search (lower bound) over an array of event indices.
  *
@@ -2,6 +2,8 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
+
 #include "src/colors.h"
 
 TEST(trace_data_test, basic) {
@@ -72,6 +74,120 @@ TEST(trace_data_test, de_duplication) {
   trace_data_release(td, a);
 }
 
+TEST(trace_data_test, deltas_rebuild_the_trace) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td = trace_data_create(a);
+  trace_data_t* copy = trace_data_create(a);
+  trace_event_matcher_t matcher = {};
+
+  trace_arg_t begin_arg = {SV("key"), SV("begin"), 0.0};
+  trace_event_t begin = {};
+  begin.name = SV("outer");
+  begin.ph = SV("B");
+  begin.ts = 100;
+  begin.args = &begin_arg;
+  begin.args_count = 1;
+  trace_data_add_event(td, &begin, &matcher, a);
+
+  trace_data_delta_t first = {};
+  trace_data_delta_capture(&first, td, trace_data_extent_t{}, nullptr, 0, a);
+  trace_data_delta_apply(copy, &first, a);
+  trace_data_delta_deinit(&first, a);
+  trace_data_extent_t base = trace_data_get_extent(td);
+  ASSERT_EQ(copy->events.len, 1u);
+  EXPECT_EQ(copy->events.ptr[0].dur, 0);
+
+  // The end event overwrites the begin event's arg in place, and a new event
+  // brings new strings.
+  trace_arg_t end_arg = {SV("key"), SV("end"), 0.0};
+  trace_event_t end = {};
+  end.ph = SV("E");
+  end.ts = 250;
+  end.args = &end_arg;
+  end.args_count = 1;
+  trace_data_add_event(td, &end, &matcher, a);
+  trace_event_t inner = {};
+  inner.name = SV("inner");
+  inner.ph = SV("X");
+  inner.ts = 120;
+  inner.dur = 30;
+  trace_data_add_event(td, &inner, &matcher, a);
+
+  size_t ended[] = {0};
+  trace_data_delta_t second = {};
+  trace_data_delta_capture(&second, td, base, ended, 1, a);
+  EXPECT_EQ(second.events.len, 1u);
+  EXPECT_EQ(second.updates.len, 1u);
+  trace_data_delta_apply(copy, &second, a);
+  trace_data_delta_deinit(&second, a);
+
+  ASSERT_EQ(copy->events.len, td->events.len);
+  ASSERT_EQ(copy->args.len, td->args.len);
+  ASSERT_EQ(copy->string_table.len, td->string_table.len);
+  EXPECT_EQ(memcmp(copy->string_buffer.ptr, td->string_buffer.ptr,
+                   td->string_buffer.len),
+            0);
+  for (size_t i = 0; i < td->events.len; i++) {
+    EXPECT_EQ(copy->events.ptr[i].ts, td->events.ptr[i].ts);
+    EXPECT_EQ(copy->events.ptr[i].dur, td->events.ptr[i].dur);
+    EXPECT_EQ(copy->events.ptr[i].name_ref, td->events.ptr[i].name_ref);
+  }
+  const trace_event_persisted_t* outer = &copy->events.ptr[0];
+  EXPECT_EQ(outer->dur, 150);
+  ASSERT_EQ(outer->args_count, 1u);
+  EXPECT_EQ(
+      trace_data_get_string(copy, copy->args.ptr[outer->args_offset].val_ref),
+      "end");
+
+  // Strings that came with a delta can be looked up and interned again.
+  EXPECT_EQ(trace_data_lookup_string(copy, SV("inner")),
+            copy->events.ptr[1].name_ref);
+  EXPECT_EQ(trace_data_push_string(copy, SV("outer"), a), outer->name_ref);
+  EXPECT_EQ(copy->string_table.len, td->string_table.len);
+
+  trace_event_matcher_deinit(&matcher);
+  trace_data_release(copy, a);
+  trace_data_release(td, a);
+}
+
+TEST(trace_data_test, string_translation) {
+  allocator_t* a = c_allocator();
+  trace_data_t* from = trace_data_create(a);
+  trace_data_t* to = trace_data_create(a);
+
+  string_ref_t from_foo = trace_data_push_string(from, SV("foo"), a);
+  string_ref_t from_bar = trace_data_push_string(from, SV("bar"), a);
+  string_ref_t from_baz = trace_data_push_string(from, SV("baz"), a);
+  trace_data_push_string(to, SV("qux"), a);
+  string_ref_t to_bar = trace_data_push_string(to, SV("bar"), a);
+  string_ref_t to_foo = trace_data_push_string(to, SV("foo"), a);
+
+  darray_uint32_t refs = {};
+  trace_data_build_string_translation(from, to, &refs, a);
+  ASSERT_EQ(refs.len, 4u);
+  EXPECT_EQ(refs.ptr[0], 0u);
+  EXPECT_EQ(refs.ptr[from_foo], to_foo);
+  EXPECT_EQ(refs.ptr[from_bar], to_bar);
+  EXPECT_EQ(refs.ptr[from_baz], 0u);
+
+  EXPECT_EQ(trace_data_translate_string(from, from_foo, to), to_foo);
+  EXPECT_EQ(trace_data_translate_string(from, 0, to), 0u);
+  EXPECT_EQ(trace_data_translate_string(to, to_foo, from), from_foo);
+
+  EXPECT_EQ(trace_data_lookup_string(to, SV("foo")), to_foo);
+  EXPECT_EQ(trace_data_lookup_string(to, SV("baz")), 0u);
+  EXPECT_EQ(trace_data_lookup_string(to, SV("")), 0u);
+
+  // An empty pool contains nothing.
+  trace_data_t* empty = trace_data_create(a);
+  EXPECT_EQ(trace_data_translate_string(from, from_foo, empty), 0u);
+
+  darray_deinit(&refs, a);
+  trace_data_release(empty, a);
+  trace_data_release(to, a);
+  trace_data_release(from, a);
+}
+
 TEST(trace_data_test, begin_end_events_basic) {
   allocator_t* a = c_allocator();
   trace_data_t* td = trace_data_create(a);
@@ -3,26 +3,8 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "core/hash_table.h"
 #include "src/trace_aggregate.h"
 
-typedef hash_table_t(string_view_t, trace_diff_entry_t) diff_map_t;
-
-static uint32_t hash_string_view(const string_view_t* key, void* ctx) {
-  (void)ctx;
-  uint32_t hash = 2166136261U;
-  for (size_t i = 0; i < key->len; i++) {
-    hash ^= (unsigned char)key->ptr[i];
-    hash *= 16777619ULL;
-  }
-  return hash;
-}
-
-static bool eq_string_view(const string_view_t* a, const string_view_t* b, void* ctx) {
-  (void)ctx;
-  return string_view_eq(*a, *b);
-}
-
 static int compare_string_views(string_view_t a, string_view_t b) {
   size_t min_len = a.len < b.len ? a.len : b.len;
   int cmp = memcmp(a.ptr, b.ptr, min_len);
@@ -48,6 +30,12 @@ static int compare_diff_count(const void* a_ptr, const void* b_ptr) {
   return compare_string_views(am->key, bm->key);
 }
 
+static double trace_diff_duration(const trace_aggregate_entry_t* e,
+                                  trace_aggregate_metric_t metric) {
+  return metric == TRACE_AGGREGATE_METRIC_SELF ? e->self_duration
+                                               : e->total_duration;
+}
+
 void trace_diff_compute(const trace_data_t* td_baseline,
                         const trace_data_t* td_target, string_view_t group_by,
                         string_view_t sort_by,
@@ -63,59 +51,78 @@ void trace_diff_compute(const trace_data_t* td_baseline,
   trace_aggregate_compute(td_baseline, group_by, SV(""), &agg_baseline, a);
   trace_aggregate_compute(td_target, group_by, SV(""), &agg_target, a);
 
-  diff_map_t map = {};
-  hash_table_init(&map, hash_string_view, eq_string_view, nullptr);
+  trace_diff_compute_from_aggregates(
+      td_baseline, &agg_baseline, td_target, &agg_target, sort_by,
+      TRACE_AGGREGATE_METRIC_TOTAL, out_entries, a);
+
+  darray_deinit(&agg_baseline, a);
+  darray_deinit(&agg_target, a);
+}
+
+void trace_diff_compute_from_aggregates(
+    const trace_data_t* td_baseline,
+    const darray_trace_aggregate_entry_t* agg_baseline,
+    const trace_data_t* td_target,
+    const darray_trace_aggregate_entry_t* agg_target, string_view_t sort_by,
+    trace_aggregate_metric_t metric, darray_trace_diff_entry_t* out_entries,
+    allocator_t* a) {
+  if (!td_baseline || !td_target || !out_entries) {
+    return;
+  }
+
+  // Keys are matched by ref: target keys are translated into the baseline's
+  // string pool, and `slots[baseline_ref]` is 1 + the index of that key's entry
+  // in `out_entries`, or 0.
+  size_t first = out_entries->len;
+  darray_uint32_t slots = {};
+  darray_resize(&slots, td_baseline->string_table.len + 1, a);
+  for (size_t i = 0; i < slots.len; i++) {
+    slots.ptr[i] = 0;
+  }
 
   // Populate baseline
-  trace_aggregate_entry_t* base_ptr = agg_baseline.ptr;
-  for (size_t i = 0; i < agg_baseline.len; i++) {
+  trace_aggregate_entry_t* base_ptr = agg_baseline->ptr;
+  for (size_t i = 0; i < agg_baseline->len; i++) {
     const trace_aggregate_entry_t* e = &base_ptr[i];
-    string_view_t name = trace_data_get_string(td_baseline, e->key_ref);
     trace_diff_entry_t entry = {
-        .key = name,
-        .baseline_duration = e->total_duration,
+        .key = trace_data_get_string(td_baseline, e->key_ref),
+        .baseline_duration = trace_diff_duration(e, metric),
         .baseline_count = e->count,
-        .target_duration = 0.0,
-        .target_count = 0,
-        .delta_duration = 0.0,
-        .delta_count = 0,
     };
-    hash_table_put(&map, &name, entry, a);
+    darray_push(out_entries, entry, a);
+    slots.ptr[e->key_ref] = (uint32_t)(out_entries->len - first);
   }
 
   // Populate target
-  trace_aggregate_entry_t* target_ptr = agg_target.ptr;
-  for (size_t i = 0; i < agg_target.len; i++) {
+  trace_aggregate_entry_t* target_ptr = agg_target->ptr;
+  for (size_t i = 0; i < agg_target->len; i++) {
     const trace_aggregate_entry_t* e = &target_ptr[i];
-    string_view_t name = trace_data_get_string(td_target, e->key_ref);
-    trace_diff_entry_t* entry = hash_table_get(&map, &name);
-    if (entry) {
-      entry->target_duration = e->total_duration;
+    string_ref_t baseline_ref =
+        trace_data_translate_string(td_target, e->key_ref, td_baseline);
+    // Ref 0 (no key) exists in every trace; other refs translate to 0 only
+    // when the baseline lacks the string.
+    bool in_baseline = e->key_ref == 0 || baseline_ref != 0;
+    uint32_t slot = in_baseline ? slots.ptr[baseline_ref] : 0;
+    if (slot != 0) {
+      trace_diff_entry_t* entry = &out_entries->ptr[first + slot - 1];
+      entry->target_duration = trace_diff_duration(e, metric);
       entry->target_count = e->count;
     } else {
-      trace_diff_entry_t new_entry = {
-          .key = name,
-          .baseline_duration = 0.0,
-          .baseline_count = 0,
-          .target_duration = e->total_duration,
+      trace_diff_entry_t entry = {
+          .key = trace_data_get_string(td_target, e->key_ref),
+          .target_duration = trace_diff_duration(e, metric),
           .target_count = e->count,
-          .delta_duration = 0.0,
-          .delta_count = 0,
       };
-      hash_table_put(&map, &name, new_entry, a);
+      darray_push(out_entries, entry, a);
     }
   }
+  darray_deinit(&slots, a);
 
-  // Collect and calculate deltas
-  if (map.capacity > 0) {
-    for (size_t i = 0; i < map.capacity; i++) {
-      if (map.entries[i].occupied) {
-        trace_diff_entry_t* e = &map.entries[i].value;
-        e->delta_duration = e->target_duration - e->baseline_duration;
-        e->delta_count = (int64_t)e->target_count - (int64_t)e->baseline_count;
-        darray_push(out_entries, *e, a);
-      }
-    }
+  // Calculate deltas
+  for (size_t i = first; i < out_entries->len; i++) {
+    trace_diff_entry_t* e = &out_entries->ptr[i];
+    e->delta_duration = e->target_duration - e->baseline_duration;
+    e->delta_count = (int64_t)e->target_count - (int64_t)e->baseline_count;
   }
 
   // Sort
@@ -128,8 +135,4 @@ void trace_diff_compute(const trace_data_t* td_baseline,
             compare_diff_duration);
     }
   }
-
-  hash_table_deinit(&map, a);
-  darray_deinit(&agg_baseline, a);
-  darray_deinit(&agg_target, a);
 }
@@ -6,6 +6,7 @@
 
 #include "core/darray.h"
 #include "core/string.h"
+#include "src/trace_aggregate.h"
 #include "src/trace_data.h"
 
 typedef struct trace_diff_entry {
@@ -39,6 +40,17 @@ void trace_diff_compute(const trace_data_t* td_baseline,
                         darray_trace_diff_entry_t* out_entries,
                         allocator_t* a);
 
+// Same as trace_diff_compute, for aggregates the caller already computed
+// (grouped the same way), e.g. for both traces in parallel. Durations are the
+// aggregates' total or self durations, per `metric`.
+void trace_diff_compute_from_aggregates(
+    const trace_data_t* td_baseline,
+    const darray_trace_aggregate_entry_t* agg_baseline,
+    const trace_data_t* td_target,
+    const darray_trace_aggregate_entry_t* agg_target, string_view_t sort_by,
+    trace_aggregate_metric_t metric, darray_trace_diff_entry_t* out_entries,
+    allocator_t* a);
+
 #ifdef __cplusplus
 }
 #endif
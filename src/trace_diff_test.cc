@@ -58,3 +58,69 @@ TEST(trace_diff_test, basic) {
   trace_data_release(td_base, a);
   trace_data_release(td_target, a);
 }
+
+TEST(trace_diff_test, from_aggregates_sorts_by_count_delta) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td_base = trace_data_create(a);
+  trace_data_t* td_target = trace_data_create(a);
+
+  add_event(td_base, a, "task1", 100);
+  add_event(td_target, a, "task1", 100);
+  add_event(td_target, a, "task2", 10);
+  add_event(td_target, a, "task2", 10);
+
+  darray_trace_aggregate_entry_t agg_base = {};
+  darray_trace_aggregate_entry_t agg_target = {};
+  trace_aggregate_compute(td_base, SV("name"), SV(""), &agg_base, a);
+  trace_aggregate_compute(td_target, SV("name"), SV(""), &agg_target, a);
+
+  darray_trace_diff_entry_t entries = {};
+  trace_diff_compute_from_aggregates(td_base, &agg_base, td_target,
+                                     &agg_target, SV("count-delta"),
+                                     TRACE_AGGREGATE_METRIC_TOTAL, &entries, a);
+
+  ASSERT_EQ(entries.len, 2u);
+  EXPECT_EQ(entries.ptr[0].key, "task2");
+  EXPECT_EQ(entries.ptr[0].delta_count, 2);
+  EXPECT_EQ(entries.ptr[1].key, "task1");
+  EXPECT_EQ(entries.ptr[1].delta_count, 0);
+
+  darray_deinit(&entries, a);
+  darray_deinit(&agg_base, a);
+  darray_deinit(&agg_target, a);
+  trace_data_release(td_base, a);
+  trace_data_release(td_target, a);
+}
+
+TEST(trace_diff_test, matches_keys_across_string_pools) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td_base = trace_data_create(a);
+  trace_data_t* td_target = trace_data_create(a);
+
+  // Interned in a different order, so the refs differ between the traces.
+  trace_data_push_string(td_target, SV("unrelated"), a);
+  add_event(td_base, a, "task1", 100);
+  add_event(td_target, a, "task2", 10);
+  add_event(td_target, a, "task1", 300);
+
+  // Events without a category share the empty key.
+  darray_trace_diff_entry_t entries = {};
+  trace_diff_compute(td_base, td_target, SV("category"), SV("dur-delta"),
+                     &entries, a);
+  ASSERT_EQ(entries.len, 1u);
+  EXPECT_EQ(entries.ptr[0].baseline_count, 1u);
+  EXPECT_EQ(entries.ptr[0].target_count, 2u);
+  darray_clear(&entries);
+
+  trace_diff_compute(td_base, td_target, SV("name"), SV("dur-delta"),
+                     &entries, a);
+  ASSERT_EQ(entries.len, 2u);
+  EXPECT_EQ(entries.ptr[0].key, "task1");
+  EXPECT_EQ(entries.ptr[0].delta_duration, 200.0);
+  EXPECT_EQ(entries.ptr[1].key, "task2");
+  EXPECT_EQ(entries.ptr[1].baseline_count, 0u);
+
+  darray_deinit(&entries, a);
+  trace_data_release(td_base, a);
+  trace_data_release(td_target, a);
+}
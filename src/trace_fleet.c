@@ -0,0 +1,129 @@
+#include "src/trace_fleet.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void trace_fleet_init(trace_fleet_t* fleet, allocator_t* a) {
+  *fleet = (trace_fleet_t){.strings = trace_data_create(a)};
+  // Slot for ref 0, the empty key.
+  trace_fleet_key_t empty = {};
+  darray_push(&fleet->keys, empty, a);
+}
+
+void trace_fleet_deinit(trace_fleet_t* fleet, allocator_t* a) {
+  trace_fleet_key_t* keys = fleet->keys.ptr;
+  for (size_t i = 0; i < fleet->keys.len; i++) {
+    darray_deinit(&keys[i].trace_durations, a);
+  }
+  darray_deinit(&fleet->keys, a);
+  trace_data_release(fleet->strings, a);
+  *fleet = (trace_fleet_t){};
+}
+
+void trace_fleet_add(trace_fleet_t* fleet, const trace_data_t* td,
+                     const darray_trace_aggregate_entry_t* entries,
+                     allocator_t* a) {
+  const trace_aggregate_entry_t* entries_ptr = entries->ptr;
+  for (size_t i = 0; i < entries->len; i++) {
+    const trace_aggregate_entry_t* e = &entries_ptr[i];
+    string_ref_t ref = trace_data_push_string(
+        fleet->strings, trace_data_get_string(td, e->key_ref), a);
+    if (ref == fleet->keys.len) {
+      trace_fleet_key_t key = {};
+      darray_push(&fleet->keys, key, a);
+    }
+    trace_fleet_key_t* key = &fleet->keys.ptr[ref];
+    key->trace_count++;
+    key->event_count += e->count;
+    key->total_duration += e->total_duration;
+    darray_push(&key->trace_durations, e->total_duration, a);
+  }
+  fleet->trace_count++;
+}
+
+static int compare_double(const void* a_ptr, const void* b_ptr) {
+  double a = *(const double*)a_ptr;
+  double b = *(const double*)b_ptr;
+  return (a > b) - (a < b);
+}
+
+// Nearest-rank percentile of sorted `values`; `p` is in (0, 1].
+static double sorted_percentile(const double* values, size_t count, double p) {
+  size_t rank = (size_t)ceil(p * (double)count);
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+static int compare_keys(const trace_fleet_entry_t* a,
+                        const trace_fleet_entry_t* b) {
+  size_t min_len = a->key.len < b->key.len ? a->key.len : b->key.len;
+  int cmp = min_len > 0 ? memcmp(a->key.ptr, b->key.ptr, min_len) : 0;
+  if (cmp == 0) {
+    cmp = (a->key.len > b->key.len) - (a->key.len < b->key.len);
+  }
+  return cmp;
+}
+
+static int compare_fleet_duration(const void* a_ptr, const void* b_ptr) {
+  const trace_fleet_entry_t* a = (const trace_fleet_entry_t*)a_ptr;
+  const trace_fleet_entry_t* b = (const trace_fleet_entry_t*)b_ptr;
+  if (a->total_duration > b->total_duration) return -1;
+  if (a->total_duration < b->total_duration) return 1;
+  return compare_keys(a, b);
+}
+
+static int compare_fleet_count(const void* a_ptr, const void* b_ptr) {
+  const trace_fleet_entry_t* a = (const trace_fleet_entry_t*)a_ptr;
+  const trace_fleet_entry_t* b = (const trace_fleet_entry_t*)b_ptr;
+  if (a->event_count > b->event_count) return -1;
+  if (a->event_count < b->event_count) return 1;
+  return compare_keys(a, b);
+}
+
+static int compare_fleet_p95(const void* a_ptr, const void* b_ptr) {
+  const trace_fleet_entry_t* a = (const trace_fleet_entry_t*)a_ptr;
+  const trace_fleet_entry_t* b = (const trace_fleet_entry_t*)b_ptr;
+  if (a->p95_duration > b->p95_duration) return -1;
+  if (a->p95_duration < b->p95_duration) return 1;
+  return compare_keys(a, b);
+}
+
+void trace_fleet_compute(const trace_fleet_t* fleet, string_view_t sort_by,
+                         darray_trace_fleet_entry_t* out_entries,
+                         allocator_t* a) {
+  darray_double_t sorted = {};
+  const trace_fleet_key_t* keys = fleet->keys.ptr;
+  for (size_t i = 0; i < fleet->keys.len; i++) {
+    const trace_fleet_key_t* key = &keys[i];
+    if (key->trace_count == 0) {
+      continue;
+    }
+    darray_clear(&sorted);
+    darray_push_n(&sorted, key->trace_durations.ptr, key->trace_durations.len,
+                  a);
+    qsort(sorted.ptr, sorted.len, sizeof(double), compare_double);
+
+    trace_fleet_entry_t entry = {
+        .key = trace_data_get_string(fleet->strings, (string_ref_t)i),
+        .trace_count = key->trace_count,
+        .event_count = key->event_count,
+        .total_duration = key->total_duration,
+        .mean_duration = key->total_duration / (double)key->trace_count,
+        .p50_duration = sorted_percentile(sorted.ptr, sorted.len, 0.5),
+        .p95_duration = sorted_percentile(sorted.ptr, sorted.len, 0.95),
+    };
+    darray_push(out_entries, entry, a);
+  }
+  darray_deinit(&sorted, a);
+
+  if (out_entries->len > 0) {
+    int (*compare)(const void*, const void*) = compare_fleet_duration;
+    if (string_view_eq(sort_by, SV("count"))) {
+      compare = compare_fleet_count;
+    } else if (string_view_eq(sort_by, SV("p95"))) {
+      compare = compare_fleet_p95;
+    }
+    qsort(out_entries->ptr, out_entries->len, sizeof(trace_fleet_entry_t),
+          compare);
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef SRC_TRACE_FLEET_H
+#define SRC_TRACE_FLEET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+#include "core/string.h"
+#include "src/trace_aggregate.h"
+#include "src/trace_data.h"
+
+// Per-key statistics merged from many traces.
+typedef struct trace_fleet_key {
+  // Number of traces that contain the key
+  size_t trace_count;
+  // Events across all traces
+  size_t event_count;
+  double total_duration;
+  // The key's total duration in each trace that contains it
+  darray_double_t trace_durations;
+} trace_fleet_key_t;
+
+// Aggregates of many traces, merged one trace at a time so only the merged
+// keys stay resident, not the traces.
+typedef struct trace_fleet {
+  // Owns the key strings. Only keys are interned, so a key's ref is also its
+  // index in `keys` (ref 0 is the empty key).
+  trace_data_t* strings;
+  darray_t(trace_fleet_key_t) keys;
+  size_t trace_count;
+} trace_fleet_t;
+
+typedef struct trace_fleet_entry {
+  string_view_t key;
+  size_t trace_count;
+  size_t event_count;
+  double total_duration;
+  // Distribution of the per-trace total duration, over the traces that
+  // contain the key.
+  double mean_duration;
+  double p50_duration;
+  double p95_duration;
+} trace_fleet_entry_t;
+
+typedef darray_t(trace_fleet_entry_t) darray_trace_fleet_entry_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void trace_fleet_init(trace_fleet_t* fleet, allocator_t* a);
+void trace_fleet_deinit(trace_fleet_t* fleet, allocator_t* a);
+
+// Merges the aggregate of one trace, as computed by trace_aggregate_compute
+// or trace_aggregate_compute_tracks.
+// Key strings are copied, so `td` can be released right after.
+void trace_fleet_add(trace_fleet_t* fleet, const trace_data_t* td,
+                     const darray_trace_aggregate_entry_t* entries,
+                     allocator_t* a);
+
+// Computes the per-key distributions.
+//
+// Arguments:
+// - fleet: The merged aggregates.
+// - sort_by: "duration", "count" or "p95".
+// - out_entries: Output darray to be populated with sorted entries. Keys
+//   point into `fleet` and stay valid until it is deinitialized.
+// - a: Allocator.
+void trace_fleet_compute(const trace_fleet_t* fleet, string_view_t sort_by,
+                         darray_trace_fleet_entry_t* out_entries,
+                         allocator_t* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SRC_TRACE_FLEET_H
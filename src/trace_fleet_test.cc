@@ -0,0 +1,73 @@
+#include "src/trace_fleet.h"
+#include <gtest/gtest.h>
+#include "core/allocator.h"
+#include "src/trace_data.h"
+
+static void add_event(trace_data_t* td, allocator_t* a, const char* name,
+                      int64_t dur) {
+  trace_event_t e = {};
+  e.ph = "X";
+  e.pid = 1;
+  e.tid = 1;
+  e.name = name;
+  e.ts = 1000;
+  e.dur = dur;
+  trace_event_matcher_t matcher = {};
+  trace_data_add_event(td, &e, &matcher, a);
+  trace_event_matcher_deinit(&matcher);
+}
+
+// Aggregates `td` by name, merges it into `fleet` and releases it.
+static void add_trace(trace_fleet_t* fleet, trace_data_t* td, allocator_t* a) {
+  darray_trace_aggregate_entry_t entries = {};
+  trace_aggregate_compute(td, SV("name"), SV(""), &entries, a);
+  trace_fleet_add(fleet, td, &entries, a);
+  darray_deinit(&entries, a);
+  trace_data_release(td, a);
+}
+
+TEST(trace_fleet_test, merges_per_trace_distributions) {
+  allocator_t* a = c_allocator();
+  trace_fleet_t fleet;
+  trace_fleet_init(&fleet, a);
+
+  // "build" takes 100, 200, ..., 1000 in ten traces; "link" is only in the
+  // last two, twice each.
+  for (int i = 1; i <= 10; i++) {
+    trace_data_t* td = trace_data_create(a);
+    if (i > 8) {
+      add_event(td, a, "link", 5);
+      add_event(td, a, "link", 5);
+    }
+    add_event(td, a, "build", 100 * i);
+    add_trace(&fleet, td, a);
+  }
+  EXPECT_EQ(fleet.trace_count, 10u);
+
+  darray_trace_fleet_entry_t entries = {};
+  trace_fleet_compute(&fleet, SV("duration"), &entries, a);
+  ASSERT_EQ(entries.len, 2u);
+
+  const trace_fleet_entry_t* build = &entries.ptr[0];
+  EXPECT_EQ(build->key, "build");
+  EXPECT_EQ(build->trace_count, 10u);
+  EXPECT_EQ(build->event_count, 10u);
+  EXPECT_DOUBLE_EQ(build->total_duration, 5500.0);
+  EXPECT_DOUBLE_EQ(build->mean_duration, 550.0);
+  EXPECT_DOUBLE_EQ(build->p50_duration, 500.0);
+  EXPECT_DOUBLE_EQ(build->p95_duration, 1000.0);
+
+  const trace_fleet_entry_t* link = &entries.ptr[1];
+  EXPECT_EQ(link->key, "link");
+  EXPECT_EQ(link->trace_count, 2u);
+  EXPECT_EQ(link->event_count, 4u);
+  EXPECT_DOUBLE_EQ(link->mean_duration, 10.0);
+
+  darray_clear(&entries);
+  trace_fleet_compute(&fleet, SV("count"), &entries, a);
+  ASSERT_EQ(entries.len, 2u);
+  EXPECT_EQ(entries.ptr[0].key, "build");
+
+  darray_deinit(&entries, a);
+  trace_fleet_deinit(&fleet, a);
+}
@@ -3,16 +3,22 @@
 #include <math.h>
 #include <stdbool.h>
 
+#include "core/quantile_sketch.h"
+
 // Computes the linear or logarithmic duration distribution histogram for a set
 // of event indices.
 void trace_histogram_compute(const darray_int64_t* results,
                              const trace_data_t* td,
-                             trace_histogram_t* out_histogram) {
+                             trace_histogram_t* out_histogram, allocator_t* a) {
   if (results && td && out_histogram) {
     out_histogram->num_buckets = 0;
     out_histogram->max_bucket_count = 0;
     out_histogram->total_count = (uint32_t)results->len;
     out_histogram->has_non_zero_durations = false;
+    out_histogram->p50_dur = 0.0;
+    out_histogram->p90_dur = 0.0;
+    out_histogram->p99_dur = 0.0;
+    out_histogram->max_dur = 0.0;
 
     const int64_t* results_ptr = results->ptr;
     const trace_event_persisted_t* events_ptr = td->events.ptr;
@@ -21,6 +27,7 @@ void trace_histogram_compute(const darray_int64_t* results,
       int64_t min_dur = -1;
       int64_t max_dur = -1;
       uint32_t zero_count = 0;
+      quantile_sketch_t sketch = {};
 
       // 1. Scan durations of selected events
       for (size_t i = 0; i < results->len; i++) {
@@ -28,6 +35,7 @@ void trace_histogram_compute(const darray_int64_t* results,
         if (idx >= td->events.len) continue;
         const trace_event_persisted_t* e = &events_ptr[idx];
         int64_t d = e->dur;
+        quantile_sketch_add(&sketch, d > 0 ? (double)d : 0.0, a);
 
         if (d <= 0) {
           zero_count++;
@@ -37,6 +45,12 @@ void trace_histogram_compute(const darray_int64_t* results,
         }
       }
 
+      out_histogram->p50_dur = quantile_sketch_quantile(&sketch, 0.5);
+      out_histogram->p90_dur = quantile_sketch_quantile(&sketch, 0.9);
+      out_histogram->p99_dur = quantile_sketch_quantile(&sketch, 0.99);
+      out_histogram->max_dur = sketch.count > 0 ? sketch.max : 0.0;
+      quantile_sketch_deinit(&sketch, a);
+
       int k_bins = 20;
 
       // 2. Initialize bucket 0 for zero-duration events if present
@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/allocator.h"
 #include "core/darray.h"
 #include "src/trace_data.h"
 
@@ -21,6 +22,12 @@ typedef struct trace_histogram {
   uint32_t max_bucket_count;
   uint32_t total_count;
   bool has_non_zero_durations;
+  // Duration percentiles of the events, estimated with a quantile sketch so
+  // large sets need no sort (max is exact).
+  double p50_dur;
+  double p90_dur;
+  double p99_dur;
+  double max_dur;
 } trace_histogram_t;
 
 #ifdef __cplusplus
@@ -34,9 +41,10 @@ extern "C" {
 // - results: The darray_int64_t of int64_t event indices.
 // - td: The trace_data_t storage.
 // - out_histogram: The trace_histogram_t output to populate.
+// - a: Allocator for scratch memory.
 void trace_histogram_compute(const darray_int64_t* results,
                              const trace_data_t* td,
-                             trace_histogram_t* out_histogram);
+                             trace_histogram_t* out_histogram, allocator_t* a);
 
 #ifdef __cplusplus
 }
@@ -54,10 +54,13 @@ TEST_F(trace_histogram_test, compute_histogram) {
   darray_push(&selected_indices, (int64_t)2, allocator_);
 
   trace_histogram_t h = {};
-  trace_histogram_compute(&selected_indices, td_, &h);
+  trace_histogram_compute(&selected_indices, td_, &h, allocator_);
 
   EXPECT_GE(h.num_buckets, 2);
   EXPECT_TRUE(h.has_non_zero_durations);
+  EXPECT_NEAR(h.p50_dur, 50.0, 0.5);
+  EXPECT_NEAR(h.p99_dur, 50.0, 0.5);
+  EXPECT_EQ(h.max_dur, 5000.0);
 
   // Verify Zero-Duration bucket counts correctly
   EXPECT_EQ(h.buckets[0].min_dur, 0);
@@ -70,7 +73,7 @@ TEST_F(trace_histogram_test, compute_histogram) {
 TEST_F(trace_histogram_test, compute_histogram_empty_results) {
   darray_int64_t empty_results = {};
   trace_histogram_t h = {};
-  trace_histogram_compute(&empty_results, td_, &h);
+  trace_histogram_compute(&empty_results, td_, &h, allocator_);
 
   EXPECT_EQ(h.num_buckets, 0);
   EXPECT_EQ(h.total_count, 0u);
@@ -92,7 +95,7 @@ TEST_F(trace_histogram_test, compute_histogram_linear_vs_logarithmic) {
   darray_push(&linear_results, 2, allocator_);
 
   trace_histogram_t h_linear = {};
-  trace_histogram_compute(&linear_results, td_, &h_linear);
+  trace_histogram_compute(&linear_results, td_, &h_linear, allocator_);
 
   // The buckets should be linearly spaced.
   // Linear check: Bucket widths should be roughly equal (except rounding).
@@ -114,7 +117,7 @@ TEST_F(trace_histogram_test, compute_histogram_linear_vs_logarithmic) {
   darray_push(&log_results, 5, allocator_);
 
   trace_histogram_t h_log = {};
-  trace_histogram_compute(&log_results, td_, &h_log);
+  trace_histogram_compute(&log_results, td_, &h_log, allocator_);
 
   // The buckets should be exponentially spaced (logarithmic).
   // Bucket widths must increase drastically!
@@ -140,7 +143,7 @@ TEST_F(trace_histogram_test, compute_histogram_narrow_range_bin_clamping) {
   darray_push(&results, 1, allocator_);
 
   trace_histogram_t h = {};
-  trace_histogram_compute(&results, td_, &h);
+  trace_histogram_compute(&results, td_, &h, allocator_);
 
   // Since range is 3, bins should be clamped to range + 1 = 4 buckets!
   EXPECT_EQ(h.num_buckets, 4);
@@ -157,7 +160,7 @@ TEST_F(trace_histogram_test, compute_histogram_invalid_index_ignored) {
 
   trace_histogram_t h = {};
   // Should exit cleanly without crashing
-  trace_histogram_compute(&results, td_, &h);
+  trace_histogram_compute(&results, td_, &h, allocator_);
 
   EXPECT_EQ(h.num_buckets, 0);
   EXPECT_EQ(h.total_count,
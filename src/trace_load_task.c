@@ -1,8 +1,10 @@
 #include "src/trace_load_task.h"
 
 #include <stdatomic.h>
+#include <stdlib.h>
 
 #include "core/assert.h"
+#include "core/self_trace.h"
 #include "src/platform.h"
 #include "src/track.h"
 
@@ -16,6 +18,8 @@ struct trace_load_task {
   trace_parser_t parser;
   trace_data_t* td;
   trace_event_matcher_t matcher;
+  // Assigns parsed events to tracks chunk by chunk
+  track_builder_t* track_builder;
 
   // Progress tracking
   size_t total_discarded_bytes;
@@ -31,8 +35,112 @@ struct trace_load_task {
       start_time;  // Wall-clock start time of the loading session (UI thread)
   _Atomic uint64_t active_parse_time_ns;  // Total accumulated active parsing
                                           // duration in nanoseconds
+
+  // Optional per-phase profile (worker-side fields only)
+  trace_load_profile_t* profile;
+
+  // Snapshot schedule (worker thread only after the first chunk)
+  size_t snapshot_interval;
+  size_t chunks_since_snapshot;
+  // What the snapshots so far carried of td
+  trace_data_extent_t published;
+  // Begin events that were still open at the previous snapshot
+  darray_t(size_t) open_events;
 };
 
+static int size_compare(const void* a, const void* b) {
+  size_t x = *(const size_t*)a;
+  size_t y = *(const size_t*)b;
+  return (x > y) - (x < y);
+}
+
+static bool snapshot_is_due(trace_load_task_t* task) {
+  bool due = false;
+  if (task->snapshot_interval > 0) {
+    task->chunks_since_snapshot++;
+    size_t event_count = task->td->events.len;
+    due = task->chunks_since_snapshot >= task->snapshot_interval &&
+          event_count > 0 &&
+          event_count >= TRACE_LOAD_SNAPSHOT_GROWTH * task->published.events;
+  }
+  return due;
+}
+
+// Hands over what was parsed since the previous snapshot: the new part of td,
+// the begin events that ended since, and the tracks that changed.
+static void take_snapshot(trace_load_task_t* task,
+                          trace_load_task_chunk_t* payload) {
+  SELF_TRACE_BEGIN("trace_load_snapshot");
+  allocator_t* a = task->allocator;
+  trace_load_snapshot_t* snapshot = (trace_load_snapshot_t*)allocator_alloc(
+      a, sizeof(trace_load_snapshot_t));
+  *snapshot = (trace_load_snapshot_t){};
+
+  // Begin events that were open at the previous snapshot and have ended since
+  // are handed over again, with their duration.
+  darray_t(size_t) open_events = {};
+  const active_b_events_map_t* open = &task->matcher.active_b_events;
+  for (size_t i = 0; i < open->capacity; i++) {
+    if (open->entries[i].occupied) {
+      const thread_stack_t* stack = &open->entries[i].value;
+      for (size_t k = 0; k < stack->stack.len; k++) {
+        darray_push(&open_events, stack->stack.ptr[k].event_idx, a);
+      }
+    }
+  }
+  qsort(open_events.ptr, open_events.len, sizeof(size_t), size_compare);
+  darray_t(size_t) ended_events = {};
+  for (size_t i = 0; i < task->open_events.len; i++) {
+    size_t event_idx = task->open_events.ptr[i];
+    if (bsearch(&event_idx, open_events.ptr, open_events.len, sizeof(size_t),
+                size_compare) == nullptr) {
+      darray_push(&ended_events, event_idx, a);
+    }
+  }
+  trace_data_delta_capture(&snapshot->data, task->td, task->published,
+                           ended_events.ptr, ended_events.len, a);
+  darray_clear(&task->open_events);
+  darray_push_n(&task->open_events, open_events.ptr, open_events.len, a);
+  darray_deinit(&ended_events, a);
+  darray_deinit(&open_events, a);
+
+  track_builder_publish(task->track_builder, task->td,
+                        snapshot->data.updates.ptr, snapshot->data.updates.len,
+                        &snapshot->tracks, a);
+  payload->snapshot = snapshot;
+  task->chunks_since_snapshot = 0;
+  task->published = trace_data_get_extent(task->td);
+  SELF_TRACE_END();
+}
+
+// Parses all available events, attributing time to tokenization, event
+// persistence and B/E matching. Only used when a profile is attached, since
+// it reads the clock twice per event.
+static void parse_events_profiled(trace_load_task_t* task) {
+  trace_load_profile_t* profile = task->profile;
+  trace_event_t event;
+  double t0 = platform_get_now();
+  bool has_event = trace_parser_next(&task->parser, &event, task->allocator);
+  while (has_event) {
+    double t1 = platform_get_now();
+    profile->parse_ms += t1 - t0;
+
+    trace_data_add_event(task->td, &event, &task->matcher, task->allocator);
+    double t2 = platform_get_now();
+    bool is_end = event.ph.len == 1 &&
+                  (event.ph.ptr[0] == 'E' || event.ph.ptr[0] == 'e');
+    if (is_end) {
+      profile->match_ms += t2 - t1;
+    } else {
+      profile->intern_ms += t2 - t1;
+    }
+
+    t0 = t2;
+    has_event = trace_parser_next(&task->parser, &event, task->allocator);
+  }
+  profile->parse_ms += platform_get_now() - t0;
+}
+
 // Background worker task (forward declared in header)
 void trace_load_task_run(task_context_t* ctx) {
   trace_load_task_chunk_t* payload = (trace_load_task_chunk_t*)ctx->user_data;
@@ -53,14 +161,35 @@ void trace_load_task_run(task_context_t* ctx) {
   }
 
   // 2. Feed the raw chunk to the streaming parser
+  SELF_TRACE_BEGIN("parse_chunk");
   task->total_discarded_bytes +=
       trace_parser_feed(&task->parser, payload->data, payload->size,
                         payload->is_eof, task->allocator);
+  if (task->profile) {
+    task->profile->parse_ms += platform_get_now() - chunk_start_time;
+  }
 
   // 3. Parse all available events in this chunk
-  trace_event_t event;
-  while (trace_parser_next(&task->parser, &event, task->allocator)) {
-    trace_data_add_event(task->td, &event, &task->matcher, task->allocator);
+  if (task->profile) {
+    parse_events_profiled(task);
+  } else {
+    trace_event_t event;
+    while (trace_parser_next(&task->parser, &event, task->allocator)) {
+      trace_data_add_event(task->td, &event, &task->matcher, task->allocator);
+    }
+  }
+  SELF_TRACE_END();
+
+  // 3b. Assign the new events to their tracks, so EOF only finishes them
+  if (!payload->is_eof) {
+    double discover_start_time = platform_get_now();
+    SELF_TRACE_BEGIN("track_builder_update");
+    track_builder_update(task->track_builder, task->td);
+    SELF_TRACE_END();
+    if (task->profile) {
+      task->profile->organize.discover_ms +=
+          platform_get_now() - discover_start_time;
+    }
   }
 
   // Decrement buffered bytes since this chunk is parsed and memory is freed
@@ -72,17 +201,21 @@ void trace_load_task_run(task_context_t* ctx) {
 
   // 5. EOF completion handling
   if (payload->is_eof) {
+    double compact_start_time = platform_get_now();
+    SELF_TRACE_BEGIN("trace_data_compact");
     trace_data_compact(task->td, task->allocator);
+    SELF_TRACE_END();
 
     double organize_start_time = platform_get_now();
 
     darray_track_t tracks = {};
     int64_t min_ts = 0;
     int64_t max_ts = 0;
-    // Run track organization pass
+    // Finish the tracks built while parsing
     allocator_t* scratch_allocator = arena_get_allocator(ctx->arena);
-    track_organize(task->td, &tracks, &min_ts, &max_ts, task->allocator,
-                   scratch_allocator);
+    track_builder_finish(task->track_builder, task->td, &tracks, &min_ts,
+                         &max_ts, scratch_allocator,
+                         task->profile ? &task->profile->organize : nullptr);
     double organize_duration_ms = platform_get_now() - organize_start_time;
 
     double size_mb = (double)(task->total_discarded_bytes + task->parser.pos) /
@@ -125,6 +258,13 @@ void trace_load_task_run(task_context_t* ctx) {
     payload->stats.total_duration_ms = total_duration_ms;
     payload->stats.ready = true;
 
+    if (task->profile) {
+      task->profile->compact_ms += organize_start_time - compact_start_time;
+      task->profile->organize_ms += organize_duration_ms;
+      task->profile->starvation_ms += starvation_ms;
+      task->profile->event_count = task->td->events.len;
+    }
+
     // Transfer ownership of parsed trace data and tracks to payload for
     // adoption
     payload->completed_td = task->td;
@@ -135,6 +275,10 @@ void trace_load_task_run(task_context_t* ctx) {
     // Clear task pointer to prevent double-free during task destruction
     task->td = nullptr;
   } else {
+    if (snapshot_is_due(task)) {
+      take_snapshot(task, payload);
+    }
+
     // Accumulate active chunk parsing time
     double chunk_duration_ms = platform_get_now() - chunk_start_time;
     atomic_fetch_add(&task->active_parse_time_ns,
@@ -155,6 +299,9 @@ static void trace_load_task_destroy(trace_load_task_t* task) {
   // Free matcher
   trace_event_matcher_deinit(&task->matcher);
 
+  track_builder_destroy(task->track_builder);
+  darray_deinit(&task->open_events, task->allocator);
+
   // Free the context structure itself
   allocator_free(task->allocator, task, sizeof(trace_load_task_t));
 }
@@ -184,10 +331,37 @@ trace_load_task_t* trace_load_task_create(task_queue_t* queue,
   // Initialize streaming trace data storage (parser and matcher are
   // ZII-initialized)
   task->td = trace_data_create(allocator);
+  task->track_builder = track_builder_create(allocator);
 
   return task;
 }
 
+void trace_load_task_set_profile(trace_load_task_t* task,
+                                 trace_load_profile_t* profile) {
+  expect(task != nullptr);
+  task->profile = profile;
+}
+
+void trace_load_task_set_snapshot_interval(trace_load_task_t* task,
+                                           size_t interval_chunks) {
+  expect(task != nullptr);
+  task->snapshot_interval = interval_chunks;
+}
+
+void trace_load_snapshot_destroy(trace_load_snapshot_t* snapshot,
+                                 allocator_t* a) {
+  if (snapshot == nullptr) return;
+  trace_data_delta_deinit(&snapshot->data, a);
+  track_deltas_free(&snapshot->tracks, a);
+  allocator_free(a, snapshot, sizeof(trace_load_snapshot_t));
+}
+
+void trace_load_task_chunk_release_snapshot(trace_load_task_chunk_t* payload,
+                                            allocator_t* a) {
+  trace_load_snapshot_destroy(payload->snapshot, a);
+  payload->snapshot = nullptr;
+}
+
 // Prepares a chunk submission slot (SQE)
 void trace_load_task_prep_chunk(trace_load_task_t* task, task_submission_t* sub,
                                 const char* data, size_t size,
@@ -16,6 +16,39 @@ extern "C" {
 // Forward declaration of the opaque loading task context
 typedef struct trace_load_task trace_load_task_t;
 
+// Per-phase breakdown of a load, in milliseconds. Reader-side phases are
+// filled by the trace loader (see trace_loader_set_profile); worker-side phases
+// by the load task when a profile is attached with
+// trace_load_task_set_profile. Reader and worker phases overlap in wall-clock
+// time.
+typedef struct trace_load_profile {
+  // --- Read task ---
+  double read_ms;          // fread() of raw or compressed input
+  double inflate_ms;       // gzip decompression
+  double backpressure_ms;  // Blocked waiting for the parser to catch up
+  // --- Worker thread ---
+  double parse_ms;   // JSON tokenization (trace_parser_feed/next)
+  double intern_ms;  // Persisting events: string interning and args
+  double match_ms;   // Pairing 'E' events with their open 'B' event
+  double compact_ms;
+  double organize_ms;
+  track_organize_profile_t organize;
+  double starvation_ms;  // Worker idle waiting for input
+  size_t event_count;
+} trace_load_profile_t;
+
+// What a trace that is still loading gained since the previous snapshot of
+// it: the new strings, events and args, and the tracks that changed. Applied
+// in order, the snapshots of a load rebuild the trace and its finished tracks
+// (see track_preview_apply) without copying what earlier ones carried.
+typedef struct trace_load_snapshot {
+  trace_data_delta_t data;
+  darray_track_delta_t tracks;
+} trace_load_snapshot_t;
+
+void trace_load_snapshot_destroy(trace_load_snapshot_t* snapshot,
+                                 allocator_t* a);
+
 // === 1. The Per-Chunk Payload Structure (exposed to UI via CQE user_data) ===
 typedef struct {
   // Opaque parent task context pointer
@@ -42,6 +75,11 @@ typedef struct {
   int64_t completed_min_ts;
   int64_t completed_max_ts;
 
+  // --- Snapshot (written by a non-EOF worker when one is due, see
+  // trace_load_task_set_snapshot_interval; taken over or released by the UI
+  // thread on CQE reap) ---
+  trace_load_snapshot_t* snapshot;
+
   // --- Performance Telemetry (written by EOF worker on success, read by UI
   // thread) ---
   struct {
@@ -56,6 +94,12 @@ typedef struct {
   } stats;
 } trace_load_task_chunk_t;
 
+// A snapshot is only taken once the event count has grown by this factor
+// since the previous one. The UI finishes each track that changed again as a
+// whole, so all snapshots together finish about a third as many events as the
+// final trace has.
+constexpr size_t TRACE_LOAD_SNAPSHOT_GROWTH = 4;
+
 // === 2. Public Loading Task Lifecycle API ===
 
 // Creates a new asynchronous trace loading task context.
@@ -64,6 +108,25 @@ trace_load_task_t* trace_load_task_create(task_queue_t* queue,
                                           task_stream_t stream_id,
                                           allocator_t* allocator);
 
+// Attaches a profile that the worker accumulates its phase timings into. Must
+// be called before the first chunk is submitted; the profile must outlive the
+// load. Profiling times every parsed event, so it adds measurable overhead.
+void trace_load_task_set_profile(trace_load_task_t* task,
+                                 trace_load_profile_t* profile);
+
+// Makes the worker publish a snapshot (see trace_load_task_chunk_t) at most
+// every `interval_chunks` chunks, so the UI can show the trace while the rest
+// of it is parsed. Snapshots are spaced by TRACE_LOAD_SNAPSHOT_GROWTH. 0 (the
+// default) disables snapshots. Must be called before the first chunk is
+// submitted.
+void trace_load_task_set_snapshot_interval(trace_load_task_t* task,
+                                           size_t interval_chunks);
+
+// Frees the snapshot of `payload`, if it has one. For payloads whose snapshot
+// the UI does not take over.
+void trace_load_task_chunk_release_snapshot(trace_load_task_chunk_t* payload,
+                                            allocator_t* a);
+
 // Prepares a chunk submission slot (SQE) for the task queue.
 // Internally copies the transient input 'data' buffer into the task-local
 // arena. sub: The vacant slot obtained from the queue by the caller. task: The
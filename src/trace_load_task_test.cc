@@ -2,6 +2,8 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
+
 #include "core/allocator.h"
 #include "core/counting_allocator.h"
 #include "core/task.h"
@@ -163,3 +165,137 @@ TEST(trace_load_task_test, cancellation_path_cleans_up_without_leaks) {
   // If the cancelled payload or raw buffer leaked, this check will fail!
   EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
 }
+
+TEST(trace_load_task_test, snapshots_are_published_while_loading) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  allocator_t* a = counting_allocator_get_allocator(&ca);
+
+  {
+    task_queue_t* queue = task_queue_create(32, inline_executor, a);
+    trace_load_task_t* task = trace_load_task_create(queue, 1, a);
+    trace_load_task_set_snapshot_interval(task, 1);
+
+    const char* chunks[] = {
+        R"([{"name": "outer", "ph": "B", "ts": 1000, "pid": 1, "tid": 1,)"
+        R"( "args": {"k": "v1"}},)",
+        R"({"name": "a", "ph": "X", "ts": 1100, "dur": 10, "pid": 1, "tid": 1},)",
+        R"({"name": "b", "ph": "X", "ts": 1200, "dur": 10, "pid": 1, "tid": 1},)",
+        R"({"name": "outer", "ph": "E", "ts": 1500, "pid": 1, "tid": 1,)"
+        R"( "args": {"k": "v2"}},)",
+        R"({"name": "c", "ph": "X", "ts": 2000, "dur": 10, "pid": 1, "tid": 2},)",
+        R"({"name": "d", "ph": "X", "ts": 3000, "dur": 10, "pid": 1, "tid": 2}])",
+    };
+    constexpr size_t chunk_count = sizeof(chunks) / sizeof(chunks[0]);
+    // Snapshots need the event count to grow by TRACE_LOAD_SNAPSHOT_GROWTH:
+    // 1 event, then 4, then the final result instead of a snapshot. The
+    // second one ends "outer", which the first published still open.
+    static_assert(TRACE_LOAD_SNAPSHOT_GROWTH == 4);
+    const size_t snapshot_events[] = {1, 0, 0, 0, 3, 0};
+
+    // The UI side: a preview rebuilt from the snapshots alone.
+    trace_data_t* preview_td = trace_data_create(a);
+    track_preview_t* preview = track_preview_create(a);
+    darray_track_t preview_tracks = {};
+    int64_t min_ts = 0, max_ts = 0;
+
+    size_t consumed = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+      bool is_eof = i == chunk_count - 1;
+      size_t len = strlen(chunks[i]);
+      consumed += len;
+      task_submission_t* sub = task_queue_get_submission(queue);
+      ASSERT_NE(sub, nullptr);
+      trace_load_task_prep_chunk(task, sub, chunks[i], len, consumed, is_eof);
+      task_queue_submit(queue);
+
+      task_completion_t cqe;
+      ASSERT_TRUE(task_queue_peek_completion(queue, &cqe));
+      EXPECT_EQ(cqe.status, TASK_STATUS_OK);
+      trace_load_task_chunk_t* payload =
+          (trace_load_task_chunk_t*)cqe.user_data;
+      if (snapshot_events[i] > 0) {
+        trace_load_snapshot_t* snapshot = payload->snapshot;
+        ASSERT_NE(snapshot, nullptr);
+        EXPECT_EQ(snapshot->data.events.len, snapshot_events[i]);
+        EXPECT_EQ(snapshot->data.updates.len, i == 0 ? 0u : 1u);
+        trace_data_delta_apply(preview_td, &snapshot->data, a);
+        track_preview_apply(preview, preview_td, &snapshot->tracks,
+                            &preview_tracks, &min_ts, &max_ts, a);
+        trace_load_task_chunk_release_snapshot(payload, a);
+      } else if (!is_eof) {
+        EXPECT_EQ(payload->snapshot, nullptr);
+      } else {
+        EXPECT_EQ(payload->snapshot, nullptr);
+        trace_data_t* td = payload->completed_td;
+        ASSERT_NE(td, nullptr);
+        EXPECT_EQ(td->events.len, 5u);
+        EXPECT_EQ(payload->completed_tracks.len, 2u);
+
+        // The preview holds the trace as of the second snapshot, with the
+        // duration and args "outer" got from its end event.
+        ASSERT_EQ(preview_td->events.len, 4u);
+        EXPECT_EQ(memcmp(preview_td->events.ptr, td->events.ptr,
+                         4 * sizeof(trace_event_persisted_t)),
+                  0);
+        EXPECT_EQ(preview_td->events.ptr[0].dur, 500);
+        const trace_event_persisted_t* outer = &preview_td->events.ptr[0];
+        ASSERT_LE(outer->args_offset + outer->args_count,
+                  preview_td->args.len);
+        for (uint32_t k = 0; k < outer->args_count; k++) {
+          const trace_arg_persisted_t* x =
+              &preview_td->args.ptr[outer->args_offset + k];
+          const trace_arg_persisted_t* y = &td->args.ptr[outer->args_offset + k];
+          EXPECT_EQ(trace_data_get_string(preview_td, x->key_ref),
+                    trace_data_get_string(td, y->key_ref));
+          EXPECT_EQ(trace_data_get_string(preview_td, x->val_ref),
+                    trace_data_get_string(td, y->val_ref));
+        }
+
+        // Its tracks are the ones organizing it in one go gives.
+        darray_track_t organized = {};
+        int64_t organized_min_ts = 0, organized_max_ts = 0;
+        track_organize(preview_td, &organized, &organized_min_ts,
+                       &organized_max_ts, a, a);
+        EXPECT_EQ(min_ts, organized_min_ts);
+        EXPECT_EQ(max_ts, organized_max_ts);
+        ASSERT_EQ(preview_tracks.len, 2u);
+        ASSERT_EQ(preview_tracks.len, organized.len);
+        for (size_t t = 0; t < organized.len; t++) {
+          const track_t* x = &preview_tracks.ptr[t];
+          const track_t* y = &organized.ptr[t];
+          EXPECT_EQ(x->tid, y->tid);
+          EXPECT_EQ(x->max_depth, y->max_depth);
+          ASSERT_EQ(x->event_indices.len, y->event_indices.len);
+          for (size_t k = 0; k < x->event_indices.len; k++) {
+            EXPECT_EQ(x->event_indices.ptr[k], y->event_indices.ptr[k]);
+            EXPECT_EQ(x->depths.ptr[k], y->depths.ptr[k]);
+          }
+          track_deinit(&organized.ptr[t], a);
+        }
+        darray_deinit(&organized, a);
+        EXPECT_EQ(preview_tracks.ptr[0].max_depth, 1u);
+
+        for (size_t t = 0; t < payload->completed_tracks.len; t++) {
+          track_deinit(&payload->completed_tracks.ptr[t], a);
+        }
+        darray_deinit(&payload->completed_tracks, a);
+        trace_data_release(td, a);
+      }
+      trace_load_task_release(task);  // Release CQE reference
+      task_queue_remove_completion(queue);
+    }
+
+    for (size_t t = 0; t < preview_tracks.len; t++) {
+      track_deinit(&preview_tracks.ptr[t], a);
+    }
+    darray_deinit(&preview_tracks, a);
+    track_preview_destroy(preview);
+    trace_data_release(preview_td, a);
+    trace_load_task_release(task);
+    task_queue_destroy(queue);
+  }
+
+  // Snapshots share no memory with the trace being loaded.
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
+}
@@ -7,6 +7,7 @@
 #include <zlib.h>
 
 #include "core/assert.h"
+#include "core/self_trace.h"
 #include "core/task.h"
 #include "src/platform.h"
 #include "src/trace_load_task.h"
@@ -17,278 +18,352 @@ static const size_t IN_BUF_SIZE = 256 * 1024;  // 256KB compressed buffer
 static const size_t OUT_BUF_SIZE =
     1024 * 1024;  // 1MB decompressed chunk buffer
 
-// Helper to reap a completed chunk completion from the queue.
-// Decrements active reference counts, frees payload data, and adopts the
-// completed trace data (and optionally organized tracks/stats) on EOF.
-static bool reap_completion_sync(task_queue_t* queue, trace_data_t** out_td,
-                                 darray_track_t* out_tracks, int64_t* out_min_ts,
-                                 int64_t* out_max_ts,
-                                 double* out_ingest_duration_ms,
-                                 double* out_organize_duration_ms,
-                                 size_t* out_reaped_count, allocator_t* a) {
-  task_completion_t cqe;
-  if (!task_queue_peek_completion(queue, &cqe)) {
-    return true;
-  }
+struct trace_loader {
+  task_queue_t* queue;
+  trace_load_task_t* load_task;
+  allocator_t* allocator;
+
+  // --- Input (only touched by the read task in flight) ---
+  FILE* file;
+  bool is_gzip;
+  z_stream strm;
+  char* in_buf;
+  bool file_eof;
+  size_t file_bytes_read;
+  double read_ms;
+  double inflate_ms;
+
+  // --- Progress (caller's thread) ---
+  bool reading;     // A read task is in flight
+  bool input_done;  // The EOF chunk has been submitted
+  bool failed;
+  size_t submitted_chunks;
+  size_t reaped_chunks;
+  size_t decompressed_size;
+  // Reads are held back while the parser is behind
+  bool backpressured;
+  double backpressure_start;
+  double backpressure_ms;
+  trace_load_profile_t* profile;
+
+  // --- Result (adopted from the EOF chunk) ---
+  trace_data_t* td;
+  darray_track_t tracks;
+  int64_t min_ts;
+  int64_t max_ts;
+  double ingest_duration_ms;
+  double organize_duration_ms;
+};
+
+// One read task: the next chunk of (decompressed) input, in the task-local
+// arena.
+typedef struct trace_loader_read {
+  trace_loader_t* loader;
+  char* data;
+  size_t size;
+  bool is_eof;
+  bool failed;
+} trace_loader_read_t;
+
+// Reads raw JSON straight into the chunk; a short read ends the input.
+static void read_raw(trace_loader_t* l, trace_loader_read_t* r) {
+  SELF_TRACE_BEGIN("read");
+  double read_start = platform_get_now();
+  r->size = fread(r->data, 1, OUT_BUF_SIZE, l->file);
+  l->read_ms += platform_get_now() - read_start;
+  SELF_TRACE_END();
+  l->file_bytes_read += r->size;
+  r->is_eof = r->size < OUT_BUF_SIZE;
+  r->failed = ferror(l->file) != 0;
+}
 
-  if (out_reaped_count) {
-    (*out_reaped_count)++;
-  }
+// Inflates into the chunk until it is full or the gzip stream ends.
+static void read_gzip(trace_loader_t* l, trace_loader_read_t* r) {
+  z_stream* strm = &l->strm;
+  strm->next_out = (Bytef*)r->data;
+  strm->avail_out = (uInt)OUT_BUF_SIZE;
+  int status = Z_OK;
+  while (strm->avail_out > 0 && status == Z_OK) {
+    if (strm->avail_in == 0 && !l->file_eof) {
+      SELF_TRACE_BEGIN("read");
+      double read_start = platform_get_now();
+      size_t n = fread(l->in_buf, 1, IN_BUF_SIZE, l->file);
+      l->read_ms += platform_get_now() - read_start;
+      SELF_TRACE_END();
+      l->file_bytes_read += n;
+      l->file_eof = n < IN_BUF_SIZE;
+      strm->next_in = (Bytef*)l->in_buf;
+      strm->avail_in = (uInt)n;
+    }
 
-  trace_load_task_chunk_t* payload = (trace_load_task_chunk_t*)cqe.user_data;
-  bool success = (cqe.status == TASK_STATUS_OK);
-
-  if (success) {
-    if (payload->is_eof) {
-      // Adopt the parsed trace data!
-      *out_td = payload->completed_td;
-
-      // Extract background telemetry stats
-      if (out_ingest_duration_ms)
-        *out_ingest_duration_ms = payload->stats.ingestion_duration_ms;
-      if (out_organize_duration_ms)
-        *out_organize_duration_ms = payload->stats.organize_duration_ms;
-
-      // Adopt organized tracks and timestamps if requested
-      if (out_tracks) {
-        *out_tracks = payload->completed_tracks;
-        if (out_min_ts) *out_min_ts = payload->completed_min_ts;
-        if (out_max_ts) *out_max_ts = payload->completed_max_ts;
-        // Clear payload array list to transfer ownership and prevent
-        // deinitialization below
-        payload->completed_tracks = (darray_track_t){};
-      }
+    SELF_TRACE_BEGIN("inflate");
+    double inflate_start = platform_get_now();
+    status = inflate(strm, Z_NO_FLUSH);
+    l->inflate_ms += platform_get_now() - inflate_start;
+    SELF_TRACE_END();
+  }
 
-      // Deinitialize organized tracks if they weren't adopted (fallback path)
-      track_t* tracks_data = payload->completed_tracks.ptr;
-      for (size_t i = 0; i < payload->completed_tracks.len; i++) {
-        track_deinit(&tracks_data[i], a);
-      }
-      darray_deinit(&payload->completed_tracks, a);
-    }
+  r->size = OUT_BUF_SIZE - strm->avail_out;
+  r->is_eof = status == Z_STREAM_END;
+  if (status == Z_BUF_ERROR && l->file_eof) {
+    fprintf(stderr, "Error: Gzip input ends before the end of its stream\n");
+    r->failed = true;
+  } else if (status != Z_OK && status != Z_STREAM_END &&
+             status != Z_BUF_ERROR) {
+    fprintf(stderr, "Error: Gzip decompression failed (code %d)\n", status);
+    r->failed = true;
   }
+}
 
-  // Clean up completion payload resources
-  // Note: payload->data and payload itself are allocated from the task-local
-  // arena and will be automatically reclaimed when task_queue_remove_completion
-  // is called.
-  trace_load_task_t* t = payload->task;
-  trace_load_task_release(t);
-  task_queue_remove_completion(queue);
+// Background read task (stream 0; a loader has at most one in flight, so the
+// input is still read in order).
+static void trace_loader_read_run(task_context_t* ctx) {
+  trace_loader_read_t* r = (trace_loader_read_t*)ctx->user_data;
+  expect(r != nullptr);
+  if (r->loader->is_gzip) {
+    read_gzip(r->loader, r);
+  } else {
+    read_raw(r->loader, r);
+  }
+}
 
-  return success;
+static void trace_loader_fail(trace_loader_t* l) {
+  if (!l->failed) {
+    l->failed = true;
+    trace_load_task_abort(l->load_task);
+  }
 }
 
-// Synchronously loads a Chrome trace file, preferring success path under if and
-// SESE.
-trace_data_t* trace_loader_load_file(const char* filename, allocator_t* a,
-                                     size_t* out_decompressed_size,
-                                     darray_track_t* out_tracks,
-                                     int64_t* out_min_ts, int64_t* out_max_ts,
-                                     double* out_ingest_duration_ms,
-                                     double* out_organize_duration_ms) {
-  trace_data_t* td = nullptr;
+trace_loader_t* trace_loader_create(const char* filename, task_queue_t* queue,
+                                    task_stream_t stream, allocator_t* a) {
+  trace_loader_t* l = nullptr;
   FILE* f = fopen(filename, "rb");
-
   if (f) {
-    // 1. Create a concurrent Task Queue (dispatched to background thread pool)
-    // and Loading Task
-    task_queue_t* queue = task_queue_create(1024, platform_submit_job, a);
-    trace_load_task_t* load_task = trace_load_task_create(queue, 1, a);
-
-    // Read first 2 bytes to check gzip magic
+    // Read first 2 bytes to check gzip magic, then seek back to the start
     unsigned char magic[2];
     size_t magic_read = fread(magic, 1, 2, f);
-
-    // Seek back to the beginning of the file
     fseek(f, 0, SEEK_SET);
 
-    bool is_gzip = (magic_read == 2 && magic[0] == 0x1f && magic[1] == 0x8b);
-    bool init_success = true;
-    size_t file_bytes_read = 0;
-    size_t decompressed_size_accum = 0;
-    size_t submitted_chunks = 0;
-    size_t reaped_chunks = 0;
-
-    // Allocate streaming buffers on the heap to prevent WASM Stack Overflow
-    char* in_buf = (char*)allocator_alloc(a, IN_BUF_SIZE);
-    char* out_buf = (char*)allocator_alloc(a, OUT_BUF_SIZE);
-    bool is_eof = false;
-
-    if (is_gzip) {
-      z_stream strm = {};  // ZII
-      if (inflateInit2(&strm, 16 + MAX_WBITS) == Z_OK) {
-        int status = Z_OK;
-        while (status != Z_STREAM_END && !is_eof && init_success) {
-          if (strm.avail_in == 0) {
-            size_t n = fread(in_buf, 1, IN_BUF_SIZE, f);
-            file_bytes_read += n;
-            if (n < IN_BUF_SIZE) {
-              is_eof = true;
-            }
-            strm.next_in = (Bytef*)in_buf;
-            strm.avail_in = (uInt)n;
-          }
-
-          do {
-            strm.next_out = (Bytef*)out_buf;
-            strm.avail_out = (uInt)OUT_BUF_SIZE;
-
-            status = inflate(&strm, Z_NO_FLUSH);
-            if (status == Z_NEED_DICT || status == Z_DATA_ERROR ||
-                status == Z_MEM_ERROR) {
-              fprintf(stderr, "Error: Gzip decompression failed (code %d)\n",
-                      status);
-              init_success = false;
-              break;
-            }
-
-            size_t decompressed_size = OUT_BUF_SIZE - strm.avail_out;
-            if (decompressed_size > 0) {
-              bool parser_eof = (status == Z_STREAM_END);
-
-              // A. Apply backpressure: Block-wait if too many bytes are
-              // buffered in-flight
-              while (trace_load_task_get_buffered_bytes(load_task) >
-                         BACKPRESSURE_THRESHOLD &&
-                     init_success) {
-                task_completion_t cqe;
-                task_queue_wait_completion(queue, &cqe);
-                if (!reap_completion_sync(queue, &td, out_tracks, out_min_ts,
-                                          out_max_ts, out_ingest_duration_ms,
-                                          out_organize_duration_ms,
-                                          &reaped_chunks, a)) {
-                  init_success = false;
-                }
-              }
-
-              if (!init_success) break;
-
-              // B. Submit the chunk to the background thread pool
-              task_submission_t* sub = task_queue_get_submission(queue);
-              if (sub == nullptr) {
-                init_success = false;
-                break;
-              }
-
-              decompressed_size_accum += decompressed_size;
-              trace_load_task_prep_chunk(load_task, sub, out_buf,
-                                         decompressed_size, file_bytes_read,
-                                         parser_eof);
-              task_queue_submit(queue);
-              submitted_chunks++;
-
-              // C. Non-blocking poll of completed chunks to keep the queue
-              // draining
-              task_completion_t cqe;
-              while (task_queue_peek_completion(queue, &cqe)) {
-                if (!reap_completion_sync(queue, &td, out_tracks, out_min_ts,
-                                          out_max_ts, out_ingest_duration_ms,
-                                          out_organize_duration_ms,
-                                          &reaped_chunks, a)) {
-                  init_success = false;
-                }
-              }
-            }
-          } while (strm.avail_out == 0 && status != Z_STREAM_END &&
-                   init_success);
-        }
-        inflateEnd(&strm);
-      } else {
+    l = allocator_alloc_struct(a, trace_loader_t);
+    *l = (trace_loader_t){
+        .queue = queue,
+        .load_task = trace_load_task_create(queue, stream, a),
+        .allocator = a,
+        .file = f,
+        .is_gzip = magic_read == 2 && magic[0] == 0x1f && magic[1] == 0x8b,
+    };
+    if (l->is_gzip) {
+      // Allocate streaming buffers on the heap to prevent WASM Stack Overflow
+      l->in_buf = (char*)allocator_alloc(a, IN_BUF_SIZE);
+      if (inflateInit2(&l->strm, 16 + MAX_WBITS) != Z_OK) {
         fprintf(stderr, "Error: Failed to initialize zlib decompression\n");
-        init_success = false;
-      }
-    } else {
-      // Direct raw JSON reading loop
-      while (!is_eof && init_success) {
-        size_t n = fread(out_buf, 1, OUT_BUF_SIZE, f);
-        file_bytes_read += n;
-        if (n < OUT_BUF_SIZE) {
-          is_eof = true;
-        }
-
-        // A. Apply backpressure: Block-wait if too many bytes are buffered
-        // in-flight
-        while (trace_load_task_get_buffered_bytes(load_task) >
-                   BACKPRESSURE_THRESHOLD &&
-               init_success) {
-          task_completion_t cqe;
-          task_queue_wait_completion(queue, &cqe);
-          if (!reap_completion_sync(queue, &td, out_tracks, out_min_ts,
-                                    out_max_ts, out_ingest_duration_ms,
-                                    out_organize_duration_ms, &reaped_chunks,
-                                    a)) {
-            init_success = false;
-          }
-        }
-
-        if (!init_success) break;
-
-        // B. Submit the chunk to the background thread pool
-        task_submission_t* sub = task_queue_get_submission(queue);
-        if (sub == nullptr) {
-          init_success = false;
-          break;
-        }
-
-        decompressed_size_accum += n;
-        trace_load_task_prep_chunk(load_task, sub, out_buf, n, file_bytes_read,
-                                   is_eof);
-        task_queue_submit(queue);
-        submitted_chunks++;
-
-        // C. Non-blocking poll of completed chunks to keep the queue draining
-        task_completion_t cqe;
-        while (task_queue_peek_completion(queue, &cqe)) {
-          if (!reap_completion_sync(queue, &td, out_tracks, out_min_ts,
-                                    out_max_ts, out_ingest_duration_ms,
-                                    out_organize_duration_ms, &reaped_chunks,
-                                    a)) {
-            init_success = false;
-          }
-        }
+        l->is_gzip = false;
+        l->failed = true;
       }
     }
+  } else {
+    fprintf(stderr, "Error: Failed to open trace file '%s'\n", filename);
+  }
+  return l;
+}
 
-    // 2. Abort if any error occurred, then drain all remaining in-flight chunks
-    // to prevent leaks
-    if (!init_success) {
-      trace_load_task_abort(load_task);
+void trace_loader_set_profile(trace_loader_t* loader,
+                              trace_load_profile_t* profile) {
+  loader->profile = profile;
+  trace_load_task_set_profile(loader->load_task, profile);
+}
+
+void trace_loader_pump(trace_loader_t* l) {
+  bool can_read = !l->reading && !l->input_done && !l->failed;
+  bool behind = can_read && trace_load_task_get_buffered_bytes(l->load_task) >
+                                BACKPRESSURE_THRESHOLD;
+  if (behind && !l->backpressured) {
+    l->backpressured = true;
+    l->backpressure_start = platform_get_now();
+  } else if (can_read && !behind) {
+    if (l->backpressured) {
+      l->backpressure_ms += platform_get_now() - l->backpressure_start;
+      l->backpressured = false;
+    }
+    // A full queue is left to a later pump; it holds tasks that will
+    // complete.
+    task_submission_t* sub = task_queue_get_submission(l->queue);
+    if (sub) {
+      allocator_t* arena = arena_get_allocator(sub->arena);
+      trace_loader_read_t* r = allocator_alloc_struct(arena,
+                                                      trace_loader_read_t);
+      *r = (trace_loader_read_t){
+          .loader = l,
+          .data = (char*)allocator_alloc_uninitialized(arena, OUT_BUF_SIZE),
+      };
+      sub->task = trace_loader_read_run;
+      sub->user_data = r;
+      sub->stream = 0;
+      task_queue_submit(l->queue);
+      l->reading = true;
     }
+  }
+}
 
-    while (reaped_chunks < submitted_chunks) {
-      task_completion_t cqe;
-      task_queue_wait_completion(queue, &cqe);
-      reap_completion_sync(queue, &td, out_tracks, out_min_ts, out_max_ts,
-                           out_ingest_duration_ms, out_organize_duration_ms,
-                           &reaped_chunks, a);
+bool trace_loader_owns_completion(const trace_loader_t* loader,
+                                  const task_completion_t* cqe) {
+  bool owns = false;
+  if (cqe->task == trace_loader_read_run) {
+    owns = ((const trace_loader_read_t*)cqe->user_data)->loader == loader;
+  } else if (cqe->task == trace_load_task_run) {
+    owns = ((const trace_load_task_chunk_t*)cqe->user_data)->task ==
+           loader->load_task;
+  }
+  return owns;
+}
+
+// Hands a chunk that was read to the parser.
+static void handle_read(trace_loader_t* l, const task_completion_t* cqe) {
+  const trace_loader_read_t* r = (const trace_loader_read_t*)cqe->user_data;
+  l->reading = false;
+  if (cqe->status != TASK_STATUS_OK || r->failed) {
+    trace_loader_fail(l);
+  } else if (!l->failed) {
+    task_submission_t* sub = task_queue_get_submission(l->queue);
+    if (sub) {
+      trace_load_task_prep_chunk(l->load_task, sub, r->data, r->size,
+                                 l->file_bytes_read, r->is_eof);
+      task_queue_submit(l->queue);
+      l->submitted_chunks++;
+      l->decompressed_size += r->size;
+      l->input_done = r->is_eof;
+    } else {
+      trace_loader_fail(l);
     }
+  }
+}
+
+// Reaps a parsed chunk, adopting the trace data (and organized tracks and
+// stats) on EOF.
+static void handle_chunk(trace_loader_t* l, const task_completion_t* cqe) {
+  allocator_t* a = l->allocator;
+  trace_load_task_chunk_t* payload = (trace_load_task_chunk_t*)cqe->user_data;
+  l->reaped_chunks++;
+
+  if (cqe->status != TASK_STATUS_OK) {
+    trace_loader_fail(l);
+  } else if (payload->is_eof) {
+    l->td = payload->completed_td;
+    l->tracks = payload->completed_tracks;
+    l->min_ts = payload->completed_min_ts;
+    l->max_ts = payload->completed_max_ts;
+    l->ingest_duration_ms = payload->stats.ingestion_duration_ms;
+    l->organize_duration_ms = payload->stats.organize_duration_ms;
+    payload->completed_tracks = (darray_track_t){};
+  }
+  trace_load_task_chunk_release_snapshot(payload, a);
 
-    fclose(f);
+  // Note: payload->data and payload itself are allocated from the task-local
+  // arena and will be automatically reclaimed when task_queue_remove_completion
+  // is called.
+  trace_load_task_release(payload->task);
+}
 
-    // Free heap-allocated streaming buffers
-    allocator_free(a, in_buf, IN_BUF_SIZE);
-    allocator_free(a, out_buf, OUT_BUF_SIZE);
+void trace_loader_handle_completion(trace_loader_t* loader,
+                                    const task_completion_t* cqe) {
+  if (cqe->task == trace_loader_read_run) {
+    handle_read(loader, cqe);
+  } else {
+    handle_chunk(loader, cqe);
+  }
+  task_queue_remove_completion(loader->queue);
+  trace_loader_pump(loader);
+}
 
-    // Release the local loading task reference
-    trace_load_task_release(load_task);
+bool trace_loader_is_done(const trace_loader_t* loader) {
+  return !loader->reading &&
+         loader->reaped_chunks == loader->submitted_chunks &&
+         (loader->input_done || loader->failed);
+}
 
-    // Destroy the local task queue
-    task_queue_destroy(queue);
+trace_data_t* trace_loader_finish(trace_loader_t* l,
+                                  size_t* out_decompressed_size,
+                                  darray_track_t* out_tracks,
+                                  int64_t* out_min_ts, int64_t* out_max_ts,
+                                  double* out_ingest_duration_ms,
+                                  double* out_organize_duration_ms) {
+  expect(trace_loader_is_done(l));
+  allocator_t* a = l->allocator;
+  trace_data_t* td = l->failed ? nullptr : l->td;
+  if (l->failed && l->td) {
+    trace_data_release(l->td, a);
+  }
 
-    if (!init_success) {
-      if (td != nullptr) {
-        trace_data_release(td, a);
-        td = nullptr;
-      }
-    } else {
-      if (out_decompressed_size) {
-        *out_decompressed_size = decompressed_size_accum;
-      }
+  if (td) {
+    if (out_decompressed_size) *out_decompressed_size = l->decompressed_size;
+    if (out_min_ts) *out_min_ts = l->min_ts;
+    if (out_max_ts) *out_max_ts = l->max_ts;
+    if (out_ingest_duration_ms) {
+      *out_ingest_duration_ms = l->ingest_duration_ms;
+    }
+    if (out_organize_duration_ms) {
+      *out_organize_duration_ms = l->organize_duration_ms;
     }
+  }
+  if (td && out_tracks) {
+    *out_tracks = l->tracks;
   } else {
-    fprintf(stderr, "Error: Failed to open trace file '%s'\n", filename);
+    for (size_t i = 0; i < l->tracks.len; i++) {
+      track_deinit(&l->tracks.ptr[i], a);
+    }
+    darray_deinit(&l->tracks, a);
+  }
+
+  if (l->profile) {
+    l->profile->read_ms = l->read_ms;
+    l->profile->inflate_ms = l->inflate_ms;
+    l->profile->backpressure_ms = l->backpressure_ms;
+  }
+
+  if (l->is_gzip) {
+    inflateEnd(&l->strm);
+  }
+  if (l->in_buf) {
+    allocator_free(a, l->in_buf, IN_BUF_SIZE);
+  }
+  fclose(l->file);
+  trace_load_task_release(l->load_task);
+  allocator_free_struct(a, l, trace_loader_t);
+  return td;
+}
+
+// Synchronously loads a Chrome trace file by driving one loader on a queue of
+// its own.
+trace_data_t* trace_loader_load_file(const char* filename, allocator_t* a,
+                                     size_t* out_decompressed_size,
+                                     darray_track_t* out_tracks,
+                                     int64_t* out_min_ts, int64_t* out_max_ts,
+                                     double* out_ingest_duration_ms,
+                                     double* out_organize_duration_ms,
+                                     trace_load_profile_t* out_profile) {
+  SELF_TRACE_BEGIN("trace_loader_load_file");
+  trace_data_t* td = nullptr;
+  task_queue_t* queue =
+      task_queue_create(TRACE_LOADER_QUEUE_SLOTS, platform_submit_job, a);
+  trace_loader_t* loader = trace_loader_create(filename, queue, 1, a);
+
+  if (loader) {
+    if (out_profile) {
+      *out_profile = (trace_load_profile_t){};
+      trace_loader_set_profile(loader, out_profile);
+    }
+    trace_loader_pump(loader);
+    while (!trace_loader_is_done(loader)) {
+      task_completion_t cqe;
+      task_queue_wait_completion(queue, &cqe);
+      trace_loader_handle_completion(loader, &cqe);
+    }
+    td = trace_loader_finish(loader, out_decompressed_size, out_tracks,
+                             out_min_ts, out_max_ts, out_ingest_duration_ms,
+                             out_organize_duration_ms);
   }
 
+  task_queue_destroy(queue);
+  SELF_TRACE_END();
   return td;
 }
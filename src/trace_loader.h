@@ -2,6 +2,8 @@
 #define SRC_TRACE_LOADER_H
 
 #include "core/allocator.h"
+#include "core/task.h"
+#include "src/trace_load_task.h"
 #include "src/track.h"
 
 #ifdef __cplusplus
@@ -19,6 +21,8 @@ extern "C" {
 // Returns the populated trace_data_t, or nullptr on failure.
 // If out_decompressed_size is not null, it will be populated with the total
 // decompressed bytes fed to the parser.
+// If out_profile is not null, it will be populated with a per-phase timing
+// breakdown of the load (see trace_load_profile_t).
 // The returned pointer must be released by the caller using
 // trace_data_release().
 trace_data_t* trace_loader_load_file(const char* filename, allocator_t* a,
@@ -26,7 +30,67 @@ trace_data_t* trace_loader_load_file(const char* filename, allocator_t* a,
                                      darray_track_t* out_tracks,
                                      int64_t* out_min_ts, int64_t* out_max_ts,
                                      double* out_ingest_duration_ms,
-                                     double* out_organize_duration_ms);
+                                     double* out_organize_duration_ms,
+                                     trace_load_profile_t* out_profile);
+
+// ─── Incremental Loading ─────────────────────────────────────────────────────
+//
+// trace_loader_load_file is built on a loader that its caller drives: reading
+// and inflating run as tasks on the caller's queue (one at a time per loader),
+// and parsing runs on the loader's serialized stream. Nothing blocks, so one
+// thread can drive any number of loads over the worker pool:
+//
+//   trace_loader_pump(loader);
+//   while (!trace_loader_is_done(loader)) {
+//     task_queue_wait_completion(queue, &cqe);
+//     if (trace_loader_owns_completion(loader, &cqe)) {
+//       trace_loader_handle_completion(loader, &cqe);
+//     }
+//   }
+//   td = trace_loader_finish(loader, ...);
+
+typedef struct trace_loader trace_loader_t;
+
+// Queue slots one loader holds at most. Size a shared queue for the loads it
+// runs at once.
+constexpr size_t TRACE_LOADER_QUEUE_SLOTS = 64;
+
+// Opens `filename` for loading on `queue`. Chunks are parsed on `stream`, which
+// must not be used by anything else. Returns nullptr if the file cannot be
+// opened.
+trace_loader_t* trace_loader_create(const char* filename, task_queue_t* queue,
+                                    task_stream_t stream, allocator_t* a);
+
+// Accumulates a per-phase profile of the load into `profile`, which must
+// outlive the loader. Must be called before the first pump.
+void trace_loader_set_profile(trace_loader_t* loader,
+                              trace_load_profile_t* profile);
+
+// Submits the next read if none is in flight and the parser has caught up.
+// Call once to start the load; completions pump the loader themselves.
+void trace_loader_pump(trace_loader_t* loader);
+
+// Returns true if `cqe` is the completion of one of the loader's tasks.
+bool trace_loader_owns_completion(const trace_loader_t* loader,
+                                  const task_completion_t* cqe);
+
+// Handles `cqe`, the completion at the head of the queue, removes it, and
+// pumps the loader.
+void trace_loader_handle_completion(trace_loader_t* loader,
+                                    const task_completion_t* cqe);
+
+// Returns true once the loader has no tasks in flight and either parsed the
+// whole file or failed.
+bool trace_loader_is_done(const trace_loader_t* loader);
+
+// Destroys a loader that is done. Returns its trace, or nullptr if the load
+// failed; the outputs are as for trace_loader_load_file and may be null.
+trace_data_t* trace_loader_finish(trace_loader_t* loader,
+                                  size_t* out_decompressed_size,
+                                  darray_track_t* out_tracks,
+                                  int64_t* out_min_ts, int64_t* out_max_ts,
+                                  double* out_ingest_duration_ms,
+                                  double* out_organize_duration_ms);
 
 #ifdef __cplusplus
 }
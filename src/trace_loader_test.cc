@@ -0,0 +1,161 @@
+#include "src/trace_loader.h"
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "core/allocator.h"
+#include "core/counting_allocator.h"
+#include "core/task.h"
+#include "src/platform.h"
+#include "src/trace_data.h"
+#include "src/track.h"
+
+static const char* MOCK_TRACE = R"([
+  {"name": "a", "cat": "c", "ph": "X", "ts": 100, "dur": 50, "pid": 1, "tid": 1},
+  {"name": "b", "cat": "c", "ph": "B", "ts": 200, "pid": 1, "tid": 2},
+  {"name": "b", "cat": "c", "ph": "E", "ts": 260, "pid": 1, "tid": 2}
+])";
+
+static std::string temp_path(const std::string& filename) {
+  const char* test_tmpdir = getenv("TEST_TMPDIR");
+  return test_tmpdir ? std::string(test_tmpdir) + "/" + filename : filename;
+}
+
+static std::string write_file(const std::string& filename,
+                              const std::string& bytes) {
+  std::string path = temp_path(filename);
+  std::ofstream f(path, std::ios::binary);
+  EXPECT_TRUE(f.is_open()) << "Failed to create temp file at: " << path;
+  f.write(bytes.data(), (std::streamsize)bytes.size());
+  return path;
+}
+
+static std::string gzip(const std::string& json) {
+  z_stream strm = {};
+  EXPECT_EQ(deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY),
+            Z_OK);
+  std::vector<unsigned char> out(json.size() + 1024);
+  strm.next_in = (Bytef*)json.data();
+  strm.avail_in = (uInt)json.size();
+  strm.next_out = out.data();
+  strm.avail_out = (uInt)out.size();
+  EXPECT_EQ(deflate(&strm, Z_FINISH), Z_STREAM_END);
+  size_t len = out.size() - strm.avail_out;
+  deflateEnd(&strm);
+  return std::string((const char*)out.data(), len);
+}
+
+static void release_tracks(darray_track_t* tracks, allocator_t* a) {
+  for (size_t i = 0; i < tracks->len; i++) {
+    track_deinit(&tracks->ptr[i], a);
+  }
+  darray_deinit(tracks, a);
+}
+
+// Drives several loaders on one queue from this thread, as fleet-aggregate
+// does: the loads share the worker pool and each parses on its own stream.
+TEST(trace_loader_test, loaders_share_one_queue) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  allocator_t* a = counting_allocator_get_allocator(&ca);
+
+  {
+    std::string paths[] = {
+        write_file("loader_raw.json", MOCK_TRACE),
+        write_file("loader_gzip.json.gz", gzip(MOCK_TRACE)),
+    };
+    constexpr size_t N = sizeof(paths) / sizeof(paths[0]);
+
+    task_queue_t* queue =
+        task_queue_create(N * TRACE_LOADER_QUEUE_SLOTS, platform_submit_job, a);
+    trace_loader_t* loaders[N] = {};
+    for (size_t i = 0; i < N; i++) {
+      loaders[i] = trace_loader_create(paths[i].c_str(), queue,
+                                       (task_stream_t)(i + 1), a);
+      ASSERT_NE(loaders[i], nullptr);
+      trace_loader_pump(loaders[i]);
+    }
+
+    size_t done = 0;
+    while (done < N) {
+      task_completion_t cqe;
+      task_queue_wait_completion(queue, &cqe);
+      bool handled = false;
+      for (size_t i = 0; i < N && !handled; i++) {
+        if (trace_loader_owns_completion(loaders[i], &cqe)) {
+          trace_loader_handle_completion(loaders[i], &cqe);
+          handled = true;
+        }
+      }
+      ASSERT_TRUE(handled);
+      done = 0;
+      for (size_t i = 0; i < N; i++) {
+        done += trace_loader_is_done(loaders[i]) ? 1 : 0;
+      }
+    }
+
+    for (size_t i = 0; i < N; i++) {
+      size_t decompressed = 0;
+      darray_track_t tracks = {};
+      int64_t min_ts = 0;
+      int64_t max_ts = 0;
+      trace_data_t* td = trace_loader_finish(
+          loaders[i], &decompressed, &tracks, &min_ts, &max_ts, nullptr,
+          nullptr);
+      ASSERT_NE(td, nullptr) << paths[i];
+      EXPECT_EQ(decompressed, strlen(MOCK_TRACE));
+      EXPECT_EQ(td->events.len, 2u);
+      EXPECT_EQ(tracks.len, 2u);
+      EXPECT_EQ(min_ts, 100);
+      EXPECT_EQ(max_ts, 260);
+      release_tracks(&tracks, a);
+      trace_data_release(td, a);
+      remove(paths[i].c_str());
+    }
+
+    task_queue_destroy(queue);
+    platform_teardown_workers();
+  }
+
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
+}
+
+// A gzip stream cut short fails the load instead of parsing the prefix.
+TEST(trace_loader_test, truncated_gzip_fails) {
+  counting_allocator_t ca;
+  counting_allocator_init(&ca, c_allocator());
+  allocator_t* a = counting_allocator_get_allocator(&ca);
+
+  {
+    std::string compressed = gzip(MOCK_TRACE);
+    std::string path = write_file("loader_truncated.json.gz",
+                                  compressed.substr(0, compressed.size() / 2));
+
+    darray_track_t tracks = {};
+    trace_data_t* td = trace_loader_load_file(path.c_str(), a, nullptr,
+                                              &tracks, nullptr, nullptr,
+                                              nullptr, nullptr, nullptr);
+    EXPECT_EQ(td, nullptr);
+    EXPECT_EQ(tracks.len, 0u);
+    remove(path.c_str());
+    platform_teardown_workers();
+  }
+
+  EXPECT_EQ(counting_allocator_get_allocated_bytes(&ca), 0u);
+}
+
+TEST(trace_loader_test, missing_file_returns_null) {
+  task_queue_t* queue = task_queue_create(TRACE_LOADER_QUEUE_SLOTS,
+                                          platform_submit_job, c_allocator());
+  EXPECT_EQ(trace_loader_create(temp_path("does_not_exist.json").c_str(),
+                                queue, 1, c_allocator()),
+            nullptr);
+  task_queue_destroy(queue);
+}
@@ -0,0 +1,150 @@
+#include "src/trace_query.h"
+
+#include <string.h>
+
+#include "src/trace_viewer.h"
+
+// Position in one track's event list.
+typedef struct trace_query_cursor {
+  const track_t* track;
+  // Index of the track, to break timestamp ties in track order
+  size_t track_idx;
+  // Next candidate in track->event_indices
+  size_t pos;
+  // Timestamp of the event at `pos`
+  int64_t ts;
+} trace_query_cursor_t;
+
+static bool trace_query_cursor_less(const trace_query_cursor_t* a,
+                                    const trace_query_cursor_t* b) {
+  return a->ts < b->ts || (a->ts == b->ts && a->track_idx < b->track_idx);
+}
+
+static void trace_query_heap_sift_down(trace_query_cursor_t* heap, size_t len,
+                                       size_t i) {
+  bool done = false;
+  while (!done) {
+    size_t smallest = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < len && trace_query_cursor_less(&heap[left], &heap[smallest])) {
+      smallest = left;
+    }
+    if (right < len &&
+        trace_query_cursor_less(&heap[right], &heap[smallest])) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      done = true;
+    } else {
+      trace_query_cursor_t tmp = heap[i];
+      heap[i] = heap[smallest];
+      heap[smallest] = tmp;
+      i = smallest;
+    }
+  }
+}
+
+static int trace_query_depth(const track_t* t, size_t pos) {
+  return t->type == TRACK_TYPE_THREAD ? (int)t->depths.ptr[pos] : 0;
+}
+
+static bool trace_query_event_matches(const trace_data_t* td,
+                                      const trace_query_params_t* params,
+                                      size_t match_len, const track_t* t,
+                                      size_t pos,
+                                      const trace_event_persisted_t* e) {
+  bool match = true;
+  // Overlap with [t_start, t_end]: e->ts <= t_end && e->ts + e->dur >= t_start
+  if (params->has_t_start && e->ts + e->dur < params->t_start) {
+    match = false;
+  }
+  if (match && params->match) {
+    string_view_t name = trace_data_get_string(td, e->name_ref);
+    string_view_t cat = trace_data_get_string(td, e->cat_ref);
+    match = trace_viewer_str_contains_case_insensitive(name, params->match,
+                                                       match_len) ||
+            trace_viewer_str_contains_case_insensitive(cat, params->match,
+                                                       match_len);
+  }
+  if (match && params->has_max_depth) {
+    match = trace_query_depth(t, pos) <= params->max_depth;
+  }
+  return match;
+}
+
+// Moves the cursor to the next matching event at or after its position.
+// Returns false once the track has no more matches.
+static bool trace_query_cursor_advance(trace_query_cursor_t* c,
+                                       const trace_data_t* td,
+                                       const trace_query_params_t* params,
+                                       size_t match_len) {
+  const track_t* t = c->track;
+  const size_t* event_indices = t->event_indices.ptr;
+  const trace_event_persisted_t* events = td->events.ptr;
+  bool found = false;
+  while (!found && c->pos < t->event_indices.len) {
+    const trace_event_persisted_t* e = &events[event_indices[c->pos]];
+    if (params->has_t_end && e->ts > params->t_end) {
+      // Events are sorted by start time; nothing later can overlap.
+      c->pos = t->event_indices.len;
+    } else if (trace_query_event_matches(td, params, match_len, t, c->pos,
+                                         e)) {
+      c->ts = e->ts;
+      found = true;
+    } else {
+      c->pos++;
+    }
+  }
+  return found;
+}
+
+void trace_query_compute(const trace_data_t* td, const darray_track_t* tracks,
+                         const trace_query_params_t* params,
+                         darray_trace_query_match_t* out_matches,
+                         allocator_t* a) {
+  size_t match_len = params->match ? strlen(params->match) : 0;
+  const track_t* tracks_data = tracks->ptr;
+
+  darray_t(trace_query_cursor_t) heap = {};
+  for (size_t i = 0; i < tracks->len; i++) {
+    const track_t* t = &tracks_data[i];
+    if (params->track && params->track != t) {
+      continue;
+    }
+    trace_query_cursor_t c = {
+        .track = t,
+        .track_idx = i,
+        .pos = params->has_t_start
+                   ? track_find_visible_start_index(t, td, params->t_start)
+                   : 0,
+    };
+    if (trace_query_cursor_advance(&c, td, params, match_len)) {
+      darray_push(&heap, c, a);
+    }
+  }
+
+  for (size_t i = heap.len / 2; i-- > 0;) {
+    trace_query_heap_sift_down(heap.ptr, heap.len, i);
+  }
+
+  size_t found = 0;
+  while (heap.len > 0 && found < params->limit) {
+    trace_query_cursor_t* top = &heap.ptr[0];
+    trace_query_match_t m = {
+        .event_idx = top->track->event_indices.ptr[top->pos],
+        .track = top->track,
+        .depth = trace_query_depth(top->track, top->pos),
+    };
+    darray_push(out_matches, m, a);
+    found++;
+
+    top->pos++;
+    if (!trace_query_cursor_advance(top, td, params, match_len)) {
+      heap.ptr[0] = *darray_pop(&heap);
+    }
+    trace_query_heap_sift_down(heap.ptr, heap.len, 0);
+  }
+
+  darray_deinit(&heap, a);
+}
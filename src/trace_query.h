@@ -0,0 +1,65 @@
+#ifndef SRC_TRACE_QUERY_H
+#define SRC_TRACE_QUERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/allocator.h"
+#include "core/darray.h"
+#include "src/trace_data.h"
+#include "src/track.h"
+
+typedef struct trace_query_params {
+  // Searches only this track; nullptr searches every track.
+  const track_t* track;
+  // Case-insensitive substring of the name or category; nullptr matches all.
+  const char* match;
+  // Events must overlap [t_start, t_end] (in us).
+  int64_t t_start;
+  int64_t t_end;
+  bool has_t_start;
+  bool has_t_end;
+  int max_depth;
+  bool has_max_depth;
+  // Most matches to return; SIZE_MAX returns all of them.
+  size_t limit;
+} trace_query_params_t;
+
+typedef struct trace_query_match {
+  size_t event_idx;
+  const track_t* track;
+  int depth;
+} trace_query_match_t;
+
+typedef darray_t(trace_query_match_t) darray_trace_query_match_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Finds events matching `params` in chronological order; events with the same
+// timestamp keep track order.
+//
+// Every track's events are already sorted by time, so this is a k-way merge:
+// one cursor per track, seeded at the first event that can overlap t_start,
+// and a min-heap on their timestamps. It stops after `limit` matches, so the
+// cost depends on the limit and the number of tracks rather than on the
+// number of matching events.
+//
+// Arguments:
+// - td: The trace_data_t storage.
+// - tracks: The organized tracks of `td`.
+// - params: Filters and limit.
+// - out_matches: Output darray the matches are appended to.
+// - a: Allocator.
+void trace_query_compute(const trace_data_t* td, const darray_track_t* tracks,
+                         const trace_query_params_t* params,
+                         darray_trace_query_match_t* out_matches,
+                         allocator_t* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SRC_TRACE_QUERY_H
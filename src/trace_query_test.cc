@@ -0,0 +1,120 @@
+#include "src/trace_query.h"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "core/allocator.h"
+#include "core/arena.h"
+#include "src/trace_data.h"
+#include "src/track.h"
+
+static void add_event(trace_data_t* td, allocator_t* a, int32_t tid,
+                      const char* name, int64_t ts, int64_t dur) {
+  trace_event_t e = {};
+  e.ph = "X";
+  e.pid = 1;
+  e.tid = tid;
+  e.name = name;
+  e.cat = "test";
+  e.ts = ts;
+  e.dur = dur;
+  trace_event_matcher_t matcher = {};
+  trace_data_add_event(td, &e, &matcher, a);
+  trace_event_matcher_deinit(&matcher);
+}
+
+class trace_query_test : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    a_ = c_allocator();
+    td_ = trace_data_create(a_);
+    // Thread 1: a long root with two children.
+    add_event(td_, a_, 1, "root", 0, 10000);
+    add_event(td_, a_, 1, "child_a", 1000, 1000);
+    add_event(td_, a_, 1, "child_b", 5000, 1000);
+    // Thread 2: interleaved with thread 1, one tie at 5000.
+    add_event(td_, a_, 2, "other_1", 500, 100);
+    add_event(td_, a_, 2, "other_2", 5000, 100);
+    add_event(td_, a_, 2, "other_3", 8000, 100);
+
+    int64_t min_ts, max_ts;
+    arena_t* scratch_arena = arena_create();
+    track_organize(td_, &tracks_, &min_ts, &max_ts, a_,
+                   arena_get_allocator(scratch_arena));
+    arena_destroy(scratch_arena);
+  }
+
+  void TearDown() override {
+    for (size_t i = 0; i < tracks_.len; i++) {
+      track_deinit(&tracks_.ptr[i], a_);
+    }
+    darray_deinit(&tracks_, a_);
+    trace_data_release(td_, a_);
+  }
+
+  // Returns the names of the matches, in order.
+  std::vector<std::string> query(const trace_query_params_t& params) {
+    darray_trace_query_match_t matches = {};
+    trace_query_compute(td_, &tracks_, &params, &matches, a_);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < matches.len; i++) {
+      const trace_event_persisted_t* e =
+          &td_->events.ptr[matches.ptr[i].event_idx];
+      names.emplace_back(trace_data_get_string(td_, e->name_ref));
+    }
+    darray_deinit(&matches, a_);
+    return names;
+  }
+
+  allocator_t* a_ = nullptr;
+  trace_data_t* td_ = nullptr;
+  darray_track_t tracks_ = {};
+};
+
+TEST_F(trace_query_test, merges_tracks_chronologically) {
+  trace_query_params_t params = {.limit = SIZE_MAX};
+  std::vector<std::string> expected = {"root",    "other_1", "child_a",
+                                       "child_b", "other_2", "other_3"};
+  EXPECT_EQ(query(params), expected);
+}
+
+TEST_F(trace_query_test, stops_at_limit) {
+  trace_query_params_t params = {.limit = 3};
+  std::vector<std::string> expected = {"root", "other_1", "child_a"};
+  EXPECT_EQ(query(params), expected);
+}
+
+TEST_F(trace_query_test, time_window_keeps_overlapping_events) {
+  // root starts before t_start but still overlaps the window.
+  trace_query_params_t params = {
+      .t_start = 4000,
+      .t_end = 6000,
+      .has_t_start = true,
+      .has_t_end = true,
+      .limit = SIZE_MAX,
+  };
+  std::vector<std::string> expected = {"root", "child_b", "other_2"};
+  EXPECT_EQ(query(params), expected);
+}
+
+TEST_F(trace_query_test, filters_by_match_depth_and_track) {
+  trace_query_params_t params = {.match = "CHILD", .limit = SIZE_MAX};
+  std::vector<std::string> expected = {"child_a", "child_b"};
+  EXPECT_EQ(query(params), expected);
+
+  params = {.max_depth = 0, .has_max_depth = true, .limit = SIZE_MAX};
+  expected = {"root", "other_1", "other_2", "other_3"};
+  EXPECT_EQ(query(params), expected);
+
+  const track_t* track = nullptr;
+  for (size_t i = 0; i < tracks_.len; i++) {
+    if (tracks_.ptr[i].tid == 2) {
+      track = &tracks_.ptr[i];
+    }
+  }
+  ASSERT_NE(track, nullptr);
+  params = {.track = track, .limit = 2};
+  expected = {"other_1", "other_2"};
+  EXPECT_EQ(query(params), expected);
+}
@@ -5,6 +5,8 @@
 
 #include "core/assert.h"
 #include "core/logging.h"
+#include "core/self_trace.h"
+#include "core/tagged_allocator.h"
 #include "core/task.h"
 #include "src/trace_data.h"
 #include "src/trace_histogram.h"
@@ -22,8 +24,11 @@ void trace_search_task_run(task_context_t* ctx) {
             task->query ? task->query : "");
 
   darray_int64_t results = {};  // ZII
+  allocator_t* results_allocator =
+      allocator_for_tag(allocator, MEMORY_TAG_SEARCH);
   bool aborted = false;
 
+  SELF_TRACE_BEGIN("trace_search");
   if (task->query && task->query[0] != '\0') {
     const char* query_ptr = task->query;
     size_t query_len = strlen(query_ptr);
@@ -73,10 +78,11 @@ void trace_search_task_run(task_context_t* ctx) {
       }
 
       if (match) {
-        darray_push(&results, (int64_t)i, allocator);
+        darray_push(&results, (int64_t)i, results_allocator);
       }
     }
   }
+  SELF_TRACE_END();
 
   if (aborted) {
     LOG_DEBUG("trace_search_task_run background task aborted");
@@ -90,7 +96,9 @@ void trace_search_task_run(task_context_t* ctx) {
     trace_histogram_t* histogram = (trace_histogram_t*)allocator_alloc(
         allocator, sizeof(trace_histogram_t));
     *histogram = (trace_histogram_t){};  // ZII
-    trace_histogram_compute(&results, td, histogram);
+    SELF_TRACE_BEGIN("trace_histogram_compute");
+    trace_histogram_compute(&results, td, histogram, allocator);
+    SELF_TRACE_END();
 
     // Save outputs to the task context to be adopted by the UI thread
     task->results = results;
@@ -7,6 +7,8 @@
 #include <string.h>
 
 #include "core/logging.h"
+#include "core/self_trace.h"
+#include "core/tagged_allocator.h"
 #include "src/colors.h"
 #include "src/format.h"
 #include "src/imgui_c.h"
@@ -43,6 +45,30 @@ static void trace_viewer_draw_vertical_minimap(const trace_viewer_t* tv,
     b = temp;         \
   } while (0)
 
+// Returns the text color that reads best on background `col`: dark gray on
+// light colors, white on dark ones.
+static uint32_t trace_viewer_text_color_on(uint32_t col) {
+  float r = (float)((col >> 0) & 0xFF) / 255.0f;
+  float g = (float)((col >> 8) & 0xFF) / 255.0f;
+  float b = (float)((col >> 16) & 0xFF) / 255.0f;
+  float lum = r * 0.299f + g * 0.587f + b * 0.114f;
+  return (lum > 0.5f) ? IG_COL32(32, 32, 32, 255)
+                      : IG_COL32(255, 255, 255, 255);
+}
+
+// Returns where event `event_idx` lives in tv->tracks, or nullptr if it is in
+// no track. The index is rebuilt at the start of every step when stale.
+static const track_event_location_t* trace_viewer_locate_event(
+    const trace_viewer_t* tv, size_t event_idx) {
+  const track_event_location_t* result = nullptr;
+  if (event_idx < tv->event_locations.len &&
+      tv->event_locations.ptr[event_idx].track_idx !=
+          TRACK_EVENT_LOCATION_NONE) {
+    result = &tv->event_locations.ptr[event_idx];
+  }
+  return result;
+}
+
 bool trace_viewer_str_contains_case_insensitive(string_view_t text,
                                                 const char* q, size_t q_len) {
   if (q_len == 0) return true;
@@ -162,7 +188,16 @@ static bool trace_viewer_selection_is_mouse_inside(const trace_viewer_t* tv,
 const double TRACE_VIEWER_MAX_ZOOM_FACTOR = 1.2;
 const double TRACE_VIEWER_MIN_ZOOM_DURATION = 1000.0;  // 1ms = 1000us
 
-void trace_viewer_init(trace_viewer_t* tv) { *tv = (trace_viewer_t){}; }
+static float trace_viewer_measure_text(const void* font, float font_size,
+                                       string_view_t text) {
+  return ig_font_calc_text_size_a((const ig_font_t*)font, font_size, FLT_MAX,
+                                  0.0f, text.ptr, text.ptr + text.len)
+      .x;
+}
+
+void trace_viewer_init(trace_viewer_t* tv) {
+  *tv = (trace_viewer_t){};
+}
 
 void trace_viewer_deinit(trace_viewer_t* tv, allocator_t* allocator) {
   track_t* tracks = tv->tracks.ptr;
@@ -170,17 +205,26 @@ void trace_viewer_deinit(trace_viewer_t* tv, allocator_t* allocator) {
     track_deinit(&tracks[i], allocator);
   }
   darray_deinit(&tv->tracks, allocator);
+  darray_deinit(&tv->event_locations, allocator);
+  text_width_cache_deinit(&tv->label_widths, allocator);
   darray_deinit(&tv->track_infos, allocator);
   darray_deinit(&tv->ruler_ticks, allocator);
   track_renderer_state_deinit(&tv->track_renderer_state, allocator);
   darray_deinit(&tv->render_blocks, allocator);
   darray_deinit(&tv->counter_render_blocks, allocator);
+  darray_deinit(&tv->event_rects, allocator);
+  darray_deinit(&tv->event_labels, allocator);
   darray_deinit(&tv->hover_matches, allocator);
   darray_deinit(&tv->selected_event_indices, allocator);
   darray_deinit(&tv->filtered_event_indices, allocator);
   darray_deinit(&tv->vertical_minimap.track_has_selected, allocator);
   darray_deinit(&tv->vertical_minimap.track_heatmap_densities, allocator);
   darray_deinit(&tv->search_query, allocator);
+  if (tv->has_call_tree) {
+    trace_call_tree_deinit(&tv->call_tree, allocator);
+  }
+  darray_deinit(&tv->call_tree_order, allocator);
+  darray_deinit(&tv->call_tree_offsets, allocator);
 }
 
 static void trace_viewer_draw_time_ruler(trace_viewer_t* tv,
@@ -313,75 +357,100 @@ static void trace_viewer_draw_selection_overlay(trace_viewer_t* tv,
   }
 }
 
+// Returns the IG_RECT_INSTANCE_* border flags of an event block and sets
+// `out_col` to the border color if it has one.
+static uint32_t trace_viewer_event_border(float x1, float x2, bool is_selected,
+                                          bool is_focused,
+                                          const theme_t* theme,
+                                          uint32_t* out_col) {
+  uint32_t flags = 0;
+  if (is_focused) {
+    flags = IG_RECT_INSTANCE_THICK_BORDER;
+    *out_col = theme->event_border_focused;
+  } else if (is_selected) {
+    flags = IG_RECT_INSTANCE_BORDER;
+    *out_col = theme->event_border_selected;
+  } else if (x2 - x1 > TRACK_MIN_EVENT_WIDTH + 0.01f) {
+    flags = IG_RECT_INSTANCE_BORDER;
+    *out_col = theme->event_border;
+  }
+  return flags;
+}
+
+static void trace_viewer_draw_event_label(trace_viewer_t* tv, trace_data_t* td,
+                                          ig_draw_list_t* draw_list,
+                                          const event_label_t* label,
+                                          float inner_width,
+                                          float tracks_canvas_pos_x,
+                                          allocator_t* allocator) {
+  float x1 = label->x1;
+  float x2 = label->x2;
+  float y1 = label->y1;
+  float y2 = label->y2;
+  float lane_height = y2 - y1 + 1.0f;
+  float event_width = x2 - x1;
+  float padding_h = 6.0f;
+
+  if (event_width > padding_h * 2.0f + 10.0f) {
+    float visible_x1 = max(x1, tracks_canvas_pos_x);
+    float visible_x2 = min(x2, tracks_canvas_pos_x + inner_width);
+
+    if (visible_x2 > visible_x1) {
+      string_view_t name = trace_data_get_string(td, label->name_ref);
+      if (name.len > 0) {
+        uint32_t text_col = trace_viewer_text_color_on(label->col);
+        float event_font_size = ig_get_font_size();
+        float text_y = y1 + (lane_height - event_font_size) * 0.5f;
+
+        float text_width =
+            text_width_cache_get(&tv->label_widths, label->name_ref, name,
+                                 trace_viewer_measure_text, allocator);
+
+        float text_x =
+            max(x1 + padding_h, x1 + (event_width - text_width) * 0.5f);
+
+        ig_vec4_t fine_clip_rect = {visible_x1 + padding_h, y1,
+                                    visible_x2 - padding_h, y2};
+
+        ig_draw_list_add_text(draw_list, ig_get_font(), event_font_size,
+                              (ig_vec2_t){text_x, text_y}, text_col, name.ptr,
+                              name.ptr + name.len, 0.0f, &fine_clip_rect);
+        tv->frame_stats.text_draws++;
+      }
+    }
+  }
+}
+
+// Draws a single event block through the draw list. The blocks of a frame go
+// through tv->event_rects instead; this is for the hover highlight on top.
 static void trace_viewer_draw_event(trace_viewer_t* tv, trace_data_t* td,
                                     ig_draw_list_t* draw_list, float x1,
                                     float x2, float y1, float y2, uint32_t col,
                                     bool is_selected, bool is_focused,
                                     string_ref_t name_ref, float inner_width,
                                     float tracks_canvas_pos_x,
-                                    const theme_t* theme) {
-  (void)tv;
-  float lane_height = y2 - y1 + 1.0f;
-
-  float border_thickness = 1.0f;
-  float event_width = x2 - x1;
-  bool draw_border = (event_width > TRACK_MIN_EVENT_WIDTH + 0.01f);
-
+                                    const theme_t* theme,
+                                    allocator_t* allocator) {
   ig_draw_list_add_rect_filled(draw_list, (ig_vec2_t){x1, y1},
                                (ig_vec2_t){x2, y2}, col);
 
-  if (is_focused || is_selected || draw_border) {
-    uint32_t border_col = theme->event_border;
-    if (is_focused) {
-      border_col = theme->event_border_focused;
-      border_thickness = 3.0f;
-    } else if (is_selected) {
-      border_col = theme->event_border_selected;
-    }
-
+  uint32_t border_col = 0;
+  uint32_t border = trace_viewer_event_border(x1, x2, is_selected, is_focused,
+                                              theme, &border_col);
+  if (border != 0) {
+    float border_thickness =
+        (border & IG_RECT_INSTANCE_THICK_BORDER) ? 3.0f : 1.0f;
     ig_draw_list_add_rect(draw_list, (ig_vec2_t){x1, y1}, (ig_vec2_t){x2, y2},
                           border_col, 0.0f, 0, border_thickness);
   }
 
   if (name_ref != 0) {
-    float padding_h = 6.0f;
-
-    if (event_width > padding_h * 2.0f + 10.0f) {
-      float visible_x1 = max(x1, tracks_canvas_pos_x);
-      float visible_x2 = min(x2, tracks_canvas_pos_x + inner_width);
-
-      if (visible_x2 > visible_x1) {
-        string_view_t name = trace_data_get_string(td, name_ref);
-        if (name.len > 0) {
-          // Calculate luminance of the event color to choose best text color
-          float r = (float)((col >> 0) & 0xFF) / 255.0f;
-          float g = (float)((col >> 8) & 0xFF) / 255.0f;
-          float b = (float)((col >> 16) & 0xFF) / 255.0f;
-          float lum = r * 0.299f + g * 0.587f + b * 0.114f;
-
-          // Use dark gray for light backgrounds, white for dark backgrounds
-          uint32_t text_col = (lum > 0.5f) ? IG_COL32(32, 32, 32, 255)
-                                           : IG_COL32(255, 255, 255, 255);
-          float event_font_size = ig_get_font_size();
-          float text_y = y1 + (lane_height - event_font_size) * 0.5f;
-
-          float text_width =
-              ig_font_calc_text_size_a(ig_get_font(), event_font_size, FLT_MAX,
-                                       0.0f, name.ptr, name.ptr + name.len)
-                  .x;
-
-          float text_x =
-              max(x1 + padding_h, x1 + (event_width - text_width) * 0.5f);
-
-          ig_vec4_t fine_clip_rect = {visible_x1 + padding_h, y1,
-                                      visible_x2 - padding_h, y2};
-
-          ig_draw_list_add_text(draw_list, ig_get_font(), event_font_size,
-                                (ig_vec2_t){text_x, text_y}, text_col, name.ptr,
-                                name.ptr + name.len, 0.0f, &fine_clip_rect);
-        }
-      }
-    }
+    event_label_t label = {
+        .x1 = x1, .x2 = x2, .y1 = y1, .y2 = y2, .col = col,
+        .name_ref = name_ref,
+    };
+    trace_viewer_draw_event_label(tv, td, draw_list, &label, inner_width,
+                                  tracks_canvas_pos_x, allocator);
   }
 }
 
@@ -431,7 +500,7 @@ static void trace_viewer_details_add_row(const char* field_label,
 static void trace_viewer_draw_event_properties(
     const trace_data_t* td, const trace_event_persisted_t* e,
     double viewport_min_ts, bool show_copy_buttons, const track_t* t,
-    const theme_t* theme, allocator_t* allocator) {
+    size_t t_pos, const theme_t* theme, allocator_t* allocator) {
   string_view_t name = trace_data_get_string(td, e->name_ref);
   string_view_t cat = trace_data_get_string(td, e->cat_ref);
   string_view_t ph = trace_data_get_string(td, e->ph_ref);
@@ -492,38 +561,15 @@ static void trace_viewer_draw_event_properties(
           show_copy_buttons, 0, false, allocator);
 
       if (t != nullptr && t->type == TRACK_TYPE_THREAD &&
-          t->self_durs.len > 0) {
-        const trace_event_persisted_t* events =
-            (const trace_event_persisted_t*)td->events.ptr;
-        const size_t* event_indices = (const size_t*)t->event_indices.ptr;
+          t_pos < t->self_durs.len) {
         const int64_t* self_durs = (const int64_t*)t->self_durs.ptr;
-
-        size_t global_event_idx = (size_t)(e - events);
-        size_t local_idx = trace_data_events_lower_bound(
-            event_indices, t->event_indices.len, events, e->ts);
-
-        bool found = false;
-        for (size_t k = local_idx; k < t->event_indices.len; k++) {
-          const trace_event_persisted_t* test_e = &events[event_indices[k]];
-          if (test_e->ts > e->ts) {
-            break;
-          }
-          if (event_indices[k] == global_event_idx) {
-            local_idx = k;
-            found = true;
-            break;
-          }
-        }
-
-        if (found) {
-          int64_t self_dur = self_durs[local_idx];
-          char self_dur_buf[32];
-          format_duration(self_dur_buf, sizeof(self_dur_buf), (double)self_dur,
-                          0.0);
-          trace_viewer_details_add_row(
-              "Self Time", (string_view_t){self_dur_buf, strlen(self_dur_buf)},
-              nullptr, show_copy_buttons, 0, false, allocator);
-        }
+        int64_t self_dur = self_durs[t_pos];
+        char self_dur_buf[32];
+        format_duration(self_dur_buf, sizeof(self_dur_buf), (double)self_dur,
+                        0.0);
+        trace_viewer_details_add_row(
+            "Self Time", (string_view_t){self_dur_buf, strlen(self_dur_buf)},
+            nullptr, show_copy_buttons, 0, false, allocator);
       }
     }
 
@@ -700,12 +746,15 @@ static void trace_viewer_draw_tooltip(trace_viewer_t* tv, trace_data_t* td,
   if (rb->count == 1) {
     const track_t* t = &tv->tracks.ptr[best_hm->track_idx];
     const trace_event_persisted_t* e = &td->events.ptr[rb->event_idx];
+    const track_event_location_t* loc =
+        trace_viewer_locate_event(tv, rb->event_idx);
+    size_t t_pos = loc ? loc->position : SIZE_MAX;
 
     ig_push_style_var(IG_STYLE_VAR_WINDOW_PADDING, (ig_vec2_t){10.0f, 10.0f});
     ig_begin_tooltip();
 
     trace_viewer_draw_event_properties(td, e, (double)tv->viewport.min_ts,
-                                       false, t, theme, allocator);
+                                       false, t, t_pos, theme, allocator);
     ig_end_tooltip();
     ig_pop_style_var(1);
   } else if (rb->count > 1) {
@@ -750,9 +799,12 @@ static void trace_viewer_draw_counter_track(
   darray_resize(&state->counter_current_values, t->counter_series.len,
                     allocator);
 
+  double blocks_start = platform_get_now();
   track_compute_counter_render_blocks(t, td, viewport_start, viewport_end,
                                       width, pos.x, focused_event_idx, state,
                                       &tv->counter_render_blocks, allocator);
+  tv->frame_stats.draw_render_blocks_ms += platform_get_now() - blocks_start;
+  tv->frame_stats.render_blocks += tv->counter_render_blocks.len;
 
   if (tv->counter_render_blocks.len == 0) return;
 
@@ -864,6 +916,8 @@ static void trace_viewer_box_select_update(trace_viewer_t* tv, trace_data_t* td,
   if (y1 > y2) swap(float, y1, y2);
 
   darray_clear(&tv->selected_event_indices);
+  allocator_t* search_allocator =
+      allocator_for_tag(allocator, MEMORY_TAG_SEARCH);
 
   double ts1 =
       trace_viewer_px_to_ts(tv->viewport.start_time, tv->viewport.end_time,
@@ -875,10 +929,9 @@ static void trace_viewer_box_select_update(trace_viewer_t* tv, trace_data_t* td,
   const track_t* tracks = tv->tracks.ptr;
   const track_view_info_t* track_infos = tv->track_infos.ptr;
 
-  for (size_t i = 0; i < tv->tracks.len; i++) {
+  for (size_t i = tv->visible_track_begin; i < tv->visible_track_end; i++) {
     const track_t* t = &tracks[i];
     const track_view_info_t* vi = &track_infos[i];
-    if (!vi->visible) continue;
 
     // Check track Y overlap
     if (vi->y + vi->height < y1 || vi->y > y2) continue;
@@ -909,7 +962,8 @@ static void trace_viewer_box_select_update(trace_viewer_t* tv, trace_data_t* td,
 
         if (event_y2 < y1 || event_y1 > y2) continue;
 
-        darray_push(&tv->selected_event_indices, (int64_t)*it, allocator);
+        darray_push(&tv->selected_event_indices, (int64_t)*it,
+                    search_allocator);
       }
     } else {
       // Counter track
@@ -928,7 +982,8 @@ static void trace_viewer_box_select_update(trace_viewer_t* tv, trace_data_t* td,
           for (const size_t* it = it_start;
                it < event_indices_ptr + t->event_indices.len; ++it) {
             if (events_ptr[*it].ts > (int64_t)ts2) break;
-            darray_push(&tv->selected_event_indices, (int64_t)*it, allocator);
+            darray_push(&tv->selected_event_indices, (int64_t)*it,
+                        search_allocator);
           }
         }
       }
@@ -949,7 +1004,8 @@ static void trace_viewer_box_select_update(trace_viewer_t* tv, trace_data_t* td,
                             !tv->search.sort_active, allocator);
 
   // Calculate the duration histogram of the selected events synchronously
-  trace_histogram_compute(&tv->selected_event_indices, td, &tv->histogram);
+  trace_histogram_compute(&tv->selected_event_indices, td, &tv->histogram,
+                          allocator);
 
   tv->selected_events_dirty = true;
   tv->search_histogram_dirty = true;
@@ -1017,9 +1073,132 @@ void trace_viewer_clear_search(trace_viewer_t* tv, allocator_t* allocator) {
   tv->search.is_searching = false;
 }
 
+void trace_viewer_index_events(trace_viewer_t* tv, const trace_data_t* td,
+                               allocator_t* allocator) {
+  if (tv->event_locations_tracks != tv->tracks.ptr ||
+      tv->event_locations.len != td->events.len) {
+    allocator_t* tracks_allocator =
+        allocator_for_tag(allocator, MEMORY_TAG_TRACKS);
+    track_build_event_locations(&tv->tracks, td->events.len,
+                                &tv->event_locations, tracks_allocator);
+    tv->event_locations_tracks = tv->tracks.ptr;
+  }
+}
+
+// Rebuilds the prefix sum of track heights in track_infos when the tracks or
+// the lane height changed since the last frame.
+static void trace_viewer_update_track_layout(trace_viewer_t* tv,
+                                             float lane_height,
+                                             allocator_t* allocator) {
+  if (tv->track_layout_dirty || tv->track_layout_tracks != tv->tracks.ptr ||
+      tv->track_infos.len != tv->tracks.len ||
+      tv->track_layout_lane_height != lane_height) {
+    darray_resize(&tv->track_infos, tv->tracks.len, allocator);
+    const track_t* tracks = tv->tracks.ptr;
+    track_view_info_t* track_infos = tv->track_infos.ptr;
+    float counter_track_height = 3.0f * lane_height;
+    float y_rel = 0.0f;
+    for (size_t i = 0; i < tv->tracks.len; i++) {
+      const track_t* t = &tracks[i];
+      track_view_info_t* vi = &track_infos[i];
+      vi->height = (t->type == TRACK_TYPE_COUNTER)
+                       ? counter_track_height
+                       : (float)(t->max_depth + 2) * lane_height;
+      vi->y_rel = y_rel;
+      vi->visible = false;
+      vi->name[0] = '\0';
+      y_rel += vi->height;
+    }
+    tv->total_tracks_height = y_rel;
+    tv->track_layout_dirty = false;
+    tv->track_layout_tracks = tv->tracks.ptr;
+    tv->track_layout_lane_height = lane_height;
+    tv->visible_track_begin = 0;
+    tv->visible_track_end = 0;
+  }
+}
+
+// Formats the header name of track `t` into `vi->name`.
+static void trace_viewer_format_track_name(const track_t* t,
+                                           const trace_data_t* td,
+                                           track_view_info_t* vi) {
+  string_view_t name_str = trace_data_get_string(td, t->name_ref);
+  string_view_t id_str = trace_data_get_string(td, t->id_ref);
+
+  if (name_str.len == 0) {
+    if (t->type == TRACK_TYPE_THREAD) {
+      snprintf(vi->name, sizeof(vi->name), "Thread %d", t->tid);
+    } else {
+      snprintf(vi->name, sizeof(vi->name), "Counter");
+    }
+  } else if (id_str.len > 0) {
+    snprintf(vi->name, sizeof(vi->name), "%.*s (%.*s)", (int)name_str.len,
+             name_str.ptr, (int)id_str.len, id_str.ptr);
+  } else {
+    snprintf(vi->name, sizeof(vi->name), "%.*s", (int)name_str.len,
+             name_str.ptr);
+  }
+}
+
+// Finds the tracks overlapping the tracks area by binary search over the
+// cached layout, and positions and names only those.
+static void trace_viewer_cull_tracks(trace_viewer_t* tv,
+                                     const trace_data_t* td,
+                                     const trace_viewer_input_t* input) {
+  const track_t* tracks = tv->tracks.ptr;
+  track_view_info_t* track_infos = tv->track_infos.ptr;
+  for (size_t i = tv->visible_track_begin; i < tv->visible_track_end; i++) {
+    track_infos[i].visible = false;
+  }
+
+  // A track is visible when y_rel + height >= view_top and y_rel <=
+  // view_bottom, both in unscrolled track coordinates.
+  float view_top = input->tracks_scroll_y;
+  float view_bottom =
+      input->tracks_scroll_y + input->canvas_height - input->ruler_height;
+  size_t lo = 0;
+  size_t hi = tv->track_infos.len;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (track_infos[mid].y_rel + track_infos[mid].height < view_top) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  size_t begin = lo;
+  hi = tv->track_infos.len;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (track_infos[mid].y_rel <= view_bottom) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  size_t end = lo;
+
+  for (size_t i = begin; i < end; i++) {
+    track_view_info_t* vi = &track_infos[i];
+    vi->y = input->canvas_y + input->ruler_height + vi->y_rel -
+            input->tracks_scroll_y;
+    vi->visible = true;
+    trace_viewer_format_track_name(&tracks[i], td, vi);
+  }
+  tv->visible_track_begin = begin;
+  tv->visible_track_end = end;
+}
+
 void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
                        const trace_viewer_input_t* input,
                        allocator_t* allocator) {
+  SELF_TRACE_BEGIN("trace_viewer_step");
+  allocator_t* render_allocator =
+      allocator_for_tag(allocator, MEMORY_TAG_RENDER);
+  allocator_t* search_allocator =
+      allocator_for_tag(allocator, MEMORY_TAG_SEARCH);
+  trace_viewer_index_events(tv, td, allocator);
+
   // 0. Handle focus requests
   if (tv->has_target_focused_event) {
     size_t event_idx = tv->target_focused_event_idx;
@@ -1212,10 +1391,9 @@ void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
   // 3. Track Layout and Pass 1: Culling, Naming, Snapping, Hit-testing
   darray_clear(&tv->hover_matches);
 
-  darray_resize(&tv->track_infos, tv->tracks.len, allocator);
-  tv->total_tracks_height = 0.0f;
+  trace_viewer_update_track_layout(tv, input->lane_height, render_allocator);
+  trace_viewer_cull_tracks(tv, td, input);
 
-  float counter_track_height = 3.0f * input->lane_height;
   bool track_list_hovered =
       input->tracks_hovered && mouse_in_tracks_content &&
       (mouse_in_selection || input->is_mouse_double_clicked) &&
@@ -1231,26 +1409,20 @@ void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
 
   if (tv->selected_events_dirty) {
     track_renderer_update_selection_bitset(
-        &tv->track_renderer_state, td, &tv->selected_event_indices, allocator);
+        &tv->track_renderer_state, td, &tv->selected_event_indices,
+        render_allocator);
 
     darray_resize(&tv->vertical_minimap.track_has_selected, tv->tracks.len,
-                      allocator);
+                      render_allocator);
     bool* track_has_selected = tv->vertical_minimap.track_has_selected.ptr;
-    const track_t* tracks = tv->tracks.ptr;
-
-    for (size_t i = 0; i < tv->tracks.len; i++) {
-      const track_t* t = &tracks[i];
-      bool has_sel = false;
-      const size_t* event_indices_ptr = t->event_indices.ptr;
-      for (size_t j = 0; j < t->event_indices.len; j++) {
-        size_t event_idx = event_indices_ptr[j];
-        if (event_idx < tv->track_renderer_state.selected_events_bitset.len &&
-            tv->track_renderer_state.selected_events_bitset.ptr[event_idx] != 0) {
-          has_sel = true;
-          break;
-        }
+    memset(track_has_selected, 0, tv->tracks.len * sizeof(bool));
+    const int64_t* selected = tv->selected_event_indices.ptr;
+    for (size_t i = 0; i < tv->selected_event_indices.len; i++) {
+      const track_event_location_t* loc =
+          trace_viewer_locate_event(tv, (size_t)selected[i]);
+      if (loc) {
+        track_has_selected[loc->track_idx] = true;
       }
-      track_has_selected[i] = has_sel;
     }
 
     tv->selected_events_dirty = false;
@@ -1259,128 +1431,99 @@ void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
   track_t* tracks = (track_t*)tv->tracks.ptr;
   track_view_info_t* track_infos = (track_view_info_t*)tv->track_infos.ptr;
 
-  for (size_t i = 0; i < tv->tracks.len; i++) {
+  if (tv->request_scroll_to_focused_event && tv->has_focused_event) {
+    const track_event_location_t* loc =
+        trace_viewer_locate_event(tv, tv->focused_event_idx);
+    if (loc) {
+      const track_view_info_t* vi = &track_infos[loc->track_idx];
+      float viewport_height = input->canvas_height - input->ruler_height;
+      tv->target_scroll_y = vi->y_rel - (viewport_height - vi->height) * 0.5f;
+      tv->has_target_scroll_y = true;
+      tv->request_scroll_to_focused_event = false;
+    }
+  }
+
+  // Everything in this loop but computing render blocks is hover work.
+  double blocks_ms = 0.0;
+  double pass_start = platform_get_now();
+  for (size_t i = tv->visible_track_begin; i < tv->visible_track_end; i++) {
     track_t* t = &tracks[i];
     track_view_info_t* vi = &track_infos[i];
+    double blocks_start = platform_get_now();
+    if (t->type == TRACK_TYPE_THREAD) {
+      track_compute_render_blocks(
+          t, td, tv->viewport.start_time, tv->viewport.end_time,
+          tracks_inner_width, tracks_origin_x,
+          tv->has_focused_event ? (int64_t)tv->focused_event_idx : -1,
+          &tv->track_renderer_state, &tv->render_blocks, render_allocator);
+      blocks_ms += platform_get_now() - blocks_start;
+
+      const track_render_block_t* rblocks = tv->render_blocks.ptr;
+      for (size_t k = 0; k < tv->render_blocks.len; k++) {
+        const track_render_block_t* rb = &rblocks[k];
+        float y1 = vi->y + (float)(rb->depth + 1) * input->lane_height;
+        float y2 = y1 + input->lane_height - 1.0f;
+
+        // Snapping
+        if (should_snap) {
+          double ts1 = trace_viewer_px_to_ts(
+              tv->viewport.start_time, tv->viewport.end_time,
+              tracks_inner_width, tracks_origin_x, rb->x1);
+          trace_viewer_snapping_suggest(tv, ts1, rb->x1, input->mouse_x, y1,
+                                        y2);
+          double ts2 = trace_viewer_px_to_ts(
+              tv->viewport.start_time, tv->viewport.end_time,
+              tracks_inner_width, tracks_origin_x, rb->x2);
+          trace_viewer_snapping_suggest(tv, ts2, rb->x2, input->mouse_x, y1,
+                                        y2);
+        }
 
-    vi->height = (t->type == TRACK_TYPE_COUNTER)
-                     ? counter_track_height
-                     : (float)(t->max_depth + 2) * input->lane_height;
-    vi->y_rel = tv->total_tracks_height;
-    vi->y = input->canvas_y + input->ruler_height + tv->total_tracks_height -
-            input->tracks_scroll_y;
-
-    const size_t* event_indices_ptr = (const size_t*)t->event_indices.ptr;
-
-    if (tv->request_scroll_to_focused_event && tv->has_focused_event) {
-      for (size_t j = 0; j < t->event_indices.len; j++) {
-        if (event_indices_ptr[j] == tv->focused_event_idx) {
-          float track_top = tv->total_tracks_height;
-          float viewport_height = input->canvas_height - input->ruler_height;
-          tv->target_scroll_y =
-              track_top - (viewport_height - vi->height) * 0.5f;
-          tv->has_target_scroll_y = true;
-          tv->request_scroll_to_focused_event = false;
-          break;
+        // Hit-testing
+        if (track_list_hovered && input->mouse_y >= y1 &&
+            input->mouse_y < y2 && input->mouse_x >= rb->x1 &&
+            input->mouse_x < rb->x2) {
+          hover_match_t match = {i, k, y1, y2, *rb};
+          darray_push(&tv->hover_matches, match, render_allocator);
         }
       }
-    }
 
-    tv->total_tracks_height += vi->height;
-
-    // Frustum culling
-    vi->visible =
-        (vi->y + vi->height >= input->canvas_y + input->ruler_height &&
-         vi->y <= input->canvas_y + input->canvas_height);
-
-    // Format header name
-    string_view_t name_str = trace_data_get_string(td, t->name_ref);
-    string_view_t id_str = trace_data_get_string(td, t->id_ref);
-
-    if (name_str.len == 0) {
-      if (t->type == TRACK_TYPE_THREAD) {
-        snprintf(vi->name, sizeof(vi->name), "Thread %d", t->tid);
-      } else {
-        snprintf(vi->name, sizeof(vi->name), "Counter");
-      }
-    } else if (id_str.len > 0) {
-      snprintf(vi->name, sizeof(vi->name), "%.*s (%.*s)", (int)name_str.len,
-               name_str.ptr, (int)id_str.len, id_str.ptr);
     } else {
-      snprintf(vi->name, sizeof(vi->name), "%.*s", (int)name_str.len,
-               name_str.ptr);
-    }
-
-    if (vi->visible) {
-      if (t->type == TRACK_TYPE_THREAD) {
-        track_compute_render_blocks(
-            t, td, tv->viewport.start_time, tv->viewport.end_time,
-            tracks_inner_width, tracks_origin_x,
-            tv->has_focused_event ? (int64_t)tv->focused_event_idx : -1,
-            &tv->track_renderer_state, &tv->render_blocks, allocator);
-
-        const track_render_block_t* rblocks = tv->render_blocks.ptr;
-        for (size_t k = 0; k < tv->render_blocks.len; k++) {
-          const track_render_block_t* rb = &rblocks[k];
-          float y1 = vi->y + (float)(rb->depth + 1) * input->lane_height;
-          float y2 = y1 + input->lane_height - 1.0f;
-
-          // Snapping
-          if (should_snap) {
-            double ts1 = trace_viewer_px_to_ts(
-                tv->viewport.start_time, tv->viewport.end_time,
-                tracks_inner_width, tracks_origin_x, rb->x1);
-            trace_viewer_snapping_suggest(tv, ts1, rb->x1, input->mouse_x, y1,
-                                          y2);
-            double ts2 = trace_viewer_px_to_ts(
-                tv->viewport.start_time, tv->viewport.end_time,
-                tracks_inner_width, tracks_origin_x, rb->x2);
-            trace_viewer_snapping_suggest(tv, ts2, rb->x2, input->mouse_x, y1,
-                                          y2);
-          }
-
-          // Hit-testing
-          if (track_list_hovered && input->mouse_y >= y1 &&
-              input->mouse_y < y2 && input->mouse_x >= rb->x1 &&
-              input->mouse_x < rb->x2) {
-            hover_match_t match = {i, k, y1, y2, *rb};
-            darray_push(&tv->hover_matches, match, allocator);
-          }
-        }
-
-      } else {
-        // Counter hit-testing
-        track_compute_counter_render_blocks(
-            t, td, tv->viewport.start_time, tv->viewport.end_time,
-            tracks_inner_width, tracks_origin_x,
-            tv->has_focused_event ? (int64_t)tv->focused_event_idx : -1,
-            &tv->track_renderer_state, &tv->counter_render_blocks, allocator);
-
-        float track_content_y = vi->y + input->lane_height;
-        float track_content_h = vi->height - input->lane_height;
-
-        if (track_list_hovered && input->mouse_y >= track_content_y &&
-            input->mouse_y < track_content_y + track_content_h) {
-          const counter_render_block_t* crblocks = tv->counter_render_blocks.ptr;
-          for (size_t k = 0; k < tv->counter_render_blocks.len; k++) {
-            const counter_render_block_t* rb = &crblocks[k];
-            if (input->mouse_x >= rb->x1 && input->mouse_x < rb->x2) {
-              hover_match_t match = {i,
-                                     k,
-                                     track_content_y,
-                                     track_content_y + track_content_h,
-                                     {0}};
-              match.rb.event_idx = rb->event_idx;
-              match.rb.count = (rb->event_idx != (size_t)-1) ? 1 : 0;
-              darray_push(&tv->hover_matches, match, allocator);
-              break;
-            }
+      // Counter hit-testing
+      track_compute_counter_render_blocks(
+          t, td, tv->viewport.start_time, tv->viewport.end_time,
+          tracks_inner_width, tracks_origin_x,
+          tv->has_focused_event ? (int64_t)tv->focused_event_idx : -1,
+          &tv->track_renderer_state, &tv->counter_render_blocks,
+          render_allocator);
+      blocks_ms += platform_get_now() - blocks_start;
+
+      float track_content_y = vi->y + input->lane_height;
+      float track_content_h = vi->height - input->lane_height;
+
+      if (track_list_hovered && input->mouse_y >= track_content_y &&
+          input->mouse_y < track_content_y + track_content_h) {
+        const counter_render_block_t* crblocks = tv->counter_render_blocks.ptr;
+        for (size_t k = 0; k < tv->counter_render_blocks.len; k++) {
+          const counter_render_block_t* rb = &crblocks[k];
+          if (input->mouse_x >= rb->x1 && input->mouse_x < rb->x2) {
+            hover_match_t match = {i,
+                                   k,
+                                   track_content_y,
+                                   track_content_y + track_content_h,
+                                   {0}};
+            match.rb.event_idx = rb->event_idx;
+            match.rb.count = (rb->event_idx != (size_t)-1) ? 1 : 0;
+            darray_push(&tv->hover_matches, match, render_allocator);
+            break;
           }
         }
       }
     }
   }
 
+  tv->frame_stats.step_render_blocks_ms = blocks_ms;
+  tv->frame_stats.hover_ms = platform_get_now() - pass_start - blocks_ms;
+
   // 4. Boundary Updates (using pre-calculated snap_best_ts from THIS frame)
   if (!interaction_ignored) {
     if (input->ruler_active) {
@@ -1493,7 +1636,7 @@ void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
     tick.x = x;
     tick.ts_rel = t_rel;
     format_duration(tick.label, sizeof(tick.label), t_rel, tick_interval);
-    darray_push(&tv->ruler_ticks, tick, allocator);
+    darray_push(&tv->ruler_ticks, tick, render_allocator);
   }
 
   tv->last_best_snap_ts = tv->snap_best_ts;
@@ -1507,7 +1650,8 @@ void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
       for (size_t i = 0; i < tv->selected_event_indices.len; i++) {
         size_t idx = (size_t)selected_ptr[i];
         if (idx < td->events.len) {
-          darray_push(&tv->filtered_event_indices, (int64_t)idx, allocator);
+          darray_push(&tv->filtered_event_indices, (int64_t)idx,
+                      search_allocator);
         }
       }
     } else if (tv->has_selected_histogram_bucket &&
@@ -1523,7 +1667,8 @@ void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
         int64_t d = e->dur;
 
         if (d >= b->min_dur && d <= b->max_dur) {
-          darray_push(&tv->filtered_event_indices, (int64_t)idx, allocator);
+          darray_push(&tv->filtered_event_indices, (int64_t)idx,
+                      search_allocator);
         }
       }
     }
@@ -1531,6 +1676,7 @@ void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
 
   // 7. Precompute Vertical Minimap Layout & Interaction
   trace_viewer_step_vertical_minimap(tv, input);
+  SELF_TRACE_END();
 }
 
 static void trace_viewer_step_vertical_minimap(
@@ -1793,8 +1939,147 @@ static void trace_viewer_draw_vertical_minimap(const trace_viewer_t* tv,
       slider_col);
 }
 
+// Asks for the call tree of the ruler selection once it settles on a range
+// other than the one shown or already asked for.
+static void trace_viewer_request_call_tree(trace_viewer_t* tv) {
+  double t1 = tv->selection_start_time;
+  double t2 = tv->selection_end_time;
+  if (t1 > t2) swap(double, t1, t2);
+  bool asked = tv->call_tree_requested || tv->call_tree_computing;
+  double start =
+      asked ? tv->call_tree_request_start_time : tv->call_tree_start_time;
+  double end = asked ? tv->call_tree_request_end_time : tv->call_tree_end_time;
+  bool changed = (!tv->has_call_tree && !asked) || tv->call_tree_dirty ||
+                 t1 != start || t2 != end;
+  if (changed && tv->selection_drag_mode == INTERACTION_DRAG_MODE_NONE) {
+    tv->call_tree_requested = true;
+    tv->call_tree_dirty = false;
+    tv->call_tree_request_start_time = t1;
+    tv->call_tree_request_end_time = t2;
+  }
+}
+
+void trace_viewer_adopt_call_tree(trace_viewer_t* tv, trace_call_tree_t tree,
+                                  darray_uint32_t order,
+                                  darray_double_t offsets, double start_time,
+                                  double end_time, allocator_t* allocator) {
+  if (tv->has_call_tree) {
+    trace_call_tree_deinit(&tv->call_tree, allocator);
+  }
+  darray_deinit(&tv->call_tree_order, allocator);
+  darray_deinit(&tv->call_tree_offsets, allocator);
+  tv->call_tree = tree;
+  tv->call_tree_order = order;
+  tv->call_tree_offsets = offsets;
+  tv->has_call_tree = true;
+  tv->call_tree_start_time = start_time;
+  tv->call_tree_end_time = end_time;
+}
+
+// Draws the merged call tree of the ruler selection as an icicle chart: top
+// level frames on the first row, each frame as wide as its share of the
+// selection's total time.
+static void trace_viewer_draw_flame_graph(trace_viewer_t* tv,
+                                          const trace_data_t* td,
+                                          const theme_t* theme) {
+  if (tv->selection_active) {
+    trace_viewer_request_call_tree(tv);
+  }
+  const trace_call_tree_node_t* nodes = tv->call_tree.nodes.ptr;
+  double root_total = tv->has_call_tree ? nodes[0].total_duration : 0.0;
+  bool updating = tv->call_tree_requested || tv->call_tree_computing;
+
+  if (!tv->selection_active) {
+    ig_text_disabled("Select a time range on the ruler to see its call tree.");
+  } else if (!tv->has_call_tree) {
+    ig_text_disabled("Computing the call tree...");
+  } else if (root_total <= 0.0) {
+    ig_text_disabled(updating ? "Computing the call tree..."
+                              : "No events in the selection.");
+  } else {
+    uint32_t max_depth = 0;
+    for (size_t i = 0; i < tv->call_tree.nodes.len; i++) {
+      if (nodes[i].depth > max_depth) max_depth = nodes[i].depth;
+    }
+    char total_buf[32];
+    format_duration(total_buf, sizeof(total_buf), root_total, 0.0);
+    ig_text_disabled("%zu frames, %s across all threads%s",
+                     tv->call_tree.nodes.len - 1, total_buf,
+                     updating ? " (updating...)" : "");
+
+    if (ig_begin_child("FlameGraph", (ig_vec2_t){0.0f, 0.0f}, false, 0)) {
+      float row_height = ig_get_frame_height();
+      ig_vec2_t origin = ig_get_cursor_screen_pos();
+      float width = ig_get_content_region_avail().x;
+      ig_invisible_button("##flame_graph",
+                          (ig_vec2_t){width, row_height * (float)max_depth});
+      bool is_hovered = ig_is_item_hovered();
+      ig_vec2_t mouse_pos = ig_get_io_mouse_pos();
+      ig_draw_list_t* draw_list = ig_get_window_draw_list();
+      float font_size = ig_get_font_size();
+      float padding_h = 4.0f;
+
+      uint32_t hovered_node = TRACE_CALL_TREE_NONE;
+      const double* offsets = tv->call_tree_offsets.ptr;
+      for (size_t i = 1; i < tv->call_tree_order.len; i++) {
+        uint32_t node = tv->call_tree_order.ptr[i];
+        const trace_call_tree_node_t* n = &nodes[node];
+        float x1 = origin.x + (float)(offsets[node] / root_total) * width;
+        float w = (float)(n->total_duration / root_total) * width;
+        if (w < 1.0f) continue;
+        float y1 = origin.y + (float)(n->depth - 1) * row_height;
+        float x2 = x1 + w - 1.0f;
+        float y2 = y1 + row_height - 1.0f;
+
+        uint32_t col = theme->event_palette[n->palette_index];
+        ig_draw_list_add_rect_filled(draw_list, (ig_vec2_t){x1, y1},
+                                     (ig_vec2_t){x2, y2}, col);
+        if (is_hovered && mouse_pos.x >= x1 && mouse_pos.x < x2 &&
+            mouse_pos.y >= y1 && mouse_pos.y < y2) {
+          hovered_node = node;
+          ig_draw_list_add_rect(draw_list, (ig_vec2_t){x1, y1},
+                                (ig_vec2_t){x2, y2},
+                                theme->event_border_focused, 0.0f, 0, 1.0f);
+        }
+
+        string_view_t name = trace_data_get_string(td, n->name_ref);
+        if (w > padding_h * 2.0f + 10.0f && name.len > 0) {
+          ig_vec4_t clip_rect = {x1 + padding_h, y1, x2 - padding_h, y2};
+          ig_draw_list_add_text(
+              draw_list, ig_get_font(), font_size,
+              (ig_vec2_t){x1 + padding_h, y1 + (row_height - font_size) * 0.5f},
+              trace_viewer_text_color_on(col), name.ptr, name.ptr + name.len,
+              0.0f, &clip_rect);
+        }
+      }
+
+      if (hovered_node != TRACE_CALL_TREE_NONE) {
+        const trace_call_tree_node_t* n = &nodes[hovered_node];
+        string_view_t name = trace_data_get_string(td, n->name_ref);
+        char dur_buf[32], self_buf[32];
+        format_duration(dur_buf, sizeof(dur_buf), n->total_duration, 0.0);
+        format_duration(self_buf, sizeof(self_buf),
+                        n->self_duration > 0.0 ? n->self_duration : 0.0, 0.0);
+        ig_begin_tooltip();
+        ig_text("%.*s", (int)name.len, name.ptr);
+        ig_text("Total: %s (%.1f%%)", dur_buf,
+                n->total_duration / root_total * 100.0);
+        ig_text("Self: %s", self_buf);
+        ig_text("Count: %zu", n->count);
+        ig_end_tooltip();
+      }
+    }
+    ig_end_child();
+  }
+}
+
 void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
                        allocator_t* allocator, const theme_t* theme_ptr) {
+  SELF_TRACE_BEGIN("trace_viewer_draw");
+  double draw_start = platform_get_now();
+  tv->frame_stats = (trace_viewer_frame_stats_t){};
+  allocator_t* render_allocator =
+      allocator_for_tag(allocator, MEMORY_TAG_RENDER);
   const theme_t* theme = theme_ptr;
 
   if (td->events.len > 0) {
@@ -1874,7 +2159,9 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
     }
     ig_end_child();
 
+    double step_start = platform_get_now();
     trace_viewer_step(tv, td, &input, allocator);
+    tv->frame_stats.step_ms = platform_get_now() - step_start;
 
     // --- Drawing Phase ---
     ig_draw_list_t* draw_list = ig_get_window_draw_list();
@@ -1916,6 +2203,8 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
       }
 
       ig_draw_list_t* track_draw_list = ig_get_window_draw_list();
+      text_width_cache_set_font(&tv->label_widths, ig_get_font(),
+                                ig_get_font_size());
 
       ig_dummy((ig_vec2_t){0.0f, tv->total_tracks_height});
       ig_set_cursor_pos((ig_vec2_t){0, 0});
@@ -1933,13 +2222,14 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
       const track_t* tracks = (const track_t*)tv->tracks.ptr;
       const track_view_info_t* track_infos =
           (const track_view_info_t*)tv->track_infos.ptr;
+      darray_clear(&tv->event_rects);
+      darray_clear(&tv->event_labels);
 
-      for (size_t i = 0; i < tv->tracks.len; i++) {
+      for (size_t i = tv->visible_track_begin; i < tv->visible_track_end;
+           i++) {
         const track_t* t = &tracks[i];
         const track_view_info_t* vi = &track_infos[i];
 
-        if (!vi->visible) continue;
-
         ig_vec2_t track_pos = {tracks_canvas_pos.x, vi->y};
 
         ig_draw_list_add_rect_filled(
@@ -1970,6 +2260,7 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
         ig_draw_list_add_text(track_draw_list, ig_get_font(), font_size,
                               text_pos, theme->track_text, vi->name,
                               vi->name + display_name_len, 0.0f, nullptr);
+        tv->frame_stats.text_draws++;
 
         ig_vec2_t text_size =
             ig_font_calc_text_size_a(ig_get_font(), font_size, FLT_MAX, 0.0f,
@@ -1996,11 +2287,15 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
         }
 
         if (t->type == TRACK_TYPE_THREAD) {
+          double blocks_start = platform_get_now();
           track_compute_render_blocks(
               t, td, tv->viewport.start_time, tv->viewport.end_time,
               inner_width, tracks_canvas_pos.x,
               tv->has_focused_event ? (int64_t)tv->focused_event_idx : -1,
-              &tv->track_renderer_state, &tv->render_blocks, allocator);
+              &tv->track_renderer_state, &tv->render_blocks, render_allocator);
+          tv->frame_stats.draw_render_blocks_ms +=
+              platform_get_now() - blocks_start;
+          tv->frame_stats.render_blocks += tv->render_blocks.len;
 
           const track_render_block_t* rblocks =
               (const track_render_block_t*)tv->render_blocks.ptr;
@@ -2008,12 +2303,24 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
             const track_render_block_t* rb = &rblocks[k];
             float y1 = track_pos.y + (float)(rb->depth + 1) * input.lane_height;
             float y2 = y1 + input.lane_height - 1.0f;
-
-            trace_viewer_draw_event(tv, td, track_draw_list, rb->x1, rb->x2, y1,
-                                    y2, theme->event_palette[rb->palette_index],
-                                    rb->is_selected, rb->is_focused,
-                                    rb->name_ref, inner_width,
-                                    tracks_canvas_pos.x, theme);
+            uint32_t col = theme->event_palette[rb->palette_index];
+
+            ig_rect_instance_t rect = {
+                .x1 = rb->x1, .y1 = y1, .x2 = rb->x2, .y2 = y2, .color = col,
+            };
+            rect.flags =
+                trace_viewer_event_border(rb->x1, rb->x2, rb->is_selected,
+                                          rb->is_focused, theme,
+                                          &rect.border_color);
+            darray_push(&tv->event_rects, rect, render_allocator);
+
+            if (rb->name_ref != 0) {
+              event_label_t label = {
+                  .x1 = rb->x1, .x2 = rb->x2, .y1 = y1, .y2 = y2, .col = col,
+                  .name_ref = rb->name_ref,
+              };
+              darray_push(&tv->event_labels, label, render_allocator);
+            }
           }
         } else {
           bool mouse_in_sel =
@@ -2029,10 +2336,21 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
               tv->viewport.start_time, tv->viewport.end_time, theme,
               (ig_vec2_t){input.mouse_x, input.mouse_y}, mouse_in_sel,
               tv->has_focused_event ? (int64_t)tv->focused_event_idx : -1,
-              allocator);
+              render_allocator);
         }
       }
 
+      // Event blocks don't overlap the track headers or counter tracks drawn
+      // above, so all of them go in one batch, with the labels on top.
+      ig_draw_list_add_rect_instances(track_draw_list, tv->event_rects.ptr,
+                                      tv->event_rects.len);
+      const event_label_t* labels = (const event_label_t*)tv->event_labels.ptr;
+      for (size_t k = 0; k < tv->event_labels.len; k++) {
+        trace_viewer_draw_event_label(tv, td, track_draw_list, &labels[k],
+                                      inner_width, tracks_canvas_pos.x,
+                                      render_allocator);
+      }
+
       // Handle hover highlighting and tooltip
       if (tv->hover_matches.len > 0) {
         const hover_match_t* hover_matches =
@@ -2067,7 +2385,8 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
             trace_viewer_draw_event(tv, td, track_draw_list, rb->x1, rb->x2,
                                     best_hm->y1, best_hm->y2, col, false,
                                     rb->is_focused, rb->name_ref, inner_width,
-                                    tracks_canvas_pos.x, theme);
+                                    tracks_canvas_pos.x, theme,
+                                    render_allocator);
           }
         }
 
@@ -2139,6 +2458,14 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
           ig_spacing();
           ig_text_disabled("Duration Distribution");
 
+          char p50_str[32], p90_str[32], p99_str[32], max_str[32];
+          format_duration(p50_str, sizeof(p50_str), h->p50_dur, 0.0);
+          format_duration(p90_str, sizeof(p90_str), h->p90_dur, 0.0);
+          format_duration(p99_str, sizeof(p99_str), h->p99_dur, 0.0);
+          format_duration(max_str, sizeof(max_str), h->max_dur, 0.0);
+          ig_text("p50 %s  p90 %s  p99 %s  max %s", p50_str, p90_str, p99_str,
+                  max_str);
+
           ig_vec2_t h_canvas_pos = ig_get_cursor_screen_pos();
           float h_canvas_width = ig_get_content_region_avail().x;
           float h_canvas_height = 80.0f;
@@ -2418,37 +2745,21 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
         const trace_event_persisted_t* events =
             (const trace_event_persisted_t*)td->events.ptr;
         const trace_event_persisted_t* e = &events[tv->focused_event_idx];
-        string_view_t ph = trace_data_get_string(td, e->ph_ref);
         const track_t* target_track = nullptr;
-
-        const track_t* tracks = (const track_t*)tv->tracks.ptr;
-        // Match track containing selected event
-        for (size_t t_idx = 0; t_idx < tv->tracks.len; t_idx++) {
-          const track_t* test_t = &tracks[t_idx];
-          bool is_counter = (ph.len == 1 && ph.ptr[0] == 'C');
-
-          if (is_counter) {
-            if (test_t->type == TRACK_TYPE_COUNTER && test_t->pid == e->pid &&
-                test_t->name_ref == e->name_ref &&
-                test_t->id_ref == e->id_ref) {
-              target_track = test_t;
-              break;
-            }
-          } else {
-            if (test_t->type == TRACK_TYPE_THREAD && test_t->pid == e->pid &&
-                test_t->tid == e->tid) {
-              target_track = test_t;
-              break;
-            }
-          }
+        size_t target_pos = SIZE_MAX;
+        const track_event_location_t* loc =
+            trace_viewer_locate_event(tv, tv->focused_event_idx);
+        if (loc) {
+          target_track = &tv->tracks.ptr[loc->track_idx];
+          target_pos = loc->position;
         }
 
         ig_text_disabled("Focused Event");
         ig_spacing();
 
         trace_viewer_draw_event_properties(td, e, (double)tv->viewport.min_ts,
-                                           true, target_track, theme,
-                                           allocator);
+                                           true, target_track, target_pos,
+                                           theme, allocator);
       }
 
       if (!has_focus && !has_selection) {
@@ -2458,9 +2769,22 @@ void trace_viewer_draw(trace_viewer_t* tv, trace_data_t* td,
     ig_end();
     ig_pop_style_var(1);
   }
+
+  if (tv->show_flame_graph_panel) {
+    if (ig_begin("Flame Graph", &tv->show_flame_graph_panel,
+                 IG_WINDOW_FLAGS_NO_FOCUS_ON_APPEARING)) {
+      trace_viewer_draw_flame_graph(tv, td, theme);
+    }
+    ig_end();
+  }
+  tv->frame_stats.draw_ms =
+      platform_get_now() - draw_start - tv->frame_stats.step_ms;
+  SELF_TRACE_END();
 }
 
-void trace_viewer_reset_view(trace_viewer_t* tv) {
+// The view trace_viewer_reset_view shows: the whole trace with some margin.
+static void trace_viewer_get_full_view(const trace_viewer_t* tv,
+                                       double* out_start, double* out_end) {
   double trace_start = (double)tv->viewport.min_ts;
   double trace_end = (double)tv->viewport.max_ts;
   double trace_duration = trace_end - trace_start;
@@ -2470,9 +2794,80 @@ void trace_viewer_reset_view(trace_viewer_t* tv) {
   if (max_duration < min_duration) max_duration = min_duration;
 
   double center = (trace_start + trace_end) * 0.5;
-  tv->viewport.start_time = center - max_duration * 0.5;
-  tv->viewport.end_time = center + max_duration * 0.5;
+  *out_start = center - max_duration * 0.5;
+  *out_end = center + max_duration * 0.5;
+}
+
+void trace_viewer_reset_view(trace_viewer_t* tv) {
+  trace_viewer_get_full_view(tv, &tv->viewport.start_time,
+                             &tv->viewport.end_time);
   tv->selected_events_dirty = true;
+  tv->track_layout_dirty = true;
+  tv->call_tree_dirty = true;
+  text_width_cache_clear(&tv->label_widths);
+}
+
+// Whether the user moved the view away from the whole range of the tracks
+// shown, so it is kept when they are replaced or grow.
+static bool trace_viewer_keeps_view(const trace_viewer_t* tv) {
+  double full_start, full_end;
+  trace_viewer_get_full_view(tv, &full_start, &full_end);
+  return tv->tracks.len > 0 && (tv->viewport.start_time != full_start ||
+                                tv->viewport.end_time != full_end);
+}
+
+// Rebuilds what is derived from the tracks after they changed.
+static void trace_viewer_tracks_changed(trace_viewer_t* tv,
+                                        const trace_data_t* td, int64_t min_ts,
+                                        int64_t max_ts, bool keep_view,
+                                        allocator_t* allocator) {
+  tv->viewport.min_ts = min_ts;
+  tv->viewport.max_ts = max_ts;
+  // The new tracks may reuse the address of the old ones.
+  tv->event_locations_tracks = nullptr;
+  tv->track_layout_tracks = nullptr;
+
+  if (keep_view) {
+    tv->selected_events_dirty = true;
+    tv->track_layout_dirty = true;
+    tv->call_tree_dirty = true;
+  } else {
+    trace_viewer_reset_view(tv);
+  }
+  trace_viewer_index_events(tv, td, allocator);
+  trace_viewer_precompute_minimap_heatmap(tv, td, allocator);
+}
+
+void trace_viewer_adopt_tracks(trace_viewer_t* tv, const trace_data_t* td,
+                               darray_track_t tracks, int64_t min_ts,
+                               int64_t max_ts, darray_track_t* out_old_tracks,
+                               allocator_t* allocator) {
+  bool keep_view = trace_viewer_keeps_view(tv);
+
+  if (out_old_tracks) {
+    *out_old_tracks = tv->tracks;
+  } else {
+    track_t* old_tracks = tv->tracks.ptr;
+    for (size_t i = 0; i < tv->tracks.len; i++) {
+      track_deinit(&old_tracks[i], allocator);
+    }
+    darray_deinit(&tv->tracks, allocator);
+  }
+  tv->tracks = tracks;
+  trace_viewer_tracks_changed(tv, td, min_ts, max_ts, keep_view, allocator);
+}
+
+void trace_viewer_apply_track_deltas(trace_viewer_t* tv,
+                                     const trace_data_t* td,
+                                     track_preview_t* preview,
+                                     const darray_track_delta_t* deltas,
+                                     allocator_t* allocator) {
+  bool keep_view = trace_viewer_keeps_view(tv);
+  int64_t min_ts = tv->viewport.min_ts;
+  int64_t max_ts = tv->viewport.max_ts;
+  track_preview_apply(preview, td, deltas, &tv->tracks, &min_ts, &max_ts,
+                      allocator);
+  trace_viewer_tracks_changed(tv, td, min_ts, max_ts, keep_view, allocator);
 }
 
 void trace_viewer_precompute_minimap_heatmap(trace_viewer_t* tv,
@@ -7,6 +7,8 @@
 #include "core/darray.h"
 #include "src/colors.h"
 #include "src/imgui_c.h"
+#include "src/text_width_cache.h"
+#include "src/trace_call_tree.h"
 #include "src/trace_data.h"
 #include "src/trace_heatmap.h"
 #include "src/trace_histogram.h"
@@ -54,6 +56,15 @@ struct hover_match {
 };
 typedef struct hover_match hover_match_t;
 
+// Label of an event block, drawn after the instanced blocks so it stays on
+// top of them.
+struct event_label {
+  float x1, x2, y1, y2;
+  uint32_t col;
+  string_ref_t name_ref;
+};
+typedef struct event_label event_label_t;
+
 struct trace_viewer_input {
   // Layout info
   float canvas_x, canvas_y;
@@ -138,6 +149,21 @@ struct vertical_minimap_state {
 };
 typedef struct vertical_minimap_state vertical_minimap_state_t;
 
+// Per-frame costs of the timeline, in milliseconds and counts.
+typedef struct trace_viewer_frame_stats {
+  // Wall-clock time of trace_viewer_step, and of the rest of
+  // trace_viewer_draw
+  double step_ms;
+  double draw_ms;
+  // The parts of step_ms and draw_ms spent computing render blocks
+  double step_render_blocks_ms;
+  double draw_render_blocks_ms;
+  // The part of step_ms spent snapping and hit-testing
+  double hover_ms;
+  size_t render_blocks;
+  size_t text_draws;
+} trace_viewer_frame_stats_t;
+
 struct trace_viewer {
   struct {
     int64_t min_ts;
@@ -166,14 +192,36 @@ struct trace_viewer {
   float snap_y2;
 
   darray_track_t tracks;
+  // Reverse index of `tracks` by global event index, rebuilt when the tracks
+  // change.
+  darray_track_event_location_t event_locations;
+  const track_t* event_locations_tracks;
   darray_t(track_view_info_t) track_infos;
+  // Widths of event labels, measured once per name and font size
+  text_width_cache_t label_widths;
   darray_t(ruler_tick_t) ruler_ticks;
   selection_overlay_layout_t selection_layout;
   float total_tracks_height;
+  // track_infos[i].y_rel and .height hold the prefix sum of the track heights.
+  // They are only rebuilt when the tracks or the lane height change, or when
+  // track_layout_dirty is set.
+  bool track_layout_dirty;
+  const track_t* track_layout_tracks;
+  float track_layout_lane_height;
+  // Tracks [visible_track_begin, visible_track_end) passed culling; only these
+  // have an up-to-date y and name.
+  size_t visible_track_begin;
+  size_t visible_track_end;
+  // Costs of the last trace_viewer_draw
+  trace_viewer_frame_stats_t frame_stats;
 
   track_renderer_state_t track_renderer_state;
   darray_track_render_block_t render_blocks;
   darray_counter_render_block_t counter_render_blocks;
+  // Event blocks of the visible thread tracks, handed to the renderer as one
+  // instanced batch per frame, and their labels.
+  darray_t(ig_rect_instance_t) event_rects;
+  darray_t(event_label_t) event_labels;
   darray_t(hover_match_t) hover_matches;
   bool has_focused_event;
   size_t focused_event_idx;
@@ -206,6 +254,24 @@ struct trace_viewer {
   trace_histogram_t histogram;
   darray_int64_t filtered_event_indices;
   vertical_minimap_state_t vertical_minimap;
+
+  // Flame graph of the ruler selection, rebuilt by a call tree task when the
+  // selection settles on a new range. The previous tree stays up meanwhile.
+  bool show_flame_graph_panel;
+  bool has_call_tree;
+  bool call_tree_dirty;
+  double call_tree_start_time;
+  double call_tree_end_time;
+  // Range of the latest tree asked for: requested until the app starts a
+  // task for it, then computing until the task completes.
+  bool call_tree_requested;
+  bool call_tree_computing;
+  double call_tree_request_start_time;
+  double call_tree_request_end_time;
+  trace_call_tree_t call_tree;
+  darray_uint32_t call_tree_order;
+  // Start of each node, in microseconds from the start of the root
+  darray_double_t call_tree_offsets;
 };
 typedef struct trace_viewer trace_viewer_t;
 
@@ -219,6 +285,31 @@ void trace_viewer_reset_view(trace_viewer_t* tv);
 void trace_viewer_precompute_minimap_heatmap(trace_viewer_t* tv,
                                              const trace_data_t* td,
                                              allocator_t* allocator);
+// Rebuilds the event-to-track index if the tracks changed. trace_viewer_step
+// does so lazily; call this right after adopting new tracks to do it then.
+void trace_viewer_index_events(trace_viewer_t* tv, const trace_data_t* td,
+                               allocator_t* allocator);
+// Takes ownership of `tracks`, organized from `td` and spanning
+// [min_ts, max_ts], frees the previous tracks (or moves them to
+// `out_old_tracks` when not null, for a task still reading them) and rebuilds
+// what is derived from them. Called with each snapshot while a trace loads
+// and once more at the end, so selections and search results, which are
+// event indices, are kept. The view is reset unless the user moved it away
+// from the whole previous range.
+void trace_viewer_adopt_tracks(trace_viewer_t* tv, const trace_data_t* td,
+                               darray_track_t tracks, int64_t min_ts,
+                               int64_t max_ts, darray_track_t* out_old_tracks,
+                               allocator_t* allocator);
+// Applies the deltas of a trace that is still loading to the tracks shown,
+// which `preview` finished from the earlier deltas, and rebuilds what is
+// derived from them, as trace_viewer_adopt_tracks does. `td` must already
+// hold what the deltas refer to. Changes the tracks in place, so no task may
+// be reading them.
+void trace_viewer_apply_track_deltas(trace_viewer_t* tv,
+                                     const trace_data_t* td,
+                                     track_preview_t* preview,
+                                     const darray_track_delta_t* deltas,
+                                     allocator_t* allocator);
 void trace_viewer_step(trace_viewer_t* tv, trace_data_t* td,
                        const trace_viewer_input_t* input,
                        allocator_t* allocator);
@@ -233,6 +324,13 @@ void trace_viewer_adopt_search_results(trace_viewer_t* tv,
 
 void trace_viewer_clear_search(trace_viewer_t* tv, allocator_t* allocator);
 
+// Shows the call tree of [start_time, end_time] built by a call tree task,
+// taking ownership of it.
+void trace_viewer_adopt_call_tree(trace_viewer_t* tv, trace_call_tree_t tree,
+                                  darray_uint32_t order,
+                                  darray_double_t offsets, double start_time,
+                                  double end_time, allocator_t* allocator);
+
 bool trace_viewer_str_contains_case_insensitive(string_view_t text,
                                                 const char* q, size_t q_len);
 
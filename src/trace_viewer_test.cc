@@ -187,6 +187,43 @@ TEST_F(TraceViewerTest, ClickToFocusAndCenter) {
   EXPECT_NEAR(tv.target_scroll_y, -30.0f, 0.1f);
 }
 
+TEST_F(TraceViewerTest, SelectedEventsMarkTheirTracks) {
+  // Three tracks with two events each; event i lives in track i / 2.
+  for (int i = 0; i < 3; i++) {
+    track_t t = {};
+    t.type = TRACK_TYPE_THREAD;
+    t.tid = i;
+    for (int j = 0; j < 2; j++) {
+      trace_event_persisted_t e = {};
+      e.ts = 1000 * j;
+      e.dur = 100;
+      e.tid = i;
+      darray_push(&t.event_indices, td->events.len, allocator);
+      darray_push(&td->events, e, allocator);
+    }
+    track_calculate_depths(&t, td, allocator);
+    darray_push(&tv.tracks, t, allocator);
+  }
+
+  darray_push(&tv.selected_event_indices, (int64_t)5, allocator);
+  tv.selected_events_dirty = true;
+
+  trace_viewer_input_t input = {};
+  input.canvas_width = 1000.0f;
+  input.canvas_height = 200.0f;
+  input.ruler_height = 20.0f;
+  input.lane_height = 20.0f;
+  trace_viewer_step(&tv, td, &input, allocator);
+
+  ASSERT_EQ(tv.event_locations.len, 6u);
+  EXPECT_EQ(tv.event_locations.ptr[5].track_idx, 2u);
+  EXPECT_EQ(tv.event_locations.ptr[5].position, 1u);
+  const bool* track_has_selected = tv.vertical_minimap.track_has_selected.ptr;
+  EXPECT_FALSE(track_has_selected[0]);
+  EXPECT_FALSE(track_has_selected[1]);
+  EXPECT_TRUE(track_has_selected[2]);
+}
+
 TEST_F(TraceViewerTest, SelectionOnClick) {
   // Add a dummy event
   trace_event_persisted_t e = {};
@@ -1231,6 +1268,49 @@ TEST_F(TraceViewerTest, TrackLayoutAndCulling) {
   EXPECT_TRUE(track_infos[1].visible);
 }
 
+TEST_F(TraceViewerTest, TrackLayoutCullsByBinarySearch) {
+  // 1000 tracks of height 40: track i spans [40 * i, 40 * i + 40).
+  for (int i = 0; i < 1000; i++) {
+    track_t t = {};
+    t.type = TRACK_TYPE_THREAD;
+    t.tid = i;
+    darray_push(&tv.tracks, t, allocator);
+  }
+
+  trace_viewer_input_t input = {};
+  input.canvas_height = 120.0f;  // Tracks area: [20, 120]
+  input.ruler_height = 20.0f;
+  input.lane_height = 20.0f;
+  input.tracks_scroll_y = 20000.0f;
+
+  trace_viewer_step(&tv, td, &input, allocator);
+
+  EXPECT_FLOAT_EQ(tv.total_tracks_height, 40000.0f);
+  // Track 499 ends at 20000 and track 502 starts at 20080, the bottom edge.
+  EXPECT_EQ(tv.visible_track_begin, 499u);
+  EXPECT_EQ(tv.visible_track_end, 503u);
+  const track_view_info_t* track_infos = tv.track_infos.ptr;
+  EXPECT_FLOAT_EQ(track_infos[500].y, 20.0f);
+  EXPECT_STREQ(track_infos[500].name, "Thread 500");
+  // Off-screen tracks are never named.
+  EXPECT_STREQ(track_infos[0].name, "");
+  EXPECT_FALSE(track_infos[0].visible);
+
+  // Scrolling back clears the old range.
+  input.tracks_scroll_y = 0.0f;
+  trace_viewer_step(&tv, td, &input, allocator);
+  EXPECT_EQ(tv.visible_track_begin, 0u);
+  EXPECT_EQ(tv.visible_track_end, 3u);
+  EXPECT_FALSE(track_infos[500].visible);
+  EXPECT_STREQ(track_infos[0].name, "Thread 0");
+
+  // A new lane height rebuilds the layout.
+  input.lane_height = 10.0f;
+  trace_viewer_step(&tv, td, &input, allocator);
+  EXPECT_FLOAT_EQ(tv.total_tracks_height, 20000.0f);
+  EXPECT_EQ(tv.visible_track_end, 6u);
+}
+
 TEST_F(TraceViewerTest, SelectionOverlayLayoutComputation) {
   tv.viewport.start_time = 0;
   tv.viewport.end_time = 1000;
@@ -4,7 +4,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "core/assert.h"
 #include "core/hash_table.h"
+#include "core/self_trace.h"
+#include "core/tagged_allocator.h"
+#include "src/platform.h"
 
 typedef struct stack_event {
   int64_t end;
@@ -228,40 +232,108 @@ void track_compact(track_t* t, allocator_t* a) {
   darray_compact(&t->block_max_durs, a);
 }
 
-void track_sort_events(track_t* t, const trace_data_t* td, allocator_t* a) {
-  if (t->event_indices.len > 1) {
+static sort_key_t sort_key_for(const trace_event_persisted_t* events,
+                               size_t idx) {
+  return (sort_key_t){.ts = events[idx].ts, .dur = events[idx].dur, .idx = idx};
+}
+
+// Sort keys shared by the tracks sorted in one pass. They are allocated from
+// the scratch allocator the first time a long track is out of order, with
+// room for the longest track, so an arena does not grow once per track.
+typedef struct sort_key_buffer {
+  allocator_t* allocator;
+  size_t capacity;
+  sort_key_t* ptr;
+} sort_key_buffer_t;
+
+static void sort_key_buffer_deinit(sort_key_buffer_t* keys) {
+  if (keys->ptr) {
+    allocator_free(keys->allocator, keys->ptr,
+                   keys->capacity * sizeof(sort_key_t));
+  }
+  *keys = (sort_key_buffer_t){};
+}
+
+// Events mostly arrive in order, so instead of sorting the whole track the
+// events that are in order with the ones kept before them stay where they
+// are; only the rest (e.g. 'X' parents written after their children) are
+// sorted and then merged back in. An ordered track costs one linear scan,
+// which also yields the latest end time of the track's events.
+static void sort_events(track_t* t, const trace_data_t* td,
+                        sort_key_buffer_t* key_buffer, int64_t* out_max_end) {
+  size_t n = t->event_indices.len;
+  size_t* event_indices = t->event_indices.ptr;
+  const trace_event_persisted_t* events = td->events.ptr;
+
+  size_t ordered_len = n;
+  int64_t max_end = INT64_MIN;
+  for (size_t i = 0; i < n; i++) {
+    sort_key_t key = sort_key_for(events, event_indices[i]);
+    if (key.ts + key.dur > max_end) {
+      max_end = key.ts + key.dur;
+    }
+    if (ordered_len == n && i > 0) {
+      sort_key_t prev = sort_key_for(events, event_indices[i - 1]);
+      if (sort_key_compare(&prev, &key) > 0) {
+        ordered_len = i;
+      }
+    }
+  }
+  *out_max_end = max_end;
+
+  if (ordered_len < n) {
     sort_key_t* keys = nullptr;
     sort_key_t stack_keys[1024];
-    if (t->event_indices.len <= 1024) {
+    if (n <= 1024) {
       keys = stack_keys;
     } else {
-      keys = (sort_key_t*)allocator_alloc(
-          a, t->event_indices.len * sizeof(sort_key_t));
+      if (!key_buffer->ptr) {
+        key_buffer->ptr = (sort_key_t*)allocator_alloc(
+            key_buffer->allocator, key_buffer->capacity * sizeof(sort_key_t));
+      }
+      keys = key_buffer->ptr;
     }
 
-    const size_t* event_indices = t->event_indices.ptr;
-    const trace_event_persisted_t* events = td->events.ptr;
-
-    for (size_t i = 0; i < t->event_indices.len; i++) {
-      size_t idx = event_indices[i];
-      keys[i].ts = events[idx].ts;
-      keys[i].dur = events[idx].dur;
-      keys[i].idx = idx;
+    // In-order events go to the front of keys, the others to the back.
+    size_t kept = 0;
+    size_t displaced = 0;
+    for (size_t i = 0; i < n; i++) {
+      sort_key_t key = sort_key_for(events, event_indices[i]);
+      if (kept == 0 || sort_key_compare(&keys[kept - 1], &key) < 0) {
+        keys[kept++] = key;
+      } else {
+        displaced++;
+        keys[n - displaced] = key;
+      }
     }
 
-    qsort(keys, t->event_indices.len, sizeof(sort_key_t), sort_key_compare);
+    sort_key_t* rest = &keys[n - displaced];
+    qsort(rest, displaced, sizeof(sort_key_t), sort_key_compare);
 
-    size_t* mutable_event_indices = t->event_indices.ptr;
-    for (size_t i = 0; i < t->event_indices.len; i++) {
-      mutable_event_indices[i] = keys[i].idx;
-    }
-
-    if (t->event_indices.len > 1024) {
-      allocator_free(a, keys, t->event_indices.len * sizeof(sort_key_t));
+    size_t i = 0;
+    size_t j = 0;
+    for (size_t k = 0; k < n; k++) {
+      if (j == displaced ||
+          (i < kept && sort_key_compare(&keys[i], &rest[j]) < 0)) {
+        event_indices[k] = keys[i++].idx;
+      } else {
+        event_indices[k] = rest[j++].idx;
+      }
     }
   }
 }
 
+void track_sort_events(track_t* t, const trace_data_t* td,
+                       allocator_t* scratch_allocator) {
+  sort_key_buffer_t keys = {
+      .allocator = scratch_allocator,
+      .capacity = t->event_indices.len,
+  };
+  int64_t max_end = 0;
+  sort_events(t, td, &keys, &max_end);
+  sort_key_buffer_deinit(&keys);
+}
+
 void track_update_max_dur(track_t* t, const trace_data_t* td, allocator_t* a) {
   int64_t max_dur = 0;
   size_t num_blocks =
@@ -396,281 +468,612 @@ size_t track_find_visible_start_index(const track_t* t, const trace_data_t* td,
   return result;
 }
 
-void track_organize(const trace_data_t* td, darray_track_t* out_tracks,
-                    int64_t* out_min_ts, int64_t* out_max_ts,
-                    allocator_t* output_allocator,
-                    allocator_t* scratch_allocator) {
-  for (size_t i = 0; i < out_tracks->len; i++) {
-    track_deinit(&out_tracks->ptr[i], output_allocator);
+void track_build_event_locations(const darray_track_t* tracks,
+                                 size_t event_count,
+                                 darray_track_event_location_t* out_locations,
+                                 allocator_t* a) {
+  SELF_TRACE_BEGIN("track_build_event_locations");
+  darray_resize(out_locations, event_count, a);
+  track_event_location_t* locations = out_locations->ptr;
+  for (size_t i = 0; i < event_count; i++) {
+    locations[i] = (track_event_location_t){
+        .track_idx = TRACK_EVENT_LOCATION_NONE,
+        .position = TRACK_EVENT_LOCATION_NONE,
+    };
   }
-  darray_clear(out_tracks);
-
-  if (td->events.len > 0) {
-    int64_t min_ts = 0;
-    int64_t max_ts = 0;
-    bool first_event = true;
-
-    typedef hash_table_t(track_key_t, size_t) track_map_t;
-    track_map_t track_map = {};
-    hash_table_init(&track_map, track_key_hash, track_key_eq, nullptr);
-
-    track_key_t last_key = {-1, -1, 0, 0};
-    size_t last_track_idx = (size_t)-1;
-
-    const trace_event_persisted_t* events = td->events.ptr;
+  const track_t* tracks_data = tracks->ptr;
+  for (size_t t_idx = 0; t_idx < tracks->len; t_idx++) {
+    const track_t* t = &tracks_data[t_idx];
+    const size_t* event_indices = t->event_indices.ptr;
+    for (size_t k = 0; k < t->event_indices.len; k++) {
+      if (event_indices[k] < event_count) {
+        locations[event_indices[k]] = (track_event_location_t){
+            .track_idx = (uint32_t)t_idx,
+            .position = (uint32_t)k,
+        };
+      }
+    }
+  }
+  SELF_TRACE_END();
+}
 
-    string_ref_t ph_c_ref = trace_data_find_string_ref_const(td, SV("C"));
-    string_ref_t ph_m_ref = trace_data_find_string_ref_const(td, SV("M"));
+typedef hash_table_t(track_key_t, size_t) track_map_t;
 
-    darray_t(size_t) event_counts = {};
+// What track_builder_publish last handed over of a track.
+typedef struct track_published {
+  size_t event_count;
+  string_ref_t name_ref;
+  int32_t sort_index;
+  // Set while publishing if one of the track's begin events ended.
+  bool dirty;
+} track_published_t;
+
+struct track_builder {
+  allocator_t* allocator;
+  // Per-track arrays are accounted as track memory; the track list itself
+  // stays on allocator.
+  allocator_t* track_allocator;
+  // In discovery order
+  darray_track_t tracks;
+  track_map_t track_map;
+  track_key_t last_key;
+  size_t last_track_idx;
+  // 0 until the string is interned, which happens before the first event
+  // that uses it.
+  string_ref_t ph_c_ref;
+  string_ref_t ph_m_ref;
+  // Events of td that have been assigned to a track
+  size_t event_count;
+  // In discovery order; tracks past its end were never published.
+  darray_t(track_published_t) published;
+};
+
+track_builder_t* track_builder_create(allocator_t* a) {
+  track_builder_t* b =
+      (track_builder_t*)allocator_alloc(a, sizeof(track_builder_t));
+  *b = (track_builder_t){
+      .allocator = a,
+      .track_allocator = allocator_for_tag(a, MEMORY_TAG_TRACKS),
+      .last_key = {-1, -1, 0, 0},
+      .last_track_idx = (size_t)-1,
+  };
+  hash_table_init(&b->track_map, track_key_hash, track_key_eq, nullptr);
+  return b;
+}
 
-    // Allocate temporary array to store resolved track index for each event
-    uint32_t* event_track_indices = (uint32_t*)allocator_alloc(
-        scratch_allocator, td->events.len * sizeof(uint32_t));
+static void track_builder_reset(track_builder_t* b) {
+  hash_table_clear(&b->track_map);
+  b->last_key = (track_key_t){-1, -1, 0, 0};
+  b->last_track_idx = (size_t)-1;
+  b->ph_c_ref = 0;
+  b->ph_m_ref = 0;
+  b->event_count = 0;
+  darray_clear(&b->published);
+}
 
-    // Pass 1: Discovery, Counting, Metadata, and Index Caching!
-    for (size_t i = 0; i < td->events.len; i++) {
-      const trace_event_persisted_t* e = &events[i];
-      bool is_counter = (e->ph_ref == ph_c_ref);
-      bool is_metadata = (e->ph_ref == ph_m_ref);
+void track_builder_destroy(track_builder_t* b) {
+  allocator_t* a = b->allocator;
+  for (size_t i = 0; i < b->tracks.len; i++) {
+    track_deinit(&b->tracks.ptr[i], a);
+  }
+  darray_deinit(&b->tracks, a);
+  hash_table_deinit(&b->track_map, a);
+  darray_deinit(&b->published, a);
+  allocator_free(a, b, sizeof(track_builder_t));
+}
 
-      if (is_metadata) {
-        event_track_indices[i] = (uint32_t)-1;  // Sentinel for metadata
+static void track_builder_apply_metadata(track_t* t, const trace_data_t* td,
+                                         const trace_event_persisted_t* e) {
+  string_view_t name_str = trace_data_get_string(td, e->name_ref);
+  const trace_arg_persisted_t* args = td->args.ptr;
+  if (string_view_eq(name_str, SV("thread_name"))) {
+    for (size_t k = 0; k < e->args_count; k++) {
+      const trace_arg_persisted_t* arg = &args[e->args_offset + k];
+      string_view_t key_str = trace_data_get_string(td, arg->key_ref);
+      if (string_view_eq(key_str, SV("name"))) {
+        t->name_ref = arg->val_ref;
+        break;
       }
-
-      track_key_t key = {};
-      if (is_counter) {
-        key.pid = e->pid;
-        key.tid = -1;
-        key.name_ref = e->name_ref;
-        key.id_ref = e->id_ref;
-      } else {
-        key.pid = e->pid;
-        key.tid = e->tid;
+    }
+  } else if (string_view_eq(name_str, SV("thread_sort_index"))) {
+    for (size_t k = 0; k < e->args_count; k++) {
+      const trace_arg_persisted_t* arg = &args[e->args_offset + k];
+      string_view_t key_str = trace_data_get_string(td, arg->key_ref);
+      if (string_view_eq(key_str, SV("sort_index"))) {
+        string_view_t val = trace_data_get_string(td, arg->val_ref);
+        t->sort_index = to_int32(val);
+        break;
       }
+    }
+  }
+}
 
-      size_t track_idx = 0;
-      if (key.pid == last_key.pid && key.tid == last_key.tid &&
-          key.name_ref == last_key.name_ref && key.id_ref == last_key.id_ref) {
-        track_idx = last_track_idx;
-      } else {
-        size_t* track_idx_ptr = hash_table_get(&track_map, &key);
-        if (track_idx_ptr == nullptr) {
-          track_t t = {
-              .type = is_counter ? TRACK_TYPE_COUNTER : TRACK_TYPE_THREAD,
-              .pid = e->pid,
-              .tid = is_counter ? -1 : e->tid,
-              .name_ref = is_counter ? e->name_ref : 0,
-              .id_ref = is_counter ? e->id_ref : 0,
-          };
-          darray_push(out_tracks, t, output_allocator);
-          track_idx = out_tracks->len - 1;
-          hash_table_put(&track_map, &key, track_idx, scratch_allocator);
-          darray_push(&event_counts, (size_t)0, scratch_allocator);
-        } else {
-          track_idx = *track_idx_ptr;
-        }
-        last_key = key;
-        last_track_idx = track_idx;
-      }
+void track_builder_update(track_builder_t* b, const trace_data_t* td) {
+  if (b->ph_c_ref == 0) {
+    b->ph_c_ref = trace_data_find_string_ref_const(td, SV("C"));
+  }
+  if (b->ph_m_ref == 0) {
+    b->ph_m_ref = trace_data_find_string_ref_const(td, SV("M"));
+  }
 
-      track_t* t = &out_tracks->ptr[track_idx];
-
-      // Check for metadata events
-      if (is_metadata) {
-        string_view_t name_str = trace_data_get_string(td, e->name_ref);
-        if (string_view_eq(name_str, SV("thread_name"))) {
-          const trace_arg_persisted_t* args = td->args.ptr;
-          for (size_t k = 0; k < e->args_count; k++) {
-            const trace_arg_persisted_t* arg = &args[e->args_offset + k];
-            string_view_t key_str = trace_data_get_string(td, arg->key_ref);
-            if (string_view_eq(key_str, SV("name"))) {
-              t->name_ref = arg->val_ref;
-              break;
-            }
-          }
-        } else if (string_view_eq(name_str, SV("thread_sort_index"))) {
-          const trace_arg_persisted_t* args = td->args.ptr;
-          for (size_t k = 0; k < e->args_count; k++) {
-            const trace_arg_persisted_t* arg = &args[e->args_offset + k];
-            string_view_t key_str = trace_data_get_string(td, arg->key_ref);
-            if (string_view_eq(key_str, SV("sort_index"))) {
-              string_view_t val = trace_data_get_string(td, arg->val_ref);
-              t->sort_index = to_int32(val);
-              break;
-            }
-          }
-        }
+  const trace_event_persisted_t* events = td->events.ptr;
+  for (size_t i = b->event_count; i < td->events.len; i++) {
+    const trace_event_persisted_t* e = &events[i];
+    bool is_counter = b->ph_c_ref != 0 && e->ph_ref == b->ph_c_ref;
+    bool is_metadata = b->ph_m_ref != 0 && e->ph_ref == b->ph_m_ref;
+
+    track_key_t key = {};
+    if (is_counter) {
+      key.pid = e->pid;
+      key.tid = -1;
+      key.name_ref = e->name_ref;
+      key.id_ref = e->id_ref;
+    } else {
+      key.pid = e->pid;
+      key.tid = e->tid;
+    }
+
+    size_t track_idx = 0;
+    if (b->last_track_idx != (size_t)-1 &&
+        track_key_eq(&key, &b->last_key, nullptr)) {
+      track_idx = b->last_track_idx;
+    } else {
+      size_t* track_idx_ptr = hash_table_get(&b->track_map, &key);
+      if (track_idx_ptr == nullptr) {
+        track_t t = {
+            .type = is_counter ? TRACK_TYPE_COUNTER : TRACK_TYPE_THREAD,
+            .pid = e->pid,
+            .tid = is_counter ? -1 : e->tid,
+            .name_ref = is_counter ? e->name_ref : 0,
+            .id_ref = is_counter ? e->id_ref : 0,
+        };
+        darray_push(&b->tracks, t, b->allocator);
+        track_idx = b->tracks.len - 1;
+        hash_table_put(&b->track_map, &key, track_idx, b->allocator);
       } else {
-        event_track_indices[i] = (uint32_t)track_idx;
-        event_counts.ptr[track_idx]++;
-
-        if (first_event) {
-          min_ts = e->ts;
-          max_ts = e->ts + e->dur;
-          first_event = false;
-        } else {
-          if (e->ts < min_ts) {
-            min_ts = e->ts;
-          }
-          if (e->ts + e->dur > max_ts) {
-            max_ts = e->ts + e->dur;
-          }
-        }
+        track_idx = *track_idx_ptr;
       }
+      b->last_key = key;
+      b->last_track_idx = track_idx;
     }
 
-    // Pre-allocate event_indices for all tracks
-    for (size_t i = 0; i < out_tracks->len; i++) {
-      darray_reserve(&out_tracks->ptr[i].event_indices, event_counts.ptr[i],
-                     output_allocator);
+    track_t* t = &b->tracks.ptr[track_idx];
+    if (is_metadata) {
+      track_builder_apply_metadata(t, td, e);
+    } else {
+      darray_push(&t->event_indices, i, b->track_allocator);
     }
+  }
+  b->event_count = td->events.len;
+}
 
-    // Pass 2: Grouping (Zero reallocations, zero lookups, zero cache checks!)
-    for (size_t i = 0; i < td->events.len; i++) {
-      uint32_t track_idx = event_track_indices[i];
-      if (track_idx != (uint32_t)-1) {
-        darray_push(&out_tracks->ptr[track_idx].event_indices, i,
-                    output_allocator);
-      }
-    }
+void track_builder_publish(track_builder_t* b, const trace_data_t* td,
+                           const trace_event_update_t* updates,
+                           size_t update_count,
+                           darray_track_delta_t* out_deltas, allocator_t* a) {
+  track_builder_update(b, td);
 
-    // Sort events, calculate depths
-    for (size_t i = 0; i < out_tracks->len; i++) {
-      track_t* t = &out_tracks->ptr[i];
-      track_sort_events(t, td, output_allocator);
-      track_update_max_dur(t, td, output_allocator);
-      if (t->type == TRACK_TYPE_THREAD) {
-        track_calculate_depths(t, td, output_allocator);
-      } else {
-        // Counter tracks don't have nested depths.
-        t->max_depth = 0;
-        darray_resize(&t->depths, t->event_indices.len, output_allocator);
-        memset(t->depths.ptr, 0, t->depths.len * sizeof(uint32_t));
-
-        darray_resize(&t->self_durs, t->event_indices.len, output_allocator);
-        memset(t->self_durs.ptr, 0, t->self_durs.len * sizeof(int64_t));
-
-        // Discover unique series (argument keys) and calculate max total
-        t->counter_max_total = 0.0;
-        const size_t* event_indices = t->event_indices.ptr;
-        const trace_arg_persisted_t* args = td->args.ptr;
-        for (size_t idx_k = 0; idx_k < t->event_indices.len; idx_k++) {
-          size_t idx = event_indices[idx_k];
-          const trace_event_persisted_t* e = &events[idx];
-          double event_total = 0.0;
-          for (uint32_t k = 0; k < e->args_count; k++) {
-            const trace_arg_persisted_t* arg = &args[e->args_offset + k];
-            string_ref_t key_ref = arg->key_ref;
-            bool found = false;
-            for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
-              if (t->counter_series.ptr[s_idx] == key_ref) {
-                found = true;
-                break;
-              }
-            }
-            if (!found) {
-              darray_push(&t->counter_series, key_ref, output_allocator);
-            }
-            event_total += arg->val_double;
-          }
-          if (event_total > t->counter_max_total) {
-            t->counter_max_total = event_total;
-          }
-        }
+  size_t published_len = b->published.len;
+  darray_resize(&b->published, b->tracks.len, b->allocator);
+  for (size_t i = published_len; i < b->tracks.len; i++) {
+    b->published.ptr[i] = (track_published_t){.dirty = true};
+  }
 
-        // Pre-resolve strings for counter series sorting
-        counter_sort_key_t* counter_keys = nullptr;
-        counter_sort_key_t stack_counter_keys[32];
-        if (t->counter_series.len <= 32) {
-          counter_keys = stack_counter_keys;
-        } else {
-          counter_keys = (counter_sort_key_t*)allocator_alloc(
-              scratch_allocator,
-              t->counter_series.len * sizeof(counter_sort_key_t));
-        }
+  // Begin events are thread events, so their track is found by thread.
+  const trace_event_persisted_t* events = td->events.ptr;
+  for (size_t i = 0; i < update_count; i++) {
+    const trace_event_persisted_t* e = &events[updates[i].event_idx];
+    track_key_t key = {.pid = e->pid, .tid = e->tid};
+    size_t* track_idx = hash_table_get(&b->track_map, &key);
+    if (track_idx != nullptr) {
+      b->published.ptr[*track_idx].dirty = true;
+    }
+  }
 
-        for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
-          counter_keys[s_idx].ref = t->counter_series.ptr[s_idx];
-          counter_keys[s_idx].str =
-              trace_data_get_string(td, t->counter_series.ptr[s_idx]);
-        }
+  for (size_t i = 0; i < b->tracks.len; i++) {
+    const track_t* t = &b->tracks.ptr[i];
+    track_published_t* p = &b->published.ptr[i];
+    if (p->dirty || t->event_indices.len > p->event_count ||
+        t->name_ref != p->name_ref || t->sort_index != p->sort_index) {
+      track_delta_t delta = {
+          .track_idx = i,
+          .header =
+              {
+                  .type = t->type,
+                  .pid = t->pid,
+                  .tid = t->tid,
+                  .name_ref = t->name_ref,
+                  .id_ref = t->id_ref,
+                  .sort_index = t->sort_index,
+              },
+      };
+      darray_push_n(&delta.event_indices, t->event_indices.ptr + p->event_count,
+                    t->event_indices.len - p->event_count, a);
+      darray_push(out_deltas, delta, a);
+      *p = (track_published_t){
+          .event_count = t->event_indices.len,
+          .name_ref = t->name_ref,
+          .sort_index = t->sort_index,
+      };
+    }
+  }
+}
 
-        qsort(counter_keys, t->counter_series.len, sizeof(counter_sort_key_t),
-              counter_sort_key_compare);
+void track_deltas_free(darray_track_delta_t* deltas, allocator_t* a) {
+  for (size_t i = 0; i < deltas->len; i++) {
+    darray_deinit(&deltas->ptr[i].event_indices, a);
+  }
+  darray_deinit(deltas, a);
+}
 
-        for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
-          t->counter_series.ptr[s_idx] = counter_keys[s_idx].ref;
-        }
+static void track_finish_counter(track_t* t, const trace_data_t* td,
+                                 allocator_t* track_allocator,
+                                 allocator_t* scratch_allocator) {
+  // Counter tracks don't have nested depths.
+  t->max_depth = 0;
+  darray_resize(&t->depths, t->event_indices.len, track_allocator);
+  memset(t->depths.ptr, 0, t->depths.len * sizeof(uint32_t));
 
-        if (t->counter_series.len > 32) {
-          allocator_free(scratch_allocator, counter_keys,
-                         t->counter_series.len * sizeof(counter_sort_key_t));
-        }
+  darray_resize(&t->self_durs, t->event_indices.len, track_allocator);
+  memset(t->self_durs.ptr, 0, t->self_durs.len * sizeof(int64_t));
 
-        // Cache palette indices
-        darray_resize(&t->counter_palette_indices, t->counter_series.len,
-                      output_allocator);
-
-        for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
-          string_view_t key_str =
-              trace_data_get_string(td, t->counter_series.ptr[s_idx]);
-          uint32_t hash = 2166136261u;
-          for (size_t char_idx = 0; char_idx < key_str.len; ++char_idx) {
-            hash ^= (uint8_t)key_str.ptr[char_idx];
-            hash *= 16777619u;
-          }
-          t->counter_palette_indices.ptr[s_idx] = (uint8_t)(hash % 8);
+  // Discover unique series (argument keys) and calculate max total
+  t->counter_max_total = 0.0;
+  const size_t* event_indices = t->event_indices.ptr;
+  const trace_event_persisted_t* events = td->events.ptr;
+  const trace_arg_persisted_t* args = td->args.ptr;
+  for (size_t idx_k = 0; idx_k < t->event_indices.len; idx_k++) {
+    size_t idx = event_indices[idx_k];
+    const trace_event_persisted_t* e = &events[idx];
+    double event_total = 0.0;
+    for (uint32_t k = 0; k < e->args_count; k++) {
+      const trace_arg_persisted_t* arg = &args[e->args_offset + k];
+      string_ref_t key_ref = arg->key_ref;
+      bool found = false;
+      for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
+        if (t->counter_series.ptr[s_idx] == key_ref) {
+          found = true;
+          break;
         }
       }
+      if (!found) {
+        darray_push(&t->counter_series, key_ref, track_allocator);
+      }
+      event_total += arg->val_double;
     }
+    if (event_total > t->counter_max_total) {
+      t->counter_max_total = event_total;
+    }
+  }
 
-    // Final track sort — Context-free using TrackSortKey
-    track_sort_key_t* keys = nullptr;
-    track_sort_key_t stack_keys[128];
-    if (out_tracks->len <= 128) {
-      keys = stack_keys;
+  // Pre-resolve strings for counter series sorting
+  counter_sort_key_t* counter_keys = nullptr;
+  counter_sort_key_t stack_counter_keys[32];
+  if (t->counter_series.len <= 32) {
+    counter_keys = stack_counter_keys;
+  } else {
+    counter_keys = (counter_sort_key_t*)allocator_alloc(
+        scratch_allocator, t->counter_series.len * sizeof(counter_sort_key_t));
+  }
+
+  for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
+    counter_keys[s_idx].ref = t->counter_series.ptr[s_idx];
+    counter_keys[s_idx].str =
+        trace_data_get_string(td, t->counter_series.ptr[s_idx]);
+  }
+
+  qsort(counter_keys, t->counter_series.len, sizeof(counter_sort_key_t),
+        counter_sort_key_compare);
+
+  for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
+    t->counter_series.ptr[s_idx] = counter_keys[s_idx].ref;
+  }
+
+  if (t->counter_series.len > 32) {
+    allocator_free(scratch_allocator, counter_keys,
+                   t->counter_series.len * sizeof(counter_sort_key_t));
+  }
+
+  // Cache palette indices
+  darray_resize(&t->counter_palette_indices, t->counter_series.len,
+                track_allocator);
+
+  for (size_t s_idx = 0; s_idx < t->counter_series.len; s_idx++) {
+    string_view_t key_str =
+        trace_data_get_string(td, t->counter_series.ptr[s_idx]);
+    uint32_t hash = 2166136261u;
+    for (size_t char_idx = 0; char_idx < key_str.len; ++char_idx) {
+      hash ^= (uint8_t)key_str.ptr[char_idx];
+      hash *= 16777619u;
+    }
+    t->counter_palette_indices.ptr[s_idx] = (uint8_t)(hash % 8);
+  }
+}
+
+// Sorts `tracks` for display. If `out_order` is not null, it receives the
+// previous position of the track now at each position.
+static void track_sort_tracks(darray_track_t* tracks, const trace_data_t* td,
+                              size_t* out_order,
+                              allocator_t* scratch_allocator) {
+  // Context-free using TrackSortKey
+  track_sort_key_t* keys = nullptr;
+  track_sort_key_t stack_keys[128];
+  if (tracks->len <= 128) {
+    keys = stack_keys;
+  } else {
+    keys = (track_sort_key_t*)allocator_alloc(
+        scratch_allocator, tracks->len * sizeof(track_sort_key_t));
+  }
+
+  for (size_t i = 0; i < tracks->len; i++) {
+    keys[i].track = &tracks->ptr[i];
+    if (tracks->ptr[i].type == TRACK_TYPE_COUNTER) {
+      keys[i].name = trace_data_get_string(td, tracks->ptr[i].name_ref);
+      keys[i].id = trace_data_get_string(td, tracks->ptr[i].id_ref);
     } else {
-      keys = (track_sort_key_t*)allocator_alloc(
-          scratch_allocator, out_tracks->len * sizeof(track_sort_key_t));
+      keys[i].name = (string_view_t){};
+      keys[i].id = (string_view_t){};
     }
+  }
 
-    for (size_t i = 0; i < out_tracks->len; i++) {
-      keys[i].track = &out_tracks->ptr[i];
-      if (out_tracks->ptr[i].type == TRACK_TYPE_COUNTER) {
-        keys[i].name = trace_data_get_string(td, out_tracks->ptr[i].name_ref);
-        keys[i].id = trace_data_get_string(td, out_tracks->ptr[i].id_ref);
-      } else {
-        keys[i].name = (string_view_t){};
-        keys[i].id = (string_view_t){};
-      }
+  qsort(keys, tracks->len, sizeof(track_sort_key_t), track_sort_key_compare);
+
+  track_t* sorted_tracks = nullptr;
+  track_t stack_sorted_tracks[64];
+  bool use_heap_sorted = tracks->len > 64;
+  if (use_heap_sorted) {
+    sorted_tracks = (track_t*)allocator_alloc(scratch_allocator,
+                                              tracks->len * sizeof(track_t));
+  } else {
+    sorted_tracks = stack_sorted_tracks;
+  }
+  for (size_t i = 0; i < tracks->len; i++) {
+    sorted_tracks[i] = *keys[i].track;
+    if (out_order) {
+      out_order[i] = (size_t)(keys[i].track - tracks->ptr);
     }
+  }
+  memcpy(tracks->ptr, sorted_tracks, tracks->len * sizeof(track_t));
 
-    qsort(keys, out_tracks->len, sizeof(track_sort_key_t),
-          track_sort_key_compare);
+  if (use_heap_sorted) {
+    allocator_free(scratch_allocator, sorted_tracks,
+                   tracks->len * sizeof(track_t));
+  }
+  if (tracks->len > 128) {
+    allocator_free(scratch_allocator, keys,
+                   tracks->len * sizeof(track_sort_key_t));
+  }
+}
 
-    track_t* sorted_tracks = nullptr;
-    track_t stack_sorted_tracks[64];
-    bool use_heap_sorted = out_tracks->len > 64;
-    if (use_heap_sorted) {
-      sorted_tracks = (track_t*)allocator_alloc(
-          scratch_allocator, out_tracks->len * sizeof(track_t));
-    } else {
-      sorted_tracks = stack_sorted_tracks;
+void track_builder_finish(track_builder_t* b, const trace_data_t* td,
+                          darray_track_t* out_tracks, int64_t* out_min_ts,
+                          int64_t* out_max_ts, allocator_t* scratch_allocator,
+                          track_organize_profile_t* out_profile) {
+  SELF_TRACE_BEGIN("track_organize");
+  track_organize_profile_t profile = {};
+  double phase_start = platform_get_now();
+  allocator_t* track_allocator = b->track_allocator;
+  for (size_t i = 0; i < out_tracks->len; i++) {
+    track_deinit(&out_tracks->ptr[i], b->allocator);
+  }
+  darray_deinit(out_tracks, b->allocator);
+
+  SELF_TRACE_BEGIN("discover");
+  track_builder_update(b, td);
+  SELF_TRACE_END();
+  profile.discover_ms = platform_get_now() - phase_start;
+  phase_start = platform_get_now();
+
+  darray_track_t tracks = b->tracks;
+  b->tracks = (darray_track_t){};
+  track_builder_reset(b);
+
+  SELF_TRACE_BEGIN("sort_events");
+  sort_key_buffer_t keys = {.allocator = scratch_allocator};
+  for (size_t i = 0; i < tracks.len; i++) {
+    if (tracks.ptr[i].event_indices.len > keys.capacity) {
+      keys.capacity = tracks.ptr[i].event_indices.len;
     }
-    for (size_t i = 0; i < out_tracks->len; i++) {
-      sorted_tracks[i] = *keys[i].track;
+  }
+  int64_t min_ts = 0;
+  int64_t max_ts = 0;
+  bool first_event = true;
+  const trace_event_persisted_t* events = td->events.ptr;
+  for (size_t i = 0; i < tracks.len; i++) {
+    track_t* t = &tracks.ptr[i];
+    int64_t max_end = 0;
+    sort_events(t, td, &keys, &max_end);
+    if (t->event_indices.len > 0) {
+      int64_t first_ts = events[t->event_indices.ptr[0]].ts;
+      if (first_event || first_ts < min_ts) {
+        min_ts = first_ts;
+      }
+      if (first_event || max_end > max_ts) {
+        max_ts = max_end;
+      }
+      first_event = false;
     }
-    memcpy(out_tracks->ptr, sorted_tracks, out_tracks->len * sizeof(track_t));
+  }
+  sort_key_buffer_deinit(&keys);
+  SELF_TRACE_END();
+  profile.sort_events_ms = platform_get_now() - phase_start;
+  phase_start = platform_get_now();
+
+  // Begin events only have their duration now, so depths could not be
+  // calculated while the events arrived.
+  SELF_TRACE_BEGIN("per_track");
+  for (size_t i = 0; i < tracks.len; i++) {
+    track_t* t = &tracks.ptr[i];
+    track_update_max_dur(t, td, track_allocator);
+    if (t->type == TRACK_TYPE_THREAD) {
+      track_calculate_depths(t, td, track_allocator);
+    } else {
+      track_finish_counter(t, td, track_allocator, scratch_allocator);
+    }
+  }
+  SELF_TRACE_END();
+  profile.per_track_ms = platform_get_now() - phase_start;
+  phase_start = platform_get_now();
+
+  SELF_TRACE_BEGIN("sort_tracks");
+  if (td->events.len > 0) {
+    track_sort_tracks(&tracks, td, nullptr, scratch_allocator);
     *out_min_ts = min_ts;
     *out_max_ts = max_ts;
+  }
+  for (size_t i = 0; i < tracks.len; i++) {
+    track_compact(&tracks.ptr[i], track_allocator);
+  }
+  darray_compact(&tracks, b->allocator);
+  *out_tracks = tracks;
+  SELF_TRACE_END();
+  profile.sort_ms = platform_get_now() - phase_start;
+
+  if (out_profile) {
+    out_profile->discover_ms += profile.discover_ms;
+    out_profile->sort_events_ms += profile.sort_events_ms;
+    out_profile->per_track_ms += profile.per_track_ms;
+    out_profile->sort_ms += profile.sort_ms;
+  }
+  SELF_TRACE_END();
+}
+
+void track_organize(const trace_data_t* td, darray_track_t* out_tracks,
+                    int64_t* out_min_ts, int64_t* out_max_ts,
+                    allocator_t* output_allocator,
+                    allocator_t* scratch_allocator) {
+  track_organize_profiled(td, out_tracks, out_min_ts, out_max_ts,
+                          output_allocator, scratch_allocator, nullptr);
+}
 
-    for (size_t i = 0; i < out_tracks->len; i++) {
-      track_compact(&out_tracks->ptr[i], output_allocator);
+void track_organize_profiled(const trace_data_t* td, darray_track_t* out_tracks,
+                             int64_t* out_min_ts, int64_t* out_max_ts,
+                             allocator_t* output_allocator,
+                             allocator_t* scratch_allocator,
+                             track_organize_profile_t* out_profile) {
+  track_builder_t* b = track_builder_create(output_allocator);
+  track_builder_finish(b, td, out_tracks, out_min_ts, out_max_ts,
+                       scratch_allocator, out_profile);
+  track_builder_destroy(b);
+}
+
+struct track_preview {
+  allocator_t* allocator;
+  allocator_t* track_allocator;
+  // Position in the finished tracks of each track, in discovery order
+  darray_t(size_t) positions;
+  // Discovery index of the track at each position
+  darray_t(size_t) discovery_indices;
+  // Latest end time of each track's events, in discovery order
+  darray_int64_t max_ends;
+};
+
+track_preview_t* track_preview_create(allocator_t* a) {
+  track_preview_t* p =
+      (track_preview_t*)allocator_alloc(a, sizeof(track_preview_t));
+  *p = (track_preview_t){
+      .allocator = a,
+      .track_allocator = allocator_for_tag(a, MEMORY_TAG_TRACKS),
+  };
+  return p;
+}
+
+void track_preview_destroy(track_preview_t* p) {
+  if (p == nullptr) return;
+  allocator_t* a = p->allocator;
+  darray_deinit(&p->positions, a);
+  darray_deinit(&p->discovery_indices, a);
+  darray_deinit(&p->max_ends, a);
+  allocator_free(a, p, sizeof(track_preview_t));
+}
+
+// Appends the deltas' events to their tracks, adding the tracks that are new.
+// Returns the length of the longest track that changed.
+static size_t track_preview_append(track_preview_t* p,
+                                   const darray_track_delta_t* deltas,
+                                   darray_track_t* tracks) {
+  size_t longest = 0;
+  for (size_t i = 0; i < deltas->len; i++) {
+    const track_delta_t* d = &deltas->ptr[i];
+    // Deltas come in discovery order, so new tracks come in order too.
+    if (d->track_idx == p->positions.len) {
+      darray_push(tracks, d->header, p->allocator);
+      darray_push(&p->positions, tracks->len - 1, p->allocator);
+      darray_push(&p->discovery_indices, d->track_idx, p->allocator);
+      darray_push(&p->max_ends, INT64_MIN, p->allocator);
+    }
+    expect(d->track_idx < p->positions.len);
+
+    track_t* t = &tracks->ptr[p->positions.ptr[d->track_idx]];
+    t->name_ref = d->header.name_ref;
+    t->sort_index = d->header.sort_index;
+    darray_push_n(&t->event_indices, d->event_indices.ptr,
+                  d->event_indices.len, p->track_allocator);
+    if (t->event_indices.len > longest) {
+      longest = t->event_indices.len;
+    }
+  }
+  return longest;
+}
+
+void track_preview_apply(track_preview_t* p, const trace_data_t* td,
+                         const darray_track_delta_t* deltas,
+                         darray_track_t* tracks, int64_t* out_min_ts,
+                         int64_t* out_max_ts, allocator_t* scratch_allocator) {
+  SELF_TRACE_BEGIN("track_preview_apply");
+  expect(tracks->len == p->positions.len);
+  allocator_t* track_allocator = p->track_allocator;
+
+  sort_key_buffer_t keys = {
+      .allocator = scratch_allocator,
+      .capacity = track_preview_append(p, deltas, tracks),
+  };
+
+  // New events are merged in by sort_events, and a begin event that got its
+  // duration may move in its track and contain the events after it, so the
+  // tracks that changed are finished again as a whole.
+  for (size_t i = 0; i < deltas->len; i++) {
+    size_t track_idx = deltas->ptr[i].track_idx;
+    track_t* t = &tracks->ptr[p->positions.ptr[track_idx]];
+    sort_events(t, td, &keys, &p->max_ends.ptr[track_idx]);
+    track_update_max_dur(t, td, track_allocator);
+    if (t->type == TRACK_TYPE_THREAD) {
+      track_calculate_depths(t, td, track_allocator);
+    } else {
+      track_finish_counter(t, td, track_allocator, scratch_allocator);
+    }
+  }
+  sort_key_buffer_deinit(&keys);
+
+  if (tracks->len > 0) {
+    size_t* order = (size_t*)allocator_alloc(scratch_allocator,
+                                             tracks->len * sizeof(size_t));
+    track_sort_tracks(tracks, td, order, scratch_allocator);
+    for (size_t i = 0; i < tracks->len; i++) {
+      order[i] = p->discovery_indices.ptr[order[i]];
+    }
+    for (size_t i = 0; i < tracks->len; i++) {
+      p->discovery_indices.ptr[i] = order[i];
+      p->positions.ptr[order[i]] = i;
     }
-    darray_compact(out_tracks, output_allocator);
+    allocator_free(scratch_allocator, order, tracks->len * sizeof(size_t));
+  }
 
-    darray_deinit(&event_counts, scratch_allocator);
-    hash_table_deinit(&track_map, scratch_allocator);
+  const trace_event_persisted_t* events = td->events.ptr;
+  bool first_event = true;
+  for (size_t i = 0; i < tracks->len; i++) {
+    const track_t* t = &tracks->ptr[i];
+    if (t->event_indices.len > 0) {
+      int64_t first_ts = events[t->event_indices.ptr[0]].ts;
+      int64_t max_end = p->max_ends.ptr[p->discovery_indices.ptr[i]];
+      if (first_event || first_ts < *out_min_ts) {
+        *out_min_ts = first_ts;
+      }
+      if (first_event || max_end > *out_max_ts) {
+        *out_max_ts = max_end;
+      }
+      first_event = false;
+    }
   }
+  SELF_TRACE_END();
 }
@@ -36,23 +36,124 @@ typedef struct track {
 
 typedef darray_t(track_t) darray_track_t;
 
+constexpr uint32_t TRACK_EVENT_LOCATION_NONE = UINT32_MAX;
+
+// Where an event lives in the organized tracks:
+// tracks[track_idx].event_indices[position].
+typedef struct track_event_location {
+  // TRACK_EVENT_LOCATION_NONE for events in no track (metadata)
+  uint32_t track_idx;
+  uint32_t position;
+} track_event_location_t;
+
+typedef darray_t(track_event_location_t) darray_track_event_location_t;
+
+// Wall-clock breakdown of a track_organize pass, in milliseconds.
+typedef struct track_organize_profile {
+  double discover_ms;     // track_builder_update: discovery, metadata, grouping
+  double sort_events_ms;  // Putting events that arrived out of order in place
+  double per_track_ms;    // Per-track max durations, depths, series
+  double sort_ms;         // Final track ordering and compaction
+} track_organize_profile_t;
+
+// Assigns events to tracks while a trace is still being parsed, so that the
+// work left once the whole trace is in is a finishing pass over each track.
+typedef struct track_builder track_builder_t;
+
+// What one track gained since the track builder last published it (see
+// track_builder_publish).
+typedef struct track_delta {
+  // Position of the track in the builder's discovery order
+  size_t track_idx;
+  // The track's type, ids and metadata so far; its arrays are empty.
+  track_t header;
+  // The track's new events, in arrival order
+  darray_t(size_t) event_indices;
+} track_delta_t;
+
+typedef darray_t(track_delta_t) darray_track_delta_t;
+
+// Finished tracks of a trace that is still loading, kept up to date with the
+// deltas its track builder publishes, so that only the tracks that changed
+// are finished again.
+typedef struct track_preview track_preview_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void track_deinit(track_t* t, allocator_t* a);
 void track_compact(track_t* t, allocator_t* a);
-void track_sort_events(track_t* t, const trace_data_t* td, allocator_t* a);
+void track_sort_events(track_t* t, const trace_data_t* td,
+                       allocator_t* scratch_allocator);
 void track_update_max_dur(track_t* t, const trace_data_t* td, allocator_t* a);
 void track_calculate_depths(track_t* t, const trace_data_t* td, allocator_t* a);
 size_t track_find_visible_start_index(const track_t* t, const trace_data_t* td,
                                       int64_t viewport_start_ts);
 
+// Builds the reverse index of `tracks`: out_locations->ptr[i] is the location
+// of event i, for every event of a trace with `event_count` events.
+void track_build_event_locations(const darray_track_t* tracks,
+                                 size_t event_count,
+                                 darray_track_event_location_t* out_locations,
+                                 allocator_t* a);
+
+track_builder_t* track_builder_create(allocator_t* a);
+void track_builder_destroy(track_builder_t* b);
+
+// Appends every event added to `td` since the previous call to its track,
+// discovering new tracks and applying metadata events. Events are kept in
+// arrival order; begin events may still be waiting for their duration.
+void track_builder_update(track_builder_t* b, const trace_data_t* td);
+
+// Brings the tracks up to date with `td` and appends to `out_deltas` the
+// tracks that changed since the previous call: new tracks, tracks with new
+// events or metadata, and the tracks of the begin events in `updates`, which
+// ended since they were published.
+void track_builder_publish(track_builder_t* b, const trace_data_t* td,
+                           const trace_event_update_t* updates,
+                           size_t update_count,
+                           darray_track_delta_t* out_deltas, allocator_t* a);
+
+void track_deltas_free(darray_track_delta_t* deltas, allocator_t* a);
+
+// Brings the tracks up to date with `td` and finishes them: events are put in
+// (ts, -dur) order, max durations, depths and counter series are computed and
+// the tracks are sorted. Moves the tracks into out_tracks (replacing its
+// contents) and leaves the builder empty. Timings are accumulated into
+// out_profile (may be nullptr).
+void track_builder_finish(track_builder_t* b, const trace_data_t* td,
+                          darray_track_t* out_tracks, int64_t* out_min_ts,
+                          int64_t* out_max_ts, allocator_t* scratch_allocator,
+                          track_organize_profile_t* out_profile);
+
+// Organizes a fully loaded trace in one go, with a temporary track_builder_t.
 void track_organize(const trace_data_t* td, darray_track_t* out_tracks,
                     int64_t* out_min_ts, int64_t* out_max_ts,
                     allocator_t* output_allocator,
                     allocator_t* scratch_allocator);
 
+// Same as track_organize, additionally accumulating per-pass timings into
+// out_profile (may be nullptr).
+void track_organize_profiled(const trace_data_t* td, darray_track_t* out_tracks,
+                             int64_t* out_min_ts, int64_t* out_max_ts,
+                             allocator_t* output_allocator,
+                             allocator_t* scratch_allocator,
+                             track_organize_profile_t* out_profile);
+
+track_preview_t* track_preview_create(allocator_t* a);
+void track_preview_destroy(track_preview_t* p);
+
+// Applies `deltas` to `tracks`, the tracks this preview finished so far
+// (initially empty). `td` must already hold everything the deltas refer to.
+// The tracks in `deltas` are finished again as by track_builder_finish, the
+// others are left alone, and `tracks` is sorted again. Sets the range of the
+// whole trace if it has events.
+void track_preview_apply(track_preview_t* p, const trace_data_t* td,
+                         const darray_track_delta_t* deltas,
+                         darray_track_t* tracks, int64_t* out_min_ts,
+                         int64_t* out_max_ts, allocator_t* scratch_allocator);
+
 #ifdef __cplusplus
 }
 #endif
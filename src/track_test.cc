@@ -2,6 +2,9 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "core/arena.h"
 #include "src/colors.h"
 #include "src/trace_data.h"
@@ -50,6 +53,49 @@ TEST(track_test, sort_events) {
   trace_data_release(td, a);
 }
 
+TEST(track_test, sort_events_completion_order) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td = trace_data_create(a);
+
+  // 'X' events written when they end: every parent comes after its children,
+  // and the first child starts at the same time as its parent.
+  track_t t = {};
+  for (int64_t root = 0; root < 400; root++) {
+    int64_t ts = root * 100;
+    for (int64_t child = 0; child < 4; child++) {
+      trace_event_t leaf = {};
+      leaf.ts = ts + child * 10;
+      leaf.dur = 5;
+      trace_data_add_event(td, a, theme_get_dark(), &leaf);
+      darray_push(&t.event_indices, td->events.len - 1, a);
+    }
+    trace_event_t parent = {};
+    parent.ts = ts;
+    parent.dur = 50;
+    trace_data_add_event(td, a, theme_get_dark(), &parent);
+    darray_push(&t.event_indices, td->events.len - 1, a);
+  }
+
+  std::vector<size_t> expected(t.event_indices.ptr,
+                               t.event_indices.ptr + t.event_indices.len);
+  const trace_event_persisted_t* events = td->events.ptr;
+  std::sort(expected.begin(), expected.end(), [&](size_t x, size_t y) {
+    if (events[x].ts != events[y].ts) return events[x].ts < events[y].ts;
+    if (events[x].dur != events[y].dur) return events[x].dur > events[y].dur;
+    return x < y;
+  });
+
+  track_sort_events(&t, td, a);
+
+  ASSERT_EQ(t.event_indices.len, expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(t.event_indices.ptr[i], expected[i]) << "position " << i;
+  }
+
+  track_deinit(&t, a);
+  trace_data_release(td, a);
+}
+
 TEST(track_test, update_max_dur) {
   allocator_t* a = c_allocator();
   trace_data_t* td = trace_data_create(a);
@@ -520,6 +566,69 @@ TEST(track_test, organize_tracks_mixed_order) {
   trace_data_release(td, a);
 }
 
+TEST(track_test, build_event_locations) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td = trace_data_create(a);
+
+  // Event 0: pid 2, ts 300. Event 1: thread_name metadata. Event 2: pid 1.
+  // Event 3: pid 2, ts 100, sorted before event 0.
+  trace_event_t e = {};
+  e.ph = "X";
+  e.pid = 2;
+  e.tid = 1;
+  e.ts = 300;
+  e.dur = 10;
+  trace_data_add_event(td, a, theme_get_dark(), &e);
+
+  trace_event_t m = {};
+  m.ph = "M";
+  m.pid = 1;
+  m.tid = 1;
+  m.name = "thread_name";
+  trace_arg_t arg = {"name", "Main", 0.0};
+  m.args = &arg;
+  m.args_count = 1;
+  trace_data_add_event(td, a, theme_get_dark(), &m);
+
+  e.pid = 1;
+  e.ts = 200;
+  trace_data_add_event(td, a, theme_get_dark(), &e);
+  e.pid = 2;
+  e.ts = 100;
+  trace_data_add_event(td, a, theme_get_dark(), &e);
+
+  darray_track_t tracks = {};
+  int64_t min_ts, max_ts;
+  track_organize(td, theme_get_dark(), &tracks, &min_ts, &max_ts, a);
+  ASSERT_EQ(tracks.len, 2u);
+
+  darray_track_event_location_t locations = {};
+  track_build_event_locations(&tracks, td->events.len, &locations, a);
+  ASSERT_EQ(locations.len, 4u);
+  EXPECT_EQ(locations.ptr[0].track_idx, 1u);
+  EXPECT_EQ(locations.ptr[0].position, 1u);
+  EXPECT_EQ(locations.ptr[1].track_idx, TRACK_EVENT_LOCATION_NONE);
+  EXPECT_EQ(locations.ptr[2].track_idx, 0u);
+  EXPECT_EQ(locations.ptr[2].position, 0u);
+  EXPECT_EQ(locations.ptr[3].track_idx, 1u);
+  EXPECT_EQ(locations.ptr[3].position, 0u);
+
+  // Every location points back at its event.
+  for (size_t i = 0; i < locations.len; i++) {
+    track_event_location_t loc = locations.ptr[i];
+    if (loc.track_idx != TRACK_EVENT_LOCATION_NONE) {
+      EXPECT_EQ(tracks.ptr[loc.track_idx].event_indices.ptr[loc.position], i);
+    }
+  }
+
+  darray_deinit(&locations, a);
+  for (size_t i = 0; i < tracks.len; i++) {
+    track_deinit(&tracks.ptr[i], a);
+  }
+  darray_deinit(&tracks, a);
+  trace_data_release(td, a);
+}
+
 TEST(track_test, organize_tracks_counters) {
   allocator_t* a = c_allocator();
   trace_data_t* td = trace_data_create(a);
@@ -699,3 +808,246 @@ TEST(track_test, organize_tracks_counters_sorting_ignore_case) {
   darray_deinit(&tracks, a);
   trace_data_release(td, a);
 }
+
+TEST(track_test, builder_matches_organize) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td = trace_data_create(a);
+  trace_event_matcher_t matcher = {};
+  track_builder_t* b = track_builder_create(a);
+
+  auto add = [&](trace_event_t e) {
+    (trace_data_add_event)(td, &e, &matcher, a);
+    // Update after every event, as if each one ended a chunk.
+    track_builder_update(b, td);
+  };
+  auto event = [](const char* ph, int32_t tid, int64_t ts, int64_t dur) {
+    trace_event_t e = {};
+    e.ph = string_view_from_cstr(ph);
+    e.name = "work";
+    e.pid = 1;
+    e.tid = tid;
+    e.ts = ts;
+    e.dur = dur;
+    return e;
+  };
+
+  // Thread 1: 'X' events in completion order.
+  add(event("X", 1, 110, 10));
+  add(event("X", 1, 100, 50));
+  add(event("X", 1, 200, 5));
+  // Thread 2: nested begin/end pairs, whose durations arrive late.
+  add(event("B", 2, 100, 0));
+  add(event("B", 2, 100, 0));
+  add(event("E", 2, 120, 0));
+  add(event("X", 2, 130, 5));
+  add(event("E", 2, 150, 0));
+  // A counter, and metadata for a track that already has events.
+  trace_event_t counter = event("C", 1, 90, 0);
+  trace_arg_t arg = {"value", "3", 3.0};
+  counter.name = "queue";
+  counter.args = &arg;
+  counter.args_count = 1;
+  add(counter);
+  trace_event_t name = event("M", 2, 0, 0);
+  trace_arg_t name_arg = {"name", "Worker", 0.0};
+  name.name = "thread_name";
+  name.args = &name_arg;
+  name.args_count = 1;
+  add(name);
+
+  darray_track_t built = {};
+  int64_t built_min_ts = 0, built_max_ts = 0;
+  arena_t* scratch_arena = arena_create_with_allocator(a);
+  track_builder_finish(b, td, &built, &built_min_ts, &built_max_ts,
+                       arena_get_allocator(scratch_arena), nullptr);
+  arena_destroy(scratch_arena);
+  track_builder_destroy(b);
+
+  darray_track_t organized = {};
+  int64_t min_ts = 0, max_ts = 0;
+  track_organize(td, theme_get_dark(), &organized, &min_ts, &max_ts, a);
+
+  EXPECT_EQ(built_min_ts, 90);
+  EXPECT_EQ(built_max_ts, 205);
+  EXPECT_EQ(built_min_ts, min_ts);
+  EXPECT_EQ(built_max_ts, max_ts);
+  ASSERT_EQ(built.len, 3u);
+  ASSERT_EQ(built.len, organized.len);
+  for (size_t i = 0; i < built.len; i++) {
+    const track_t* x = &built.ptr[i];
+    const track_t* y = &organized.ptr[i];
+    EXPECT_EQ(x->type, y->type);
+    EXPECT_EQ(x->tid, y->tid);
+    EXPECT_EQ(x->name_ref, y->name_ref);
+    EXPECT_EQ(x->max_depth, y->max_depth);
+    ASSERT_EQ(x->event_indices.len, y->event_indices.len);
+    for (size_t k = 0; k < x->event_indices.len; k++) {
+      EXPECT_EQ(x->event_indices.ptr[k], y->event_indices.ptr[k]);
+      EXPECT_EQ(x->depths.ptr[k], y->depths.ptr[k]);
+    }
+  }
+
+  // Thread 2 is named, and both inner events sit inside the outer begin.
+  EXPECT_EQ(trace_data_get_string(td, built.ptr[2].name_ref), "Worker");
+  EXPECT_EQ(built.ptr[2].max_depth, 1u);
+  EXPECT_EQ(built.ptr[2].event_indices.len, 3u);
+  // Thread 1 is sorted: the parent first, then its child.
+  const trace_event_persisted_t* events = td->events.ptr;
+  EXPECT_EQ(events[built.ptr[1].event_indices.ptr[0]].ts, 100);
+  EXPECT_EQ(events[built.ptr[1].event_indices.ptr[1]].ts, 110);
+  EXPECT_EQ(built.ptr[1].depths.ptr[1], 1u);
+
+  for (size_t i = 0; i < built.len; i++) {
+    track_deinit(&built.ptr[i], a);
+    track_deinit(&organized.ptr[i], a);
+  }
+  darray_deinit(&built, a);
+  darray_deinit(&organized, a);
+  trace_event_matcher_deinit(&matcher);
+  trace_data_release(td, a);
+}
+
+TEST(track_test, preview_matches_organize) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td = trace_data_create(a);
+  trace_event_matcher_t matcher = {};
+  track_builder_t* b = track_builder_create(a);
+  track_preview_t* preview = track_preview_create(a);
+  darray_track_t tracks = {};
+  int64_t min_ts = 0, max_ts = 0;
+  std::vector<size_t> open;
+
+  // Publishes after every event, as if each one ended a chunk with a
+  // snapshot, and applies the deltas to the preview's tracks.
+  auto add = [&](trace_event_t e) {
+    std::vector<trace_event_update_t> updates;
+    if (e.ph == "E") {
+      size_t begin_idx = open.back();
+      open.pop_back();
+      (trace_data_add_event)(td, &e, &matcher, a);
+      updates.push_back({begin_idx, td->events.ptr[begin_idx]});
+    } else {
+      (trace_data_add_event)(td, &e, &matcher, a);
+      if (e.ph == "B") {
+        open.push_back(td->events.len - 1);
+      }
+    }
+    darray_track_delta_t deltas = {};
+    track_builder_publish(b, td, updates.data(), updates.size(), &deltas, a);
+    track_preview_apply(preview, td, &deltas, &tracks, &min_ts, &max_ts, a);
+    track_deltas_free(&deltas, a);
+  };
+  auto event = [](const char* ph, int32_t tid, int64_t ts, int64_t dur) {
+    trace_event_t e = {};
+    e.ph = string_view_from_cstr(ph);
+    e.name = "work";
+    e.pid = 1;
+    e.tid = tid;
+    e.ts = ts;
+    e.dur = dur;
+    return e;
+  };
+
+  // Thread 2 first, so the tracks are reordered once thread 1 shows up.
+  add(event("B", 2, 100, 0));
+  add(event("B", 2, 100, 0));
+  add(event("E", 2, 120, 0));
+  // Thread 1: 'X' events in completion order.
+  add(event("X", 1, 110, 10));
+  add(event("X", 1, 100, 50));
+  add(event("X", 2, 130, 5));
+  add(event("E", 2, 150, 0));
+  add(event("X", 1, 200, 5));
+  trace_event_t counter = event("C", 1, 90, 0);
+  trace_arg_t arg = {"value", "3", 3.0};
+  counter.name = "queue";
+  counter.args = &arg;
+  counter.args_count = 1;
+  add(counter);
+  trace_event_t name = event("M", 2, 0, 0);
+  trace_arg_t name_arg = {"name", "Worker", 0.0};
+  name.name = "thread_name";
+  name.args = &name_arg;
+  name.args_count = 1;
+  add(name);
+
+  darray_track_t organized = {};
+  int64_t organized_min_ts = 0, organized_max_ts = 0;
+  track_organize(td, theme_get_dark(), &organized, &organized_min_ts,
+                 &organized_max_ts, a);
+
+  EXPECT_EQ(min_ts, organized_min_ts);
+  EXPECT_EQ(max_ts, organized_max_ts);
+  ASSERT_EQ(tracks.len, 3u);
+  ASSERT_EQ(tracks.len, organized.len);
+  for (size_t i = 0; i < tracks.len; i++) {
+    const track_t* x = &tracks.ptr[i];
+    const track_t* y = &organized.ptr[i];
+    EXPECT_EQ(x->type, y->type);
+    EXPECT_EQ(x->tid, y->tid);
+    EXPECT_EQ(x->name_ref, y->name_ref);
+    EXPECT_EQ(x->max_depth, y->max_depth);
+    EXPECT_EQ(x->max_dur, y->max_dur);
+    EXPECT_EQ(x->counter_series.len, y->counter_series.len);
+    ASSERT_EQ(x->event_indices.len, y->event_indices.len);
+    for (size_t k = 0; k < x->event_indices.len; k++) {
+      EXPECT_EQ(x->event_indices.ptr[k], y->event_indices.ptr[k]);
+      EXPECT_EQ(x->depths.ptr[k], y->depths.ptr[k]);
+      EXPECT_EQ(x->self_durs.ptr[k], y->self_durs.ptr[k]);
+    }
+  }
+  EXPECT_EQ(trace_data_get_string(td, tracks.ptr[2].name_ref), "Worker");
+
+  for (size_t i = 0; i < tracks.len; i++) {
+    track_deinit(&tracks.ptr[i], a);
+    track_deinit(&organized.ptr[i], a);
+  }
+  darray_deinit(&tracks, a);
+  darray_deinit(&organized, a);
+  track_preview_destroy(preview);
+  track_builder_destroy(b);
+  trace_event_matcher_deinit(&matcher);
+  trace_data_release(td, a);
+}
+
+TEST(track_test, organize_tracks_long_out_of_order) {
+  allocator_t* a = c_allocator();
+  trace_data_t* td = trace_data_create(a);
+
+  // Longer than the stack keys, written latest first, on two threads so the
+  // sort keys are reused across tracks.
+  const int64_t lens[] = {3000, 2000};
+  for (int32_t tid = 1; tid <= 2; tid++) {
+    for (int64_t i = lens[tid - 1]; i > 0; i--) {
+      trace_event_t e = {};
+      e.ph = "X";
+      e.pid = 1;
+      e.tid = tid;
+      e.ts = i * 10;
+      e.dur = 5;
+      trace_data_add_event(td, a, theme_get_dark(), &e);
+    }
+  }
+
+  darray_track_t tracks = {};
+  int64_t min_ts, max_ts;
+  track_organize(td, theme_get_dark(), &tracks, &min_ts, &max_ts, a);
+
+  ASSERT_EQ(tracks.len, 2u);
+  for (size_t i = 0; i < tracks.len; i++) {
+    const track_t* t = &tracks.ptr[i];
+    ASSERT_EQ(t->event_indices.len, (size_t)lens[t->tid - 1]);
+    for (size_t j = 1; j < t->event_indices.len; j++) {
+      EXPECT_LT(td->events.ptr[t->event_indices.ptr[j - 1]].ts,
+                td->events.ptr[t->event_indices.ptr[j]].ts);
+    }
+  }
+  EXPECT_EQ(min_ts, 10);
+  EXPECT_EQ(max_ts, 30005);
+
+  for (size_t i = 0; i < tracks.len; i++) {
+    track_deinit(&tracks.ptr[i], a);
+  }
+  darray_deinit(&tracks, a);
+  trace_data_release(td, a);
+}
@@ -1,31 +1,61 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <glob.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "core/allocator.h"
+#include "core/assert.h"
+#include "core/counting_allocator.h"
+#include "core/json_reader.h"
 #include "core/json_writer.h"
 #include "core/darray.h"
+#include "core/self_trace.h"
+#include "core/tagged_allocator.h"
+#include "core/task.h"
+#include "core/vm_allocator.h"
 #include "src/trace_data.h"
 #include "src/trace_concurrency.h"
 #include "src/trace_aggregate.h"
 #include "src/trace_diff.h"
+#include "src/trace_fleet.h"
+#include "src/cli_output.h"
 #include "src/cli_table.h"
+#include "src/trace_call_tree.h"
 #include "src/trace_histogram.h"
+#include "src/trace_query.h"
+#include "src/platform.h"
 #include "src/trace_loader.h"
 #include "src/trace_viewer.h"
 #include "src/track.h"
 
 // Print the global usage and exit.
 static void print_usage(const char* prog_name) {
-  fprintf(stderr, "Usage: %s <subcommand> <trace_file> [options]\n\n",
+  fprintf(stderr,
+          "Usage: %s [global options] <subcommand> <trace_file> [options]\n\n",
           prog_name);
+  fprintf(stderr, "Global Options:\n");
+  fprintf(stderr,
+          "  --profile                    Print a per-phase timing and "
+          "memory table.\n");
+  fprintf(stderr,
+          "  --self-trace <path>          Record ztracing's own execution "
+          "as a Chrome trace.\n\n");
   fprintf(stderr, "Subcommands:\n");
   fprintf(stderr,
           "  summary <trace_file>         Print high-level trace metadata "
           "(counts, duration).\n");
   fprintf(stderr,
-          "                               Options: [--list-tracks]\n");
+          "                               Options: [--list-tracks] "
+          "[--memory]\n");
   fprintf(stderr,
           "  inspect <trace_file>         Inspect detailed event parameters "
           "at a timestamp.\n");
@@ -54,6 +84,8 @@ static void print_usage(const char* prog_name) {
           "                               Options: [--group-by name|category]\n");
   fprintf(stderr,
           "                                        [--sort duration|count]\n");
+  fprintf(stderr,
+          "                                        [--metric total|self|both]\n");
   fprintf(stderr,
           "                                        [--min-count <n>]\n");
   fprintf(stderr,
@@ -62,6 +94,29 @@ static void print_usage(const char* prog_name) {
           "                               Options: [--group-by name|category]\n");
   fprintf(stderr,
           "                                        [--sort dur-delta|count-delta]\n");
+  fprintf(stderr,
+          "                                        [--metric total|self]\n");
+  fprintf(stderr,
+          "                                        "
+          "[--memory-budget <MiB>]\n");
+  fprintf(stderr,
+          "  fleet-aggregate <dir|glob>   Aggregate many traces into "
+          "per-key distributions.\n");
+  fprintf(stderr,
+          "                               Options: [--group-by name|category]\n");
+  fprintf(stderr,
+          "                                        [--sort duration|count|p95]\n");
+  fprintf(stderr,
+          "                                        [--jobs <n>] "
+          "[--memory-budget <MiB>]\n");
+  fprintf(stderr,
+          "  flamegraph <trace_file>      Merge the stacks of all threads "
+          "into a call tree.\n");
+  fprintf(stderr,
+          "                               Options: [--root <name>] "
+          "[--t-start <us>]\n");
+  fprintf(stderr,
+          "                                        [--t-end <us>]\n");
   fprintf(stderr,
           "  histogram <trace_file>       Compute duration histogram "
           "buckets.\n");
@@ -71,17 +126,65 @@ static void print_usage(const char* prog_name) {
   fprintf(stderr,
           "                                        [--t-start <us>] "
           "[--t-end <us>]\n");
+  fprintf(stderr,
+          "  batch <trace_file> [script]  Run many subcommands over one "
+          "load.\n");
+  fprintf(stderr,
+          "                               Options: [--exec \"<subcommand> "
+          "[options]\"]...\n");
+  fprintf(stderr,
+          "                                        [--jobs <n>]\n");
+  fprintf(stderr,
+          "  serve <trace_file>           Keep traces loaded and answer "
+          "JSON requests,\n");
+  fprintf(stderr,
+          "                               one per line, on stdin or a "
+          "socket.\n");
+  fprintf(stderr,
+          "                               Options: [--socket <path>]\n\n");
+  fprintf(stderr, "Output Options (analysis subcommands):\n");
+  fprintf(stderr,
+          "  --format table|json|jsonl|csv  Print result tables as text "
+          "(default) or as\n");
+  fprintf(stderr,
+          "                               machine-readable records.\n");
 }
 
+// Most --exec commands accepted by batch.
+constexpr size_t CLI_MAX_EXECS = 64;
+
 typedef struct cli_args {
+  // Global options
+  bool profile;
+  const char* self_trace_path;
+
   const char* subcommand;
   const char* trace_file;
   const char* trace_file_2;
   bool list_tracks;
+  bool memory;
+  const char* socket_path;
+  cli_format_t format;
+
+  // Batch options
+  const char* script_path;
+  const char* execs[CLI_MAX_EXECS];
+  size_t exec_count;
+  int jobs;
+  bool has_jobs;
+
+  // Set for commands that run on a worker (batch --jobs). They must not wait
+  // on tasks of their own, which could need the worker they occupy.
+  bool on_worker;
+
+  // Fleet options
+  int memory_budget_mb;
+  bool has_memory_budget;
 
   // Histogram / Filtering options
   const char* track_filter;
   const char* match_filter;
+  const char* root_filter;
   int64_t t_start;
   int64_t t_end;
   int max_depth;
@@ -90,6 +193,7 @@ typedef struct cli_args {
   int min_count;
   string_view_t group_by;
   string_view_t sort_by;
+  string_view_t metric;
   bool has_t_start;
   bool has_t_end;
   bool has_max_depth;
@@ -99,7 +203,8 @@ typedef struct cli_args {
 } cli_args_t;
 
 // Parses CLI arguments manually.
-static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
+static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args,
+                            FILE* err) {
   bool success = true;
 
   if (argc < 2) {
@@ -113,8 +218,18 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
     if (string_view_eq(arg, SV("-h")) ||
         string_view_eq(arg, SV("--help"))) {
       success = false;
+    } else if (string_view_eq(arg, SV("--profile"))) {
+      out_args->profile = true;
+    } else if (string_view_eq(arg, SV("--self-trace"))) {
+      if (i + 1 < argc) {
+        out_args->self_trace_path = argv[i + 1];
+        i++;
+      } else {
+        fprintf(err, "Error: Missing value for option '--self-trace'\n");
+        success = false;
+      }
     } else if (arg.len > 0 && arg.ptr[0] == '-') {
-      fprintf(stderr, "Error: Unknown global option '%s'\n", argv[i]);
+      fprintf(err, "Error: Unknown global option '%s'\n", argv[i]);
       success = false;
     } else {
       out_args->subcommand = argv[i];
@@ -125,7 +240,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
   }
 
   if (success && !out_args->subcommand) {
-    fprintf(stderr, "Error: No subcommand provided.\n");
+    fprintf(err, "Error: No subcommand provided.\n");
     success = false;
   }
 
@@ -140,7 +255,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         i++;
       }
     } else {
-      fprintf(stderr, "Error: Missing trace file argument.\n");
+      fprintf(err, "Error: Missing trace file argument.\n");
       success = false;
     }
   }
@@ -156,7 +271,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         i++;
       }
     } else {
-      fprintf(stderr, "Error: Missing second trace file argument for diff.\n");
+      fprintf(err, "Error: Missing second trace file argument for diff.\n");
       success = false;
     }
   }
@@ -170,7 +285,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->has_t_start = true;
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--ts'\n");
+        fprintf(err, "Error: Missing value for option '--ts'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--track"))) {
@@ -178,7 +293,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->track_filter = argv[i + 1];
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--track'\n");
+        fprintf(err, "Error: Missing value for option '--track'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--match"))) {
@@ -186,7 +301,15 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->match_filter = argv[i + 1];
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--match'\n");
+        fprintf(err, "Error: Missing value for option '--match'\n");
+        success = false;
+      }
+    } else if (string_view_eq(arg, SV("--root"))) {
+      if (i + 1 < argc) {
+        out_args->root_filter = argv[i + 1];
+        i++;
+      } else {
+        fprintf(err, "Error: Missing value for option '--root'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--t-start"))) {
@@ -195,7 +318,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->has_t_start = true;
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--t-start'\n");
+        fprintf(err, "Error: Missing value for option '--t-start'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--t-end"))) {
@@ -204,7 +327,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->has_t_end = true;
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--t-end'\n");
+        fprintf(err, "Error: Missing value for option '--t-end'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--max-depth"))) {
@@ -213,7 +336,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->has_max_depth = true;
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--max-depth'\n");
+        fprintf(err, "Error: Missing value for option '--max-depth'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--limit"))) {
@@ -222,18 +345,77 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->has_limit = true;
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--limit'\n");
+        fprintf(err, "Error: Missing value for option '--limit'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--list-tracks"))) {
       out_args->list_tracks = true;
+    } else if (string_view_eq(arg, SV("--memory"))) {
+      out_args->memory = true;
+    } else if (string_view_eq(arg, SV("--format"))) {
+      if (i + 1 < argc) {
+        if (!cli_format_parse(string_view_from_cstr(argv[i + 1]),
+                              &out_args->format)) {
+          fprintf(err,
+                  "Error: Invalid value for --format: '%s'. Expected "
+                  "'table', 'json', 'jsonl' or 'csv'.\n",
+                  argv[i + 1]);
+          success = false;
+        }
+        i++;
+      } else {
+        fprintf(err, "Error: Missing value for option '--format'\n");
+        success = false;
+      }
+    } else if (string_view_eq(arg, SV("--socket"))) {
+      if (i + 1 < argc) {
+        out_args->socket_path = argv[i + 1];
+        i++;
+      } else {
+        fprintf(err, "Error: Missing value for option '--socket'\n");
+        success = false;
+      }
+    } else if (string_view_eq(arg, SV("--exec"))) {
+      if (i + 1 < argc && out_args->exec_count < CLI_MAX_EXECS) {
+        out_args->execs[out_args->exec_count++] = argv[i + 1];
+        i++;
+      } else if (i + 1 < argc) {
+        fprintf(err, "Error: Too many '--exec' options (at most %zu)\n",
+                (size_t)CLI_MAX_EXECS);
+        success = false;
+      } else {
+        fprintf(err, "Error: Missing value for option '--exec'\n");
+        success = false;
+      }
+    } else if (string_view_eq(arg, SV("--jobs"))) {
+      if (i + 1 < argc) {
+        out_args->jobs = atoi(argv[i + 1]);
+        out_args->has_jobs = true;
+        i++;
+      } else {
+        fprintf(err, "Error: Missing value for option '--jobs'\n");
+        success = false;
+      }
+    } else if (string_view_eq(arg, SV("--memory-budget"))) {
+      if (i + 1 < argc) {
+        out_args->memory_budget_mb = atoi(argv[i + 1]);
+        out_args->has_memory_budget = true;
+        i++;
+      } else {
+        fprintf(err, "Error: Missing value for option '--memory-budget'\n");
+        success = false;
+      }
+    } else if (strcmp(out_args->subcommand, "batch") == 0 &&
+               out_args->script_path == nullptr &&
+               (arg.len == 1 || (arg.len > 0 && arg.ptr[0] != '-'))) {
+      out_args->script_path = argv[i];
     } else if (string_view_eq(arg, SV("--buckets"))) {
       if (i + 1 < argc) {
         out_args->concurrency_buckets = atoi(argv[i + 1]);
         out_args->has_concurrency_buckets = true;
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--buckets'\n");
+        fprintf(err, "Error: Missing value for option '--buckets'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--group-by"))) {
@@ -241,7 +423,7 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->group_by = string_view_from_cstr(argv[i + 1]);
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--group-by'\n");
+        fprintf(err, "Error: Missing value for option '--group-by'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--sort"))) {
@@ -249,7 +431,15 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->sort_by = string_view_from_cstr(argv[i + 1]);
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--sort'\n");
+        fprintf(err, "Error: Missing value for option '--sort'\n");
+        success = false;
+      }
+    } else if (string_view_eq(arg, SV("--metric"))) {
+      if (i + 1 < argc) {
+        out_args->metric = string_view_from_cstr(argv[i + 1]);
+        i++;
+      } else {
+        fprintf(err, "Error: Missing value for option '--metric'\n");
         success = false;
       }
     } else if (string_view_eq(arg, SV("--min-count"))) {
@@ -258,11 +448,11 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
         out_args->has_min_count = true;
         i++;
       } else {
-        fprintf(stderr, "Error: Missing value for option '--min-count'\n");
+        fprintf(err, "Error: Missing value for option '--min-count'\n");
         success = false;
       }
     } else {
-      fprintf(stderr, "Error: Unknown option '%s' for subcommand '%s'\n",
+      fprintf(err, "Error: Unknown option '%s' for subcommand '%s'\n",
               argv[i], out_args->subcommand);
       success = false;
     }
@@ -272,71 +462,111 @@ static bool parse_arguments(int argc, char* argv[], cli_args_t* out_args) {
   return success;
 }
 
-// Handles the 'summary' subcommand.
-static int handle_summary(const trace_data_t* td, const darray_track_t* tracks,
-                          int64_t min_ts, int64_t max_ts, bool list_tracks,
-                          allocator_t* a) {
-  (void)a; // Unused now since cli_table uses its own arena
+static void add_memory_row(cli_output_t* o, string_view_t tag,
+                           const memory_tag_stats_t* stats) {
+  cli_output_add_row(o);
+  cli_output_set_string(o, 0, tag);
+  cli_output_set_double(o, 1,
+                        (double)stats->current_bytes / (1024.0 * 1024.0), 2);
+  cli_output_set_double(o, 2, (double)stats->peak_bytes / (1024.0 * 1024.0),
+                        2);
+  cli_output_set_int(o, 3, (int64_t)stats->alloc_count);
+}
 
-  cli_table_t summary_table = {};
-  cli_table_init(&summary_table);
+// Prints current/peak bytes and allocation counts per subsystem (--memory).
+static void print_memory_by_tag(tagged_allocator_t* ta, cli_output_t* o) {
+  if (cli_output_is_table(o)) {
+    fprintf(o->out, "\n");
+  }
+  cli_output_begin_table(o, SV("memory"));
+  cli_output_add_column(o, SV("tag"), SV("Tag"), CLI_ALIGN_LEFT, 10, true);
+  cli_output_add_column(o, SV("current_mb"), SV("Current (MB)"),
+                        CLI_ALIGN_RIGHT, 12, false);
+  cli_output_add_column(o, SV("peak_mb"), SV("Peak (MB)"), CLI_ALIGN_RIGHT,
+                        10, false);
+  cli_output_add_column(o, SV("allocs"), SV("Allocs"), CLI_ALIGN_RIGHT, 8,
+                        false);
+
+  memory_tag_stats_t stats;
+  for (size_t i = 0; i < MEMORY_TAG_COUNT; i++) {
+    memory_tag_t tag = (memory_tag_t)i;
+    tagged_allocator_get_stats(ta, tag, &stats);
+    add_memory_row(o, string_view_from_cstr(memory_tag_name(tag)), &stats);
+  }
+  tagged_allocator_get_total_stats(ta, &stats);
+  add_memory_row(o, SV("total"), &stats);
 
-  cli_table_add_column(&summary_table, SV("Metric"), CLI_ALIGN_LEFT, 25, true);
-  cli_table_add_column(&summary_table, SV("Value"), CLI_ALIGN_LEFT, 15, true);
+  cli_output_end_table(o);
+}
 
-  cli_table_add_row(&summary_table);
-  cli_table_set_cell(&summary_table, 0, SV("Event Count"));
-  cli_table_set_cell_fmt(&summary_table, 1, "%zu", td->events.len);
+// Handles the 'summary' subcommand. `memory` is non-null with --memory.
+static int handle_summary(const trace_data_t* td, const darray_track_t* tracks,
+                          int64_t min_ts, int64_t max_ts, bool list_tracks,
+                          tagged_allocator_t* memory, cli_output_t* o) {
+  cli_output_begin_table(o, SV("summary"));
+  cli_output_add_column(o, SV("metric"), SV("Metric"), CLI_ALIGN_LEFT, 25,
+                        true);
+  cli_output_add_column(o, SV("value"), SV("Value"), CLI_ALIGN_LEFT, 15, true);
 
-  cli_table_add_row(&summary_table);
-  cli_table_set_cell(&summary_table, 0, SV("Track Count"));
-  cli_table_set_cell_fmt(&summary_table, 1, "%zu", tracks->len);
+  cli_output_add_row(o);
+  cli_output_set_string(o, 0, SV("Event Count"));
+  cli_output_set_int(o, 1, (int64_t)td->events.len);
 
-  cli_table_add_row(&summary_table);
-  cli_table_set_cell(&summary_table, 0, SV("Min Timestamp (us)"));
-  cli_table_set_cell_fmt(&summary_table, 1, "%ld", (long)min_ts);
+  cli_output_add_row(o);
+  cli_output_set_string(o, 0, SV("Track Count"));
+  cli_output_set_int(o, 1, (int64_t)tracks->len);
 
-  cli_table_add_row(&summary_table);
-  cli_table_set_cell(&summary_table, 0, SV("Max Timestamp (us)"));
-  cli_table_set_cell_fmt(&summary_table, 1, "%ld", (long)max_ts);
+  cli_output_add_row(o);
+  cli_output_set_string(o, 0, SV("Min Timestamp (us)"));
+  cli_output_set_int(o, 1, min_ts);
 
-  cli_table_add_row(&summary_table);
-  cli_table_set_cell(&summary_table, 0, SV("Duration (ms)"));
-  cli_table_set_cell_fmt(&summary_table, 1, "%.3f", (double)(max_ts - min_ts) / 1000.0);
+  cli_output_add_row(o);
+  cli_output_set_string(o, 0, SV("Max Timestamp (us)"));
+  cli_output_set_int(o, 1, max_ts);
 
-  cli_table_print(&summary_table);
-  cli_table_deinit(&summary_table);
+  cli_output_add_row(o);
+  cli_output_set_string(o, 0, SV("Duration (ms)"));
+  cli_output_set_double(o, 1, (double)(max_ts - min_ts) / 1000.0, 3);
 
-  if (list_tracks) {
-    printf("\n");
-    cli_table_t tracks_table = {};
-    cli_table_init(&tracks_table);
+  cli_output_end_table(o);
 
-    cli_table_add_column(&tracks_table, SV("Index"), CLI_ALIGN_RIGHT, 5, true);
-    cli_table_add_column(&tracks_table, SV("Track Name"), CLI_ALIGN_LEFT, 20, true);
-    cli_table_add_column(&tracks_table, SV("Type"), CLI_ALIGN_LEFT, 10, true);
-    cli_table_add_column(&tracks_table, SV("PID"), CLI_ALIGN_RIGHT, 8, true);
-    cli_table_add_column(&tracks_table, SV("TID"), CLI_ALIGN_RIGHT, 8, true);
-    cli_table_add_column(&tracks_table, SV("Event Count"), CLI_ALIGN_RIGHT, 12, true);
-    cli_table_add_column(&tracks_table, SV("Max Depth"), CLI_ALIGN_RIGHT, 10, true);
+  if (list_tracks) {
+    if (cli_output_is_table(o)) {
+      fprintf(o->out, "\n");
+    }
+    cli_output_begin_table(o, SV("tracks"));
+    cli_output_add_column(o, SV("index"), SV("Index"), CLI_ALIGN_RIGHT, 5,
+                          true);
+    cli_output_add_column(o, SV("name"), SV("Track Name"), CLI_ALIGN_LEFT, 20,
+                          true);
+    cli_output_add_column(o, SV("type"), SV("Type"), CLI_ALIGN_LEFT, 10, true);
+    cli_output_add_column(o, SV("pid"), SV("PID"), CLI_ALIGN_RIGHT, 8, true);
+    cli_output_add_column(o, SV("tid"), SV("TID"), CLI_ALIGN_RIGHT, 8, true);
+    cli_output_add_column(o, SV("event_count"), SV("Event Count"),
+                          CLI_ALIGN_RIGHT, 12, true);
+    cli_output_add_column(o, SV("max_depth"), SV("Max Depth"), CLI_ALIGN_RIGHT,
+                          10, true);
 
     track_t* tracks_data = tracks->ptr;
     for (size_t i = 0; i < tracks->len; i++) {
       const track_t* t = &tracks_data[i];
       string_view_t track_name = trace_data_get_string(td, t->name_ref);
 
-      cli_table_add_row(&tracks_table);
-      cli_table_set_cell_fmt(&tracks_table, 0, "%zu", i);
-      cli_table_set_cell(&tracks_table, 1, track_name);
-      cli_table_set_cell(&tracks_table, 2, t->type == TRACK_TYPE_THREAD ? SV("THREAD") : SV("COUNTER"));
-      cli_table_set_cell_fmt(&tracks_table, 3, "%d", t->pid);
-      cli_table_set_cell_fmt(&tracks_table, 4, "%d", t->tid);
-      cli_table_set_cell_fmt(&tracks_table, 5, "%zu", t->event_indices.len);
-      cli_table_set_cell_fmt(&tracks_table, 6, "%d", t->max_depth);
+      cli_output_add_row(o);
+      cli_output_set_int(o, 0, (int64_t)i);
+      cli_output_set_string(o, 1, track_name);
+      cli_output_set_string(o, 2, t->type == TRACK_TYPE_THREAD ? SV("THREAD") : SV("COUNTER"));
+      cli_output_set_int(o, 3, t->pid);
+      cli_output_set_int(o, 4, t->tid);
+      cli_output_set_int(o, 5, (int64_t)t->event_indices.len);
+      cli_output_set_int(o, 6, t->max_depth);
     }
 
-    cli_table_print(&tracks_table);
-    cli_table_deinit(&tracks_table);
+    cli_output_end_table(o);
+  }
+
+  if (memory) {
+    print_memory_by_tag(memory, o);
   }
 
   return 0;
@@ -345,7 +575,7 @@ static int handle_summary(const trace_data_t* td, const darray_track_t* tracks,
 // Handles the 'concurrency' subcommand.
 static int handle_concurrency(const trace_data_t* td, const darray_track_t* tracks,
                               int64_t min_ts, int64_t max_ts, const cli_args_t* args,
-                              allocator_t* a) {
+                              allocator_t* a, cli_output_t* o) {
   size_t buckets = args->has_concurrency_buckets ? (size_t)args->concurrency_buckets : 16;
 
   darray_t(trace_concurrency_bucket_t) concurrency_buckets = {};
@@ -362,13 +592,17 @@ static int handle_concurrency(const trace_data_t* td, const darray_track_t* trac
     temp_buckets /= 10;
   }
 
-  cli_table_t table = {};
-  cli_table_init(&table);
-
-  cli_table_add_column(&table, SV("Bucket"), CLI_ALIGN_LEFT, 0, true);
-  cli_table_add_column(&table, SV("Time Range (s)"), CLI_ALIGN_LEFT, 0, true);
-  cli_table_add_column(&table, SV("Concurrency (Active Threads)"), CLI_ALIGN_LEFT, 0, true);
-  cli_table_add_column(&table, SV("Dominant Events"), CLI_ALIGN_LEFT, 0, true);
+  // Bucket labels, ranges and bars are table-only; machine formats get the
+  // raw numbers behind them.
+  cli_output_begin_table(o, SV("concurrency"));
+  cli_output_add_column(o, SV(""), SV("Bucket"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("bucket"), SV(""), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV(""), SV("Time Range (s)"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("start_s"), SV(""), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("end_s"), SV(""), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV(""), SV("Concurrency (Active Threads)"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("utilization_pct"), SV(""), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("dominant_events"), SV("Dominant Events"), CLI_ALIGN_LEFT, 0, true);
 
   size_t thread_track_count = 0;
   track_t* tracks_data = tracks->ptr;
@@ -394,28 +628,38 @@ static int handle_concurrency(const trace_data_t* td, const darray_track_t* trac
     if (active_chars < 0) active_chars = 0;
     if (active_chars > 20) active_chars = 20;
 
-    cli_table_add_row(&table);
+    cli_output_add_row(o);
 
-    // Col 0: Bucket
-    cli_table_set_cell_fmt(&table, 0, "[%0*zu]", bucket_width, b);
-
-    // Col 1: Time Range
-    cli_table_set_cell_fmt(&table, 1, "%.1f - %.1f", start_s, end_s);
+    // Col 0-1: Bucket
+    if (cli_output_is_table(o)) {
+      cli_output_set_fmt(o, 0, "[%0*zu]", bucket_width, b);
+    }
+    cli_output_set_int(o, 1, (int64_t)b);
 
-    // Col 2: Concurrency Bar
-    string_t bar = {};
-    string_append(&bar, SV("["), a);
-    for (int i = 0; i < active_chars; i++) {
-      string_append(&bar, SV("█"), a);
+    // Col 2-4: Time Range
+    if (cli_output_is_table(o)) {
+      cli_output_set_fmt(o, 2, "%.1f - %.1f", start_s, end_s);
     }
-    for (int i = active_chars; i < 20; i++) {
-      string_append(&bar, SV("░"), a);
+    cli_output_set_double(o, 3, start_s, 1);
+    cli_output_set_double(o, 4, end_s, 1);
+
+    // Col 5-6: Concurrency Bar
+    if (cli_output_is_table(o)) {
+      string_t bar = {};
+      string_append(&bar, SV("["), a);
+      for (int i = 0; i < active_chars; i++) {
+        string_append(&bar, SV("█"), a);
+      }
+      for (int i = active_chars; i < 20; i++) {
+        string_append(&bar, SV("░"), a);
+      }
+      string_printf(&bar, a, "] %3.0f%%     ", pct);
+      cli_output_set_string(o, 5, string_get_view(&bar));
+      string_free(bar, a);
     }
-    string_printf(&bar, a, "] %3.0f%%     ", pct);
-    cli_table_set_cell(&table, 2, string_get_view(&bar));
-    string_free(bar, a);
+    cli_output_set_double(o, 6, pct, 0);
 
-    // Col 3: Dominant Events
+    // Col 7: Dominant Events
     string_t events_str = {};
     for (size_t i = 0; i < bucket->dominant_events_count; i++) {
       string_view_t name = trace_data_get_string(td, bucket->dominant_events[i]);
@@ -424,43 +668,230 @@ static int handle_concurrency(const trace_data_t* td, const darray_track_t* trac
         string_append(&events_str, SV(", "), a);
       }
     }
-    cli_table_set_cell(&table, 3, string_get_view(&events_str));
+    cli_output_set_string(o, 7, string_get_view(&events_str));
     string_free(events_str, a);
   }
 
-  cli_table_print(&table);
-  cli_table_deinit(&table);
+  cli_output_end_table(o);
 
   darray_deinit(&concurrency_buckets, a);
   return 0;
 }
 
+// Most track ranges one trace's analysis is split into.
+constexpr size_t CLI_MAX_TRACK_RANGES = 8;
+
+// Tracks [begin, end) of one trace, analyzed as one task.
+typedef struct cli_track_range {
+  size_t begin;
+  size_t end;
+} cli_track_range_t;
+
+typedef darray_t(cli_track_range_t) cli_track_ranges_t;
+
+// Splits `tracks` into at most `max_ranges` ranges with about the same number
+// of events each.
+static void cli_split_tracks(const darray_track_t* tracks, size_t max_ranges,
+                             cli_track_ranges_t* out_ranges, allocator_t* a) {
+  size_t total_events = 0;
+  for (size_t i = 0; i < tracks->len; i++) {
+    total_events += tracks->ptr[i].event_indices.len;
+  }
+  size_t begin = 0;
+  size_t events = 0;
+  size_t range_count = 0;
+  for (size_t i = 0; i < tracks->len; i++) {
+    events += tracks->ptr[i].event_indices.len;
+    bool last = i + 1 == tracks->len;
+    // Cut once this range holds its share of the events.
+    if (last || events * max_ranges >= total_events * (range_count + 1)) {
+      cli_track_range_t range = {.begin = begin, .end = i + 1};
+      darray_push(out_ranges, range, a);
+      begin = i + 1;
+      range_count++;
+    }
+  }
+}
+
+// Runs `run` on each of the `count` items of `item_size` bytes at `items`,
+// in parallel on the task queue through `task` (which passes its user_data
+// to `run`). With `on_worker` (the caller already occupies a worker, and
+// waiting on tasks from there could deadlock the pool) they run inline.
+static void cli_run_parts(void (*run)(void*), task_t task, void* items,
+                          size_t item_size, size_t count, bool on_worker,
+                          allocator_t* a) {
+  uint8_t* item_bytes = (uint8_t*)items;
+  if (on_worker || count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      run(item_bytes + i * item_size);
+    }
+  } else {
+    task_queue_t* queue = task_queue_create(count, platform_submit_job, a);
+    for (size_t i = 0; i < count; i++) {
+      task_submission_t* sqe = task_queue_get_submission(queue);
+      sqe->task = task;
+      sqe->user_data = item_bytes + i * item_size;
+    }
+    task_queue_submit(queue);
+    for (size_t i = 0; i < count; i++) {
+      task_completion_t cqe;
+      task_queue_wait_completion(queue, &cqe);
+      task_queue_remove_completion(queue);
+    }
+    task_queue_destroy(queue);
+  }
+}
+
+// Aggregates one range of a trace's tracks on the task queue.
+typedef struct cli_aggregate_part {
+  // Index of the trace in the cli_aggregate_traces call
+  size_t trace_idx;
+  const trace_data_t* td;
+  const darray_track_t* tracks;
+  cli_track_range_t range;
+  trace_aggregate_partial_t partial;
+  allocator_t* allocator;
+} cli_aggregate_part_t;
+
+typedef darray_t(cli_aggregate_part_t) cli_aggregate_parts_t;
+
+static void cli_aggregate_part_run(void* user_data) {
+  cli_aggregate_part_t* part = (cli_aggregate_part_t*)user_data;
+  trace_aggregate_partial_add_tracks(&part->partial, part->td, part->tracks,
+                                     part->range.begin, part->range.end,
+                                     part->allocator);
+}
+
+static void cli_aggregate_part_task(task_context_t* ctx) {
+  cli_aggregate_part_run(ctx->user_data);
+}
+
+// Aggregates `count` traces from their tracks into `out_entries[i]`. Each
+// trace is split into track ranges that run in parallel on the task queue,
+// unless `on_worker`.
+static void cli_aggregate_traces(const trace_data_t* const* tds,
+                                 const darray_track_t* const* tracks,
+                                 size_t count, string_view_t group_by,
+                                 string_view_t sort_by,
+                                 trace_aggregate_metric_t metric,
+                                 bool on_worker,
+                                 darray_trace_aggregate_entry_t* out_entries,
+                                 allocator_t* a) {
+  size_t max_ranges = on_worker ? 1 : CLI_MAX_TRACK_RANGES;
+  cli_aggregate_parts_t parts = {};
+  cli_track_ranges_t ranges = {};
+  for (size_t i = 0; i < count; i++) {
+    darray_clear(&ranges);
+    cli_split_tracks(tracks[i], max_ranges, &ranges, a);
+    for (size_t j = 0; j < ranges.len; j++) {
+      cli_aggregate_part_t part = {
+          .trace_idx = i,
+          .td = tds[i],
+          .tracks = tracks[i],
+          .range = ranges.ptr[j],
+          .allocator = a,
+      };
+      trace_aggregate_partial_init(&part.partial, group_by);
+      darray_push(&parts, part, a);
+    }
+  }
+  darray_deinit(&ranges, a);
+
+  cli_run_parts(cli_aggregate_part_run, cli_aggregate_part_task, parts.ptr,
+                sizeof(cli_aggregate_part_t), parts.len, on_worker, a);
+
+  // Each trace's parts are contiguous; merge them into its first one.
+  size_t j = 0;
+  for (size_t i = 0; i < count; i++) {
+    trace_aggregate_partial_t* merged = nullptr;
+    for (; j < parts.len && parts.ptr[j].trace_idx == i; j++) {
+      if (merged == nullptr) {
+        merged = &parts.ptr[j].partial;
+      } else {
+        trace_aggregate_partial_merge(merged, &parts.ptr[j].partial, a);
+      }
+    }
+    if (merged) {
+      trace_aggregate_partial_collect(merged, sort_by, metric, &out_entries[i],
+                                      a);
+    }
+  }
+
+  for (size_t i = 0; i < parts.len; i++) {
+    trace_aggregate_partial_deinit(&parts.ptr[i].partial, a);
+  }
+  darray_deinit(&parts, a);
+}
+
+// Parses --metric. `allow_both` accepts "both", for the combined table.
+static bool cli_parse_metric(string_view_t s, bool allow_both,
+                             trace_aggregate_metric_t* out_metric,
+                             bool* out_both, FILE* err) {
+  *out_both = allow_both && string_view_eq(s, SV("both"));
+  bool ok = *out_both || trace_aggregate_metric_parse(s, out_metric);
+  if (*out_both) {
+    *out_metric = TRACE_AGGREGATE_METRIC_TOTAL;
+  }
+  if (!ok) {
+    fprintf(err,
+            "Error: Invalid value for --metric: '%.*s'. Expected 'total'%s "
+            "'self'%s.\n",
+            (int)s.len, s.ptr, allow_both ? "," : " or",
+            allow_both ? " or 'both'" : "");
+  }
+  return ok;
+}
+
 // Handles the 'aggregate' subcommand.
-static int handle_aggregate(const trace_data_t* td, const cli_args_t* args,
-                            allocator_t* a) {
+static int handle_aggregate(const trace_data_t* td,
+                            const darray_track_t* tracks,
+                            const cli_args_t* args, allocator_t* a,
+                            cli_output_t* o, FILE* err) {
   string_view_t group_by = string_view_is_empty(args->group_by) ? SV("name") : args->group_by;
   string_view_t sort_by = string_view_is_empty(args->sort_by) ? SV("duration") : args->sort_by;
+  string_view_t metric_name = string_view_is_empty(args->metric) ? SV("total") : args->metric;
 
   if (!string_view_eq(group_by, SV("name")) && !string_view_eq(group_by, SV("category"))) {
-    fprintf(stderr, "Error: Invalid value for --group-by: '%.*s'. Expected 'name' or 'category'.\n", (int)group_by.len, group_by.ptr);
+    fprintf(err, "Error: Invalid value for --group-by: '%.*s'. Expected 'name' or 'category'.\n", (int)group_by.len, group_by.ptr);
     return 1;
   }
   if (!string_view_eq(sort_by, SV("duration")) && !string_view_eq(sort_by, SV("count"))) {
-    fprintf(stderr, "Error: Invalid value for --sort: '%.*s'. Expected 'duration' or 'count'.\n", (int)sort_by.len, sort_by.ptr);
+    fprintf(err, "Error: Invalid value for --sort: '%.*s'. Expected 'duration' or 'count'.\n", (int)sort_by.len, sort_by.ptr);
     return 1;
   }
+  trace_aggregate_metric_t metric = TRACE_AGGREGATE_METRIC_TOTAL;
+  bool both = false;
+  if (!cli_parse_metric(metric_name, true, &metric, &both, err)) {
+    return 1;
+  }
+  bool show_total = both || metric == TRACE_AGGREGATE_METRIC_TOTAL;
+  bool show_self = both || metric == TRACE_AGGREGATE_METRIC_SELF;
 
   darray_trace_aggregate_entry_t entries = {};
-  trace_aggregate_compute(td, group_by, sort_by, &entries, a);
+  cli_aggregate_traces(&td, &tracks, 1, group_by, sort_by, metric,
+                       args->on_worker, &entries, a);
 
-  cli_table_t table = {};
-  cli_table_init(&table);
+  cli_output_begin_table(o, SV("aggregate"));
 
   bool by_cat = string_view_eq(group_by, SV("category"));
-  cli_table_add_column(&table, by_cat ? SV("Event Category") : SV("Event Name"), CLI_ALIGN_LEFT, 30, true);
-  cli_table_add_column(&table, SV("Total Duration (s)"), CLI_ALIGN_RIGHT, 18, true);
-  cli_table_add_column(&table, SV("Event Count"), CLI_ALIGN_RIGHT, 11, true);
-  cli_table_add_column(&table, SV("Average Duration (ms)"), CLI_ALIGN_RIGHT, 20, true);
+  cli_output_add_column(o, by_cat ? SV("category") : SV("name"), by_cat ? SV("Event Category") : SV("Event Name"), CLI_ALIGN_LEFT, 30, true);
+  if (show_total) {
+    cli_output_add_column(o, SV("total_duration_s"), SV("Total Duration (s)"), CLI_ALIGN_RIGHT, 18, true);
+  }
+  if (show_self) {
+    cli_output_add_column(o, SV("self_duration_s"), SV("Self Duration (s)"), CLI_ALIGN_RIGHT, 17, true);
+  }
+  cli_output_add_column(o, SV("count"), SV("Event Count"), CLI_ALIGN_RIGHT, 11, true);
+  if (show_total) {
+    cli_output_add_column(o, SV("avg_duration_ms"), SV("Average Duration (ms)"), CLI_ALIGN_RIGHT, 20, true);
+  }
+  if (show_self) {
+    cli_output_add_column(o, SV("avg_self_duration_ms"), SV("Average Self (ms)"), CLI_ALIGN_RIGHT, 17, true);
+  }
+  cli_output_add_column(o, SV("p50_duration_ms"), SV("P50 (ms)"), CLI_ALIGN_RIGHT, 10, true);
+  cli_output_add_column(o, SV("p90_duration_ms"), SV("P90 (ms)"), CLI_ALIGN_RIGHT, 10, true);
+  cli_output_add_column(o, SV("p99_duration_ms"), SV("P99 (ms)"), CLI_ALIGN_RIGHT, 10, true);
+  cli_output_add_column(o, SV("max_duration_ms"), SV("Max (ms)"), CLI_ALIGN_RIGHT, 10, true);
 
   int min_count = args->has_min_count ? args->min_count : 2;
   size_t skipped_count = 0;
@@ -472,28 +903,37 @@ static int handle_aggregate(const trace_data_t* td, const cli_args_t* args,
       continue;
     }
     string_view_t key_name = trace_data_get_string(td, e->key_ref);
-    
-    double total_dur_s = e->total_duration / 1000000.0;
-    double avg_dur_ms = 0.0;
-    if (e->count > 0) {
-      avg_dur_ms = (e->total_duration / (double)e->count) / 1000.0;
-    }
+    double count = e->count > 0 ? (double)e->count : 1.0;
 
-    cli_table_add_row(&table);
-    cli_table_set_cell(&table, 0, key_name);
-    cli_table_set_cell_fmt(&table, 1, "%.2f", total_dur_s);
-    cli_table_set_cell_fmt(&table, 2, "%zu", e->count);
-    cli_table_set_cell_fmt(&table, 3, "%.2f", avg_dur_ms);
+    size_t col = 0;
+    cli_output_add_row(o);
+    cli_output_set_string(o, col++, key_name);
+    if (show_total) {
+      cli_output_set_double(o, col++, e->total_duration / 1000000.0, 2);
+    }
+    if (show_self) {
+      cli_output_set_double(o, col++, e->self_duration / 1000000.0, 2);
+    }
+    cli_output_set_int(o, col++, (int64_t)e->count);
+    if (show_total) {
+      cli_output_set_double(o, col++, e->total_duration / count / 1000.0, 2);
+    }
+    if (show_self) {
+      cli_output_set_double(o, col++, e->self_duration / count / 1000.0, 2);
+    }
+    cli_output_set_double(o, col++, e->p50_duration / 1000.0, 2);
+    cli_output_set_double(o, col++, e->p90_duration / 1000.0, 2);
+    cli_output_set_double(o, col++, e->p99_duration / 1000.0, 2);
+    cli_output_set_double(o, col++, e->max_duration / 1000.0, 2);
   }
 
-  cli_table_print(&table);
-  cli_table_deinit(&table);
+  cli_output_end_table(o);
 
-  if (skipped_count > 0) {
+  if (skipped_count > 0 && cli_output_is_table(o)) {
     if (min_count == 2) {
-      printf("\n* Skipped %zu single-instance events (count = 1).\n", skipped_count);
+      fprintf(o->out, "\n* Skipped %zu single-instance events (count = 1).\n", skipped_count);
     } else {
-      printf("\n* Skipped %zu events with count < %d.\n", skipped_count, min_count);
+      fprintf(o->out, "\n* Skipped %zu events with count < %d.\n", skipped_count, min_count);
     }
   }
 
@@ -502,32 +942,61 @@ static int handle_aggregate(const trace_data_t* td, const cli_args_t* args,
 }
 
 // Handles the 'diff' subcommand.
-static int handle_diff(const trace_data_t* td_baseline, const trace_data_t* td_target,
-                       const cli_args_t* args, allocator_t* a) {
+static int handle_diff(const trace_data_t* td_baseline,
+                       const darray_track_t* tracks_baseline,
+                       const trace_data_t* td_target,
+                       const darray_track_t* tracks_target,
+                       const cli_args_t* args, allocator_t* a,
+                       cli_output_t* o, FILE* err) {
   string_view_t group_by = string_view_is_empty(args->group_by) ? SV("name") : args->group_by;
   string_view_t sort_by = string_view_is_empty(args->sort_by) ? SV("dur-delta") : args->sort_by;
+  string_view_t metric_name = string_view_is_empty(args->metric) ? SV("total") : args->metric;
 
   if (!string_view_eq(group_by, SV("name")) && !string_view_eq(group_by, SV("category"))) {
-    fprintf(stderr, "Error: Invalid value for --group-by: '%.*s'. Expected 'name' or 'category'.\n", (int)group_by.len, group_by.ptr);
+    fprintf(err, "Error: Invalid value for --group-by: '%.*s'. Expected 'name' or 'category'.\n", (int)group_by.len, group_by.ptr);
     return 1;
   }
   if (!string_view_eq(sort_by, SV("dur-delta")) && !string_view_eq(sort_by, SV("count-delta"))) {
-    fprintf(stderr, "Error: Invalid value for --sort: '%.*s'. Expected 'dur-delta' or 'count-delta'.\n", (int)sort_by.len, sort_by.ptr);
+    fprintf(err, "Error: Invalid value for --sort: '%.*s'. Expected 'dur-delta' or 'count-delta'.\n", (int)sort_by.len, sort_by.ptr);
+    return 1;
+  }
+  trace_aggregate_metric_t metric = TRACE_AGGREGATE_METRIC_TOTAL;
+  bool both = false;
+  if (!cli_parse_metric(metric_name, false, &metric, &both, err)) {
     return 1;
   }
 
+  // Both traces' track ranges share one task queue.
+  const trace_data_t* tds[] = {td_baseline, td_target};
+  const darray_track_t* tracks[] = {tracks_baseline, tracks_target};
+  darray_trace_aggregate_entry_t aggregates[2] = {};
+  cli_aggregate_traces(tds, tracks, 2, group_by, SV(""), metric,
+                       args->on_worker, aggregates, a);
+
   darray_trace_diff_entry_t entries = {};
-  trace_diff_compute(td_baseline, td_target, group_by, sort_by, &entries, a);
+  trace_diff_compute_from_aggregates(td_baseline, &aggregates[0], td_target,
+                                     &aggregates[1], sort_by, metric, &entries,
+                                     a);
+  darray_deinit(&aggregates[0], a);
+  darray_deinit(&aggregates[1], a);
 
-  cli_table_t table = {};
-  cli_table_init(&table);
+  cli_output_begin_table(o, SV("diff"));
 
   bool by_cat = string_view_eq(group_by, SV("category"));
-  cli_table_add_column(&table, by_cat ? SV("Event Category") : SV("Event Name"), CLI_ALIGN_LEFT, 30, true);
-  cli_table_add_column(&table, SV("Baseline Dur (s)"), CLI_ALIGN_RIGHT, 16, true);
-  cli_table_add_column(&table, SV("Target Dur (s)"), CLI_ALIGN_RIGHT, 14, true);
-  cli_table_add_column(&table, SV("Delta Dur (s)"), CLI_ALIGN_RIGHT, 14, true);
-  cli_table_add_column(&table, SV("Delta Count"), CLI_ALIGN_RIGHT, 11, true);
+  bool self = metric == TRACE_AGGREGATE_METRIC_SELF;
+  cli_output_add_column(o, by_cat ? SV("category") : SV("name"), by_cat ? SV("Event Category") : SV("Event Name"), CLI_ALIGN_LEFT, 30, true);
+  if (self) {
+    cli_output_add_column(o, SV("baseline_self_s"), SV("Baseline Self (s)"), CLI_ALIGN_RIGHT, 17, true);
+    cli_output_add_column(o, SV("target_self_s"), SV("Target Self (s)"), CLI_ALIGN_RIGHT, 15, true);
+    cli_output_add_column(o, SV("delta_self_s"), SV("Delta Self (s)"), CLI_ALIGN_RIGHT, 14, true);
+  } else {
+    cli_output_add_column(o, SV("baseline_duration_s"), SV("Baseline Dur (s)"), CLI_ALIGN_RIGHT, 16, true);
+    cli_output_add_column(o, SV("target_duration_s"), SV("Target Dur (s)"), CLI_ALIGN_RIGHT, 14, true);
+    cli_output_add_column(o, SV("delta_duration_s"), SV("Delta Dur (s)"), CLI_ALIGN_RIGHT, 14, true);
+  }
+  cli_output_add_column(o, SV("delta_count"), SV("Delta Count"), CLI_ALIGN_RIGHT, 11, true);
+  cli_output_set_show_sign(o, 3);
+  cli_output_set_show_sign(o, 4);
 
   trace_diff_entry_t* entries_ptr = entries.ptr;
   for (size_t i = 0; i < entries.len; i++) {
@@ -538,24 +1007,143 @@ static int handle_diff(const trace_data_t* td_baseline, const trace_data_t* td_t
     double target_dur_s = e->target_duration / 1000000.0;
     double delta_dur_s = e->delta_duration / 1000000.0;
 
-    cli_table_add_row(&table);
-    cli_table_set_cell(&table, 0, key_name);
-    cli_table_set_cell_fmt(&table, 1, "%.2f", base_dur_s);
-    cli_table_set_cell_fmt(&table, 2, "%.2f", target_dur_s);
-    cli_table_set_cell_fmt(&table, 3, "%+.2f", delta_dur_s);
-    cli_table_set_cell_fmt(&table, 4, "%+ld", (long)e->delta_count);
+    cli_output_add_row(o);
+    cli_output_set_string(o, 0, key_name);
+    cli_output_set_double(o, 1, base_dur_s, 2);
+    cli_output_set_double(o, 2, target_dur_s, 2);
+    cli_output_set_double(o, 3, delta_dur_s, 2);
+    cli_output_set_int(o, 4, e->delta_count);
   }
 
-  cli_table_print(&table);
-  cli_table_deinit(&table);
+  cli_output_end_table(o);
 
   darray_deinit(&entries, a);
   return 0;
 }
 
+// Builds the call tree of one range of a trace's tracks on the task queue.
+typedef struct cli_call_tree_part {
+  const trace_data_t* td;
+  const darray_track_t* tracks;
+  cli_track_range_t range;
+  const trace_call_tree_filter_t* filter;
+  trace_call_tree_t tree;
+  allocator_t* allocator;
+} cli_call_tree_part_t;
+
+typedef darray_t(cli_call_tree_part_t) cli_call_tree_parts_t;
+
+static void cli_call_tree_part_run(void* user_data) {
+  cli_call_tree_part_t* part = (cli_call_tree_part_t*)user_data;
+  trace_call_tree_add_tracks(&part->tree, part->td, part->tracks,
+                             part->range.begin, part->range.end, part->filter,
+                             part->allocator);
+}
+
+static void cli_call_tree_part_task(task_context_t* ctx) {
+  cli_call_tree_part_run(ctx->user_data);
+}
+
+// Handles the 'flamegraph' subcommand.
+static int handle_flamegraph(const trace_data_t* td,
+                             const darray_track_t* tracks,
+                             const cli_args_t* args, allocator_t* a,
+                             cli_output_t* o, FILE* err) {
+  trace_call_tree_filter_t filter = trace_call_tree_filter_all();
+  if (args->has_t_start) {
+    filter.start_ts = args->t_start;
+  }
+  if (args->has_t_end) {
+    filter.end_ts = args->t_end;
+  }
+  if (args->root_filter) {
+    filter.root_ref =
+        trace_data_lookup_string(td, string_view_from_cstr(args->root_filter));
+    if (filter.root_ref == 0) {
+      fprintf(err, "Error: No events named '%s'.\n", args->root_filter);
+      return 1;
+    }
+  }
+
+  cli_track_ranges_t ranges = {};
+  cli_split_tracks(tracks, args->on_worker ? 1 : CLI_MAX_TRACK_RANGES, &ranges,
+                   a);
+  cli_call_tree_parts_t parts = {};
+  for (size_t i = 0; i < ranges.len; i++) {
+    cli_call_tree_part_t part = {
+        .td = td,
+        .tracks = tracks,
+        .range = ranges.ptr[i],
+        .filter = &filter,
+        .allocator = a,
+    };
+    trace_call_tree_init(&part.tree, a);
+    darray_push(&parts, part, a);
+  }
+  darray_deinit(&ranges, a);
+
+  cli_run_parts(cli_call_tree_part_run, cli_call_tree_part_task, parts.ptr,
+                sizeof(cli_call_tree_part_t), parts.len, args->on_worker, a);
+
+  trace_call_tree_t tree;
+  trace_call_tree_init(&tree, a);
+  for (size_t i = 0; i < parts.len; i++) {
+    trace_call_tree_merge(&tree, &parts.ptr[i].tree, a);
+    trace_call_tree_deinit(&parts.ptr[i].tree, a);
+  }
+  darray_deinit(&parts, a);
+
+  darray_uint32_t order = {};
+  trace_call_tree_preorder(&tree, &order, a);
+  const trace_call_tree_node_t* nodes = tree.nodes.ptr;
+  string_t stack = {};
+
+  if (cli_output_is_table(o)) {
+    // Folded stacks: one "a;b;c <self us>" line per frame path with self
+    // time, as read by flamegraph.pl and speedscope.
+    for (size_t i = 1; i < order.len; i++) {
+      const trace_call_tree_node_t* n = &nodes[order.ptr[i]];
+      int64_t self_us = (int64_t)(n->self_duration + 0.5);
+      if (self_us > 0) {
+        string_reset(&stack);
+        trace_call_tree_append_stack(&tree, td, order.ptr[i], &stack, a);
+        fprintf(o->out, "%s %lld\n", string_get_cstr(&stack),
+                (long long)self_us);
+      }
+    }
+  } else {
+    cli_output_begin_table(o, SV("flamegraph"));
+    cli_output_add_column(o, SV("stack"), SV("Stack"), CLI_ALIGN_LEFT, 40, true);
+    cli_output_add_column(o, SV("name"), SV("Name"), CLI_ALIGN_LEFT, 30, true);
+    cli_output_add_column(o, SV("depth"), SV("Depth"), CLI_ALIGN_RIGHT, 5, true);
+    cli_output_add_column(o, SV("count"), SV("Count"), CLI_ALIGN_RIGHT, 11, true);
+    cli_output_add_column(o, SV("total_us"), SV("Total (us)"), CLI_ALIGN_RIGHT, 12, true);
+    cli_output_add_column(o, SV("self_us"), SV("Self (us)"), CLI_ALIGN_RIGHT, 12, true);
+    for (size_t i = 1; i < order.len; i++) {
+      const trace_call_tree_node_t* n = &nodes[order.ptr[i]];
+      double self_duration = n->self_duration > 0.0 ? n->self_duration : 0.0;
+      string_reset(&stack);
+      trace_call_tree_append_stack(&tree, td, order.ptr[i], &stack, a);
+      cli_output_add_row(o);
+      cli_output_set_string(o, 0, string_get_view(&stack));
+      cli_output_set_string(o, 1, trace_data_get_string(td, n->name_ref));
+      cli_output_set_int(o, 2, (int64_t)n->depth);
+      cli_output_set_int(o, 3, (int64_t)n->count);
+      cli_output_set_int(o, 4, (int64_t)(n->total_duration + 0.5));
+      cli_output_set_int(o, 5, (int64_t)(self_duration + 0.5));
+    }
+    cli_output_end_table(o);
+  }
+
+  string_free(stack, a);
+  darray_deinit(&order, a);
+  trace_call_tree_deinit(&tree, a);
+  return 0;
+}
+
 // Handles the 'histogram' subcommand.
 static int handle_histogram(const trace_data_t* td, const darray_track_t* tracks,
-                            const cli_args_t* args, allocator_t* a) {
+                            const cli_args_t* args, allocator_t* a, cli_output_t* o) {
   // Gather all event indices matching the filters
   darray_int64_t selected_indices = {};
   const trace_event_persisted_t* events = td->events.ptr;
@@ -618,7 +1206,7 @@ static int handle_histogram(const trace_data_t* td, const darray_track_t* tracks
 
   // Compute histogram
   trace_histogram_t h = {};
-  trace_histogram_compute(&selected_indices, td, &h);
+  trace_histogram_compute(&selected_indices, td, &h, a);
 
   // Print summary
   const char* scale_str = "linear";
@@ -630,7 +1218,10 @@ static int handle_histogram(const trace_data_t* td, const darray_track_t* tracks
       scale_str = "logarithmic";
     }
   }
-  printf("Scale: %s, Total Events: %zu\n\n", scale_str, selected_indices.len);
+  if (cli_output_is_table(o)) {
+    fprintf(o->out, "Scale: %s, Total Events: %zu\n\n", scale_str,
+            selected_indices.len);
+  }
 
   // Calculate bucket_width for formatting
   int bucket_width = 1;
@@ -640,13 +1231,15 @@ static int handle_histogram(const trace_data_t* td, const darray_track_t* tracks
     temp_buckets /= 10;
   }
 
-  cli_table_t table = {};
-  cli_table_init(&table);
-
-  cli_table_add_column(&table, SV("Bucket"), CLI_ALIGN_LEFT, 0, true);
-  cli_table_add_column(&table, SV("Range (us)"), CLI_ALIGN_LEFT, 0, true);
-  cli_table_add_column(&table, SV("Count"), CLI_ALIGN_RIGHT, 0, true);
-  cli_table_add_column(&table, SV("Distribution"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_begin_table(o, SV("histogram"));
+  cli_output_add_column(o, SV(""), SV("Bucket"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("bucket"), SV(""), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV(""), SV("Range (us)"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("min_us"), SV(""), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("max_us"), SV(""), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("count"), SV("Count"), CLI_ALIGN_RIGHT, 0, true);
+  cli_output_add_column(o, SV(""), SV("Distribution"), CLI_ALIGN_LEFT, 0, true);
+  cli_output_add_column(o, SV("pct"), SV(""), CLI_ALIGN_LEFT, 0, true);
 
   for (int i = 0; i < h.num_buckets; i++) {
     const trace_histogram_bucket_t* b = &h.buckets[i];
@@ -660,26 +1253,35 @@ static int handle_histogram(const trace_data_t* td, const darray_track_t* tracks
     if (active_chars < 0) active_chars = 0;
     if (active_chars > 20) active_chars = 20;
 
-    cli_table_add_row(&table);
-    cli_table_set_cell_fmt(&table, 0, "[%0*d]", bucket_width, i);
-    cli_table_set_cell_fmt(&table, 1, "%ld - %ld", (long)b->min_dur, (long)b->max_dur);
-    cli_table_set_cell_fmt(&table, 2, "%u", b->count);
-
-    string_t bar = {};
-    string_append(&bar, SV("["), a);
-    for (int j = 0; j < active_chars; j++) {
-      string_append(&bar, SV("█"), a);
+    cli_output_add_row(o);
+    if (cli_output_is_table(o)) {
+      cli_output_set_fmt(o, 0, "[%0*d]", bucket_width, i);
     }
-    for (int j = active_chars; j < 20; j++) {
-      string_append(&bar, SV("░"), a);
+    cli_output_set_int(o, 1, i);
+    if (cli_output_is_table(o)) {
+      cli_output_set_fmt(o, 2, "%ld - %ld", (long)b->min_dur, (long)b->max_dur);
     }
-    string_printf(&bar, a, "] %3.0f%%", pct);
-    cli_table_set_cell(&table, 3, string_get_view(&bar));
-    string_free(bar, a);
+    cli_output_set_int(o, 3, b->min_dur);
+    cli_output_set_int(o, 4, b->max_dur);
+    cli_output_set_int(o, 5, b->count);
+
+    if (cli_output_is_table(o)) {
+      string_t bar = {};
+      string_append(&bar, SV("["), a);
+      for (int j = 0; j < active_chars; j++) {
+        string_append(&bar, SV("█"), a);
+      }
+      for (int j = active_chars; j < 20; j++) {
+        string_append(&bar, SV("░"), a);
+      }
+      string_printf(&bar, a, "] %3.0f%%", pct);
+      cli_output_set_string(o, 6, string_get_view(&bar));
+      string_free(bar, a);
+    }
+    cli_output_set_double(o, 7, pct, 0);
   }
 
-  cli_table_print(&table);
-  cli_table_deinit(&table);
+  cli_output_end_table(o);
 
   darray_deinit(&selected_indices, a);
   return 0;
@@ -687,16 +1289,17 @@ static int handle_histogram(const trace_data_t* td, const darray_track_t* tracks
 
 // Handles the 'inspect' subcommand.
 static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
-                          const cli_args_t* args, allocator_t* a) {
+                          const cli_args_t* args, allocator_t* a,
+                          cli_output_t* o, FILE* err) {
   (void)a;
   if (!args->track_filter) {
-    fprintf(stderr,
+    fprintf(err,
             "Error: Missing required option '--track <name>' for inspect "
             "subcommand.\n");
     return 1;
   }
   if (!args->has_t_start) {
-    fprintf(stderr,
+    fprintf(err,
             "Error: Missing required option '--ts <ts_us>' for inspect "
             "subcommand.\n");
     return 1;
@@ -719,7 +1322,7 @@ static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
   }
 
   if (!target_track) {
-    fprintf(stderr, "Error: Track '%s' not found.\n", args->track_filter);
+    fprintf(err, "Error: Track '%s' not found.\n", args->track_filter);
     return 1;
   }
 
@@ -730,8 +1333,9 @@ static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
   size_t start_k = trace_data_events_lower_bound(
       event_indices, target_track->event_indices.len, events, target_ts);
 
-  // Inspect all events starting at target_ts
-  bool first_event = true;
+  // Inspect all events starting at target_ts. Machine formats tag every row
+  // with the ordinal of its event.
+  int64_t event_ordinal = 0;
   for (size_t k = start_k; k < target_track->event_indices.len; k++) {
     size_t event_idx = event_indices[k];
     const trace_event_persisted_t* e = &events[event_idx];
@@ -739,44 +1343,50 @@ static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
       break;  // Since events are sorted by ts, we stop as soon as ts differs
     }
 
-    if (!first_event) {
-      printf("\n---\n\n");
+    if (event_ordinal > 0 && cli_output_is_table(o)) {
+      fprintf(o->out, "\n---\n\n");
     }
-    first_event = false;
-
-    cli_table_t details_table = {};
-    cli_table_init(&details_table);
 
-    cli_table_add_column(&details_table, SV("Property"), CLI_ALIGN_LEFT, 20, true);
-    cli_table_add_column(&details_table, SV("Value"), CLI_ALIGN_LEFT, 30, true);
-
-    cli_table_add_row(&details_table);
-    cli_table_set_cell(&details_table, 0, SV("Name"));
-    cli_table_set_cell(&details_table, 1, trace_data_get_string(td, e->name_ref));
-
-    cli_table_add_row(&details_table);
-    cli_table_set_cell(&details_table, 0, SV("Track"));
-    cli_table_set_cell(&details_table, 1, target_track_name);
-
-    cli_table_add_row(&details_table);
-    cli_table_set_cell(&details_table, 0, SV("Timestamp (us)"));
-    cli_table_set_cell_fmt(&details_table, 1, "%ld", (long)e->ts);
-
-    cli_table_add_row(&details_table);
-    cli_table_set_cell(&details_table, 0, SV("Duration (us)"));
-    cli_table_set_cell_fmt(&details_table, 1, "%ld", (long)e->dur);
+    cli_output_begin_table(o, SV("details"));
+    cli_output_add_column(o, SV("event"), SV(""), CLI_ALIGN_LEFT, 0, true);
+    cli_output_add_column(o, SV("property"), SV("Property"), CLI_ALIGN_LEFT,
+                          20, true);
+    cli_output_add_column(o, SV("value"), SV("Value"), CLI_ALIGN_LEFT, 30,
+                          true);
+
+    cli_output_add_row(o);
+    cli_output_set_int(o, 0, event_ordinal);
+    cli_output_set_string(o, 1, SV("Name"));
+    cli_output_set_string(o, 2, trace_data_get_string(td, e->name_ref));
+
+    cli_output_add_row(o);
+    cli_output_set_int(o, 0, event_ordinal);
+    cli_output_set_string(o, 1, SV("Track"));
+    cli_output_set_string(o, 2, target_track_name);
+
+    cli_output_add_row(o);
+    cli_output_set_int(o, 0, event_ordinal);
+    cli_output_set_string(o, 1, SV("Timestamp (us)"));
+    cli_output_set_int(o, 2, e->ts);
+
+    cli_output_add_row(o);
+    cli_output_set_int(o, 0, event_ordinal);
+    cli_output_set_string(o, 1, SV("Duration (us)"));
+    cli_output_set_int(o, 2, e->dur);
 
     if (target_track->type == TRACK_TYPE_THREAD) {
       const int64_t* self_durs = target_track->self_durs.ptr;
       const uint32_t* depths = target_track->depths.ptr;
 
-      cli_table_add_row(&details_table);
-      cli_table_set_cell(&details_table, 0, SV("Self Time (us)"));
-      cli_table_set_cell_fmt(&details_table, 1, "%ld", (long)self_durs[k]);
+      cli_output_add_row(o);
+      cli_output_set_int(o, 0, event_ordinal);
+      cli_output_set_string(o, 1, SV("Self Time (us)"));
+      cli_output_set_int(o, 2, self_durs[k]);
 
-      cli_table_add_row(&details_table);
-      cli_table_set_cell(&details_table, 0, SV("Depth"));
-      cli_table_set_cell_fmt(&details_table, 1, "%d", depths[k]);
+      cli_output_add_row(o);
+      cli_output_set_int(o, 0, event_ordinal);
+      cli_output_set_string(o, 1, SV("Depth"));
+      cli_output_set_int(o, 2, depths[k]);
 
       uint32_t depth_target = depths[k];
 
@@ -791,13 +1401,15 @@ static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
 
       if (parent_event) {
         string_view_t parent_name = trace_data_get_string(td, parent_event->name_ref);
-        cli_table_add_row(&details_table);
-        cli_table_set_cell(&details_table, 0, SV("Parent Name"));
-        cli_table_set_cell(&details_table, 1, parent_name);
-
-        cli_table_add_row(&details_table);
-        cli_table_set_cell(&details_table, 0, SV("Parent TS (us)"));
-        cli_table_set_cell_fmt(&details_table, 1, "%ld", (long)parent_event->ts);
+        cli_output_add_row(o);
+        cli_output_set_int(o, 0, event_ordinal);
+        cli_output_set_string(o, 1, SV("Parent Name"));
+        cli_output_set_string(o, 2, parent_name);
+
+        cli_output_add_row(o);
+        cli_output_set_int(o, 0, event_ordinal);
+        cli_output_set_string(o, 1, SV("Parent TS (us)"));
+        cli_output_set_int(o, 2, parent_event->ts);
       }
     }
 
@@ -809,21 +1421,21 @@ static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
         const trace_arg_persisted_t* arg = &args_ptr[a_idx];
         string_view_t key = trace_data_get_string(td, arg->key_ref);
         
-        cli_table_add_row(&details_table);
+        cli_output_add_row(o);
+        cli_output_set_int(o, 0, event_ordinal);
         // Prefix argument keys to distinguish them
-        cli_table_set_cell_fmt(&details_table, 0, "Arg: %.*s", (int)key.len, key.ptr);
+        cli_output_set_fmt(o, 1, "Arg: %.*s", (int)key.len, key.ptr);
         
         if (arg->val_ref != 0) {
           string_view_t val = trace_data_get_string(td, arg->val_ref);
-          cli_table_set_cell(&details_table, 1, val);
+          cli_output_set_string(o, 2, val);
         } else {
-          cli_table_set_cell_fmt(&details_table, 1, "%f", arg->val_double);
+          cli_output_set_double(o, 2, arg->val_double, 6);
         }
       }
     }
 
-    cli_table_print(&details_table);
-    cli_table_deinit(&details_table);
+    cli_output_end_table(o);
 
     // 2. Find and print Children
     if (target_track->type == TRACK_TYPE_THREAD) {
@@ -843,13 +1455,17 @@ static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
       }
 
       if (child_count > 0) {
-        printf("\nChildren:\n");
-        cli_table_t children_table = {};
-        cli_table_init(&children_table);
-
-        cli_table_add_column(&children_table, SV("Child Name"), CLI_ALIGN_LEFT, 20, true);
-        cli_table_add_column(&children_table, SV("Timestamp (us)"), CLI_ALIGN_RIGHT, 15, true);
-        cli_table_add_column(&children_table, SV("Duration (us)"), CLI_ALIGN_RIGHT, 15, true);
+        if (cli_output_is_table(o)) {
+          fprintf(o->out, "\nChildren:\n");
+        }
+        cli_output_begin_table(o, SV("children"));
+        cli_output_add_column(o, SV("event"), SV(""), CLI_ALIGN_LEFT, 0, true);
+        cli_output_add_column(o, SV("name"), SV("Child Name"), CLI_ALIGN_LEFT,
+                              20, true);
+        cli_output_add_column(o, SV("ts_us"), SV("Timestamp (us)"),
+                              CLI_ALIGN_RIGHT, 15, true);
+        cli_output_add_column(o, SV("dur_us"), SV("Duration (us)"),
+                              CLI_ALIGN_RIGHT, 15, true);
 
         for (size_t next = k + 1; next < target_track->event_indices.len; next++) {
           uint32_t next_depth = depths[next];
@@ -860,40 +1476,27 @@ static int handle_inspect(const trace_data_t* td, const darray_track_t* tracks,
             const trace_event_persisted_t* child_event = &events[event_indices[next]];
             string_view_t child_name = trace_data_get_string(td, child_event->name_ref);
 
-            cli_table_add_row(&children_table);
-            cli_table_set_cell(&children_table, 0, child_name);
-            cli_table_set_cell_fmt(&children_table, 1, "%ld", (long)child_event->ts);
-            cli_table_set_cell_fmt(&children_table, 2, "%ld", (long)child_event->dur);
+            cli_output_add_row(o);
+            cli_output_set_int(o, 0, event_ordinal);
+            cli_output_set_string(o, 1, child_name);
+            cli_output_set_int(o, 2, child_event->ts);
+            cli_output_set_int(o, 3, child_event->dur);
           }
         }
 
-        cli_table_print(&children_table);
-        cli_table_deinit(&children_table);
+        cli_output_end_table(o);
       }
     }
+    event_ordinal++;
   }
 
   return 0;
 }
 
-typedef struct {
-  size_t event_idx;
-  const track_t* track;
-  int depth;
-  int64_t ts;
-} query_match_t;
-
-static int compare_query_matches(const void* a_ptr, const void* b_ptr) {
-  const query_match_t* am = (const query_match_t*)a_ptr;
-  const query_match_t* bm = (const query_match_t*)b_ptr;
-  if (am->ts < bm->ts) return -1;
-  if (am->ts > bm->ts) return 1;
-  return 0;
-}
-
 // Handles the 'query' subcommand.
 static int handle_query(const trace_data_t* td, const darray_track_t* tracks,
-                        const cli_args_t* args, allocator_t* a) {
+                        const cli_args_t* args, allocator_t* a, cli_output_t* o,
+                        FILE* err) {
   track_t* tracks_data = tracks->ptr;
 
   // Find the target track if filtering by track
@@ -909,182 +1512,1746 @@ static int handle_query(const trace_data_t* td, const darray_track_t* tracks,
       }
     }
     if (!track_filter) {
-      fprintf(stderr, "Error: Track '%s' not found.\n", args->track_filter);
+      fprintf(err, "Error: Track '%s' not found.\n", args->track_filter);
       return 1;
     }
   }
 
-  // Collect matches
-  darray_t(query_match_t) matches = {};
+  trace_query_params_t params = {
+      .track = track_filter,
+      .match = args->match_filter,
+      .t_start = args->t_start,
+      .t_end = args->t_end,
+      .has_t_start = args->has_t_start,
+      .has_t_end = args->has_t_end,
+      .max_depth = args->max_depth,
+      .has_max_depth = args->has_max_depth,
+      .limit = args->has_limit ? (size_t)args->limit : SIZE_MAX,
+  };
+  darray_trace_query_match_t matches = {};
+  trace_query_compute(td, tracks, &params, &matches, a);
+
+  cli_output_begin_table(o, SV("events"));
+  cli_output_add_column(o, SV("name"), SV("Event Name"), CLI_ALIGN_LEFT, 30, true);
+  cli_output_add_column(o, SV("track"), SV("Track"), CLI_ALIGN_LEFT, 20, true);
+  cli_output_add_column(o, SV("ts_us"), SV("Start Time (us)"), CLI_ALIGN_RIGHT, 17, true);
+  cli_output_add_column(o, SV("dur_us"), SV("Duration (us)"), CLI_ALIGN_RIGHT, 15, true);
+  cli_output_add_column(o, SV("depth"), SV("Depth"), CLI_ALIGN_RIGHT, 5, true);
 
   const trace_event_persisted_t* events = td->events.ptr;
+  for (size_t i = 0; i < matches.len; i++) {
+    const trace_query_match_t* m = &matches.ptr[i];
+    const trace_event_persisted_t* e = &events[m->event_idx];
 
-  // Loop over tracks (either the filtered one, or all of them)
-  size_t start_track = 0;
-  size_t end_track = tracks->len;
-  if (track_filter) {
-    for (size_t i = 0; i < tracks->len; i++) {
-      if (&tracks_data[i] == track_filter) {
-        start_track = i;
-        end_track = i + 1;
-        break;
-      }
-    }
+    cli_output_add_row(o);
+    cli_output_set_string(o, 0, trace_data_get_string(td, e->name_ref));
+    cli_output_set_string(o, 1, trace_data_get_string(td, m->track->name_ref));
+    cli_output_set_int(o, 2, e->ts);
+    cli_output_set_int(o, 3, e->dur);
+    cli_output_set_int(o, 4, m->depth);
   }
 
-  for (size_t t_idx = start_track; t_idx < end_track; t_idx++) {
-    const track_t* t = &tracks_data[t_idx];
-    const size_t* event_indices = t->event_indices.ptr;
-    const uint32_t* depths = t->depths.ptr;
+  cli_output_end_table(o);
 
-    for (size_t k = 0; k < t->event_indices.len; k++) {
-      size_t event_idx = event_indices[k];
-      const trace_event_persisted_t* e = &events[event_idx];
+  darray_deinit(&matches, a);
 
-      // 1. Time-window check: overlap with [t_start, t_end]
-      // e->ts <= t_end && e->ts + e->dur >= t_start
-      if (args->has_t_start && (e->ts + e->dur < args->t_start)) {
-        continue;
-      }
-      if (args->has_t_end && (e->ts > args->t_end)) {
-        continue;
-      }
+  return 0;
+}
 
-      // 2. Substring match check
-      if (args->match_filter) {
-        string_view_t name = trace_data_get_string(td, e->name_ref);
-        string_view_t cat = trace_data_get_string(td, e->cat_ref);
-        bool match =
-            trace_viewer_str_contains_case_insensitive(
-                name, args->match_filter, strlen(args->match_filter)) ||
-            trace_viewer_str_contains_case_insensitive(
-                cat, args->match_filter, strlen(args->match_filter));
-        if (!match) continue;
-      }
+// Wall-clock time and allocator activity of one sequential stage (--profile).
+typedef struct cli_profile_stage {
+  double start_ms;
+  size_t start_alloc_count;
+  double duration_ms;
+  size_t alloc_count;
+  size_t peak_bytes;
+  size_t live_bytes;
+} cli_profile_stage_t;
+
+static void cli_profile_stage_begin(cli_profile_stage_t* stage,
+                                    counting_allocator_t* ca) {
+  counting_allocator_reset_peak(ca);
+  stage->start_alloc_count = counting_allocator_get_alloc_count(ca);
+  stage->start_ms = platform_get_now();
+}
 
-      // 3. Max depth check
-      if (args->has_max_depth) {
-        int depth = (t->type == TRACK_TYPE_THREAD) ? (int)depths[k] : 0;
-        if (depth > args->max_depth) {
-          continue;
-        }
-      }
+static void cli_profile_stage_end(cli_profile_stage_t* stage,
+                                  counting_allocator_t* ca) {
+  stage->duration_ms = platform_get_now() - stage->start_ms;
+  stage->alloc_count =
+      counting_allocator_get_alloc_count(ca) - stage->start_alloc_count;
+  stage->peak_bytes = counting_allocator_get_peak_bytes(ca);
+  stage->live_bytes = counting_allocator_get_allocated_bytes(ca);
+}
 
-      // We have a match!
-      query_match_t m_val = {
-          .event_idx = event_idx,
-          .track = t,
-          .depth = (t->type == TRACK_TYPE_THREAD) ? (int)depths[k] : 0,
-          .ts = e->ts,
-      };
-      darray_push(&matches, m_val, a);
-    }
-  }
+static void add_profile_stage_row(cli_table_t* table, string_view_t phase,
+                                  const cli_profile_stage_t* stage) {
+  cli_table_add_row(table);
+  cli_table_set_cell(table, 0, phase);
+  cli_table_set_cell(table, 1, SV("main"));
+  cli_table_set_cell_fmt(table, 2, "%.3f", stage->duration_ms);
+  cli_table_set_cell_fmt(table, 3, "%zu", stage->alloc_count);
+  cli_table_set_cell_fmt(table, 4, "%.2f",
+                         (double)stage->peak_bytes / (1024.0 * 1024.0));
+  cli_table_set_cell_fmt(table, 5, "%.2f",
+                         (double)stage->live_bytes / (1024.0 * 1024.0));
+}
 
-  // Sort matches chronologically
-  if (matches.len > 0) {
-    qsort(matches.ptr, matches.len, sizeof(query_match_t),
-          compare_query_matches);
-  }
+static void add_profile_phase_row(cli_table_t* table, string_view_t phase,
+                                  string_view_t thread, double duration_ms) {
+  cli_table_add_row(table);
+  cli_table_set_cell(table, 0, phase);
+  cli_table_set_cell(table, 1, thread);
+  cli_table_set_cell_fmt(table, 2, "%.3f", duration_ms);
+  cli_table_set_cell(table, 3, SV("-"));
+  cli_table_set_cell(table, 4, SV("-"));
+  cli_table_set_cell(table, 5, SV("-"));
+}
 
+// Prints the --profile table. Reader and worker phases of the load overlap in
+// wall-clock time, so they need not add up to the load stage.
+static void print_profile(const trace_load_profile_t* load,
+                          const cli_profile_stage_t* load_stage,
+                          const cli_profile_stage_t* command_stage) {
   cli_table_t table = {};
   cli_table_init(&table);
 
-  cli_table_add_column(&table, SV("Event Name"), CLI_ALIGN_LEFT, 30, true);
-  cli_table_add_column(&table, SV("Track"), CLI_ALIGN_LEFT, 20, true);
-  cli_table_add_column(&table, SV("Start Time (us)"), CLI_ALIGN_RIGHT, 17, true);
-  cli_table_add_column(&table, SV("Duration (us)"), CLI_ALIGN_RIGHT, 15, true);
-  cli_table_add_column(&table, SV("Depth"), CLI_ALIGN_RIGHT, 5, true);
-
-  size_t limit = args->has_limit ? (size_t)args->limit : matches.len;
-  size_t print_count = (matches.len < limit) ? matches.len : limit;
-
-  const query_match_t* matches_data = (const query_match_t*)matches.ptr;
-  for (size_t i = 0; i < print_count; i++) {
-    const query_match_t* m = &matches_data[i];
-    const trace_event_persisted_t* e = &events[m->event_idx];
-
-    cli_table_add_row(&table);
-    cli_table_set_cell(&table, 0, trace_data_get_string(td, e->name_ref));
-    cli_table_set_cell(&table, 1, trace_data_get_string(td, m->track->name_ref));
-    cli_table_set_cell_fmt(&table, 2, "%ld", (long)e->ts);
-    cli_table_set_cell_fmt(&table, 3, "%ld", (long)e->dur);
-    cli_table_set_cell_fmt(&table, 4, "%d", m->depth);
-  }
-
+  cli_table_add_column(&table, SV("Phase"), CLI_ALIGN_LEFT, 20, true);
+  cli_table_add_column(&table, SV("Thread"), CLI_ALIGN_LEFT, 6, false);
+  cli_table_add_column(&table, SV("Time (ms)"), CLI_ALIGN_RIGHT, 10, false);
+  cli_table_add_column(&table, SV("Allocs"), CLI_ALIGN_RIGHT, 8, false);
+  cli_table_add_column(&table, SV("Peak (MB)"), CLI_ALIGN_RIGHT, 10, false);
+  cli_table_add_column(&table, SV("Live (MB)"), CLI_ALIGN_RIGHT, 10, false);
+
+  add_profile_stage_row(&table, SV("load"), load_stage);
+  add_profile_phase_row(&table, SV("  read"), SV("reader"), load->read_ms);
+  add_profile_phase_row(&table, SV("  inflate"), SV("reader"),
+                        load->inflate_ms);
+  add_profile_phase_row(&table, SV("  backpressure"), SV("reader"),
+                        load->backpressure_ms);
+  add_profile_phase_row(&table, SV("  parse"), SV("worker"), load->parse_ms);
+  add_profile_phase_row(&table, SV("  intern"), SV("worker"),
+                        load->intern_ms);
+  add_profile_phase_row(&table, SV("  b/e match"), SV("worker"),
+                        load->match_ms);
+  add_profile_phase_row(&table, SV("  discover"), SV("worker"),
+                        load->organize.discover_ms);
+  add_profile_phase_row(&table, SV("  starvation"), SV("worker"),
+                        load->starvation_ms);
+  add_profile_phase_row(&table, SV("  compact"), SV("worker"),
+                        load->compact_ms);
+  add_profile_phase_row(&table, SV("  organize"), SV("worker"),
+                        load->organize_ms);
+  add_profile_phase_row(&table, SV("    sort events"), SV("worker"),
+                        load->organize.sort_events_ms);
+  add_profile_phase_row(&table, SV("    per-track"), SV("worker"),
+                        load->organize.per_track_ms);
+  add_profile_phase_row(&table, SV("    sort"), SV("worker"),
+                        load->organize.sort_ms);
+  add_profile_stage_row(&table, SV("command"), command_stage);
+
+  printf("\n");
   cli_table_print(&table);
   cli_table_deinit(&table);
+}
 
-  darray_deinit(&matches, a);
-
-  return 0;
+// ─── Loaded Traces ───────────────────────────────────────────────────────────
+
+// A trace that has been loaded and organized into tracks. Subcommands only
+// read it, so one load can serve any number of them.
+typedef struct cli_trace {
+  trace_data_t* td;
+  darray_track_t tracks;
+  int64_t min_ts;
+  int64_t max_ts;
+} cli_trace_t;
+
+static bool cli_trace_load(cli_trace_t* t, const char* path, allocator_t* a,
+                           trace_load_profile_t* out_profile) {
+  *t = (cli_trace_t){};
+  t->td = trace_loader_load_file(path, a, nullptr, &t->tracks, &t->min_ts,
+                                 &t->max_ts, nullptr, nullptr, out_profile);
+  return t->td != nullptr;
 }
 
-// main entry point preferring success path under if.
-int main(int argc, char* argv[]) {
-  int exit_code = 0;
-  cli_args_t args = {};
+static void cli_trace_deinit(cli_trace_t* t, allocator_t* a) {
+  track_t* tracks = t->tracks.ptr;
+  for (size_t i = 0; i < t->tracks.len; i++) {
+    track_deinit(&tracks[i], a);
+  }
+  darray_deinit(&t->tracks, a);
+  trace_data_release(t->td, a);
+  *t = (cli_trace_t){};
+}
 
-  if (parse_arguments(argc, argv, &args)) {
-    allocator_t* a = c_allocator();
-    darray_track_t tracks = {};
-    int64_t min_ts = 0;
-    int64_t max_ts = 0;
-    trace_data_t* td =
-        trace_loader_load_file(args.trace_file, a, nullptr, &tracks, &min_ts,
-                               &max_ts, nullptr, nullptr);
-
-    if (td) {
-      string_view_t sub = string_view_from_cstr(args.subcommand);
-
-      if (string_view_eq(sub, SV("summary"))) {
-        exit_code =
-            handle_summary(td, &tracks, min_ts, max_ts, args.list_tracks, a);
-      } else if (string_view_eq(sub, SV("concurrency"))) {
-        exit_code = handle_concurrency(td, &tracks, min_ts, max_ts, &args, a);
-      } else if (string_view_eq(sub, SV("aggregate"))) {
-        exit_code = handle_aggregate(td, &args, a);
-      } else if (string_view_eq(sub, SV("diff"))) {
-        darray_track_t tracks_2 = {};
-        int64_t min_ts_2 = 0;
-        int64_t max_ts_2 = 0;
-        trace_data_t* td2 =
-            trace_loader_load_file(args.trace_file_2, a, nullptr, &tracks_2, &min_ts_2,
-                                   &max_ts_2, nullptr, nullptr);
-        if (td2) {
-          exit_code = handle_diff(td, td2, &args, a);
-          
-          // Clean up td2
-          track_t* tracks_data_2 = tracks_2.ptr;
-          for (size_t i = 0; i < tracks_2.len; i++) {
-            track_deinit(&tracks_data_2[i], a);
-          }
-          darray_deinit(&tracks_2, a);
-          trace_data_release(td2, a);
-        } else {
-          exit_code = 1;
-        }
-      } else if (string_view_eq(sub, SV("histogram"))) {
-        exit_code = handle_histogram(td, &tracks, &args, a);
-      } else if (string_view_eq(sub, SV("inspect"))) {
-        exit_code = handle_inspect(td, &tracks, &args, a);
-      } else if (string_view_eq(sub, SV("query"))) {
-        exit_code = handle_query(td, &tracks, &args, a);
-      } else {
-        fprintf(stderr, "Error: Subcommand '%s' is not yet implemented.\n",
-                args.subcommand);
-        exit_code = 1;
+// Memory per inflated input byte assumed for a load that has not run yet.
+// Loads of JSON traces peak at about 1x (250-300 MB traces) to 2.6x (20 MB
+// traces, where fixed-size buffers weigh more) their input.
+constexpr double CLI_TRACE_MEMORY_RATIO = 2.0;
+
+// Returns the size of the trace at `path` once inflated. For gzip input this
+// is the size recorded in the trailer, which wraps at 4 GiB; it is never
+// taken to be smaller than the file.
+static size_t cli_trace_input_size(const char* path) {
+  size_t size = 0;
+  struct stat st;
+  if (stat(path, &st) == 0) {
+    size = (size_t)st.st_size;
+  }
+  FILE* f = fopen(path, "rb");
+  if (f) {
+    uint8_t magic[2] = {};
+    uint8_t trailer[4] = {};
+    bool is_gzip = fread(magic, 1, 2, f) == 2 && magic[0] == 0x1f &&
+                   magic[1] == 0x8b;
+    if (is_gzip && fseek(f, -4, SEEK_END) == 0 &&
+        fread(trailer, 1, 4, f) == 4) {
+      size_t inflated = (size_t)trailer[0] | (size_t)trailer[1] << 8 |
+                        (size_t)trailer[2] << 16 | (size_t)trailer[3] << 24;
+      if (inflated > size) {
+        size = inflated;
       }
-
-      // Clean up pre-organized tracks
-      track_t* tracks_data = tracks.ptr;
-      for (size_t i = 0; i < tracks.len; i++) {
-        track_deinit(&tracks_data[i], a);
+    }
+    fclose(f);
+  }
+  return size;
+}
+
+// Returns the --memory-budget in bytes, or SIZE_MAX if there is none.
+static size_t cli_memory_budget(const cli_args_t* args) {
+  return args->has_memory_budget && args->memory_budget_mb > 0
+             ? (size_t)args->memory_budget_mb << 20
+             : SIZE_MAX;
+}
+
+// Loads `traces[i]` from `paths[i]` on one task queue driven from this thread,
+// so the reads and parses of all of them share the worker pool. The loads run
+// at once unless their estimated memory exceeds `budget`, in which case they
+// run one after another. `profile`, if not null, profiles the first load.
+// Returns true if every trace loaded.
+static bool cli_trace_load_all(cli_trace_t* traces, const char* const* paths,
+                               size_t count, size_t budget, allocator_t* a,
+                               trace_load_profile_t* profile) {
+  SELF_TRACE_BEGIN("cli_trace_load_all");
+  size_t estimated_bytes = 0;
+  for (size_t i = 0; i < count; i++) {
+    estimated_bytes +=
+        (size_t)((double)cli_trace_input_size(paths[i]) *
+                 CLI_TRACE_MEMORY_RATIO);
+  }
+  size_t jobs = estimated_bytes <= budget ? count : 1;
+  task_queue_t* queue = task_queue_create(jobs * TRACE_LOADER_QUEUE_SLOTS,
+                                          platform_submit_job, a);
+  darray_t(trace_loader_t*) loaders = {};
+  darray_resize(&loaders, count, a);
+
+  bool ok = true;
+  size_t next_load = 0;
+  size_t loading = 0;
+  size_t finished = 0;
+  while (finished < count) {
+    if (next_load < count && loading < jobs) {
+      cli_trace_t* t = &traces[next_load];
+      *t = (cli_trace_t){};
+      trace_loader_t* loader = trace_loader_create(
+          paths[next_load], queue, (task_stream_t)(next_load + 1), a);
+      if (loader) {
+        if (next_load == 0 && profile) {
+          trace_loader_set_profile(loader, profile);
+        }
+        trace_loader_pump(loader);
+        loading++;
+      } else {
+        ok = false;
+        finished++;
+      }
+      loaders.ptr[next_load] = loader;
+      next_load++;
+    } else {
+      task_completion_t cqe;
+      task_queue_wait_completion(queue, &cqe);
+      bool handled = false;
+      for (size_t i = 0; i < next_load && !handled; i++) {
+        trace_loader_t* loader = loaders.ptr[i];
+        if (loader && trace_loader_owns_completion(loader, &cqe)) {
+          trace_loader_handle_completion(loader, &cqe);
+          handled = true;
+        }
+      }
+      expect(handled);
+    }
+
+    for (size_t i = 0; i < next_load; i++) {
+      trace_loader_t* loader = loaders.ptr[i];
+      if (loader && trace_loader_is_done(loader)) {
+        cli_trace_t* t = &traces[i];
+        t->td = trace_loader_finish(loader, nullptr, &t->tracks, &t->min_ts,
+                                    &t->max_ts, nullptr, nullptr);
+        ok = ok && t->td != nullptr;
+        loaders.ptr[i] = nullptr;
+        loading--;
+        finished++;
+      }
+    }
+  }
+
+  darray_deinit(&loaders, a);
+  task_queue_destroy(queue);
+  SELF_TRACE_END();
+  return ok;
+}
+
+// Traces loaded on demand and kept by path, for commands that may refer to
+// the same trace many times.
+typedef struct cli_cached_trace {
+  char* path;
+  size_t path_size;
+  cli_trace_t trace;
+} cli_cached_trace_t;
+
+typedef struct cli_trace_cache {
+  // Entries are allocated one by one so they stay put while the array grows.
+  darray_t(cli_cached_trace_t*) traces;
+  allocator_t* allocator;
+} cli_trace_cache_t;
+
+// Returns the loaded trace for `path`, loading it first if needed. Returns
+// nullptr if the trace fails to load.
+static cli_trace_t* cli_trace_cache_get(cli_trace_cache_t* cache,
+                                        const char* path) {
+  allocator_t* a = cache->allocator;
+  cli_trace_t* result = nullptr;
+  for (size_t i = 0; result == nullptr && i < cache->traces.len; i++) {
+    if (strcmp(cache->traces.ptr[i]->path, path) == 0) {
+      result = &cache->traces.ptr[i]->trace;
+    }
+  }
+  if (result == nullptr) {
+    cli_cached_trace_t* entry = allocator_alloc_struct(a, cli_cached_trace_t);
+    if (cli_trace_load(&entry->trace, path, a, nullptr)) {
+      entry->path_size = strlen(path) + 1;
+      entry->path = allocator_alloc(a, entry->path_size);
+      memcpy(entry->path, path, entry->path_size);
+      darray_push(&cache->traces, entry, a);
+      result = &entry->trace;
+    } else {
+      allocator_free_struct(a, entry, cli_cached_trace_t);
+    }
+  }
+  return result;
+}
+
+static void cli_cached_trace_free(cli_trace_cache_t* cache,
+                                  cli_cached_trace_t* entry) {
+  allocator_t* a = cache->allocator;
+  cli_trace_deinit(&entry->trace, a);
+  allocator_free(a, entry->path, entry->path_size);
+  allocator_free_struct(a, entry, cli_cached_trace_t);
+}
+
+// Drops the trace loaded from `path`. Returns false if it was not loaded.
+static bool cli_trace_cache_unload(cli_trace_cache_t* cache,
+                                   const char* path) {
+  bool found = false;
+  for (size_t i = 0; !found && i < cache->traces.len; i++) {
+    if (strcmp(cache->traces.ptr[i]->path, path) == 0) {
+      cli_cached_trace_free(cache, cache->traces.ptr[i]);
+      memmove(&cache->traces.ptr[i], &cache->traces.ptr[i + 1],
+              (cache->traces.len - i - 1) * sizeof(cache->traces.ptr[0]));
+      cache->traces.len--;
+      found = true;
+    }
+  }
+  return found;
+}
+
+static void cli_trace_cache_deinit(cli_trace_cache_t* cache) {
+  for (size_t i = 0; i < cache->traces.len; i++) {
+    cli_cached_trace_free(cache, cache->traces.ptr[i]);
+  }
+  darray_deinit(&cache->traces, cache->allocator);
+}
+
+// Runs an analysis subcommand over loaded traces and writes its output to
+// `out` and its errors to `err`. `trace_2` is only read by diff; `memory` is
+// non-null when summary should print --memory.
+static int run_subcommand(const cli_args_t* args, const cli_trace_t* trace,
+                          const cli_trace_t* trace_2,
+                          tagged_allocator_t* memory, allocator_t* a,
+                          FILE* out, FILE* err) {
+  int exit_code = 0;
+  const trace_data_t* td = trace->td;
+  const darray_track_t* tracks = &trace->tracks;
+  string_view_t sub = string_view_from_cstr(args->subcommand);
+  cli_output_t o;
+  cli_output_init(&o, args->format, out, a);
+
+  if (string_view_eq(sub, SV("summary"))) {
+    exit_code = handle_summary(td, tracks, trace->min_ts, trace->max_ts,
+                               args->list_tracks, memory, &o);
+  } else if (string_view_eq(sub, SV("concurrency"))) {
+    exit_code = handle_concurrency(td, tracks, trace->min_ts, trace->max_ts,
+                                   args, a, &o);
+  } else if (string_view_eq(sub, SV("aggregate"))) {
+    exit_code = handle_aggregate(td, tracks, args, a, &o, err);
+  } else if (string_view_eq(sub, SV("diff"))) {
+    exit_code = handle_diff(td, tracks, trace_2->td, &trace_2->tracks, args, a,
+                            &o, err);
+  } else if (string_view_eq(sub, SV("flamegraph"))) {
+    exit_code = handle_flamegraph(td, tracks, args, a, &o, err);
+  } else if (string_view_eq(sub, SV("histogram"))) {
+    exit_code = handle_histogram(td, tracks, args, a, &o);
+  } else if (string_view_eq(sub, SV("inspect"))) {
+    exit_code = handle_inspect(td, tracks, args, a, &o, err);
+  } else if (string_view_eq(sub, SV("query"))) {
+    exit_code = handle_query(td, tracks, args, a, &o, err);
+  } else {
+    fprintf(err, "Error: Subcommand '%s' is not yet implemented.\n",
+            args->subcommand);
+    exit_code = 1;
+  }
+  cli_output_deinit(&o);
+  return exit_code;
+}
+
+// Rejects options of a batch or serve command that only main() acts on, so
+// they are not silently ignored.
+static bool cli_check_nested_args(const cli_args_t* args, FILE* err) {
+  bool ok = true;
+  if (args->memory) {
+    fprintf(err,
+            "Error: '--memory' is not supported inside batch or serve "
+            "commands\n");
+    ok = false;
+  }
+  return ok;
+}
+
+// ─── Serve ───────────────────────────────────────────────────────────────────
+//
+// `serve` keeps traces loaded between requests. Each request is one line of
+// JSON and gets one line of JSON back:
+//
+//   {"id": 1, "command": "query", "args": ["--match", "Frame"]}
+//   {"id":1,"ok":true,"exit_code":0,"elapsed_ms":0.4,"output":"...","error":""}
+//
+// "command" is any analysis subcommand, run with the same flags as on the
+// command line except --format: "result" is the subcommand's --format json
+// document, or null if it wrote none, and "error" holds its error messages.
+// "trace" (and "trace_2" for diff) select the traces; they default to the
+// trace given to serve. Traces are loaded on first use and stay loaded.
+//
+// Control commands: "load" and "unload" a "trace", "list" loaded traces, and
+// "shutdown" the server. "load" and "list" return a "traces" table.
+//
+// Each request writes its result and errors into memory streams of its own,
+// so nothing else the process prints (e.g. worker logs) reaches a response.
+// Requests are handled one at a time on the main thread. With --socket,
+// connections are too: a second client waits in the listen backlog until the
+// first one disconnects.
+
+// Most arguments accepted in one request.
+constexpr size_t CLI_SERVE_MAX_ARGS = 64;
+
+typedef struct cli_server {
+  cli_trace_cache_t cache;
+  bool shutdown;
+} cli_server_t;
+
+typedef struct cli_request {
+  // Echoed back verbatim; JSON_TOKEN_NULL when the request has no id.
+  json_token_t id;
+  const char* command;
+  const char* trace;
+  const char* trace_2;
+  const char* args[CLI_SERVE_MAX_ARGS];
+  size_t args_count;
+  // Backing store for the strings above, decoded and NUL-terminated.
+  darray_uint8_t strings;
+} cli_request_t;
+
+static int cli_hex_digit(char c) {
+  int result = -1;
+  if (c >= '0' && c <= '9') {
+    result = c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    result = c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    result = c - 'A' + 10;
+  }
+  return result;
+}
+
+// Appends the UTF-8 encoding of a \uXXXX escape. Surrogate pairs are not
+// combined; paths and arguments are not expected to need them.
+static void cli_push_utf8(darray_uint8_t* out, uint32_t cp) {
+  if (cp < 0x80) {
+    out->ptr[out->len++] = (uint8_t)cp;
+  } else if (cp < 0x800) {
+    out->ptr[out->len++] = (uint8_t)(0xC0 | (cp >> 6));
+    out->ptr[out->len++] = (uint8_t)(0x80 | (cp & 0x3F));
+  } else {
+    out->ptr[out->len++] = (uint8_t)(0xE0 | (cp >> 12));
+    out->ptr[out->len++] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+    out->ptr[out->len++] = (uint8_t)(0x80 | (cp & 0x3F));
+  }
+}
+
+// Decodes the body of a JSON string token into `out` and returns it as a C
+// string. `out` must have room for raw.len + 1 more bytes; decoding never
+// grows a string, so earlier results stay valid.
+static const char* cli_json_unescape(string_view_t raw, darray_uint8_t* out) {
+  const char* result = (const char*)out->ptr + out->len;
+  for (size_t i = 0; i < raw.len; i++) {
+    char c = raw.ptr[i];
+    if (c != '\\' || i + 1 >= raw.len) {
+      out->ptr[out->len++] = (uint8_t)c;
+      continue;
+    }
+    i++;
+    switch (raw.ptr[i]) {
+      case 'n': out->ptr[out->len++] = '\n'; break;
+      case 't': out->ptr[out->len++] = '\t'; break;
+      case 'r': out->ptr[out->len++] = '\r'; break;
+      case 'b': out->ptr[out->len++] = '\b'; break;
+      case 'f': out->ptr[out->len++] = '\f'; break;
+      case 'u': {
+        uint32_t cp = 0;
+        bool valid = i + 4 < raw.len;
+        for (size_t k = 1; valid && k <= 4; k++) {
+          int d = cli_hex_digit(raw.ptr[i + k]);
+          valid = d >= 0;
+          cp = (cp << 4) | (uint32_t)(valid ? d : 0);
+        }
+        if (valid) {
+          cli_push_utf8(out, cp);
+          i += 4;
+        } else {
+          out->ptr[out->len++] = 'u';
+        }
+        break;
+      }
+      default: out->ptr[out->len++] = (uint8_t)raw.ptr[i]; break;
+    }
+  }
+  out->ptr[out->len++] = 0;
+  return result;
+}
+
+// Skips the value that starts with `tok`, including nested containers.
+static bool cli_json_skip_value(json_reader_t* r, const json_token_t* tok) {
+  bool ok = tok->type != JSON_TOKEN_ERROR && tok->type != JSON_TOKEN_EOF;
+  int depth = 0;
+  if (tok->type == JSON_TOKEN_OBJECT_START ||
+      tok->type == JSON_TOKEN_ARRAY_START) {
+    depth = 1;
+  }
+  while (ok && depth > 0) {
+    json_token_t t;
+    json_reader_next(r, &t);
+    if (t.type == JSON_TOKEN_OBJECT_START || t.type == JSON_TOKEN_ARRAY_START) {
+      depth++;
+    } else if (t.type == JSON_TOKEN_OBJECT_END ||
+               t.type == JSON_TOKEN_ARRAY_END) {
+      depth--;
+    } else if (t.type == JSON_TOKEN_ERROR || t.type == JSON_TOKEN_EOF) {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static bool cli_request_parse_args(cli_request_t* req, json_reader_t* r,
+                                   FILE* err) {
+  bool ok = true;
+  bool done = false;
+  while (ok && !done) {
+    json_token_t tok;
+    json_reader_next(r, &tok);
+    if (tok.type == JSON_TOKEN_ARRAY_END) {
+      done = true;
+    } else if (tok.type == JSON_TOKEN_COMMA) {
+      // Separator
+    } else if (req->args_count >= CLI_SERVE_MAX_ARGS) {
+      fprintf(err, "Error: Too many arguments (at most %zu)\n",
+              (size_t)CLI_SERVE_MAX_ARGS);
+      ok = false;
+    } else if (tok.type == JSON_TOKEN_STRING ||
+               tok.type == JSON_TOKEN_NUMBER_I64 ||
+               tok.type == JSON_TOKEN_NUMBER_F64) {
+      // Numbers are passed through as written, e.g. ["--limit", 10].
+      req->args[req->args_count++] = cli_json_unescape(tok.val.str,
+                                                       &req->strings);
+    } else {
+      fprintf(err, "Error: \"args\" must be an array of strings\n");
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// Parses one request line, reporting problems to `err`. Strings in `req` point
+// into `req->strings`, except for `req->id`, which points into `line`.
+static bool cli_request_parse(cli_request_t* req, string_view_t line,
+                              allocator_t* a, FILE* err) {
+  json_reader_t r;
+  json_reader_init(&r, line.ptr, line.len);
+  req->id = (json_token_t){.type = JSON_TOKEN_NULL};
+  // Decoded strings are never longer than the line that holds them.
+  darray_reserve(&req->strings, line.len + 1, a);
+
+  json_token_t tok;
+  json_reader_next(&r, &tok);
+  bool ok = tok.type == JSON_TOKEN_OBJECT_START;
+  bool done = false;
+  while (ok && !done) {
+    json_reader_next(&r, &tok);
+    if (tok.type == JSON_TOKEN_OBJECT_END) {
+      done = true;
+    } else if (tok.type == JSON_TOKEN_COMMA) {
+      // Separator
+    } else if (tok.type == JSON_TOKEN_STRING) {
+      string_view_t key = tok.val.str;
+      json_token_t value;
+      json_reader_next(&r, &tok);
+      json_reader_next(&r, &value);
+      ok = tok.type == JSON_TOKEN_COLON;
+      if (!ok) {
+        // Malformed
+      } else if (string_view_eq(key, SV("id"))) {
+        req->id = value;
+        ok = value.type == JSON_TOKEN_STRING ||
+             value.type == JSON_TOKEN_NUMBER_I64 ||
+             value.type == JSON_TOKEN_NUMBER_F64 ||
+             value.type == JSON_TOKEN_NULL;
+      } else if (string_view_eq(key, SV("command")) ||
+                 string_view_eq(key, SV("trace")) ||
+                 string_view_eq(key, SV("trace_2"))) {
+        ok = value.type == JSON_TOKEN_STRING;
+        if (ok) {
+          const char* s = cli_json_unescape(value.val.str, &req->strings);
+          if (string_view_eq(key, SV("command"))) {
+            req->command = s;
+          } else if (string_view_eq(key, SV("trace"))) {
+            req->trace = s;
+          } else {
+            req->trace_2 = s;
+          }
+        }
+      } else if (string_view_eq(key, SV("args"))) {
+        ok = value.type == JSON_TOKEN_ARRAY_START &&
+             cli_request_parse_args(req, &r, err);
+      } else {
+        ok = cli_json_skip_value(&r, &value);
+      }
+    } else {
+      ok = false;
+    }
+  }
+
+  if (ok && req->command == nullptr) {
+    fprintf(err, "Error: Request has no \"command\"\n");
+    ok = false;
+  } else if (!ok) {
+    fprintf(err, "Error: Malformed request\n");
+  }
+  return ok;
+}
+
+// Starts the "traces" table returned by "load" and "list".
+static void cli_server_begin_traces(cli_output_t* o) {
+  cli_output_begin_table(o, SV("traces"));
+  cli_output_add_column(o, SV("trace"), SV("Trace"), CLI_ALIGN_LEFT, 20, true);
+  cli_output_add_column(o, SV("events"), SV("Events"), CLI_ALIGN_RIGHT, 10,
+                        false);
+  cli_output_add_column(o, SV("tracks"), SV("Tracks"), CLI_ALIGN_RIGHT, 8,
+                        false);
+}
+
+static void cli_server_add_trace(cli_output_t* o, const char* path,
+                                 const cli_trace_t* trace) {
+  cli_output_add_row(o);
+  cli_output_set_string(o, 0, string_view_from_cstr(path));
+  cli_output_set_int(o, 1, (int64_t)trace->td->events.len);
+  cli_output_set_int(o, 2, (int64_t)trace->tracks.len);
+}
+
+static void cli_server_list(cli_server_t* srv, FILE* out) {
+  cli_output_t o;
+  cli_output_init(&o, CLI_FORMAT_JSON, out, srv->cache.allocator);
+  cli_server_begin_traces(&o);
+  for (size_t i = 0; i < srv->cache.traces.len; i++) {
+    cli_cached_trace_t* entry = srv->cache.traces.ptr[i];
+    cli_server_add_trace(&o, entry->path, &entry->trace);
+  }
+  cli_output_end_table(&o);
+  cli_output_deinit(&o);
+}
+
+// Returns the loaded trace for `path`, loading it first if needed.
+static cli_trace_t* cli_server_get_trace(cli_server_t* srv, const char* path,
+                                         FILE* err) {
+  cli_trace_t* trace = cli_trace_cache_get(&srv->cache, path);
+  if (trace == nullptr) {
+    fprintf(err, "Error: Failed to load trace '%s'\n", path);
+  }
+  return trace;
+}
+
+// Runs an analysis subcommand by building the argv the command line would
+// have passed, so requests accept exactly the CLI flags. The result is always
+// the --format json document.
+static int cli_server_run(cli_server_t* srv, const cli_request_t* req,
+                          const char* trace_path, FILE* out, FILE* err) {
+  int exit_code = 0;
+  char* argv[CLI_SERVE_MAX_ARGS + 4];
+  int argc = 0;
+  argv[argc++] = "ztracing";
+  argv[argc++] = (char*)req->command;
+  argv[argc++] = (char*)trace_path;
+  if (strcmp(req->command, "diff") == 0 && req->trace_2) {
+    argv[argc++] = (char*)req->trace_2;
+  }
+  bool has_format = false;
+  for (size_t i = 0; i < req->args_count; i++) {
+    argv[argc++] = (char*)req->args[i];
+    has_format = has_format || strcmp(req->args[i], "--format") == 0;
+  }
+
+  cli_args_t args = {};
+  if (has_format) {
+    fprintf(err, "Error: '--format' is not supported in serve requests; "
+                 "results are always JSON\n");
+    exit_code = 1;
+  } else if (!parse_arguments(argc, argv, &args, err) ||
+             !cli_check_nested_args(&args, err)) {
+    exit_code = 1;
+  } else if (strcmp(args.subcommand, "serve") == 0) {
+    fprintf(err, "Error: 'serve' cannot be requested from a server\n");
+    exit_code = 1;
+  } else {
+    args.format = CLI_FORMAT_JSON;
+    cli_trace_t* trace = cli_server_get_trace(srv, args.trace_file, err);
+    cli_trace_t* trace_2 = nullptr;
+    if (trace && args.trace_file_2) {
+      trace_2 = cli_server_get_trace(srv, args.trace_file_2, err);
+    }
+    if (trace && (args.trace_file_2 == nullptr || trace_2)) {
+      exit_code = run_subcommand(&args, trace, trace_2, nullptr,
+                                 srv->cache.allocator, out, err);
+    } else {
+      exit_code = 1;
+    }
+  }
+  return exit_code;
+}
+
+static int cli_server_dispatch(cli_server_t* srv, const cli_request_t* req,
+                               FILE* out, FILE* err) {
+  int exit_code = 0;
+  string_view_t command = string_view_from_cstr(req->command);
+  const char* trace_path = req->trace;
+  if (trace_path == nullptr && srv->cache.traces.len > 0) {
+    trace_path = srv->cache.traces.ptr[0]->path;
+  }
+
+  if (string_view_eq(command, SV("shutdown"))) {
+    srv->shutdown = true;
+  } else if (string_view_eq(command, SV("list"))) {
+    cli_server_list(srv, out);
+  } else if (trace_path == nullptr) {
+    fprintf(err, "Error: No trace loaded; pass \"trace\"\n");
+    exit_code = 1;
+  } else if (string_view_eq(command, SV("load"))) {
+    cli_trace_t* trace = cli_server_get_trace(srv, trace_path, err);
+    if (trace) {
+      cli_output_t o;
+      cli_output_init(&o, CLI_FORMAT_JSON, out, srv->cache.allocator);
+      cli_server_begin_traces(&o);
+      cli_server_add_trace(&o, trace_path, trace);
+      cli_output_end_table(&o);
+      cli_output_deinit(&o);
+    } else {
+      exit_code = 1;
+    }
+  } else if (string_view_eq(command, SV("unload"))) {
+    if (!cli_trace_cache_unload(&srv->cache, trace_path)) {
+      fprintf(err, "Error: Trace '%s' is not loaded\n", trace_path);
+      exit_code = 1;
+    }
+  } else {
+    exit_code = cli_server_run(srv, req, trace_path, out, err);
+  }
+  return exit_code;
+}
+
+static void cli_server_handle(cli_server_t* srv, string_view_t line,
+                              FILE* out) {
+  allocator_t* a = srv->cache.allocator;
+  double start = platform_get_now();
+  char* result = nullptr;
+  size_t result_size = 0;
+  char* error = nullptr;
+  size_t error_size = 0;
+  FILE* result_stream = open_memstream(&result, &result_size);
+  FILE* error_stream = open_memstream(&error, &error_size);
+
+  int exit_code = 1;
+  cli_request_t req = {};
+  if (result_stream == nullptr || error_stream == nullptr) {
+    fprintf(stderr, "Error: Failed to allocate a response: %s\n",
+            strerror(errno));
+  } else if (cli_request_parse(&req, line, a, error_stream)) {
+    exit_code = cli_server_dispatch(srv, &req, result_stream, error_stream);
+  }
+  // Closing a memory stream sets its buffer and size for the last time.
+  if (result_stream) {
+    fclose(result_stream);
+  }
+  if (error_stream) {
+    fclose(error_stream);
+  }
+  double elapsed_ms = platform_get_now() - start;
+
+  // The result document ends with a newline, which would split the response.
+  string_view_t result_json = string_view_from_parts(result, result_size);
+  while (result_json.len > 0 && result_json.ptr[result_json.len - 1] == '\n') {
+    result_json.len--;
+  }
+
+  darray_uint8_t response = {};
+  json_writer_t w;
+  json_writer_init(&w, false, &response, a);
+  json_writer_begin_object(&w);
+  json_writer_name(&w, SV("id"));
+  if (req.id.type == JSON_TOKEN_STRING) {
+    json_writer_string(&w, string_view_from_cstr(
+                               cli_json_unescape(req.id.val.str,
+                                                 &req.strings)));
+  } else if (req.id.type == JSON_TOKEN_NUMBER_I64) {
+    json_writer_number_int(&w, req.id.val.i64);
+  } else if (req.id.type == JSON_TOKEN_NUMBER_F64) {
+    json_writer_number_double(&w, req.id.val.f64);
+  } else {
+    json_writer_null(&w);
+  }
+  json_writer_name(&w, SV("ok"));
+  json_writer_bool(&w, exit_code == 0);
+  json_writer_name(&w, SV("exit_code"));
+  json_writer_number_int(&w, exit_code);
+  json_writer_name(&w, SV("elapsed_ms"));
+  json_writer_number_double(&w, elapsed_ms);
+  json_writer_name(&w, SV("result"));
+  if (result_json.len > 0) {
+    json_writer_raw(&w, result_json);
+  } else {
+    json_writer_null(&w);
+  }
+  json_writer_name(&w, SV("error"));
+  json_writer_string(&w, string_view_from_parts(error, error_size));
+  json_writer_end_object(&w);
+  darray_push(&response, '\n', a);
+
+  fwrite(response.ptr, 1, response.len, out);
+  fflush(out);
+
+  darray_deinit(&response, a);
+  darray_deinit(&req.strings, a);
+  free(error);
+  free(result);
+}
+
+// Reads one line, without its newline, into `line`. Returns false at end of
+// input.
+static bool cli_read_line(FILE* in, darray_uint8_t* line, allocator_t* a) {
+  char chunk[4096];
+  bool got_any = false;
+  bool done = false;
+  darray_clear(line);
+  while (!done && fgets(chunk, sizeof(chunk), in)) {
+    size_t n = strlen(chunk);
+    got_any = true;
+    if (n > 0 && chunk[n - 1] == '\n') {
+      n--;
+      done = true;
+    }
+    darray_push_n(line, (uint8_t*)chunk, n, a);
+  }
+  if (line->len > 0 && line->ptr[line->len - 1] == '\r') {
+    line->len--;
+  }
+  return got_any;
+}
+
+static void cli_serve_stream(cli_server_t* srv, FILE* in, FILE* out) {
+  darray_uint8_t line = {};
+  while (!srv->shutdown && cli_read_line(in, &line, srv->cache.allocator)) {
+    if (line.len > 0) {
+      cli_server_handle(
+          srv, string_view_from_parts((const char*)line.ptr, line.len), out);
+    }
+  }
+  darray_deinit(&line, srv->cache.allocator);
+}
+
+// Binds `fd` to `addr`. A socket file left behind by a server that is gone
+// is replaced: only when the path is taken, a connection to it is refused,
+// and it is a socket. Binding first leaves no window in which a live
+// server's socket could be unlinked. Reports failures to stderr.
+static bool cli_serve_bind(int fd, const struct sockaddr_un* addr) {
+  const char* path = addr->sun_path;
+  bool bound = bind(fd, (const struct sockaddr*)addr, sizeof(*addr)) == 0;
+  bool reported = false;
+  if (!bound && errno == EADDRINUSE) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = probe >= 0 && connect(probe, (const struct sockaddr*)addr,
+                                      sizeof(*addr)) == 0;
+    if (probe >= 0) {
+      close(probe);
+    }
+    struct stat st;
+    if (live) {
+      fprintf(stderr, "Error: A server is already listening on '%s'\n", path);
+      reported = true;
+    } else if (lstat(path, &st) != 0 || !S_ISSOCK(st.st_mode)) {
+      fprintf(stderr, "Error: '%s' exists and is not a socket\n", path);
+      reported = true;
+    } else if (unlink(path) == 0) {
+      bound = bind(fd, (const struct sockaddr*)addr, sizeof(*addr)) == 0;
+    }
+  }
+  if (!bound && !reported) {
+    fprintf(stderr, "Error: Failed to listen on '%s': %s\n", path,
+            strerror(errno));
+  }
+  return bound;
+}
+
+// Accepts connections on a Unix domain socket, one at a time, until a client
+// sends "shutdown".
+static int cli_serve_socket(cli_server_t* srv, const char* path) {
+  int exit_code = 0;
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  int fd = -1;
+  bool bound = false;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error: Socket path '%s' is too long\n", path);
+    exit_code = 1;
+  } else {
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    // Anyone who can connect can run queries, so only the owner may.
+    mode_t old_umask = umask(0177);
+    bound = fd >= 0 && cli_serve_bind(fd, &addr);
+    umask(old_umask);
+    if (fd < 0 || (bound && listen(fd, 8) != 0)) {
+      fprintf(stderr, "Error: Failed to listen on '%s': %s\n", path,
+              strerror(errno));
+      exit_code = 1;
+    } else if (!bound) {
+      exit_code = 1;
+    }
+  }
+
+  while (exit_code == 0 && !srv->shutdown) {
+    int conn = accept(fd, nullptr, nullptr);
+    if (conn >= 0) {
+      FILE* in = fdopen(conn, "r");
+      FILE* out = fdopen(dup(conn), "w");
+      if (in && out) {
+        cli_serve_stream(srv, in, out);
+      }
+      if (out) {
+        fclose(out);
+      }
+      if (in) {
+        fclose(in);
+      } else {
+        close(conn);
+      }
+    } else if (errno != EINTR) {
+      fprintf(stderr, "Error: Failed to accept on '%s': %s\n", path,
+              strerror(errno));
+      exit_code = 1;
+    }
+  }
+
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (bound) {
+    unlink(path);
+  }
+  return exit_code;
+}
+
+static int handle_serve(const cli_args_t* args, allocator_t* a) {
+  int exit_code = 0;
+  cli_server_t srv = {.cache = {.allocator = a}};
+  // A client that disconnects mid-response must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  if (cli_trace_cache_get(&srv.cache, args->trace_file) == nullptr) {
+    exit_code = 1;
+  } else if (args->socket_path) {
+    exit_code = cli_serve_socket(&srv, args->socket_path);
+  } else {
+    cli_serve_stream(&srv, stdin, stdout);
+  }
+
+  cli_trace_cache_deinit(&srv.cache);
+  return exit_code;
+}
+
+// ─── Fleet ───────────────────────────────────────────────────────────────────
+//
+// `fleet-aggregate` aggregates every trace matched by a directory or a glob
+// (quote it so the shell leaves it alone) and merges the results into per-key
+// distributions across traces.
+//
+// Traces are loaded and aggregated as tasks on one task queue, driven from
+// this thread, so the work shares the worker pool however many traces there
+// are. Each trace is merged and released on this thread in path order. At most
+// --jobs traces are resident at once, and a new load only starts while the
+// estimated memory of the loads in flight stays within --memory-budget. A load
+// is estimated from the inflated size of its input and the most memory per
+// input byte that any finished load has needed.
+
+// Default for --jobs: traces loaded at once.
+constexpr size_t CLI_FLEET_DEFAULT_JOBS = 2;
+
+typedef struct cli_fleet_load {
+  const char* path;
+  // Inflated size of the input
+  size_t input_bytes;
+  // Memory this load was admitted with
+  size_t estimated_bytes;
+  string_view_t group_by;
+  // Counts this load's allocations, for its peak memory.
+  counting_allocator_t counting;
+  // Non-null while the trace is loading
+  trace_loader_t* loader;
+  trace_data_t* td;
+  darray_track_t tracks;
+  darray_trace_aggregate_entry_t entries;
+  // Set once the entries are computed, or the load failed
+  bool done;
+} cli_fleet_load_t;
+
+typedef darray_t(const char*) cli_fleet_paths_t;
+
+// Aggregates a loaded trace on a worker, then drops its tracks.
+static void cli_fleet_aggregate_task(task_context_t* ctx) {
+  cli_fleet_load_t* load = (cli_fleet_load_t*)ctx->user_data;
+  allocator_t* a = &load->counting.super;
+  trace_aggregate_compute_tracks(load->td, &load->tracks, load->group_by,
+                                 SV(""), TRACE_AGGREGATE_METRIC_TOTAL,
+                                 &load->entries, a);
+  for (size_t i = 0; i < load->tracks.len; i++) {
+    track_deinit(&load->tracks.ptr[i], a);
+  }
+  darray_deinit(&load->tracks, a);
+}
+
+// Takes the trace of a finished loader and queues its aggregation.
+static void cli_fleet_load_finish(cli_fleet_load_t* load,
+                                  task_queue_t* queue) {
+  load->td = trace_loader_finish(load->loader, nullptr, &load->tracks,
+                                 nullptr, nullptr, nullptr, nullptr);
+  load->loader = nullptr;
+  task_submission_t* sub = load->td ? task_queue_get_submission(queue)
+                                    : nullptr;
+  if (sub) {
+    sub->task = cli_fleet_aggregate_task;
+    sub->user_data = load;
+    sub->stream = 0;
+    task_queue_submit(queue);
+  } else {
+    load->done = true;
+  }
+}
+
+// Routes the completion at the head of the queue to the load it belongs to.
+static void cli_fleet_handle_completion(cli_fleet_load_t* loads, size_t begin,
+                                        size_t end, task_queue_t* queue,
+                                        const task_completion_t* cqe) {
+  if (cqe->task == cli_fleet_aggregate_task) {
+    ((cli_fleet_load_t*)cqe->user_data)->done = true;
+    task_queue_remove_completion(queue);
+  } else {
+    bool handled = false;
+    for (size_t i = begin; !handled && i < end; i++) {
+      cli_fleet_load_t* load = &loads[i];
+      if (load->loader &&
+          trace_loader_owns_completion(load->loader, cqe)) {
+        trace_loader_handle_completion(load->loader, cqe);
+        if (trace_loader_is_done(load->loader)) {
+          cli_fleet_load_finish(load, queue);
+        }
+        handled = true;
+      }
+    }
+    expect(handled);
+  }
+}
+
+// Expands `pattern` into the sorted paths of regular files. A directory
+// matches every file in it.
+static bool cli_fleet_expand(const char* pattern, glob_t* out_glob,
+                             cli_fleet_paths_t* out_paths, allocator_t* a) {
+  struct stat st;
+  string_t dir_pattern = {};
+  if (stat(pattern, &st) == 0 && S_ISDIR(st.st_mode)) {
+    string_printf(&dir_pattern, a, "%s/*", pattern);
+    pattern = string_get_view(&dir_pattern).ptr;
+  }
+  bool ok = glob(pattern, 0, nullptr, out_glob) == 0;
+  for (size_t i = 0; ok && i < out_glob->gl_pathc; i++) {
+    const char* path = out_glob->gl_pathv[i];
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+      darray_push(out_paths, path, a);
+    }
+  }
+  string_free(dir_pattern, a);
+  return ok && out_paths->len > 0;
+}
+
+// Loads, aggregates and merges the traces at `paths`, then prints the fleet
+// table.
+static int cli_fleet_aggregate_paths(const cli_args_t* args,
+                                     const cli_fleet_paths_t* paths,
+                                     string_view_t group_by,
+                                     string_view_t sort_by, allocator_t* a) {
+  size_t jobs = args->has_jobs && args->jobs > 0 ? (size_t)args->jobs
+                                                 : CLI_FLEET_DEFAULT_JOBS;
+  size_t budget = cli_memory_budget(args);
+  double memory_ratio = CLI_TRACE_MEMORY_RATIO;
+  bool memory_ratio_measured = false;
+
+  // Loads in flight, oldest first: [next_merge, next_load).
+  darray_t(cli_fleet_load_t) loads = {};
+  darray_resize(&loads, paths->len, a);
+  size_t next_load = 0;
+  size_t next_merge = 0;
+  size_t bytes_in_flight = 0;
+  size_t failed_count = 0;
+  trace_fleet_t fleet;
+  trace_fleet_init(&fleet, a);
+  // Room for every load in flight, plus its aggregation.
+  size_t max_in_flight = jobs < paths->len ? jobs : paths->len;
+  task_queue_t* queue = task_queue_create(
+      max_in_flight * (TRACE_LOADER_QUEUE_SLOTS + 1), platform_submit_job, a);
+
+  while (next_merge < paths->len) {
+    // Always keep one load going, even if it alone exceeds the budget.
+    bool can_start = true;
+    while (can_start && next_load < paths->len) {
+      size_t input_bytes = cli_trace_input_size(paths->ptr[next_load]);
+      size_t estimated_bytes = (size_t)((double)input_bytes * memory_ratio);
+      size_t in_flight = next_load - next_merge;
+      can_start = in_flight == 0 ||
+                  (in_flight < jobs && bytes_in_flight <= budget &&
+                   estimated_bytes <= budget - bytes_in_flight);
+      if (can_start) {
+        cli_fleet_load_t* load = &loads.ptr[next_load];
+        *load = (cli_fleet_load_t){
+            .path = paths->ptr[next_load],
+            .input_bytes = input_bytes,
+            .estimated_bytes = estimated_bytes,
+            .group_by = group_by,
+        };
+        counting_allocator_init(&load->counting, a);
+        // Every load parses on a stream of its own.
+        load->loader = trace_loader_create(load->path, queue,
+                                           (task_stream_t)(next_load + 1),
+                                           &load->counting.super);
+        if (load->loader) {
+          trace_loader_pump(load->loader);
+        } else {
+          load->done = true;
+        }
+        bytes_in_flight += estimated_bytes;
+        next_load++;
       }
-      darray_deinit(&tracks, a);
-      trace_data_release(td, a);
+    }
+
+    cli_fleet_load_t* load = &loads.ptr[next_merge];
+    if (!load->done) {
+      task_completion_t cqe;
+      task_queue_wait_completion(queue, &cqe);
+      cli_fleet_handle_completion(loads.ptr, next_merge, next_load, queue,
+                                  &cqe);
+    } else {
+      // Later loads are estimated with the most memory any load has needed.
+      if (load->input_bytes > 0) {
+        double ratio =
+            (double)counting_allocator_get_peak_bytes(&load->counting) /
+            (double)load->input_bytes;
+        if (!memory_ratio_measured || ratio > memory_ratio) {
+          memory_ratio = ratio;
+          memory_ratio_measured = true;
+        }
+      }
+      allocator_t* load_allocator = &load->counting.super;
+      if (load->td) {
+        trace_fleet_add(&fleet, load->td, &load->entries, a);
+        trace_data_release(load->td, load_allocator);
+      } else {
+        failed_count++;
+      }
+      darray_deinit(&load->entries, load_allocator);
+      bytes_in_flight -= load->estimated_bytes;
+      next_merge++;
+    }
+  }
+  task_queue_destroy(queue);
+
+  darray_trace_fleet_entry_t entries = {};
+  trace_fleet_compute(&fleet, sort_by, &entries, a);
+
+  cli_output_t o;
+  cli_output_init(&o, args->format, stdout, a);
+  if (cli_output_is_table(&o)) {
+    printf("Traces: %zu", fleet.trace_count);
+    if (failed_count > 0) {
+      printf(" (%zu failed to load)", failed_count);
+    }
+    printf("\n\n");
+  }
+
+  cli_output_begin_table(&o, SV("fleet_aggregate"));
+  bool by_cat = string_view_eq(group_by, SV("category"));
+  cli_output_add_column(&o, by_cat ? SV("category") : SV("name"),
+                        by_cat ? SV("Event Category") : SV("Event Name"),
+                        CLI_ALIGN_LEFT, 30, true);
+  cli_output_add_column(&o, SV("traces"), SV("Traces"), CLI_ALIGN_RIGHT, 6,
+                        true);
+  cli_output_add_column(&o, SV("count"), SV("Event Count"), CLI_ALIGN_RIGHT,
+                        11, true);
+  cli_output_add_column(&o, SV("total_duration_s"), SV("Total Dur (s)"),
+                        CLI_ALIGN_RIGHT, 13, true);
+  cli_output_add_column(&o, SV("mean_duration_ms"), SV("Mean/Trace (ms)"),
+                        CLI_ALIGN_RIGHT, 15, true);
+  cli_output_add_column(&o, SV("p50_duration_ms"), SV("P50 (ms)"),
+                        CLI_ALIGN_RIGHT, 10, true);
+  cli_output_add_column(&o, SV("p95_duration_ms"), SV("P95 (ms)"),
+                        CLI_ALIGN_RIGHT, 10, true);
+
+  trace_fleet_entry_t* entries_ptr = entries.ptr;
+  for (size_t i = 0; i < entries.len; i++) {
+    const trace_fleet_entry_t* e = &entries_ptr[i];
+    cli_output_add_row(&o);
+    cli_output_set_string(&o, 0, e->key);
+    cli_output_set_int(&o, 1, (int64_t)e->trace_count);
+    cli_output_set_int(&o, 2, (int64_t)e->event_count);
+    cli_output_set_double(&o, 3, e->total_duration / 1000000.0, 2);
+    cli_output_set_double(&o, 4, e->mean_duration / 1000.0, 2);
+    cli_output_set_double(&o, 5, e->p50_duration / 1000.0, 2);
+    cli_output_set_double(&o, 6, e->p95_duration / 1000.0, 2);
+  }
+  cli_output_end_table(&o);
+  cli_output_deinit(&o);
+
+  darray_deinit(&entries, a);
+  trace_fleet_deinit(&fleet, a);
+  darray_deinit(&loads, a);
+  return failed_count > 0 ? 1 : 0;
+}
+
+static int handle_fleet_aggregate(const cli_args_t* args, allocator_t* a) {
+  int exit_code = 0;
+  string_view_t group_by =
+      string_view_is_empty(args->group_by) ? SV("name") : args->group_by;
+  string_view_t sort_by =
+      string_view_is_empty(args->sort_by) ? SV("duration") : args->sort_by;
+  glob_t matches = {};
+  cli_fleet_paths_t paths = {};
+
+  if (!string_view_eq(group_by, SV("name")) &&
+      !string_view_eq(group_by, SV("category"))) {
+    fprintf(stderr,
+            "Error: Invalid value for --group-by: '%.*s'. Expected 'name' or "
+            "'category'.\n",
+            (int)group_by.len, group_by.ptr);
+    exit_code = 1;
+  } else if (!string_view_eq(sort_by, SV("duration")) &&
+             !string_view_eq(sort_by, SV("count")) &&
+             !string_view_eq(sort_by, SV("p95"))) {
+    fprintf(stderr,
+            "Error: Invalid value for --sort: '%.*s'. Expected 'duration', "
+            "'count' or 'p95'.\n",
+            (int)sort_by.len, sort_by.ptr);
+    exit_code = 1;
+  } else if (!cli_fleet_expand(args->trace_file, &matches, &paths, a)) {
+    fprintf(stderr, "Error: No trace files match '%s'\n", args->trace_file);
+    exit_code = 1;
+  } else {
+    exit_code = cli_fleet_aggregate_paths(args, &paths, group_by, sort_by, a);
+  }
+
+  darray_deinit(&paths, a);
+  globfree(&matches);
+  return exit_code;
+}
+
+// ─── Batch ───────────────────────────────────────────────────────────────────
+//
+// `batch` loads a trace once and runs a list of subcommands against it. The
+// list comes from a script (one command per line, `#` starts a comment; `-`
+// reads stdin) followed by any --exec commands:
+//
+//   summary
+//   query --match "Frame Begin" --limit 10 > frames.txt
+//   diff baseline.json --sort count-delta
+//
+// Commands take the usual flags with the batch trace implied, so diff only
+// names the trace to compare against. A trailing `> path` writes the result
+// to a file; otherwise it goes to stdout under a `==> command <==` header.
+//
+// Commands only read the loaded traces, so with --jobs <n> up to n of them run
+// at once on the task queue. Results bound for stdout are buffered and printed
+// in script order.
+
+// Most tokens in one batch command.
+constexpr size_t CLI_BATCH_MAX_TOKENS = 64;
+
+typedef struct cli_batch_command {
+  // The command as written, for headers and errors.
+  string_view_t source;
+  // Unquoted tokens, pointing into cli_batch_t::storage.
+  char* tokens[CLI_BATCH_MAX_TOKENS];
+  size_t token_count;
+  const char* output_path;
+  cli_args_t args;
+
+  // Set up by cli_batch_run() before the command executes.
+  const cli_trace_t* trace;
+  const cli_trace_t* trace_2;
+  allocator_t* allocator;
+
+  // Results. `buffer` holds stdout output of a parallel run (open_memstream).
+  char* buffer;
+  size_t buffer_size;
+  int exit_code;
+  bool done;
+} cli_batch_command_t;
+
+typedef struct cli_batch {
+  // Script lines followed by --exec commands, one per line.
+  darray_uint8_t text;
+  // Tokens of every command, NUL-terminated. Reserved up front so pointers
+  // into it stay valid.
+  darray_uint8_t storage;
+  darray_t(cli_batch_command_t) commands;
+  // Traces other than the batch trace, e.g. diff targets.
+  cli_trace_cache_t cache;
+} cli_batch_t;
+
+static bool cli_read_file(const char* path, darray_uint8_t* out,
+                          allocator_t* a) {
+  bool ok = true;
+  bool is_stdin = strcmp(path, "-") == 0;
+  FILE* f = is_stdin ? stdin : fopen(path, "rb");
+  if (f) {
+    char chunk[4096];
+    size_t n = 0;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+      darray_push_n(out, (uint8_t*)chunk, n, a);
+    }
+    ok = !ferror(f);
+    if (!is_stdin) {
+      fclose(f);
+    }
+  } else {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "Error: Failed to read batch script '%s'\n", path);
+  }
+  return ok;
+}
+
+// Splits `line` into whitespace-separated tokens, copying them into
+// `storage`. Single or double quotes group words and are removed.
+static bool cli_batch_tokenize(cli_batch_command_t* cmd, string_view_t line,
+                               darray_uint8_t* storage) {
+  bool ok = true;
+  size_t i = 0;
+  bool done = false;
+  while (ok && !done) {
+    while (i < line.len && (line.ptr[i] == ' ' || line.ptr[i] == '\t')) {
+      i++;
+    }
+    if (i >= line.len || line.ptr[i] == '#') {
+      done = true;
+    } else if (cmd->token_count >= CLI_BATCH_MAX_TOKENS) {
+      fprintf(stderr, "Error: Too many arguments (at most %zu)\n",
+              (size_t)CLI_BATCH_MAX_TOKENS);
+      ok = false;
     } else {
+      cmd->tokens[cmd->token_count++] =
+          (char*)storage->ptr + storage->len;
+      char quote = 0;
+      while (i < line.len &&
+             (quote || (line.ptr[i] != ' ' && line.ptr[i] != '\t'))) {
+        char c = line.ptr[i++];
+        if (quote == 0 && (c == '"' || c == '\'')) {
+          quote = c;
+        } else if (c == quote) {
+          quote = 0;
+        } else {
+          storage->ptr[storage->len++] = (uint8_t)c;
+        }
+      }
+      storage->ptr[storage->len++] = 0;
+      if (quote) {
+        fprintf(stderr, "Error: Unterminated quote\n");
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+// Parses one command line, reporting errors with the command's position.
+static bool cli_batch_parse_command(cli_batch_command_t* cmd,
+                                    const char* trace_path,
+                                    darray_uint8_t* storage) {
+  bool ok = cli_batch_tokenize(cmd, cmd->source, storage);
+  if (ok && cmd->token_count >= 2 &&
+      strcmp(cmd->tokens[cmd->token_count - 2], ">") == 0) {
+    cmd->output_path = cmd->tokens[cmd->token_count - 1];
+    cmd->token_count -= 2;
+  }
+
+  // Build the argv the command line would have passed, with the batch trace
+  // as the trace file.
+  char* argv[CLI_BATCH_MAX_TOKENS + 2];
+  int argc = 0;
+  if (ok && cmd->token_count > 0) {
+    argv[argc++] = "ztracing";
+    argv[argc++] = cmd->tokens[0];
+    argv[argc++] = (char*)trace_path;
+    for (size_t i = 1; i < cmd->token_count; i++) {
+      argv[argc++] = cmd->tokens[i];
+    }
+    ok = parse_arguments(argc, argv, &cmd->args, stderr) &&
+         cli_check_nested_args(&cmd->args, stderr);
+  } else if (ok) {
+    fprintf(stderr, "Error: Missing subcommand\n");
+    ok = false;
+  }
+
+  static const char* const subcommands[] = {
+      "summary", "concurrency", "aggregate", "diff",
+      "flamegraph", "histogram", "inspect", "query",
+  };
+  constexpr size_t subcommand_count =
+      sizeof(subcommands) / sizeof(subcommands[0]);
+  bool known = false;
+  for (size_t i = 0; ok && !known && i < subcommand_count; i++) {
+    known = strcmp(cmd->args.subcommand, subcommands[i]) == 0;
+  }
+  if (ok && !known) {
+    fprintf(stderr, "Error: '%s' is not an analysis subcommand\n",
+            cmd->args.subcommand);
+    ok = false;
+  }
+  return ok;
+}
+
+// Reads the script and --exec commands and parses every command, so mistakes
+// are reported before the trace is loaded.
+static bool cli_batch_prepare(cli_batch_t* batch, const cli_args_t* args,
+                              allocator_t* a) {
+  bool ok = true;
+  batch->cache.allocator = a;
+  size_t script_lines = 0;
+  if (args->script_path) {
+    ok = cli_read_file(args->script_path, &batch->text, a);
+    darray_push(&batch->text, '\n', a);
+    for (size_t i = 0; i < batch->text.len; i++) {
+      script_lines += batch->text.ptr[i] == '\n';
+    }
+  }
+  for (size_t i = 0; i < args->exec_count; i++) {
+    darray_push_n(&batch->text, (const uint8_t*)args->execs[i],
+                  strlen(args->execs[i]), a);
+    darray_push(&batch->text, '\n', a);
+  }
+  // Tokens plus their terminators never outgrow the text they came from.
+  darray_reserve(&batch->storage, batch->text.len + 1, a);
+
+  const char* text = (const char*)batch->text.ptr;
+  size_t line_start = 0;
+  size_t line_number = 0;
+  for (size_t i = 0; ok && i < batch->text.len; i++) {
+    if (text[i] != '\n') {
+      continue;
+    }
+    string_view_t line =
+        string_view_from_parts(text + line_start, i - line_start);
+    line_start = i + 1;
+    line_number++;
+    while (line.len > 0 && (line.ptr[line.len - 1] == '\r' ||
+                            line.ptr[line.len - 1] == ' ' ||
+                            line.ptr[line.len - 1] == '\t')) {
+      line.len--;
+    }
+    while (line.len > 0 && (line.ptr[0] == ' ' || line.ptr[0] == '\t')) {
+      line = string_view_slice(line, 1, line.len);
+    }
+    if (line.len == 0 || line.ptr[0] == '#') {
+      continue;
+    }
+
+    cli_batch_command_t cmd = {.source = line};
+    if (cli_batch_parse_command(&cmd, args->trace_file, &batch->storage)) {
+      darray_push(&batch->commands, cmd, a);
+    } else if (line_number <= script_lines) {
+      fprintf(stderr, "Error: Invalid command on line %zu of '%s': %.*s\n",
+              line_number, args->script_path, (int)line.len, line.ptr);
+      ok = false;
+    } else {
+      fprintf(stderr, "Error: Invalid --exec command: %.*s\n",
+              (int)line.len, line.ptr);
+      ok = false;
+    }
+  }
+
+  if (ok && batch->commands.len == 0) {
+    fprintf(stderr,
+            "Error: No commands to run; pass a script or --exec.\n");
+    ok = false;
+  }
+
+  // Commands may run at once (--jobs), and two writing the same file would
+  // interleave or truncate each other's output. Paths are compared as
+  // written.
+  const cli_batch_command_t* cmds = batch->commands.ptr;
+  for (size_t i = 0; ok && i < batch->commands.len; i++) {
+    for (size_t j = 0; ok && cmds[i].output_path && j < i; j++) {
+      if (cmds[j].output_path &&
+          strcmp(cmds[j].output_path, cmds[i].output_path) == 0) {
+        fprintf(stderr, "Error: More than one command writes to '%s'\n",
+                cmds[i].output_path);
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+static void cli_batch_deinit(cli_batch_t* batch, allocator_t* a) {
+  for (size_t i = 0; i < batch->commands.len; i++) {
+    free(batch->commands.ptr[i].buffer);
+  }
+  darray_deinit(&batch->commands, a);
+  darray_deinit(&batch->storage, a);
+  darray_deinit(&batch->text, a);
+  if (batch->cache.allocator) {
+    cli_trace_cache_deinit(&batch->cache);
+  }
+}
+
+// Runs one command. Output bound for stdout goes straight to stdout, or into
+// `cmd->buffer` when `buffered` so parallel commands do not interleave.
+static void cli_batch_execute(cli_batch_command_t* cmd, bool buffered) {
+  FILE* out = stdout;
+  if (cmd->output_path) {
+    out = fopen(cmd->output_path, "w");
+    if (!out) {
+      fprintf(stderr, "Error: Failed to open '%s' for writing\n",
+              cmd->output_path);
+    }
+  } else if (buffered) {
+    out = open_memstream(&cmd->buffer, &cmd->buffer_size);
+  }
+
+  if (out) {
+    SELF_TRACE_BEGIN("batch_command");
+    cmd->exit_code = run_subcommand(&cmd->args, cmd->trace, cmd->trace_2,
+                                    nullptr, cmd->allocator, out, stderr);
+    SELF_TRACE_END();
+    if (out != stdout) {
+      fclose(out);
+    }
+  } else {
+    cmd->exit_code = 1;
+  }
+}
+
+static void cli_batch_task(task_context_t* ctx) {
+  cli_batch_command_t* cmd = (cli_batch_command_t*)ctx->user_data;
+  cmd->args.on_worker = true;
+  cli_batch_execute(cmd, true);
+}
+
+static void cli_batch_print_header(const cli_batch_command_t* cmd,
+                                   bool* first) {
+  if (!*first) {
+    printf("\n");
+  }
+  printf("==> %.*s <==\n", (int)cmd->source.len, cmd->source.ptr);
+  *first = false;
+}
+
+static int cli_batch_run(cli_batch_t* batch, const cli_args_t* args,
+                         const cli_trace_t* trace, allocator_t* a) {
+  int exit_code = 0;
+  cli_batch_command_t* cmds = batch->commands.ptr;
+  size_t count = batch->commands.len;
+
+  // Load diff targets up front, on this thread.
+  bool ok = true;
+  for (size_t i = 0; ok && i < count; i++) {
+    cmds[i].trace = trace;
+    cmds[i].allocator = a;
+    if (cmds[i].args.trace_file_2) {
+      cmds[i].trace_2 =
+          cli_trace_cache_get(&batch->cache, cmds[i].args.trace_file_2);
+      ok = cmds[i].trace_2 != nullptr;
+    }
+  }
+
+  size_t jobs = args->has_jobs && args->jobs > 1 ? (size_t)args->jobs : 1;
+  bool first = true;
+  if (!ok) {
+    exit_code = 1;
+  } else if (jobs == 1) {
+    for (size_t i = 0; i < count; i++) {
+      if (cmds[i].output_path == nullptr) {
+        cli_batch_print_header(&cmds[i], &first);
+      }
+      cli_batch_execute(&cmds[i], false);
+      fflush(stdout);
+    }
+  } else {
+    task_queue_t* queue = task_queue_create(jobs, platform_submit_job, a);
+    size_t next_submit = 0;
+    size_t next_print = 0;
+    size_t in_flight = 0;
+    while (next_print < count) {
+      bool submitted = false;
+      while (in_flight < jobs && next_submit < count) {
+        task_submission_t* sqe = task_queue_get_submission(queue);
+        sqe->task = cli_batch_task;
+        sqe->user_data = &cmds[next_submit];
+        next_submit++;
+        in_flight++;
+        submitted = true;
+      }
+      if (submitted) {
+        task_queue_submit(queue);
+      }
+
+      task_completion_t cqe;
+      task_queue_wait_completion(queue, &cqe);
+      ((cli_batch_command_t*)cqe.user_data)->done = true;
+      task_queue_remove_completion(queue);
+      in_flight--;
+
+      // Print finished results in order; later ones wait for earlier ones.
+      while (next_print < count && cmds[next_print].done) {
+        cli_batch_command_t* cmd = &cmds[next_print];
+        if (cmd->output_path == nullptr) {
+          cli_batch_print_header(cmd, &first);
+          fwrite(cmd->buffer, 1, cmd->buffer_size, stdout);
+        }
+        next_print++;
+      }
+    }
+    task_queue_destroy(queue);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (cmds[i].exit_code != 0) {
+      exit_code = cmds[i].exit_code;
+    }
+  }
+  return exit_code;
+}
+
+// main entry point preferring success path under if.
+int main(int argc, char* argv[]) {
+  int exit_code = 0;
+  cli_args_t args = {};
+
+  if (parse_arguments(argc, argv, &args, stderr)) {
+    vm_allocator_t vm_allocator;
+    vm_allocator_init(&vm_allocator, c_allocator());
+    allocator_t* a = vm_allocator_get_allocator(&vm_allocator);
+    counting_allocator_t profile_allocator = {};
+    trace_load_profile_t load_profile = {};
+    cli_profile_stage_t load_stage = {};
+    cli_profile_stage_t command_stage = {};
+    if (args.profile) {
+      counting_allocator_init(&profile_allocator, a);
+      a = counting_allocator_get_allocator(&profile_allocator);
+      cli_profile_stage_begin(&load_stage, &profile_allocator);
+    }
+    tagged_allocator_t memory_allocator = {};
+    if (args.memory) {
+      tagged_allocator_init(&memory_allocator, a);
+      a = tagged_allocator_get_allocator(&memory_allocator);
+    }
+    if (args.self_trace_path) {
+      self_trace_set_thread_name("main");
+      self_trace_set_enabled(true);
+    }
+
+    // The trace, and for diff the target trace.
+    cli_trace_t traces[2] = {};
+    const char* trace_paths[2] = {args.trace_file, args.trace_file_2};
+    size_t trace_count = args.trace_file_2 ? 2 : 1;
+    cli_batch_t batch = {};
+    bool is_batch = strcmp(args.subcommand, "batch") == 0;
+    bool is_serve = strcmp(args.subcommand, "serve") == 0;
+    bool is_fleet = strcmp(args.subcommand, "fleet-aggregate") == 0;
+
+    if (is_serve) {
+      exit_code = handle_serve(&args, a);
+    } else if (is_fleet) {
+      exit_code = handle_fleet_aggregate(&args, a);
+    } else if (is_batch && !cli_batch_prepare(&batch, &args, a)) {
       exit_code = 1;
+    } else if (cli_trace_load_all(traces, trace_paths, trace_count,
+                                  cli_memory_budget(&args), a,
+                                  args.profile ? &load_profile : nullptr)) {
+      if (args.profile) {
+        cli_profile_stage_end(&load_stage, &profile_allocator);
+        cli_profile_stage_begin(&command_stage, &profile_allocator);
+      }
+      SELF_TRACE_BEGIN("subcommand");
+      if (is_batch) {
+        exit_code = cli_batch_run(&batch, &args, &traces[0], a);
+      } else {
+        exit_code = run_subcommand(&args, &traces[0], &traces[1],
+                                   args.memory ? &memory_allocator : nullptr,
+                                   a, stdout, stderr);
+      }
+      SELF_TRACE_END();
+
+      if (args.profile) {
+        cli_profile_stage_end(&command_stage, &profile_allocator);
+        print_profile(&load_profile, &load_stage, &command_stage);
+      }
+
+    } else {
+      exit_code = 1;
+    }
+    cli_trace_deinit(&traces[1], a);
+    cli_trace_deinit(&traces[0], a);
+    cli_batch_deinit(&batch, a);
+
+    if (args.self_trace_path) {
+      self_trace_set_enabled(false);
+      if (!self_trace_write_file(args.self_trace_path, a)) {
+        fprintf(stderr, "Error: Failed to write self-trace to '%s'\n",
+                args.self_trace_path);
+        exit_code = 1;
+      }
     }
   } else {
     print_usage(argv[0]);
@@ -1,14 +1,20 @@
 #include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <zlib.h>
 
 #include <array>
+#include <chrono>
 #include <cstdio>
 #include <fstream>
+#include <iterator>
 #include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace {
@@ -264,6 +270,324 @@ TEST_F(ztracing_cli_test, summary_list_tracks_output_matches_golden) {
                        "summary_list_tracks.golden", 0);
 }
 
+// Verify that --self-trace writes a Chrome trace that ztracing can load back.
+TEST_F(ztracing_cli_test, self_trace_writes_loadable_trace) {
+  std::string path =
+      write_temp_trace("self_trace_input.json", STANDARD_MOCK_TRACE);
+  const char* test_tmpdir = getenv("TEST_TMPDIR");
+  std::string out_path = test_tmpdir
+                             ? std::string(test_tmpdir) + "/self_trace.json"
+                             : "self_trace.json";
+  temp_files_.push_back(out_path);
+
+  command_result res =
+      run_cli("--self-trace " + out_path + " summary " + path);
+  EXPECT_EQ(res.exit_code, 0);
+
+  std::ifstream f(out_path);
+  ASSERT_TRUE(f.is_open());
+  std::string content((std::istreambuf_iterator<char>(f)),
+                      std::istreambuf_iterator<char>());
+  EXPECT_NE(content.find("\"name\":\"cli_trace_load_all\""),
+            std::string::npos);
+  EXPECT_NE(content.find("\"name\":\"track_organize\""), std::string::npos);
+
+  command_result reload = run_cli("summary " + out_path);
+  EXPECT_EQ(reload.exit_code, 0);
+}
+
+// Verify that --profile appends the per-phase table after the command output.
+TEST_F(ztracing_cli_test, profile_prints_phase_table) {
+  std::string path = write_temp_trace("profile_input.json", STANDARD_MOCK_TRACE);
+
+  command_result res = run_cli("--profile summary " + path);
+  EXPECT_EQ(res.exit_code, 0);
+  size_t summary_pos = res.output.find("Event Count");
+  size_t profile_pos = res.output.find("Peak (MB)");
+  ASSERT_NE(summary_pos, std::string::npos);
+  ASSERT_NE(profile_pos, std::string::npos);
+  EXPECT_LT(summary_pos, profile_pos);
+  for (const char* phase : {"load", "read", "parse", "intern", "b/e match",
+                            "organize", "discover", "command"}) {
+    EXPECT_NE(res.output.find(phase, profile_pos), std::string::npos) << phase;
+  }
+}
+
+TEST_F(ztracing_cli_test, summary_memory_prints_tag_table) {
+  std::string path = write_temp_trace("memory_input.json", STANDARD_MOCK_TRACE);
+
+  command_result res = run_cli("summary " + path + " --memory");
+  EXPECT_EQ(res.exit_code, 0);
+  size_t table_pos = res.output.find("Current (MB)");
+  ASSERT_NE(table_pos, std::string::npos);
+  EXPECT_LT(res.output.find("Event Count"), table_pos);
+  for (const char* tag :
+       {"strings", "events", "args", "tracks", "other", "total"}) {
+    EXPECT_NE(res.output.find(tag, table_pos), std::string::npos) << tag;
+  }
+}
+
+// Verify that --format prints tables as JSON, JSON lines or CSV, and rejects
+// unknown formats.
+TEST_F(ztracing_cli_test, format_prints_machine_readable_tables) {
+  std::string path = write_temp_trace("format_input.json", STANDARD_MOCK_TRACE);
+
+  command_result json = run_cli("summary " + path + " --format json");
+  EXPECT_EQ(json.exit_code, 0);
+  EXPECT_EQ(json.output,
+            "[{\"table\":\"summary\",\"rows\":["
+            "{\"metric\":\"Event Count\",\"value\":2},"
+            "{\"metric\":\"Track Count\",\"value\":1},"
+            "{\"metric\":\"Min Timestamp (us)\",\"value\":1000},"
+            "{\"metric\":\"Max Timestamp (us)\",\"value\":3000},"
+            "{\"metric\":\"Duration (ms)\",\"value\":2}]}]\n");
+
+  command_result jsonl = run_cli("query " + path + " --format jsonl");
+  EXPECT_EQ(jsonl.exit_code, 0);
+  EXPECT_EQ(jsonl.output,
+            "{\"table\":\"events\",\"name\":\"task_A\",\"track\":\"\","
+            "\"ts_us\":1000,\"dur_us\":500,\"depth\":0}\n"
+            "{\"table\":\"events\",\"name\":\"task_B\",\"track\":\"\","
+            "\"ts_us\":2000,\"dur_us\":1000,\"depth\":0}\n");
+
+  command_result csv =
+      run_cli("concurrency " + path + " --buckets 2 --format csv");
+  EXPECT_EQ(csv.exit_code, 0);
+  EXPECT_EQ(csv.output,
+            "bucket,start_s,end_s,utilization_pct,dominant_events\n"
+            "0,0,0.001,50,task_A\n"
+            "1,0.001,0.002,100,task_B\n");
+
+  command_result invalid = run_cli("summary " + path + " --format xml");
+  EXPECT_EQ(invalid.exit_code, 1);
+  EXPECT_NE(invalid.output.find("Invalid value for --format: 'xml'"),
+            std::string::npos);
+}
+
+// Verify that 'serve' answers one JSON line per request and reports
+// failures without exiting.
+TEST_F(ztracing_cli_test, serve_answers_requests_on_stdin) {
+  std::string path = write_temp_trace("serve_input.json", STANDARD_MOCK_TRACE);
+  std::string requests = write_temp_trace(
+      "serve_requests.jsonl",
+      "{\"id\": 1, \"command\": \"summary\"}\n"
+      "{\"id\": \"q\", \"command\": \"query\", \"args\": [\"--limit\", 1]}\n"
+      "{\"id\": 3, \"command\": \"bogus\"}\n"
+      "not json\n"
+      "{\"id\": 4, \"command\": \"list\"}\n"
+      "{\"id\": 5, \"command\": \"summary\", \"args\": [\"--format\", "
+      "\"csv\"]}\n");
+
+  command_result res = run_cli("serve " + path + " < " + requests);
+  EXPECT_EQ(res.exit_code, 0);
+
+  std::vector<std::string> lines;
+  std::istringstream stream(res.output);
+  for (std::string line; std::getline(stream, line);) {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(lines.size(), 6u) << res.output;
+  EXPECT_EQ(lines[0].rfind("{\"id\":1,\"ok\":true,\"exit_code\":0,", 0), 0u);
+  EXPECT_NE(lines[0].find("\"result\":[{\"table\":\"summary\",\"rows\":["),
+            std::string::npos);
+  EXPECT_NE(lines[0].find("{\"metric\":\"Event Count\",\"value\":"),
+            std::string::npos);
+  EXPECT_EQ(lines[1].rfind("{\"id\":\"q\",\"ok\":true,", 0), 0u);
+  EXPECT_NE(lines[1].find("\"result\":[{\"table\":\"events\""),
+            std::string::npos);
+  EXPECT_EQ(lines[2].rfind("{\"id\":3,\"ok\":false,\"exit_code\":1,", 0), 0u);
+  EXPECT_NE(lines[2].find("\"result\":null"), std::string::npos);
+  EXPECT_NE(lines[2].find("Subcommand 'bogus' is not yet implemented"),
+            std::string::npos);
+  EXPECT_EQ(lines[3].rfind("{\"id\":null,\"ok\":false,", 0), 0u);
+  EXPECT_NE(lines[4].find("{\"table\":\"traces\",\"rows\":[{\"trace\":\"" +
+                          path + "\""),
+            std::string::npos);
+  EXPECT_EQ(lines[5].rfind("{\"id\":5,\"ok\":false,", 0), 0u);
+  EXPECT_NE(lines[5].find("'--format' is not supported"), std::string::npos);
+}
+
+// Connects to the Unix socket at `path`, retrying while the server starts.
+static int connect_when_listening(const std::string& path) {
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+  int fd = -1;
+  for (int attempt = 0; fd < 0 && attempt < 500; attempt++) {
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(s, (sockaddr*)&addr, sizeof(addr)) == 0) {
+      fd = s;
+    } else {
+      close(s);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  return fd;
+}
+
+// Verify that 'serve --socket' takes over a stale socket, refuses to take
+// over a live one, and removes its socket on shutdown.
+TEST_F(ztracing_cli_test, serve_socket_replaces_only_stale_sockets) {
+  std::string path =
+      write_temp_trace("socket_serve_input.json", STANDARD_MOCK_TRACE);
+  // TEST_TMPDIR can be longer than a socket path may be.
+  std::string socket_path =
+      "/tmp/ztracing_cli_test_" + std::to_string(getpid()) + ".sock";
+
+  // A socket file whose server is gone.
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path.c_str());
+  int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_EQ(bind(stale, (sockaddr*)&addr, sizeof(addr)), 0);
+  close(stale);
+
+  command_result server = {};
+  std::thread server_thread(
+      [&] { server = run_cli("serve " + path + " --socket " + socket_path); });
+  int fd = connect_when_listening(socket_path);
+  ASSERT_GE(fd, 0);
+
+  command_result second = run_cli("serve " + path + " --socket " + socket_path);
+  EXPECT_EQ(second.exit_code, 1);
+  EXPECT_NE(second.output.find("A server is already listening"),
+            std::string::npos)
+      << second.output;
+
+  std::string request = "{\"id\": 1, \"command\": \"shutdown\"}\n";
+  ASSERT_EQ(write(fd, request.data(), request.size()),
+            (ssize_t)request.size());
+  std::string response;
+  char c = 0;
+  while (read(fd, &c, 1) == 1 && c != '\n') {
+    response += c;
+  }
+  close(fd);
+  server_thread.join();
+
+  EXPECT_EQ(response.rfind("{\"id\":1,\"ok\":true,", 0), 0u) << response;
+  EXPECT_EQ(server.exit_code, 0) << server.output;
+  EXPECT_NE(access(socket_path.c_str(), F_OK), 0);
+}
+
+// Verify that 'serve --socket' refuses to replace a file that is not a socket.
+TEST_F(ztracing_cli_test, serve_socket_keeps_existing_file) {
+  std::string path = write_temp_trace("socket_input.json", STANDARD_MOCK_TRACE);
+  std::string socket_path = write_temp_trace("not_a_socket", "keep me");
+
+  command_result res = run_cli("serve " + path + " --socket " + socket_path);
+  EXPECT_EQ(res.exit_code, 1);
+  EXPECT_NE(res.output.find("exists and is not a socket"), std::string::npos)
+      << res.output;
+
+  std::ifstream f(socket_path);
+  std::string content((std::istreambuf_iterator<char>(f)),
+                      std::istreambuf_iterator<char>());
+  EXPECT_EQ(content, "keep me");
+}
+
+// Verify that 'batch' runs script and --exec commands in order, writes
+// redirected results to their file, and prints the same output in parallel.
+TEST_F(ztracing_cli_test, batch_runs_commands_over_one_load) {
+  std::string path = write_temp_trace("batch_input.json", STANDARD_MOCK_TRACE);
+  const char* test_tmpdir = getenv("TEST_TMPDIR");
+  std::string out_path = test_tmpdir
+                             ? std::string(test_tmpdir) + "/batch_aggregate.txt"
+                             : "batch_aggregate.txt";
+  temp_files_.push_back(out_path);
+  std::string script = write_temp_trace(
+      "batch_script.txt",
+      "# Checks\n"
+      "summary\n"
+      "\n"
+      "query --match 'Frame' --limit 1\n"
+      "aggregate > " + out_path + "\n");
+
+  command_result res =
+      run_cli("batch " + path + " " + script + " --exec concurrency");
+  EXPECT_EQ(res.exit_code, 0) << res.output;
+  size_t summary_pos = res.output.find("==> summary <==");
+  size_t query_pos = res.output.find("==> query --match 'Frame' --limit 1 <==");
+  size_t concurrency_pos = res.output.find("==> concurrency <==");
+  ASSERT_NE(summary_pos, std::string::npos) << res.output;
+  ASSERT_NE(query_pos, std::string::npos) << res.output;
+  ASSERT_NE(concurrency_pos, std::string::npos) << res.output;
+  EXPECT_LT(summary_pos, query_pos);
+  EXPECT_LT(query_pos, concurrency_pos);
+  EXPECT_EQ(res.output.find("aggregate"), std::string::npos);
+
+  std::ifstream f(out_path);
+  ASSERT_TRUE(f.is_open());
+  std::string aggregate((std::istreambuf_iterator<char>(f)),
+                        std::istreambuf_iterator<char>());
+  EXPECT_NE(aggregate.find("Total Duration"), std::string::npos);
+
+  command_result parallel = run_cli("batch " + path + " " + script +
+                                    " --exec concurrency --jobs 4");
+  EXPECT_EQ(parallel.exit_code, 0);
+  EXPECT_EQ(parallel.output, res.output);
+}
+
+// Verify that an invalid batch command is reported before anything runs.
+TEST_F(ztracing_cli_test, batch_rejects_invalid_command) {
+  std::string path = write_temp_trace("batch_invalid.json", STANDARD_MOCK_TRACE);
+
+  command_result res =
+      run_cli("batch " + path + " --exec summary --exec 'query --bogus'");
+  EXPECT_EQ(res.exit_code, 1);
+  EXPECT_NE(res.output.find("Invalid --exec command: query --bogus"),
+            std::string::npos);
+  EXPECT_EQ(res.output.find("Event Count"), std::string::npos);
+}
+
+// Verify that batch rejects commands that would write the same file, and
+// options it cannot honor per command.
+TEST_F(ztracing_cli_test, batch_rejects_shared_output_and_memory) {
+  std::string path = write_temp_trace("batch_shared.json", STANDARD_MOCK_TRACE);
+
+  command_result shared =
+      run_cli("batch " + path +
+              " --exec 'summary > batch_shared.txt'"
+              " --exec 'aggregate > batch_shared.txt' --jobs 2");
+  EXPECT_EQ(shared.exit_code, 1);
+  EXPECT_NE(shared.output.find("More than one command writes to "
+                               "'batch_shared.txt'"),
+            std::string::npos)
+      << shared.output;
+  EXPECT_EQ(shared.output.find("Event Count"), std::string::npos);
+
+  command_result memory =
+      run_cli("batch " + path + " --exec 'summary --memory'");
+  EXPECT_EQ(memory.exit_code, 1);
+  EXPECT_NE(memory.output.find("'--memory' is not supported"),
+            std::string::npos)
+      << memory.output;
+}
+
+// Verify that fleet-aggregate merges every trace matched by a glob.
+TEST_F(ztracing_cli_test, fleet_aggregate_merges_matched_traces) {
+  std::string path_a = write_temp_trace("fleet_a.json", STANDARD_MOCK_TRACE);
+  write_temp_trace("fleet_b.json", STANDARD_MOCK_TRACE);
+  std::string pattern = path_a.substr(0, path_a.rfind("a.json")) + "*.json";
+
+  command_result res = run_cli("fleet-aggregate '" + pattern +
+                               "' --jobs 1 --memory-budget 1 --format csv");
+  EXPECT_EQ(res.exit_code, 0) << res.output;
+  EXPECT_EQ(res.output,
+            "name,traces,count,total_duration_s,mean_duration_ms,"
+            "p50_duration_ms,p95_duration_ms\n"
+            "task_B,2,2,0.002,1,1,1\n"
+            "task_A,2,2,0.001,0.5,0.5,0.5\n");
+
+  command_result table = run_cli("fleet-aggregate '" + pattern + "'");
+  EXPECT_EQ(table.exit_code, 0);
+  EXPECT_NE(table.output.find("Traces: 2"), std::string::npos);
+
+  command_result none = run_cli("fleet-aggregate '" + pattern + ".missing'");
+  EXPECT_EQ(none.exit_code, 1);
+  EXPECT_NE(none.output.find("No trace files match"), std::string::npos);
+}
+
 // Verify the 'concurrency' subcommand output.
 TEST_F(ztracing_cli_test, concurrency_output_matches_golden) {
   std::string path =
@@ -385,6 +709,77 @@ TEST_F(ztracing_cli_test, aggregate_output_matches_golden) {
                        "aggregate_sort_by_count.golden", 0);
 }
 
+// Verify that --metric reports self time, which excludes nested children.
+TEST_F(ztracing_cli_test, aggregate_and_diff_by_self_time) {
+  std::string nested_trace = R"([
+    {"name": "task_A", "cat": "cpu", "ph": "X", "ts": 1000, "dur": 500, "pid": 1, "tid": 1},
+    {"name": "task_B", "cat": "gpu", "ph": "X", "ts": 1500, "dur": 1000, "pid": 1, "tid": 1},
+    {"name": "task_A", "cat": "cpu", "ph": "X", "ts": 2000, "dur": 300, "pid": 1, "tid": 1}
+  ])";
+  std::string path = write_temp_trace("aggregate_self.json", nested_trace);
+
+  command_result both = run_cli("aggregate " + path +
+                                " --metric both --min-count 1 --format csv");
+  EXPECT_EQ(both.exit_code, 0);
+  EXPECT_EQ(both.output,
+            "name,total_duration_s,self_duration_s,count,avg_duration_ms,"
+            "avg_self_duration_ms,p50_duration_ms,p90_duration_ms,"
+            "p99_duration_ms,max_duration_ms\n"
+            "task_B,0.001,0.0007,1,1,0.7,1,1,1,1\n"
+            "task_A,0.0008,0.0008,2,0.4,0.4,0.301913,0.301913,0.301913,0.5\n");
+
+  command_result diff = run_cli("diff " + path + " " + path +
+                                " --metric self --format jsonl");
+  EXPECT_EQ(diff.exit_code, 0);
+  EXPECT_NE(diff.output.find("\"name\":\"task_B\",\"baseline_self_s\":0.0007"),
+            std::string::npos)
+      << diff.output;
+
+  command_result invalid = run_cli("diff " + path + " " + path +
+                                   " --metric both");
+  EXPECT_EQ(invalid.exit_code, 1);
+  EXPECT_NE(invalid.output.find("Expected 'total' or 'self'"),
+            std::string::npos);
+}
+
+// Verify that flamegraph merges the stacks of all threads.
+TEST_F(ztracing_cli_test, flamegraph_merges_stacks_across_threads) {
+  std::string nested_trace = R"([
+    {"name": "Javac", "ph": "X", "ts": 0, "dur": 1000, "pid": 1, "tid": 1},
+    {"name": "parse", "ph": "X", "ts": 100, "dur": 300, "pid": 1, "tid": 1},
+    {"name": "Javac", "ph": "X", "ts": 0, "dur": 500, "pid": 1, "tid": 2},
+    {"name": "parse", "ph": "X", "ts": 0, "dur": 200, "pid": 1, "tid": 2},
+    {"name": "idle", "ph": "X", "ts": 600, "dur": 50, "pid": 1, "tid": 2}
+  ])";
+  std::string path = write_temp_trace("flamegraph.json", nested_trace);
+
+  command_result folded = run_cli("flamegraph " + path);
+  EXPECT_EQ(folded.exit_code, 0);
+  EXPECT_EQ(folded.output,
+            "Javac 1000\n"
+            "Javac;parse 500\n"
+            "idle 50\n");
+
+  command_result under = run_cli("flamegraph " + path +
+                                 " --root parse --format csv");
+  EXPECT_EQ(under.exit_code, 0);
+  EXPECT_EQ(under.output,
+            "stack,name,depth,count,total_us,self_us\n"
+            "parse,parse,1,2,500,500\n");
+
+  command_result window = run_cli("flamegraph " + path +
+                                  " --t-start 300 --t-end 700");
+  EXPECT_EQ(window.exit_code, 0);
+  EXPECT_EQ(window.output,
+            "Javac 500\n"
+            "Javac;parse 100\n"
+            "idle 50\n");
+
+  command_result missing = run_cli("flamegraph " + path + " --root nope");
+  EXPECT_EQ(missing.exit_code, 1);
+  EXPECT_NE(missing.output.find("No events named 'nope'"), std::string::npos);
+}
+
 // Verify the 'aggregate' subcommand with --min-count option.
 TEST_F(ztracing_cli_test, aggregate_min_count_matches_golden) {
   std::string complex_trace = R"([
@@ -427,6 +822,34 @@ TEST_F(ztracing_cli_test, diff_output_matches_golden) {
   // 3. Group by name, sort by count-delta descending
   assert_golden_output("diff " + path_base + " " + path_target + " --sort count-delta",
                        "diff_sort_by_count_delta.golden", 0);
+
+  // 4. A missing target fails the load.
+  command_result missing =
+      run_cli("diff " + path_base + " " + path_target + ".missing");
+  EXPECT_EQ(missing.exit_code, 1);
+}
+
+// Verify that a diff whose traces do not fit --memory-budget together loads
+// them one after another, with the same result.
+TEST_F(ztracing_cli_test, diff_within_memory_budget_matches) {
+  // About 700 KB, so two loads are estimated past 1 MiB.
+  std::string trace = "[";
+  for (int i = 0; i < 8000; i++) {
+    trace += std::string(i ? "," : "") +
+             "{\"name\": \"task_" + std::to_string(i % 7) +
+             "\", \"ph\": \"X\", \"ts\": " + std::to_string(i * 10) +
+             ", \"dur\": 5, \"pid\": 1, \"tid\": 1}";
+  }
+  trace += "]";
+  std::string path = write_temp_trace("diff_budget.json", trace);
+
+  command_result together = run_cli("diff " + path + " " + path);
+  command_result serial =
+      run_cli("diff " + path + " " + path + " --memory-budget 1");
+  EXPECT_EQ(together.exit_code, 0);
+  EXPECT_EQ(serial.exit_code, 0);
+  EXPECT_EQ(serial.output, together.output);
+  EXPECT_NE(serial.output.find("task_6"), std::string::npos);
 }
 
 }  // namespace
@@ -1,3 +1,4 @@
+#include <GLES3/gl3.h>
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -5,8 +6,10 @@
 #include <string.h>
 
 #include "core/counting_allocator.h"
+#include "core/tagged_allocator.h"
 #include "core/logging.h"
 #include "core/darray.h"
+#include "core/self_trace.h"
 #include "src/app.h"
 #include "src/headless_gl.h"
 #include "src/imgui_c.h"
@@ -17,6 +20,13 @@
 static app_t* g_app = nullptr;
 static headless_gl_context_t g_gl_ctx = {};
 static darray_uint8_t g_font_data = {};
+// Time spent submitting the last frame's draw data and waiting for the GPU to
+// finish it, in milliseconds.
+static double g_last_submit_ms = 0.0;
+
+// Output path for self-tracing, taken from the ZTRACING_SELF_TRACE environment
+// variable. Recording is enabled for the whole session when set.
+static const char* g_self_trace_path = nullptr;
 
 static void* imgui_alloc(size_t sz, void* user_data) {
   allocator_t* a = (allocator_t*)user_data;
@@ -39,13 +49,20 @@ static void imgui_free(void* ptr, void* user_data) {
 int ztracing_init(const char* canvas_selector) {
   (void)canvas_selector;
 
+  g_self_trace_path = getenv("ZTRACING_SELF_TRACE");
+  if (g_self_trace_path && g_self_trace_path[0] != '\0') {
+    self_trace_set_thread_name("main");
+    self_trace_set_enabled(true);
+  }
+
   allocator_t* default_allocator = c_allocator();
   g_app = (app_t*)allocator_alloc(default_allocator, sizeof(app_t));
   app_init(g_app, default_allocator);
 
   static allocator_t* imgui_allocator;
-  imgui_allocator =
-      counting_allocator_get_allocator(&g_app->counting_allocator);
+  imgui_allocator = allocator_for_tag(
+      tagged_allocator_get_allocator(&g_app->tagged_allocator),
+      MEMORY_TAG_RENDER);
   ig_set_allocator_functions(imgui_alloc, imgui_free, imgui_allocator);
 
   ig_create_context();
@@ -73,19 +90,46 @@ int ztracing_init(const char* canvas_selector) {
 void ztracing_update(void) {
   assert(g_app != nullptr);
 
-  ig_io_set_display_size(
-      (ig_vec2_t){(float)g_gl_ctx.width, (float)g_gl_ctx.height});
+  ig_vec2_t display_size = {(float)g_gl_ctx.width, (float)g_gl_ctx.height};
+  ig_vec2_t last_display_size = ig_get_io_display_size();
+  if (display_size.x != last_display_size.x ||
+      display_size.y != last_display_size.y) {
+    ig_io_set_display_size(display_size);
+    app_request_redraw(g_app);
+  }
   ig_io_set_delta_time(1.0f / 60.0f);
 
+  SELF_TRACE_BEGIN("frame");
+
   // Poll and process all pending background task completions first
+  double frame_start = platform_get_now();
   app_poll_completions(g_app);
+  double poll_ms = platform_get_now() - frame_start;
 
-  ig_new_frame();
-  app_update(g_app);
-  ig_render();
+  if (ig_io_has_pending_input_events()) {
+    app_request_redraw(g_app);
+  }
 
-  // Render to FBO
-  imgui_impl_webgl_render_draw_data(ig_get_draw_data());
+  // When nothing changed, the FBO keeps the previous frame.
+  if (app_needs_redraw(g_app)) {
+    double update_start = platform_get_now();
+    ig_new_frame();
+    app_update(g_app);
+    ig_render();
+
+    // Render to FBO
+    SELF_TRACE_BEGIN("render");
+    double submit_start = platform_get_now();
+    imgui_impl_webgl_render_draw_data(ig_get_draw_data());
+    glFinish();
+    g_last_submit_ms = platform_get_now() - submit_start;
+    SELF_TRACE_END();
+
+    app_record_frame(g_app, frame_start, poll_ms, submit_start - update_start,
+                     g_last_submit_ms,
+                     imgui_impl_webgl_get_stats().uploaded_bytes);
+  }
+  SELF_TRACE_END();
 }
 
 void ztracing_deinit(void) {
@@ -98,8 +142,17 @@ void ztracing_deinit(void) {
 
   platform_teardown_workers();
 
+  if (self_trace_is_enabled()) {
+    self_trace_set_enabled(false);
+    if (self_trace_write_file(g_self_trace_path, c_allocator())) {
+      LOG_INFO("Self-trace written to %s", g_self_trace_path);
+    } else {
+      LOG_ERROR("Failed to write self-trace to %s", g_self_trace_path);
+    }
+  }
+
   allocator_t* app_allocator =
-      counting_allocator_get_allocator(&g_app->counting_allocator);
+      tagged_allocator_get_allocator(&g_app->tagged_allocator);
   if (g_font_data.ptr) {
     darray_deinit(&g_font_data, app_allocator);
   }
@@ -124,7 +177,7 @@ void ztracing_set_font_data(unsigned char* font_data, int font_size) {
 
   darray_clear(&g_font_data);
   allocator_t* allocator =
-      counting_allocator_get_allocator(&g_app->counting_allocator);
+      tagged_allocator_get_allocator(&g_app->tagged_allocator);
   size_t len = (size_t)font_size;
   darray_resize(&g_font_data, len, allocator);
   memcpy(g_font_data.ptr, font_data, len);
@@ -133,17 +186,18 @@ void ztracing_set_font_data(unsigned char* font_data, int font_size) {
   ig_set_font_data(g_font_data.ptr, (int)g_font_data.len, dpi_scale);
   imgui_impl_webgl_destroy_fonts_texture();
   imgui_impl_webgl_create_fonts_texture();
+  app_request_redraw(g_app);
 }
 
 void* ztracing_malloc(int size) {
   assert(g_app != nullptr);
-  allocator_t* a = counting_allocator_get_allocator(&g_app->counting_allocator);
+  allocator_t* a = tagged_allocator_get_allocator(&g_app->tagged_allocator);
   return allocator_alloc(a, (size_t)size);
 }
 
 void ztracing_free(void* ptr, int size) {
   assert(g_app != nullptr);
-  allocator_t* a = counting_allocator_get_allocator(&g_app->counting_allocator);
+  allocator_t* a = tagged_allocator_get_allocator(&g_app->tagged_allocator);
   allocator_free(a, ptr, (size_t)size);
 }
 
@@ -181,3 +235,5 @@ size_t ztracing_get_allocated_bytes(void) {
 }
 
 app_t* ztracing_headless_get_app(void) { return g_app; }
+
+double ztracing_headless_get_last_submit_ms(void) { return g_last_submit_ms; }
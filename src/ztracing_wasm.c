@@ -7,6 +7,7 @@
 
 #include "core/assert.h"
 #include "core/counting_allocator.h"
+#include "core/tagged_allocator.h"
 #include "core/logging.h"
 #include "core/darray.h"
 #include "src/app.h"
@@ -40,23 +41,18 @@ static void imgui_free(void* ptr, void* user_data) {
 
 static void main_loop() {
   // 1. Poll and process all pending background task completions first
+  double frame_start = platform_get_now();
   app_poll_completions(g_app);
+  double poll_ms = platform_get_now() - frame_start;
 
-  // 2. Check if a redraw has been requested by the app state
-  bool request_update = false;
-  if (g_app->loading.request_update) {
-    g_app->loading.request_update = false;
-    request_update = true;
-  }
-
-  if (request_update) {
-    imgui_impl_wasm_request_update();
-  }
-
-  if (g_app->power_save_mode && !imgui_impl_wasm_need_update()) {
+  // 2. Skip the frame unless input, a completion, a theme or size change or
+  // an animation may have changed it; the canvas keeps the previous frame.
+  // Input and resizes are tracked by imgui_impl_wasm.
+  if (!imgui_impl_wasm_need_update() && !app_needs_redraw(g_app)) {
     return;
   }
 
+  double update_start = platform_get_now();
   imgui_impl_webgl_new_frame();
   imgui_impl_wasm_new_frame();
   ig_new_frame();
@@ -64,6 +60,7 @@ static void main_loop() {
   app_update(g_app);
 
   ig_render();
+  double gl_start = platform_get_now();
 
   ig_vec2_t display_size = ig_get_io_display_size();
   ig_vec2_t fb_scale = ig_get_io_display_framebuffer_scale();
@@ -73,6 +70,9 @@ static void main_loop() {
   glClear(GL_COLOR_BUFFER_BIT);
 
   imgui_impl_webgl_render_draw_data(ig_get_draw_data());
+  app_record_frame(g_app, frame_start, poll_ms, gl_start - update_start,
+                   platform_get_now() - gl_start,
+                   imgui_impl_webgl_get_stats().uploaded_bytes);
 }
 
 EMSCRIPTEN_KEEPALIVE int ztracing_init(const char* canvas_selector) {
@@ -81,8 +81,9 @@ EMSCRIPTEN_KEEPALIVE int ztracing_init(const char* canvas_selector) {
   app_init(g_app, default_allocator);
 
   static allocator_t* imgui_allocator;
-  imgui_allocator =
-      counting_allocator_get_allocator(&g_app->counting_allocator);
+  imgui_allocator = allocator_for_tag(
+      tagged_allocator_get_allocator(&g_app->tagged_allocator),
+      MEMORY_TAG_RENDER);
   ig_set_allocator_functions(imgui_alloc, imgui_free, imgui_allocator);
 
   ig_create_context();
@@ -134,7 +135,7 @@ EMSCRIPTEN_KEEPALIVE void ztracing_set_font_data(unsigned char* font_data,
                                                  int font_size) {
   darray_clear(&g_font_data);
   allocator_t* allocator =
-      counting_allocator_get_allocator(&g_app->counting_allocator);
+      tagged_allocator_get_allocator(&g_app->tagged_allocator);
   size_t len = (size_t)font_size;
   darray_resize(&g_font_data, len, allocator);
   memcpy(g_font_data.ptr, font_data, len);
@@ -149,13 +150,13 @@ EMSCRIPTEN_KEEPALIVE void ztracing_set_font_data(unsigned char* font_data,
 
 EMSCRIPTEN_KEEPALIVE void* ztracing_malloc(int size) {
   expect(g_app != nullptr);
-  allocator_t* a = counting_allocator_get_allocator(&g_app->counting_allocator);
+  allocator_t* a = tagged_allocator_get_allocator(&g_app->tagged_allocator);
   return allocator_alloc(a, (size_t)size);
 }
 
 EMSCRIPTEN_KEEPALIVE void ztracing_free(void* ptr, int size) {
   expect(g_app != nullptr);
-  allocator_t* a = counting_allocator_get_allocator(&g_app->counting_allocator);
+  allocator_t* a = tagged_allocator_get_allocator(&g_app->tagged_allocator);
   allocator_free(a, ptr, (size_t)size);
 }
 
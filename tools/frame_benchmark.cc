@@ -0,0 +1,432 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "core/allocator.h"
+#include "core/json_writer.h"
+#include "src/app.h"
+#include "src/platform.h"
+#include "src/ztracing.h"
+#include "third_party/imgui/imgui.h"
+
+// Exported by ztracing_headless.c for native tools.
+extern "C" app_t* ztracing_headless_get_app(void);
+extern "C" double ztracing_headless_get_last_submit_ms(void);
+
+// Matches the headless GL surface.
+static const float SCREEN_WIDTH = 800.0f;
+// Part of the screen covered by the tracks in the default dock layout.
+static const float TRACKS_LEFT = 100.0f;
+static const float TRACKS_RIGHT = 700.0f;
+static const float TRACKS_TOP = 120.0f;
+static const float TRACKS_BOTTOM = 400.0f;
+
+// Events of the densest visible track spread across the tracks by the label
+// scenarios, so that most blocks are wide enough for a label.
+static const size_t LABEL_DENSE_EVENTS = 20;
+
+static const size_t CHUNK_SIZE = 1024 * 1024;
+static const int MAX_BUFFERED_BYTES = 32 * 1024 * 1024;
+
+struct frame_sample {
+  double step_ms;
+  double draw_ms;
+  double submit_ms;
+  double frame_ms;
+  double upload_bytes;
+  double text_draws;
+};
+
+struct scenario {
+  const char* name;
+  std::vector<frame_sample> samples;
+};
+
+// Runs one frame and records its phase timings into `s`.
+static void frame(scenario* s) {
+  double start = platform_get_now();
+  ztracing_update();
+  double end = platform_get_now();
+  const app_t* app = ztracing_headless_get_app();
+  const trace_viewer_t* tv = &app->trace_viewer;
+  const frame_profiler_t* fp = &app->frame_profiler;
+  s->samples.push_back({
+      .step_ms = tv->frame_stats.step_ms,
+      .draw_ms = tv->frame_stats.draw_ms,
+      .submit_ms = ztracing_headless_get_last_submit_ms(),
+      .frame_ms = end - start,
+      .upload_bytes = (double)frame_profiler_get(fp, fp->len - 1)
+                          ->counters[FRAME_COUNTER_UPLOAD_BYTES],
+      .text_draws = (double)tv->frame_stats.text_draws,
+  });
+}
+
+// Milliseconds from the start of the load until the first trace was shown
+// (the first snapshot, or the whole trace if none was taken), and until the
+// load completed.
+struct load_timings {
+  double first_trace_ms;
+  double load_ms;
+};
+
+static void update_load_timings(load_timings* t, double start) {
+  if (t->first_trace_ms == 0.0 &&
+      ztracing_headless_get_app()->trace_data != nullptr) {
+    t->first_trace_ms = platform_get_now() - start;
+  }
+}
+
+static bool load_file(const char* filename, load_timings* timings) {
+  FILE* f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "error: could not open file %s\n", filename);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  double total = (double)ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  // Feed chunks the way ztracing.js streams a file, with the same
+  // backpressure.
+  double start = platform_get_now();
+  ztracing_begin_session(1, filename, total);
+  double consumed = 0.0;
+  std::vector<char> chunk(CHUNK_SIZE);
+  while (true) {
+    size_t n = fread(chunk.data(), 1, CHUNK_SIZE, f);
+    if (n == 0) {
+      break;
+    }
+    // ztracing_handle_file_chunk frees exactly `n` bytes, so allocate that
+    // much, as ztracing.js does.
+    char* buf = (char*)ztracing_malloc((int)n);
+    memcpy(buf, chunk.data(), n);
+    consumed += (double)n;
+    int buffered =
+        ztracing_handle_file_chunk(1, buf, (int)n, consumed, false);
+    while (buffered > MAX_BUFFERED_BYTES) {
+      ztracing_update();
+      update_load_timings(timings, start);
+      usleep(1000);
+      buffered = ztracing_get_buffered_bytes();
+    }
+  }
+  fclose(f);
+  ztracing_handle_file_chunk(1, nullptr, 0, consumed, true);
+
+  while (ztracing_is_loading_active()) {
+    ztracing_update();
+    update_load_timings(timings, start);
+    usleep(1000);
+  }
+  update_load_timings(timings, start);
+  timings->load_ms = platform_get_now() - start;
+  // Let the dock layout settle with the new timeline.
+  for (int i = 0; i < 3; i++) {
+    ztracing_update();
+  }
+  return ztracing_headless_get_app()->trace_data->events.len > 0;
+}
+
+// Frames at the whole-trace zoom level, the densest view.
+static void run_zoom_out_full(scenario* s) {
+  trace_viewer_t* tv = &ztracing_headless_get_app()->trace_viewer;
+  tv->viewport.start_time = (double)tv->viewport.min_ts;
+  tv->viewport.end_time = (double)tv->viewport.max_ts;
+  ImGui::GetIO().AddMousePosEvent(SCREEN_WIDTH * 0.5f, 20.0f);
+  for (int i = 0; i < 60; i++) {
+    frame(s);
+  }
+}
+
+// Ctrl+wheel zooms in around the middle of the tracks, then back out.
+static void run_zoom(scenario* s) {
+  ImGuiIO& io = ImGui::GetIO();
+  io.AddMousePosEvent((TRACKS_LEFT + TRACKS_RIGHT) * 0.5f,
+                      (TRACKS_TOP + TRACKS_BOTTOM) * 0.5f);
+  io.AddKeyEvent(ImGuiMod_Ctrl, true);
+  for (int i = 0; i < 60; i++) {
+    io.AddMouseWheelEvent(0.0f, i < 30 ? 1.0f : -1.0f);
+    frame(s);
+  }
+  io.AddKeyEvent(ImGuiMod_Ctrl, false);
+  frame(s);
+}
+
+// Drags the timeline right to left and back.
+static void run_pan(scenario* s) {
+  ImGuiIO& io = ImGui::GetIO();
+  float y = (TRACKS_TOP + TRACKS_BOTTOM) * 0.5f;
+  for (int sweep = 0; sweep < 2; sweep++) {
+    float from = sweep == 0 ? TRACKS_RIGHT : TRACKS_LEFT;
+    float to = sweep == 0 ? TRACKS_LEFT : TRACKS_RIGHT;
+    io.AddMousePosEvent(from, y);
+    frame(s);
+    io.AddMouseButtonEvent(0, true);
+    frame(s);
+    for (int i = 1; i <= 60; i++) {
+      io.AddMousePosEvent(from + (to - from) * (float)i / 60.0f, y);
+      frame(s);
+    }
+    io.AddMouseButtonEvent(0, false);
+    frame(s);
+  }
+}
+
+// Wheel scrolls the track list down and back up.
+static void run_scroll(scenario* s) {
+  ImGuiIO& io = ImGui::GetIO();
+  io.AddMousePosEvent((TRACKS_LEFT + TRACKS_RIGHT) * 0.5f,
+                      (TRACKS_TOP + TRACKS_BOTTOM) * 0.5f);
+  for (int i = 0; i < 60; i++) {
+    io.AddMouseWheelEvent(0.0f, i < 30 ? -1.0f : 1.0f);
+    frame(s);
+  }
+}
+
+// Shift-drags a growing box over the tracks.
+static void run_box_select(scenario* s) {
+  ImGuiIO& io = ImGui::GetIO();
+  io.AddKeyEvent(ImGuiMod_Shift, true);
+  io.AddMousePosEvent(TRACKS_LEFT, TRACKS_TOP);
+  frame(s);
+  io.AddMouseButtonEvent(0, true);
+  frame(s);
+  for (int i = 1; i <= 30; i++) {
+    float t = (float)i / 30.0f;
+    io.AddMousePosEvent(TRACKS_LEFT + (TRACKS_RIGHT - TRACKS_LEFT) * t,
+                        TRACKS_TOP + (TRACKS_BOTTOM - TRACKS_TOP) * t);
+    frame(s);
+  }
+  io.AddMouseButtonEvent(0, false);
+  io.AddKeyEvent(ImGuiMod_Shift, false);
+  frame(s);
+}
+
+static void press_ctrl_f(scenario* s) {
+  ImGuiIO& io = ImGui::GetIO();
+  io.AddKeyEvent(ImGuiMod_Ctrl, true);
+  io.AddKeyEvent(ImGuiKey_F, true);
+  frame(s);
+  io.AddKeyEvent(ImGuiKey_F, false);
+  io.AddKeyEvent(ImGuiMod_Ctrl, false);
+  frame(s);
+}
+
+// Types `query` into the search box one character per frame, then runs until
+// the search job finishes.
+static void run_search(scenario* s, const std::string& query) {
+  // The first Ctrl+F opens the Details panel, the second focuses the search
+  // input once the layout has settled.
+  press_ctrl_f(s);
+  for (int i = 0; i < 3; i++) {
+    frame(s);
+  }
+  press_ctrl_f(s);
+
+  ImGuiIO& io = ImGui::GetIO();
+  for (char c : query) {
+    io.AddInputCharacter((unsigned int)(unsigned char)c);
+    frame(s);
+  }
+  const trace_viewer_t* tv = &ztracing_headless_get_app()->trace_viewer;
+  double start = platform_get_now();
+  while (tv->search.is_searching && platform_get_now() - start < 10000.0) {
+    frame(s);
+  }
+  io.AddKeyEvent(ImGuiKey_Escape, true);
+  frame(s);
+  io.AddKeyEvent(ImGuiKey_Escape, false);
+  frame(s);
+}
+
+// Moves the mouse across the tracks along a few rows, showing tooltips.
+static void run_hover(scenario* s) {
+  ImGuiIO& io = ImGui::GetIO();
+  for (int row = 0; row < 4; row++) {
+    float y = TRACKS_TOP + (TRACKS_BOTTOM - TRACKS_TOP) * (float)row / 4.0f;
+    for (int i = 0; i <= 60; i++) {
+      io.AddMousePosEvent(
+          TRACKS_LEFT + (TRACKS_RIGHT - TRACKS_LEFT) * (float)i / 60.0f, y);
+      frame(s);
+    }
+  }
+}
+
+// Zooms in on the middle of the visible thread track with the most events,
+// where a frame draws the most labels. With `cached` false, the label width
+// cache is bypassed and every label is measured every frame.
+static void run_labels(scenario* s, bool cached) {
+  app_t* app = ztracing_headless_get_app();
+  trace_viewer_t* tv = &app->trace_viewer;
+  const trace_data_t* td = app->trace_data;
+  const track_t* densest = nullptr;
+  for (size_t i = tv->visible_track_begin; i < tv->visible_track_end; i++) {
+    const track_t* t = &tv->tracks.ptr[i];
+    if (t->type == TRACK_TYPE_THREAD &&
+        (densest == nullptr ||
+         t->event_indices.len > densest->event_indices.len)) {
+      densest = t;
+    }
+  }
+  if (densest != nullptr && densest->event_indices.len > 0) {
+    size_t count = densest->event_indices.len;
+    size_t first = count / 2;
+    size_t last = std::min(first + LABEL_DENSE_EVENTS, count - 1);
+    const trace_event_persisted_t* first_event =
+        &td->events.ptr[densest->event_indices.ptr[first]];
+    const trace_event_persisted_t* last_event =
+        &td->events.ptr[densest->event_indices.ptr[last]];
+    tv->viewport.start_time = (double)first_event->ts;
+    tv->viewport.end_time = (double)std::max(
+        last_event->ts + last_event->dur, first_event->ts + 1);
+  }
+  text_width_cache_clear(&tv->label_widths);
+  tv->label_widths.bypass = !cached;
+  ImGui::GetIO().AddMousePosEvent(SCREEN_WIDTH * 0.5f, 20.0f);
+  for (int i = 0; i < 60; i++) {
+    frame(s);
+  }
+  tv->label_widths.bypass = false;
+}
+
+// Nearest-rank percentile of sorted `values`.
+static double percentile(const std::vector<double>& values, double p) {
+  size_t rank = (size_t)std::ceil(p * (double)values.size());
+  if (rank > 0) rank--;
+  return values[std::min(rank, values.size() - 1)];
+}
+
+static void write_phase(json_writer_t* w, const char* name,
+                        std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  json_writer_name(w, string_view_from_cstr(name));
+  json_writer_begin_object(w);
+  json_writer_name(w, SV("p50"));
+  json_writer_number_double(w, percentile(values, 0.50));
+  json_writer_name(w, SV("p95"));
+  json_writer_number_double(w, percentile(values, 0.95));
+  json_writer_name(w, SV("p99"));
+  json_writer_number_double(w, percentile(values, 0.99));
+  json_writer_name(w, SV("max"));
+  json_writer_number_double(w, values.back());
+  json_writer_end_object(w);
+}
+
+static void write_load(json_writer_t* w, const load_timings* t) {
+  json_writer_begin_object(w);
+  json_writer_name(w, SV("scenario"));
+  json_writer_string(w, SV("load"));
+  json_writer_name(w, SV("first_trace_ms"));
+  json_writer_number_double(w, t->first_trace_ms);
+  json_writer_name(w, SV("load_ms"));
+  json_writer_number_double(w, t->load_ms);
+  json_writer_end_object(w);
+  json_writer_newline(w);
+}
+
+// Writes one JSON Lines record with the percentiles of each phase.
+static void write_scenario(json_writer_t* w, const scenario* s) {
+  std::vector<double> step, draw, submit, total, upload, text;
+  for (const frame_sample& f : s->samples) {
+    step.push_back(f.step_ms);
+    draw.push_back(f.draw_ms);
+    submit.push_back(f.submit_ms);
+    total.push_back(f.frame_ms);
+    upload.push_back(f.upload_bytes);
+    text.push_back(f.text_draws);
+  }
+  json_writer_begin_object(w);
+  json_writer_name(w, SV("scenario"));
+  json_writer_string(w, string_view_from_cstr(s->name));
+  json_writer_name(w, SV("frames"));
+  json_writer_number_int(w, (int64_t)s->samples.size());
+  if (!s->samples.empty()) {
+    write_phase(w, "step_ms", step);
+    write_phase(w, "draw_ms", draw);
+    write_phase(w, "submit_ms", submit);
+    write_phase(w, "frame_ms", total);
+    write_phase(w, "upload_bytes", upload);
+    write_phase(w, "text_draws", text);
+  }
+  json_writer_end_object(w);
+  json_writer_newline(w);
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <trace_file>\n", argv[0]);
+    return 1;
+  }
+
+  if (ztracing_init("") != 0) {
+    fprintf(stderr, "error: could not initialize headless ztracing\n");
+    return 1;
+  }
+  // Measure every frame, including the ones damage tracking would skip.
+  ztracing_headless_get_app()->power_save_mode = false;
+
+  int result = 0;
+  load_timings timings = {};
+  if (!load_file(argv[1], &timings)) {
+    fprintf(stderr, "error: no events loaded from %s\n", argv[1]);
+    result = 1;
+  } else {
+    // Search for the name of the first event so the query has matches.
+    const trace_data_t* td = ztracing_headless_get_app()->trace_data;
+    string_view_t name = trace_data_get_string(td, td->events.ptr[0].name_ref);
+    std::string query(name.ptr, name.len);
+    if (query.size() > 16) query.resize(16);
+
+    scenario scenarios[] = {
+        {.name = "zoom_out_full"}, {.name = "zoom"},
+        {.name = "pan"},           {.name = "scroll"},
+        {.name = "box_select"},    {.name = "search"},
+        {.name = "hover"},
+    };
+    run_zoom_out_full(&scenarios[0]);
+    run_zoom(&scenarios[1]);
+    run_pan(&scenarios[2]);
+    run_scroll(&scenarios[3]);
+    run_box_select(&scenarios[4]);
+    run_search(&scenarios[5], query);
+    run_hover(&scenarios[6]);
+
+    scenario all = {.name = "all"};
+    for (const scenario& s : scenarios) {
+      all.samples.insert(all.samples.end(), s.samples.begin(),
+                         s.samples.end());
+    }
+
+    // The same label-dense view with and without the label width cache;
+    // not part of "all".
+    scenario labels[] = {
+        {.name = "labels_uncached"},
+        {.name = "labels_cached"},
+    };
+    run_labels(&labels[0], false);
+    run_labels(&labels[1], true);
+
+    allocator_t* a = c_allocator();
+    darray_uint8_t block = {};
+    json_writer_t w;
+    json_writer_init_stream(&w, false, stdout, &block, a);
+    write_load(&w, &timings);
+    for (const scenario& s : scenarios) {
+      write_scenario(&w, &s);
+    }
+    write_scenario(&w, &all);
+    for (const scenario& s : labels) {
+      write_scenario(&w, &s);
+    }
+    json_writer_flush(&w);
+    darray_deinit(&block, a);
+  }
+  ztracing_deinit();
+  return result;
+}
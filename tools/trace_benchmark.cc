@@ -4,6 +4,8 @@
 
 #include "core/allocator.h"
 #include "core/counting_allocator.h"
+#include "core/tagged_allocator.h"
+#include "core/vm_allocator.h"
 #include "src/colors.h"
 #include "src/trace_data.h"
 #include "src/trace_loader.h"
@@ -33,9 +35,13 @@ int main(int argc, char** argv) {
 
   bool is_gzip = (magic_read == 2 && magic[0] == 0x1f && magic[1] == 0x8b);
 
+  vm_allocator_t va;
+  vm_allocator_init(&va, c_allocator());
   counting_allocator_t ca;
-  counting_allocator_init(&ca, c_allocator());
-  allocator_t* a = counting_allocator_get_allocator(&ca);
+  counting_allocator_init(&ca, vm_allocator_get_allocator(&va));
+  tagged_allocator_t ta;
+  tagged_allocator_init(&ta, counting_allocator_get_allocator(&ca));
+  allocator_t* a = tagged_allocator_get_allocator(&ta);
 
   // 1. Benchmark Ingestion (Read + Decompress + Parse + Add + Background
   // Organize)
@@ -49,7 +55,7 @@ int main(int argc, char** argv) {
   auto ingest_start = std::chrono::high_resolution_clock::now();
   trace_data_t* td = trace_loader_load_file(
       filename, a, &decompressed_size, &tracks, &min_ts, &max_ts,
-      &background_ingest_ms, &background_organize_ms);
+      &background_ingest_ms, &background_organize_ms, nullptr);
   auto ingest_end = std::chrono::high_resolution_clock::now();
 
   if (!td) {
@@ -109,6 +115,17 @@ int main(int argc, char** argv) {
   printf("----------------------------------------\n");
   printf("Consumed Memory:       %.2f MB (%zu bytes)\n",
          (double)consumed_mem / (1024.0 * 1024.0), consumed_mem);
+  printf("VM Committed:          %.2f MB (%.2f MB reserved)\n",
+         (double)vm_allocator_get_committed_bytes(&va) / (1024.0 * 1024.0),
+         (double)vm_allocator_get_reserved_bytes(&va) / (1024.0 * 1024.0));
+  for (size_t i = 0; i < MEMORY_TAG_COUNT; i++) {
+    memory_tag_stats_t stats;
+    tagged_allocator_get_stats(&ta, (memory_tag_t)i, &stats);
+    printf("  %-8s current %8.2f MB  peak %8.2f MB  allocs %zu\n",
+           memory_tag_name((memory_tag_t)i),
+           (double)stats.current_bytes / (1024.0 * 1024.0),
+           (double)stats.peak_bytes / (1024.0 * 1024.0), stats.alloc_count);
+  }
   printf("----------------------------------------\n");
 
   // Deinit